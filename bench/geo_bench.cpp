@@ -0,0 +1,125 @@
+/*
+   GeoSet search latency (p50 / p99) with 10M points
+
+   70% of the points are clustered around 500 "cities", the rest is spread uniformly, queries are
+   centred on cities where the data is densest
+
+   Build: cmake -DBUILD_BENCHMARKS=ON .. && cmake --build . --target geo_bench
+   Run:   ./geo_bench [points] [queries]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "GeoSet.h"
+
+namespace
+{
+    constexpr size_t CITIES = 500;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Point
+    {
+        double longitude;
+        double latitude;
+    };
+
+    struct Query
+    {
+        std::string name;
+        GeoSet::Shape shape;
+        size_t count;
+    };
+
+    void runQueries(const GeoSet &set, const std::vector<Point> &centres, const Query &query)
+    {
+        std::vector<double> latencies;
+        latencies.reserve(centres.size());
+        size_t totalResults = 0;
+
+        for (const auto &centre : centres)
+        {
+            auto start = Clock::now();
+            auto matches = set.Search(centre.longitude, centre.latitude, query.shape, GeoSet::Sort::ASC, query.count);
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            totalResults += matches.size();
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p))]; };
+
+        std::cout << std::left << std::setw(28) << query.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << static_cast<double>(totalResults) / centres.size()
+                  << std::setw(12) << percentile(0.50) << std::setw(12) << percentile(0.99)
+                  << std::setw(12) << latencies.back() << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t numPoints = argc > 1 ? std::stoul(argv[1]) : 10'000'000;
+    size_t numQueries = argc > 2 ? std::stoul(argv[2]) : 10'000;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> longitude(-180.0, 180.0);
+    std::uniform_real_distribution<double> latitude(-60.0, 70.0);
+    std::normal_distribution<double> spread(0.0, 0.15); // ~15km
+    std::uniform_int_distribution<size_t> pickCity(0, CITIES - 1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    std::vector<Point> cities(CITIES);
+    for (auto &city : cities)
+        city = {longitude(rng), latitude(rng)};
+
+    auto clampPoint = [](Point p) { return Point{std::clamp(p.longitude, -180.0, 180.0), std::clamp(p.latitude, -85.0, 85.0)}; };
+
+    GeoSet set;
+    auto start = Clock::now();
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        Point point{longitude(rng), latitude(rng)};
+        if (uniform(rng) < 0.7)
+        {
+            const Point &city = cities[pickCity(rng)];
+            point = clampPoint({city.longitude + spread(rng), city.latitude + spread(rng)});
+        }
+
+        bool changed;
+        set.Add("point:" + std::to_string(i), point.longitude, point.latitude, changed);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << "Loaded " << numPoints << " points in " << std::setprecision(2) << std::fixed << seconds << "s ("
+              << static_cast<uint64_t>(numPoints / seconds) << " GEOADD/s), index memory ~"
+              << set.MemoryUsage() / (1024 * 1024) << " MB" << std::endl
+              << std::endl;
+
+    std::vector<Point> centres(numQueries);
+    for (auto &centre : centres)
+    {
+        const Point &city = cities[pickCity(rng)];
+        centre = clampPoint({city.longitude + spread(rng), city.latitude + spread(rng)});
+    }
+
+    std::vector<Query> queries{
+        {"BYRADIUS 500 m", {false, 500}, 0},
+        {"BYRADIUS 2 km", {false, 2000}, 0},
+        {"BYRADIUS 5 km COUNT 10 ASC", {false, 5000}, 10},
+        {"BYRADIUS 50 km COUNT 10 ASC", {false, 50000}, 10},
+        {"BYBOX 4x4 km", {true, 0, 4000, 4000}, 0},
+        {"BYBOX 20x10 km COUNT 10 ASC", {true, 0, 20000, 10000}, 10},
+    };
+
+    std::cout << std::left << std::setw(28) << "query" << std::right << std::setw(12) << "avg results"
+              << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    for (const auto &query : queries)
+        runQueries(set, centres, query);
+
+    return 0;
+}
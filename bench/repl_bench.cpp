@@ -0,0 +1,199 @@
+/*
+   Replication link bandwidth / CPU, plain vs LZ4 framed, over a local socket pair
+
+   A RESP stream of propagated writes goes from a sender thread to a receiver thread the way the master
+   sends it: cut into batches (what piled up in one event loop iteration), each batch framed on its own.
+   Reported per workload and batch size: throughput of the logical stream, bytes on the wire, and the CPU
+   time of both ends. "1GbE s" is the time the wire bytes alone take on a 1 Gbit/s link
+
+   Build: cmake -DBUILD_BENCHMARKS=ON .. && cmake --build . --target repl_bench
+   Run:   ./repl_bench [stream MB]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstring>
+#include <ctime>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Lz4.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Result
+    {
+        double seconds;
+        double senderCpu;
+        double receiverCpu;
+        uint64_t wireBytes;
+        bool intact;
+    };
+
+    double threadCpuSeconds()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    void appendCommand(std::string &out, std::initializer_list<std::string_view> args)
+    {
+        out += "*" + std::to_string(args.size()) + "\r\n";
+        for (auto arg : args)
+        {
+            out += "$" + std::to_string(arg.size()) + "\r\n";
+            out += arg;
+            out += "\r\n";
+        }
+    }
+
+    // SETs of session documents, the kind of values that repeat a lot of structure
+    std::string sessionStream(size_t bytes, std::mt19937_64 &rng)
+    {
+        static const char *agents[] = {"Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 Chrome/120.0",
+                                       "Mozilla/5.0 (Macintosh; Intel Mac OS X 14_2) AppleWebKit/605.1.15 Safari/17.2",
+                                       "Mozilla/5.0 (X11; Linux x86_64; rv:121.0) Gecko/20100101 Firefox/121.0"};
+        std::uniform_int_distribution<uint32_t> id(0, 9'999'999);
+        std::string stream;
+        while (stream.size() < bytes)
+        {
+            std::string value = "{\"user_id\":" + std::to_string(id(rng)) + ",\"ip\":\"10." + std::to_string(id(rng) % 256) + "." +
+                                std::to_string(id(rng) % 256) + ".7\",\"agent\":\"" + agents[id(rng) % 3] +
+                                "\",\"cart\":[" + std::to_string(id(rng) % 5000) + "," + std::to_string(id(rng) % 5000) +
+                                "],\"last_seen\":" + std::to_string(1'700'000'000 + id(rng)) + "}";
+            appendCommand(stream, {"SET", "session:" + std::to_string(id(rng)), value});
+        }
+        return stream;
+    }
+
+    // SETs of random bytes, nothing to gain
+    std::string randomStream(size_t bytes, std::mt19937_64 &rng)
+    {
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::string stream, value(200, '\0');
+        for (uint64_t key = 0; stream.size() < bytes; ++key)
+        {
+            for (auto &c : value)
+                c = static_cast<char>(byte(rng));
+            appendCommand(stream, {"SET", "blob:" + std::to_string(key), value});
+        }
+        return stream;
+    }
+
+    bool sendAll(int fd, const char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+            if (sent <= 0)
+                return false;
+            data += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+    Result run(const std::string &stream, size_t batch, bool lz4)
+    {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+            throw std::runtime_error("socketpair failed");
+
+        Result result{};
+        result.intact = true;
+        std::thread receiver([&]
+        {
+            double cpuStart = threadCpuSeconds();
+            Lz4::FrameDecoder decoder;
+            std::vector<char> buffer(256 * 1024);
+            std::string decoded;
+            size_t received = 0;
+            ssize_t bytes;
+            while ((bytes = recv(pair[1], buffer.data(), buffer.size(), 0)) > 0)
+            {
+                const char *data = buffer.data();
+                size_t length = bytes;
+                if (lz4)
+                {
+                    decoded.clear();
+                    decoder.Feed(buffer.data(), bytes, decoded);
+                    data = decoded.data();
+                    length = decoded.size();
+                }
+                result.intact &= received + length <= stream.size() && std::memcmp(stream.data() + received, data, length) == 0;
+                received += length;
+            }
+            result.intact &= received == stream.size();
+            result.receiverCpu = threadCpuSeconds() - cpuStart;
+        });
+
+        auto start = Clock::now();
+        double cpuStart = threadCpuSeconds();
+        std::string frames;
+        for (size_t pos = 0; pos < stream.size(); pos += batch)
+        {
+            std::string_view chunk = std::string_view(stream).substr(pos, batch);
+            if (lz4)
+            {
+                frames.clear();
+                Lz4::AppendFrames(chunk, frames);
+                chunk = frames;
+            }
+            result.wireBytes += chunk.size();
+            sendAll(pair[0], chunk.data(), chunk.size());
+        }
+        result.senderCpu = threadCpuSeconds() - cpuStart;
+        shutdown(pair[0], SHUT_WR);
+
+        receiver.join();
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        close(pair[0]);
+        close(pair[1]);
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t streamBytes = (argc > 1 ? std::stoul(argv[1]) : 128) << 20;
+
+    std::mt19937_64 rng(42);
+    std::vector<std::pair<std::string, std::string>> workloads{
+        {"sessions", sessionStream(streamBytes, rng)},
+        {"random", randomStream(streamBytes, rng)},
+    };
+
+    std::cout << std::left << std::setw(10) << "workload" << std::setw(8) << "batch" << std::setw(7) << "link"
+              << std::right << std::setw(10) << "MB/s" << std::setw(11) << "wire MB" << std::setw(8) << "ratio"
+              << std::setw(12) << "send cpu s" << std::setw(12) << "recv cpu s" << std::setw(10) << "1GbE s" << std::endl;
+
+    for (const auto &[name, stream] : workloads)
+    {
+        for (size_t batch : {size_t{512}, size_t{64 * 1024}, size_t{1 << 20}})
+        {
+            for (bool lz4 : {false, true})
+            {
+                Result result = run(stream, batch, lz4);
+                std::string batchName = batch >= (1 << 20) ? std::to_string(batch >> 20) + "M" : batch >= 1024 ? std::to_string(batch >> 10) + "K" : std::to_string(batch);
+                std::cout << std::left << std::setw(10) << name << std::setw(8) << batchName << std::setw(7) << (lz4 ? "lz4" : "plain")
+                          << std::right << std::fixed << std::setprecision(1)
+                          << std::setw(10) << stream.size() / result.seconds / (1 << 20)
+                          << std::setw(11) << static_cast<double>(result.wireBytes) / (1 << 20)
+                          << std::setprecision(2) << std::setw(8) << static_cast<double>(stream.size()) / result.wireBytes
+                          << std::setprecision(3) << std::setw(12) << result.senderCpu << std::setw(12) << result.receiverCpu
+                          << std::setw(10) << result.wireBytes / 125e6
+                          << (result.intact ? "" : "  CORRUPT") << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
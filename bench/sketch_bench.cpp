@@ -0,0 +1,93 @@
+/*
+   Update throughput of CountMinSketch and TopK with 1M distinct items
+
+   Build: cmake -DBUILD_BENCHMARKS=ON .. && cmake --build . --target sketch_bench
+   Run:   ./sketch_bench [updates]
+*/
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include "CountMinSketch.h"
+#include "TopK.h"
+
+namespace
+{
+    constexpr size_t DISTINCT_ITEMS = 1'000'000;
+
+    // Zipf like skew (s = 1) over the distinct items, the usual shape of "top endpoints" traffic
+    std::vector<uint32_t> makeWorkload(size_t updates)
+    {
+        std::vector<double> weights(DISTINCT_ITEMS);
+        for (size_t i = 0; i < DISTINCT_ITEMS; ++i)
+            weights[i] = 1.0 / (i + 1);
+
+        std::mt19937_64 rng(42);
+        std::discrete_distribution<uint32_t> distribution(weights.begin(), weights.end());
+
+        std::vector<uint32_t> workload(updates);
+        for (auto &item : workload)
+            item = distribution(rng);
+
+        // make sure every one of the 1M items is seen at least once
+        for (size_t i = 0; i < DISTINCT_ITEMS && i < updates; ++i)
+            workload[i] = i;
+        std::shuffle(workload.begin(), workload.end(), rng);
+
+        return workload;
+    }
+
+    template <typename Fn>
+    void measure(const std::string &name, const std::vector<std::string> &items, const std::vector<uint32_t> &workload, Fn &&update)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t index : workload)
+            update(items[index]);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << name << ": " << workload.size() << " updates in " << elapsed << "s -> "
+                  << static_cast<uint64_t>(workload.size() / elapsed) << " updates/s" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t updates = argc > 1 ? std::stoul(argv[1]) : 10'000'000;
+
+    std::vector<std::string> items(DISTINCT_ITEMS);
+    for (size_t i = 0; i < DISTINCT_ITEMS; ++i)
+        items[i] = "/api/endpoint/" + std::to_string(i);
+
+    auto workload = makeWorkload(updates);
+    std::cout << "Workload: " << updates << " updates over " << DISTINCT_ITEMS << " distinct items" << std::endl;
+
+    auto cms = CountMinSketch::FromErrorRate(0.001, 0.01);
+    measure("CMS.INCRBY (" + std::to_string(cms->Width()) + "x" + std::to_string(cms->Depth()) + ")", items, workload,
+            [&cms](const std::string &item) { cms->IncrBy(item, 1); });
+
+    TopK topk(10, 2000, 5, 0.9);
+    measure("TOPK.ADD (k=10, 2000x5)", items, workload,
+            [&topk](const std::string &item) { topk.IncrBy(item, 1); });
+
+    // Accuracy against exact counts
+    std::unordered_map<uint32_t, uint64_t> exact;
+    for (uint32_t index : workload)
+        ++exact[index];
+
+    std::cout << "Memory: CMS " << cms->MemoryUsage() / 1024 << "KB, TopK " << topk.MemoryUsage() / 1024
+              << "KB (exact counters would need one key per item: " << exact.size() << " keys)" << std::endl;
+
+    std::cout << "Top 10 (item, topk estimate, cms estimate, exact):" << std::endl;
+    for (const auto &[item, count] : topk.List())
+    {
+        uint32_t index = std::stoul(item.substr(item.find_last_of('/') + 1));
+        std::cout << "  " << item << " " << count << " " << cms->Query(item) << " " << exact[index] << std::endl;
+    }
+
+    return 0;
+}
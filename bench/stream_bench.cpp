@@ -0,0 +1,253 @@
+/*
+   Stream memory per entry and range read latency, packed nodes vs the nested std::map layout
+   streams used before
+
+   Heap bytes are counted by replacing the global operator new / delete. Range reads fetch 100 entries
+   from a random start ID: the map layout copies them into the ID keyed map XRANGE used to build, packed
+   nodes are read through Stream::Iterator and RESP encoded into one reply buffer, the way XRANGE is now.
+   The tiered row spills every node but the last to a StreamTier in ./stream_bench_tier first, its bytes
+   are what stays resident and its ranges read the nodes back from the mapped segments
+
+   Build: cmake -DBUILD_BENCHMARKS=ON .. && cmake --build . --target stream_bench
+   Run:   ./stream_bench [entries]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <map>
+#include <new>
+#include <charconv>
+#include <cstdlib>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "Stream.h"
+#include "ConsumerGroup.h"
+#include "RESPEncoder.h"
+
+namespace
+{
+    size_t g_heapBytes = 0;
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = std::malloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    g_heapBytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr)
+        g_heapBytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using MapLayout = std::map<unsigned long, std::map<unsigned long, std::map<std::string, std::string>>>;
+
+    struct Workload
+    {
+        std::string name;
+        std::vector<std::pair<StreamId, std::vector<std::string>>> entries{};
+    };
+
+    // Sensor readings, a few entries per millisecond, always the same fields
+    Workload sensorWorkload(size_t count, std::mt19937_64 &rng)
+    {
+        Workload workload{"sensors"};
+        std::uniform_int_distribution<int> reading(0, 999);
+        uint64_t ms = 1'700'000'000'000;
+        for (size_t index = 0; index < count; ++index)
+        {
+            ms += index % 4 == 0;
+            workload.entries.push_back({{ms, index % 4},
+                                        {"sensor_id", "s-" + std::to_string(reading(rng) % 64), "temperature", std::to_string(reading(rng) / 10.0),
+                                         "humidity", std::to_string(reading(rng) % 100), "status", "ok"}});
+        }
+        return workload;
+    }
+
+    // Application events, the field set changes with the event type
+    Workload eventWorkload(size_t count, std::mt19937_64 &rng)
+    {
+        static const char *types[] = {"login", "view", "purchase"};
+        Workload workload{"events"};
+        std::uniform_int_distribution<uint32_t> id(0, 9'999'999);
+        uint64_t ms = 1'700'000'000'000;
+        for (size_t index = 0; index < count; ++index)
+        {
+            ms += 1 + id(rng) % 20;
+            std::string type = types[id(rng) % 3];
+            std::vector<std::string> fields{"type", type, "user", std::to_string(id(rng))};
+            if (type == "purchase")
+                fields.insert(fields.end(), {"amount", std::to_string(id(rng) % 10000), "currency", "EUR"});
+            else if (type == "view")
+                fields.insert(fields.end(), {"page", "/products/" + std::to_string(id(rng) % 5000)});
+            workload.entries.push_back({{ms, 0}, std::move(fields)});
+        }
+        return workload;
+    }
+
+    std::map<std::string, std::map<std::string, std::string>> mapRange(const MapLayout &store, StreamId start, size_t count)
+    {
+        std::map<std::string, std::map<std::string, std::string>> result;
+        for (auto it = store.lower_bound(start.ms); it != store.end() && result.size() < count; ++it)
+        {
+            for (auto seqIt = it->first == start.ms ? it->second.lower_bound(start.seq) : it->second.begin();
+                 seqIt != it->second.end() && result.size() < count; ++seqIt)
+                result[std::to_string(it->first) + "-" + std::to_string(seqIt->first)] = seqIt->second;
+        }
+        return result;
+    }
+
+    // A full IdList chunk splits in two, an ID landing right at the split point has to stay findable
+    bool idListSplitHolds()
+    {
+        IdList<StreamId> list;
+        for (uint64_t ms = 2; ms <= 2 * IdList<StreamId>::CHUNK_SIZE; ms += 2)
+            list.Insert({ms, 0});
+        StreamId middle{IdList<StreamId>::CHUNK_SIZE + 1, 0};
+        list.Insert(middle);
+        if (list.Size() != IdList<StreamId>::CHUNK_SIZE + 1 || !list.Find(middle))
+            return false;
+        for (uint64_t ms = 2; ms <= 2 * IdList<StreamId>::CHUNK_SIZE; ms += 2)
+            if (!list.Find({ms, 0}))
+                return false;
+        return list.Erase(middle) && !list.Find(middle) && list.Size() == IdList<StreamId>::CHUNK_SIZE;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    constexpr size_t RANGE = 100, QUERIES = 20'000;
+
+    if (!idListSplitHolds())
+    {
+        std::cerr << "IdList: ID inserted at a chunk split is lost" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<Workload> workloads;
+    workloads.push_back(sensorWorkload(count, rng));
+    workloads.push_back(eventWorkload(count, rng));
+
+    std::cout << std::left << std::setw(10) << "workload" << std::setw(8) << "layout" << std::right
+              << std::setw(14) << "bytes/entry" << std::setw(12) << "add ns" << std::setw(14) << "range us" << std::endl;
+
+    for (const auto &workload : workloads)
+    {
+        std::vector<StreamId> starts;
+        std::uniform_int_distribution<size_t> pick(0, workload.entries.size() - RANGE - 1);
+        for (size_t query = 0; query < QUERIES; ++query)
+            starts.push_back(workload.entries[pick(rng)].first);
+
+        // Ranges of RANGE entries, RESP encoded the way XRANGE does
+        auto streamRanges = [](const Stream &stream, const std::vector<StreamId> &starts)
+        {
+            size_t returned = 0;
+            std::string reply;
+            for (const auto &from : starts)
+            {
+                reply.clear();
+                Stream::Iterator iterator(stream, from, {UINT64_MAX, UINT64_MAX});
+                for (size_t entries = 0; entries < RANGE && iterator.Next(); ++entries, ++returned)
+                {
+                    char id[41];
+                    char *idEnd = std::to_chars(id, id + 20, iterator.Id().ms).ptr;
+                    *idEnd++ = '-';
+                    idEnd = std::to_chars(idEnd, id + sizeof(id), iterator.Id().seq).ptr;
+                    RESPEncoder::appendString(reply, std::string_view(id, idEnd - id));
+                    iterator.ForEachField([&reply](std::string_view field, std::string_view value)
+                                          {
+                        RESPEncoder::appendString(reply, field);
+                        RESPEncoder::appendString(reply, value); });
+                }
+            }
+            return returned;
+        };
+
+        auto report = [&](const char *layout, size_t bytes, double addSeconds, double rangeSeconds)
+        {
+            std::cout << std::left << std::setw(10) << workload.name << std::setw(8) << layout << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(14) << static_cast<double>(bytes) / workload.entries.size()
+                      << std::setw(12) << addSeconds * 1e9 / workload.entries.size()
+                      << std::setprecision(2) << std::setw(14) << rangeSeconds * 1e6 / QUERIES << std::endl;
+        };
+
+        {
+            size_t before = g_heapBytes;
+            auto start = Clock::now();
+            auto store = std::make_unique<MapLayout>();
+            for (const auto &[id, fields] : workload.entries)
+            {
+                auto &fieldValues = (*store)[id.ms][id.seq];
+                for (size_t index = 0; index < fields.size(); index += 2)
+                    fieldValues[fields[index]] = fields[index + 1];
+            }
+            double addSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            size_t bytes = g_heapBytes - before;
+
+            start = Clock::now();
+            size_t returned = 0;
+            for (const auto &from : starts)
+                returned += mapRange(*store, from, RANGE).size();
+            report("map", bytes, addSeconds, std::chrono::duration<double>(Clock::now() - start).count());
+            if (returned != RANGE * QUERIES)
+                std::cout << "  short ranges: " << returned << std::endl;
+        }
+
+        {
+            size_t before = g_heapBytes;
+            auto start = Clock::now();
+            auto stream = std::make_unique<Stream>(workload.name);
+            for (const auto &[id, fields] : workload.entries)
+                stream->AddEntry(id.ms, id.seq, fields);
+            double addSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            size_t bytes = g_heapBytes - before;
+
+            start = Clock::now();
+            size_t returned = streamRanges(*stream, starts);
+            report("packed", bytes, addSeconds, std::chrono::duration<double>(Clock::now() - start).count());
+            if (returned != RANGE * QUERIES)
+                std::cout << "  short ranges: " << returned << std::endl;
+        }
+
+        {
+            size_t before = g_heapBytes;
+            auto start = Clock::now();
+            StreamTier tier("stream_bench_tier", 1);
+            auto stream = std::make_unique<Stream>(workload.name);
+            for (const auto &[id, fields] : workload.entries)
+                stream->AddEntry(id.ms, id.seq, fields);
+            stream->SpillOlderThan(UINT64_MAX, tier);
+            double addSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            size_t bytes = g_heapBytes - before;
+
+            start = Clock::now();
+            size_t returned = streamRanges(*stream, starts);
+            report("tiered", bytes, addSeconds, std::chrono::duration<double>(Clock::now() - start).count());
+            if (returned != RANGE * QUERIES)
+                std::cout << "  short ranges: " << returned << std::endl;
+        }
+        rmdir("stream_bench_tier");
+    }
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+   Vector set recall vs latency on a synthetic clustered dataset
+
+   - Distance kernel throughput for every kernel set the CPU supports
+   - FLAT and HNSW indexes, float32 and int8, recall@k against the exact float32 answer and
+     per query latency (mean / p99) for a sweep of HNSW search widths (ef)
+
+   Build: cmake -DBUILD_BENCHMARKS=ON .. && cmake --build . --target vector_bench
+   Run:   ./vector_bench [vectors] [dimension] [queries] [cosine|l2|ip]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_set>
+
+#include "VectorSet.h"
+#include "VectorDistance.h"
+
+namespace
+{
+    constexpr size_t K = 10;
+    constexpr size_t CLUSTERS = 64;
+
+    using Clock = std::chrono::steady_clock;
+
+    // Gaussian blobs around random centres, closer to real embeddings than uniform noise
+    std::vector<float> makeCentres(size_t dimension, std::mt19937_64 &rng)
+    {
+        std::normal_distribution<float> normal(0.0f, 4.0f);
+        std::vector<float> centres(CLUSTERS * dimension);
+        for (auto &value : centres)
+            value = normal(rng);
+        return centres;
+    }
+
+    std::vector<float> makeDataset(const std::vector<float> &centres, size_t count, size_t dimension, std::mt19937_64 &rng)
+    {
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        std::uniform_int_distribution<size_t> cluster(0, CLUSTERS - 1);
+
+        std::vector<float> data(count * dimension);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float *centre = &centres[cluster(rng) * dimension];
+            for (size_t d = 0; d < dimension; ++d)
+                data[i * dimension + d] = centre[d] + normal(rng);
+        }
+
+        return data;
+    }
+
+    void benchmarkKernels(size_t dimension, std::mt19937_64 &rng)
+    {
+        constexpr size_t VECTORS = 4096;
+        constexpr size_t ROUNDS = 50;
+
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        std::vector<float> floats(VECTORS * dimension);
+        std::vector<int8_t> bytes(VECTORS * dimension);
+        for (size_t i = 0; i < floats.size(); ++i)
+        {
+            floats[i] = uniform(rng);
+            bytes[i] = static_cast<int8_t>(floats[i] * 127);
+        }
+
+        std::cout << "Distance kernels (dimension " << dimension << ", ns per distance)" << std::endl;
+        for (const DistanceKernels *kernels : SupportedDistanceKernels())
+        {
+            auto time = [&](auto &&fn)
+            {
+                volatile double sink = 0;
+                auto start = Clock::now();
+                for (size_t round = 0; round < ROUNDS; ++round)
+                    for (size_t i = 1; i < VECTORS; ++i)
+                        sink = sink + fn(i);
+                auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                return elapsed / (ROUNDS * (VECTORS - 1));
+            };
+
+            double dotF32 = time([&](size_t i) { return kernels->dotF32(&floats[0], &floats[i * dimension], dimension); });
+            double l2F32 = time([&](size_t i) { return kernels->l2SquaredF32(&floats[0], &floats[i * dimension], dimension); });
+            double dotI8 = time([&](size_t i) { return kernels->dotI8(&bytes[0], &bytes[i * dimension], dimension); });
+
+            std::cout << "  " << std::left << std::setw(8) << kernels->name << std::fixed << std::setprecision(1)
+                      << " dot f32 " << dotF32 << "  l2 f32 " << l2F32 << "  dot i8 " << dotI8 << std::endl;
+        }
+        std::cout << "  active: " << ActiveDistanceKernels().name << std::endl
+                  << std::endl;
+    }
+
+    struct Result
+    {
+        double recall;
+        double meanUs;
+        double p99Us;
+    };
+
+    Result runQueries(const VectorSet &set, const std::vector<float> &queries, size_t dimension,
+                      const std::vector<std::unordered_set<std::string>> &truth, uint32_t ef)
+    {
+        size_t numQueries = truth.size();
+        std::vector<double> latencies(numQueries);
+        size_t hits = 0;
+
+        for (size_t q = 0; q < numQueries; ++q)
+        {
+            auto start = Clock::now();
+            auto result = set.Search(&queries[q * dimension], K, ef);
+            latencies[q] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+            for (const auto &[element, distance] : result)
+                hits += truth[q].contains(element);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        double total = 0;
+        for (double latency : latencies)
+            total += latency;
+
+        return {static_cast<double>(hits) / (numQueries * K), total / numQueries,
+                latencies[std::min(numQueries - 1, numQueries * 99 / 100)]};
+    }
+
+    std::unique_ptr<VectorSet> build(const std::vector<float> &data, size_t count, size_t dimension, const VectorSet::Options &options, double &seconds)
+    {
+        auto set = std::make_unique<VectorSet>(dimension, options);
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i)
+            set->Add(std::to_string(i), &data[i * dimension]);
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return set;
+    }
+
+    void printRow(const std::string &name, const std::string &ef, const Result &result)
+    {
+        std::cout << std::left << std::setw(12) << name << std::setw(6) << ef << std::right << std::fixed
+                  << std::setprecision(4) << std::setw(10) << result.recall
+                  << std::setprecision(1) << std::setw(12) << result.meanUs << std::setw(12) << result.p99Us
+                  << std::setw(12) << static_cast<uint64_t>(1e6 / result.meanUs) << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 100'000;
+    size_t dimension = argc > 2 ? std::stoul(argv[2]) : 128;
+    size_t numQueries = argc > 3 ? std::stoul(argv[3]) : 500;
+    std::string metricName = argc > 4 ? argv[4] : "cosine";
+
+    VectorSet::Metric metric = metricName == "l2" ? VectorSet::Metric::L2 : metricName == "ip" ? VectorSet::Metric::IP : VectorSet::Metric::COSINE;
+
+    std::mt19937_64 rng(42);
+    benchmarkKernels(dimension, rng);
+
+    std::cout << "Generating " << count << " vectors of dimension " << dimension << " (" << metricName << ")..." << std::endl;
+    std::vector<float> centres = makeCentres(dimension, rng);
+    std::vector<float> data = makeDataset(centres, count, dimension, rng);
+    std::vector<float> queries = makeDataset(centres, numQueries, dimension, rng);
+
+    // Ground truth: exact float32 search
+    VectorSet::Options exactOptions{metric, VectorSet::Quantization::FP32, VectorSet::IndexType::FLAT};
+    double seconds;
+    auto exact = build(data, count, dimension, exactOptions, seconds);
+
+    std::vector<std::unordered_set<std::string>> truth(numQueries);
+    for (size_t q = 0; q < numQueries; ++q)
+        for (const auto &[element, distance] : exact->Search(&queries[q * dimension], K))
+            truth[q].insert(element);
+
+    std::cout << std::endl
+              << std::left << std::setw(12) << "index" << std::setw(6) << "ef" << std::right << std::setw(10) << "recall@10"
+              << std::setw(12) << "mean us" << std::setw(12) << "p99 us" << std::setw(12) << "qps" << std::endl;
+
+    printRow("flat fp32", "-", runQueries(*exact, queries, dimension, truth, 0));
+    exact.reset();
+
+    {
+        VectorSet::Options options{metric, VectorSet::Quantization::INT8, VectorSet::IndexType::FLAT};
+        auto set = build(data, count, dimension, options, seconds);
+        printRow("flat int8", "-", runQueries(*set, queries, dimension, truth, 0));
+    }
+
+    for (auto quantization : {VectorSet::Quantization::FP32, VectorSet::Quantization::INT8})
+    {
+        VectorSet::Options options{metric, quantization, VectorSet::IndexType::HNSW};
+        auto set = build(data, count, dimension, options, seconds);
+
+        std::string name = quantization == VectorSet::Quantization::FP32 ? "hnsw fp32" : "hnsw int8";
+        for (uint32_t ef : {10, 20, 40, 80, 160, 320})
+            printRow(name, std::to_string(ef), runQueries(*set, queries, dimension, truth, ef));
+
+        std::cout << "  " << name << " build: " << std::setprecision(2) << seconds << "s ("
+                  << static_cast<uint64_t>(count / seconds) << " inserts/s), memory "
+                  << set->MemoryUsage() / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    return 0;
+}
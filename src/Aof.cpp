@@ -0,0 +1,394 @@
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <charconv>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Aof.h"
+
+AofReader::AofReader(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed opening " + path + ": " + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed reading " + path + ": " + strerror(errno));
+    }
+
+    m_size = st.st_size;
+    if (m_size > 0)
+    {
+        void *mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed mapping " + path + ": " + strerror(errno));
+        }
+        m_data = static_cast<const char *>(mapped);
+        madvise(mapped, m_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+    close(fd);
+}
+
+AofReader::~AofReader()
+{
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+bool AofReader::readHeader(char type, int64_t &value)
+{
+    if (m_pos >= m_size)
+        return false;
+    if (m_data[m_pos] != type)
+        throw std::runtime_error("Bad AOF format at offset " + std::to_string(m_pos));
+
+    const char *start = m_data + m_pos + 1;
+    const char *end = static_cast<const char *>(std::memchr(start, '\r', m_size - m_pos - 1));
+    if (!end || end + 1 >= m_data + m_size)
+        return false;
+
+    auto [ptr, ec] = std::from_chars(start, end, value);
+    if (ec != std::errc() || ptr != end || end[1] != '\n' || value < 0)
+        throw std::runtime_error("Bad AOF format at offset " + std::to_string(m_pos));
+
+    m_pos = end + 2 - m_data;
+    return true;
+}
+
+bool AofReader::Next(std::vector<std::string> &args)
+{
+    m_pos = m_commandEnd;
+    if (m_pos == m_size)
+        return false;
+
+    // Anything that runs past the end of the file is a write cut short by a crash
+    int64_t count;
+    if (!readHeader('*', count) || static_cast<uint64_t>(count) > m_size - m_pos)
+    {
+        m_truncated = true;
+        return false;
+    }
+    if (count == 0)
+        throw std::runtime_error("Bad AOF format at offset " + std::to_string(m_commandEnd));
+
+    args.resize(count);
+    for (auto &arg : args)
+    {
+        int64_t length;
+        if (!readHeader('$', length) || static_cast<uint64_t>(length) + 2 > m_size - m_pos)
+        {
+            m_truncated = true;
+            return false;
+        }
+        if (m_data[m_pos + length] != '\r' || m_data[m_pos + length + 1] != '\n')
+            throw std::runtime_error("Bad AOF format at offset " + std::to_string(m_pos + length));
+
+        arg.assign(m_data + m_pos, length);
+        m_pos += length + 2;
+    }
+
+    m_commandEnd = m_pos;
+    return true;
+}
+
+bool AppendOnlyFile::ParseFsync(const std::string &value, Fsync &policy)
+{
+    if (value == "always")
+        policy = Fsync::ALWAYS;
+    else if (value == "everysec")
+        policy = Fsync::EVERYSEC;
+    else if (value == "no")
+        policy = Fsync::NO;
+    else
+        return false;
+    return true;
+}
+
+std::string AppendOnlyFile::FsyncName(Fsync policy)
+{
+    switch (policy)
+    {
+    case Fsync::ALWAYS:
+        return "always";
+    case Fsync::EVERYSEC:
+        return "everysec";
+    default:
+        return "no";
+    }
+}
+
+void AppendOnlyFile::Open(const std::string &dir, const std::string &fileName, Fsync policy)
+{
+    m_dir = dir;
+    m_fileName = fileName;
+    m_policy = policy;
+    m_enabled = true;
+
+    if (mkdir(m_dir.c_str(), 0755) < 0 && errno != EEXIST)
+        throw std::runtime_error("Failed creating the AOF directory " + m_dir + ": " + strerror(errno));
+
+    struct stat st;
+    if (stat(manifestPath().c_str(), &st) == 0)
+        readManifest();
+
+    m_baseSize = m_incrSize = 0;
+    for (const auto &file : m_files)
+    {
+        if (stat(PathOf(file.name).c_str(), &st) < 0)
+            throw std::runtime_error("AOF manifest lists " + file.name + " which is missing: " + strerror(errno));
+        (file.type == 'b' ? m_baseSize : m_incrSize) += st.st_size;
+    }
+    m_rewriteSize = CurrentSize();
+}
+
+void AppendOnlyFile::readManifest()
+{
+    std::ifstream manifest(manifestPath());
+    if (!manifest.is_open())
+        throw std::runtime_error("Failed opening " + manifestPath());
+
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        std::string tagFile, tagSeq, tagType, type;
+        ManifestFile file;
+        if (!(fields >> tagFile >> file.name >> tagSeq >> file.seq >> tagType >> type) || tagFile != "file" || tagSeq != "seq"
+            || tagType != "type" || (type != "b" && type != "i" && type != "h") || file.name.find('/') != std::string::npos)
+            throw std::runtime_error("Corrupt AOF manifest " + manifestPath() + ": '" + line + "'");
+
+        // History files are leftovers of a rewrite that did not get to delete them
+        file.type = type[0];
+        if (file.type != 'h')
+            m_files.push_back(std::move(file));
+    }
+
+    if (std::count_if(m_files.begin(), m_files.end(), [](const ManifestFile &file) { return file.type == 'b'; }) > 1)
+        throw std::runtime_error("AOF manifest " + manifestPath() + " lists more than one base file");
+
+    // The base always loads first, incremental files in sequence order
+    std::stable_sort(m_files.begin(), m_files.end(), [](const ManifestFile &a, const ManifestFile &b)
+                     { return a.type != b.type ? a.type == 'b' : a.seq < b.seq; });
+}
+
+void AppendOnlyFile::writeManifest(const std::vector<ManifestFile> &files)
+{
+    std::string manifest;
+    for (const auto &file : files)
+        manifest += "file " + file.name + " seq " + std::to_string(file.seq) + " type " + file.type + "\n";
+
+    std::string tempPath = m_dir + "/temp-" + m_fileName + ".manifest";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = fd >= 0 && write(fd, manifest.data(), manifest.size()) == static_cast<ssize_t>(manifest.size()) && fsync(fd) == 0;
+    std::string reason = strerror(errno);
+    if (fd >= 0)
+        close(fd);
+    if (!written || rename(tempPath.c_str(), manifestPath().c_str()) < 0)
+    {
+        unlink(tempPath.c_str());
+        throw std::runtime_error("Failed writing the AOF manifest: " + (written ? std::string(strerror(errno)) : reason));
+    }
+}
+
+void AppendOnlyFile::openNewIncr()
+{
+    uint64_t seq = 1;
+    for (const auto &file : m_files)
+    {
+        if (file.type == 'i')
+            seq = std::max(seq, file.seq + 1);
+    }
+
+    ManifestFile incr{m_fileName + "." + std::to_string(seq) + ".incr.aof", seq, 'i'};
+    int fd = open(PathOf(incr.name).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Failed creating " + PathOf(incr.name) + ": " + strerror(errno));
+
+    // The file only counts once the manifest lists it
+    auto files = m_files;
+    files.push_back(incr);
+    try
+    {
+        writeManifest(files);
+    }
+    catch (...)
+    {
+        close(fd);
+        unlink(PathOf(incr.name).c_str());
+        throw;
+    }
+
+    m_files = std::move(files);
+    std::lock_guard<std::mutex> lock(m_fsyncMutex);
+    m_fd = fd;
+}
+
+void AppendOnlyFile::StartAppending()
+{
+    if (!m_files.empty() && m_files.back().type == 'i')
+    {
+        std::string path = PathOf(m_files.back().name);
+        m_fd = open(path.c_str(), O_WRONLY | O_APPEND);
+        if (m_fd < 0)
+            throw std::runtime_error("Failed opening " + path + " for appending: " + strerror(errno));
+    }
+    else
+    {
+        openNewIncr();
+    }
+
+    if (m_policy == Fsync::EVERYSEC)
+        m_fsyncThread = std::thread(&AppendOnlyFile::fsyncLoop, this);
+}
+
+bool AppendOnlyFile::Flush()
+{
+    if (m_buffer.empty() || m_fd == -1)
+        return true;
+
+    size_t written = 0;
+    while (written < m_buffer.size())
+    {
+        ssize_t bytes = write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        written += bytes;
+    }
+
+    // A partial write is continued next time, the file stays a valid prefix of the command stream
+    m_buffer.erase(0, written);
+    m_incrSize += written;
+    m_lastWriteOk = m_buffer.empty();
+    if (written == 0)
+        return m_lastWriteOk;
+
+    if (m_policy == Fsync::ALWAYS)
+        fdatasync(m_fd);
+    else if (m_policy == Fsync::EVERYSEC)
+        m_unsynced = true;
+    return m_lastWriteOk;
+}
+
+void AppendOnlyFile::fsyncLoop()
+{
+    std::unique_lock<std::mutex> lock(m_fsyncMutex);
+    while (!m_stopFsync)
+    {
+        m_fsyncCondition.wait_for(lock, std::chrono::seconds(1));
+        if (m_fd != -1 && m_unsynced.exchange(false))
+            fdatasync(m_fd);
+    }
+}
+
+void AppendOnlyFile::closeTail()
+{
+    std::lock_guard<std::mutex> lock(m_fsyncMutex);
+    if (m_fd != -1)
+    {
+        fdatasync(m_fd);
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_unsynced = false;
+}
+
+void AppendOnlyFile::Close()
+{
+    Flush();
+
+    if (m_fsyncThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_fsyncMutex);
+            m_stopFsync = true;
+        }
+        m_fsyncCondition.notify_one();
+        m_fsyncThread.join();
+    }
+
+    closeTail();
+}
+
+void AppendOnlyFile::StartRewrite()
+{
+    Flush();
+    closeTail();
+    openNewIncr();
+    m_rewriteIncrSeq = m_files.back().seq;
+}
+
+std::string AppendOnlyFile::TempBasePath(pid_t pid) const
+{
+    return m_dir + "/temp-rewriteaof-" + std::to_string(pid) + ".rdb";
+}
+
+void AppendOnlyFile::FinishRewrite(const std::string &tempBasePath)
+{
+    uint64_t seq = 1;
+    for (const auto &file : m_files)
+    {
+        if (file.type == 'b')
+            seq = file.seq + 1;
+    }
+
+    ManifestFile base{m_fileName + "." + std::to_string(seq) + ".base.rdb", seq, 'b'};
+    if (rename(tempBasePath.c_str(), PathOf(base.name).c_str()) < 0)
+    {
+        unlink(tempBasePath.c_str());
+        throw std::runtime_error("Failed moving the rewritten AOF base in place: " + std::string(strerror(errno)));
+    }
+
+    std::vector<ManifestFile> files{base};
+    std::vector<ManifestFile> obsolete;
+    for (const auto &file : m_files)
+    {
+        if (file.type == 'i' && file.seq >= m_rewriteIncrSeq)
+            files.push_back(file);
+        else
+            obsolete.push_back(file);
+    }
+
+    try
+    {
+        writeManifest(files);
+    }
+    catch (...)
+    {
+        unlink(PathOf(base.name).c_str());
+        throw;
+    }
+
+    for (const auto &file : obsolete)
+        unlink(PathOf(file.name).c_str());
+    m_files = std::move(files);
+
+    Flush();
+    struct stat st;
+    m_baseSize = m_incrSize = 0;
+    for (const auto &file : m_files)
+    {
+        if (stat(PathOf(file.name).c_str(), &st) == 0)
+            (file.type == 'b' ? m_baseSize : m_incrSize) += st.st_size;
+    }
+    m_rewriteSize = CurrentSize();
+}
@@ -0,0 +1,124 @@
+#ifndef AOF_H
+#define AOF_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+
+/*
+   Append only file, multi part layout of Redis 7
+   - <dir>/<appenddirname> holds a base file (an RDB snapshot), the incremental files written after
+     it and <appendfilename>.manifest listing them in load order: "file <name> seq <n> type b|i"
+   - Write commands are RESP encoded into an in-memory buffer and handed to write(2) once per event
+     loop iteration. appendfsync always fsyncs right after that write, everysec leaves it to a
+     background thread that fsyncs once a second, no leaves it to the kernel
+   - A rewrite switches the tail to a new incremental file first, so the new base only has to cover
+     what came before it; once the base is in place the manifest is swapped and older files go away
+*/
+
+class AofReader
+{
+public:
+    AofReader(const std::string &path);
+    ~AofReader();
+    AofReader(const AofReader &) = delete;
+    AofReader &operator=(const AofReader &) = delete;
+
+    /* Parses the next command of the mapped file into args, false at the end of the file or of its last complete command */
+    bool Next(std::vector<std::string> &args);
+    bool Truncated() const { return m_truncated; } /* the file ends part way through a command */
+    size_t ValidBytes() const { return m_commandEnd; }
+
+private:
+    const char *m_data{};
+    size_t m_size{};
+    size_t m_pos{};
+    size_t m_commandEnd{};
+    bool m_truncated{false};
+
+    bool readHeader(char type, int64_t &value); /* "<type><value>\r\n" */
+};
+
+class AppendOnlyFile
+{
+public:
+    enum class Fsync
+    {
+        ALWAYS,
+        EVERYSEC,
+        NO
+    };
+
+    struct ManifestFile
+    {
+        std::string name;
+        uint64_t seq{};
+        char type{}; /* 'b' base, 'i' incremental */
+    };
+
+    ~AppendOnlyFile() { Close(); }
+
+    static bool ParseFsync(const std::string &value, Fsync &policy);
+    static std::string FsyncName(Fsync policy);
+
+    /* Creates the directory if needed and reads the manifest if there is one */
+    void Open(const std::string &dir, const std::string &fileName, Fsync policy);
+    /* Opens the last incremental file of the manifest for appending, a new one if there is none */
+    void StartAppending();
+    void Close(); /* writes out the buffer, fsyncs and stops the fsync thread */
+
+    bool Enabled() const { return m_enabled; }
+    Fsync Policy() const { return m_policy; }
+    const std::vector<ManifestFile> &Files() const { return m_files; }
+    std::string PathOf(const std::string &name) const { return m_dir + "/" + name; }
+
+    void Feed(std::string_view command) { m_buffer.append(command); }
+    bool HasPendingWrites() const { return !m_buffer.empty(); }
+    size_t BufferLength() const { return m_buffer.size(); }
+    bool Flush(); /* false if the buffer could not be written out completely, the rest is retried next time */
+
+    void StartRewrite(); /* writes from now on go to a new incremental file that outlives the rewrite */
+    std::string TempBasePath(pid_t pid) const;
+    void FinishRewrite(const std::string &tempBasePath); /* installs the new base and manifest, throws on failure */
+
+    uint64_t BaseSize() const { return m_baseSize; }
+    uint64_t CurrentSize() const { return m_baseSize + m_incrSize; }
+    uint64_t SizeAfterLastRewrite() const { return m_rewriteSize; }
+    bool LastWriteOk() const { return m_lastWriteOk; }
+
+private:
+    bool m_enabled{false};
+    Fsync m_policy{Fsync::EVERYSEC};
+    std::string m_dir;
+    std::string m_fileName;
+    std::vector<ManifestFile> m_files;
+    uint64_t m_rewriteIncrSeq{}; /* incremental files from this seq on belong to the rewrite in progress */
+
+    int m_fd{-1};
+    std::string m_buffer;
+    uint64_t m_baseSize{};
+    uint64_t m_incrSize{};
+    uint64_t m_rewriteSize{};
+    bool m_lastWriteOk{true};
+
+    std::thread m_fsyncThread;
+    std::mutex m_fsyncMutex; /* guards m_fd against the fsync thread while the tail file changes */
+    std::condition_variable m_fsyncCondition;
+    std::atomic<bool> m_unsynced{false};
+    bool m_stopFsync{false};
+
+    std::string manifestPath() const { return m_dir + "/" + m_fileName + ".manifest"; }
+    void readManifest();
+    void writeManifest(const std::vector<ManifestFile> &files);
+    void openNewIncr();
+    void closeTail();
+    void fsyncLoop();
+};
+
+#endif // AOF_H
@@ -0,0 +1,216 @@
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "BloomFilter.h"
+#include "Utility.h"
+
+namespace
+{
+    constexpr uint64_t BLOCK_BITS = 512;
+    constexpr double TIGHTENING_RATIO = 0.5; // error rate multiplier for every new layer
+    constexpr double BLOCKED_OVERHEAD = 1.2; // extra space to make up for the higher false positive rate of blocking
+    const double LN2 = std::log(2.0);
+
+    // Bit positions inside a block come from a remix of the hash, the high bits already picked the block
+    inline std::pair<uint32_t, uint32_t> blockHashes(uint64_t hash)
+    {
+        uint64_t x = hash ^ (hash >> 31);
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        return {static_cast<uint32_t>(x), static_cast<uint32_t>(x >> 32) | 1};
+    }
+
+    double bitsPerItem(double errorRate)
+    {
+        return -std::log(errorRate) / (LN2 * LN2);
+    }
+
+    // In double, a capacity times an expansion can be past what fits in 64 bits
+    double layerBytes(double capacity, double errorRate)
+    {
+        return capacity * bitsPerItem(errorRate) * BLOCKED_OVERHEAD / 8;
+    }
+
+    inline uint64_t fastRange(uint64_t hash, uint64_t range)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * range) >> 64);
+    }
+}
+
+BloomFilter::Layer::Layer(uint64_t capacity, double errorRate)
+    : capacity(capacity), errorRate(errorRate)
+{
+    double bitsPerEntry = bitsPerItem(errorRate);
+    hashes = std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil(LN2 * bitsPerEntry)));
+
+    auto bits = static_cast<uint64_t>(std::ceil(capacity * bitsPerEntry * BLOCKED_OVERHEAD));
+    blocks.resize(std::max<uint64_t>(1, (bits + BLOCK_BITS - 1) / BLOCK_BITS)); // value initialized => all zero
+}
+
+bool BloomFilter::Layer::Test(uint64_t hash) const
+{
+    const Block &block = blocks[fastRange(hash, blocks.size())];
+    auto [h1, h2] = blockHashes(hash);
+
+    for (uint32_t i = 0; i < hashes; ++i)
+    {
+        uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+        if ((block.words[bit >> 6] & (1ULL << (bit & 63))) == 0)
+            return false;
+    }
+
+    return true;
+}
+
+void BloomFilter::Layer::Set(uint64_t hash)
+{
+    Block &block = blocks[fastRange(hash, blocks.size())];
+    auto [h1, h2] = blockHashes(hash);
+
+    for (uint32_t i = 0; i < hashes; ++i)
+    {
+        uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+        block.words[bit >> 6] |= 1ULL << (bit & 63);
+    }
+
+    ++count;
+}
+
+BloomFilter::BloomFilter(uint64_t capacity, double errorRate, uint32_t expansion, bool nonScaling)
+    : m_expansion(expansion), m_nonScaling(nonScaling)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("capacity must be positive");
+    // Written so that NaN fails it too
+    if (!(errorRate > 0 && errorRate < 1))
+        throw std::invalid_argument("error rate must be in the range (0, 1)");
+    if (expansion == 0)
+        throw std::invalid_argument("expansion must be positive");
+    if (layerBytes(capacity, errorRate) > MAX_LAYER_BYTES)
+        throw std::invalid_argument("capacity too large for the error rate");
+
+    m_layers.emplace_back(capacity, errorRate);
+}
+
+bool BloomFilter::Add(const std::string &item)
+{
+    uint64_t hash = murmurHash64A(item);
+
+    for (const auto &layer : m_layers)
+    {
+        if (layer.Test(hash))
+            return false;
+    }
+
+    if (m_layers.back().count >= m_layers.back().capacity)
+    {
+        if (m_nonScaling)
+            throw std::runtime_error("non scaling filter is full");
+
+        const Layer &last = m_layers.back();
+        if (layerBytes(static_cast<double>(last.capacity) * m_expansion, last.errorRate * TIGHTENING_RATIO) > MAX_LAYER_BYTES)
+            throw std::runtime_error("filter reached its maximum size");
+        m_layers.emplace_back(last.capacity * m_expansion, last.errorRate * TIGHTENING_RATIO);
+    }
+
+    m_layers.back().Set(hash);
+    return true;
+}
+
+bool BloomFilter::Exists(const std::string &item) const
+{
+    uint64_t hash = murmurHash64A(item);
+
+    // Newest layers are the biggest, so most items live there
+    for (auto it = m_layers.rbegin(); it != m_layers.rend(); ++it)
+    {
+        if (it->Test(hash))
+            return true;
+    }
+
+    return false;
+}
+
+uint64_t BloomFilter::Size() const
+{
+    uint64_t size = 0;
+    for (const auto &layer : m_layers)
+        size += layer.count;
+    return size;
+}
+
+uint64_t BloomFilter::Capacity() const
+{
+    uint64_t capacity = 0;
+    for (const auto &layer : m_layers)
+        capacity += layer.capacity;
+    return capacity;
+}
+
+size_t BloomFilter::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const auto &layer : m_layers)
+        bytes += sizeof(layer) + layer.blocks.size() * sizeof(Block);
+    return bytes;
+}
+
+std::string BloomFilter::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint32_t>(blob, m_expansion);
+    appendBinary<uint8_t>(blob, m_nonScaling);
+    appendBinary<uint64_t>(blob, m_layers.size());
+
+    for (const auto &layer : m_layers)
+    {
+        appendBinary<uint64_t>(blob, layer.capacity);
+        appendBinary<double>(blob, layer.errorRate);
+        appendBinary<uint64_t>(blob, layer.count);
+        appendBinary<uint64_t>(blob, layer.blocks.size());
+        blob.append(reinterpret_cast<const char *>(layer.blocks.data()), layer.blocks.size() * sizeof(Block));
+    }
+
+    return blob;
+}
+
+std::unique_ptr<BloomFilter> BloomFilter::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    std::unique_ptr<BloomFilter> filter(new BloomFilter());
+
+    filter->m_expansion = reader.read<uint32_t>();
+    filter->m_nonScaling = reader.read<uint8_t>();
+    auto numLayers = reader.read<uint64_t>();
+
+    // Held to what BF.RESERVE and scaling accept, nothing is allocated for a header the blob can't back
+    constexpr size_t LAYER_HEADER_BYTES = 4 * sizeof(uint64_t);
+    if (filter->m_expansion == 0 || numLayers == 0 || numLayers > reader.remaining() / (LAYER_HEADER_BYTES + sizeof(Block)))
+        throw std::runtime_error("Corrupted bloom filter");
+
+    for (uint64_t i = 0; i < numLayers; ++i)
+    {
+        auto capacity = reader.read<uint64_t>();
+        auto errorRate = reader.read<double>();
+        auto count = reader.read<uint64_t>();
+        auto numBlocks = reader.read<uint64_t>();
+        if (capacity == 0 || !(errorRate > 0 && errorRate < 1) || layerBytes(capacity, errorRate) > MAX_LAYER_BYTES ||
+            numBlocks > reader.remaining() / sizeof(Block))
+            throw std::runtime_error("Corrupted bloom filter layer");
+
+        Layer &layer = filter->m_layers.emplace_back(capacity, errorRate);
+        if (numBlocks != layer.blocks.size())
+            throw std::runtime_error("Corrupted bloom filter layer");
+
+        layer.count = count;
+        size_t bytes = layer.blocks.size() * sizeof(Block);
+        std::memcpy(layer.blocks.data(), reader.readBytes(bytes), bytes);
+    }
+
+    if (filter->m_layers.empty())
+        throw std::runtime_error("Corrupted bloom filter");
+
+    return filter;
+}
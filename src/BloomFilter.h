@@ -0,0 +1,65 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/*
+   Scalable blocked Bloom filter
+   - Every layer is split into cache line sized blocks (512 bits), all the bits of an item live in
+     one block so a lookup costs a single cache miss per layer
+   - When the last layer reaches its capacity a new one is chained, 'expansion' times bigger and
+     with a tighter error rate so the compound error rate stays close to the requested one
+*/
+
+class BloomFilter
+{
+public:
+    static constexpr double DEFAULT_ERROR_RATE = 0.01;
+    static constexpr uint64_t DEFAULT_CAPACITY = 100;
+    static constexpr uint32_t DEFAULT_EXPANSION = 2;
+    static constexpr uint64_t MAX_LAYER_BYTES = 1ULL << 30; // reserving or growing past it is refused
+
+    BloomFilter(uint64_t capacity, double errorRate, uint32_t expansion = DEFAULT_EXPANSION, bool nonScaling = false);
+
+    /* Returns true if the item was added, false if it (probably) already existed. Throws when a non scaling filter is full */
+    bool Add(const std::string &item);
+    bool Exists(const std::string &item) const;
+
+    uint64_t Size() const;     // number of items added
+    uint64_t Capacity() const; // total capacity of all layers
+    size_t MemoryUsage() const;
+    size_t NumberOfLayers() const { return m_layers.size(); }
+
+    std::string Serialize() const;
+    static std::unique_ptr<BloomFilter> Deserialize(const std::string &blob);
+
+private:
+    struct alignas(64) Block
+    {
+        uint64_t words[8];
+    };
+
+    struct Layer
+    {
+        uint64_t capacity{};
+        double errorRate{};
+        uint32_t hashes{};
+        uint64_t count{};
+        std::vector<Block> blocks;
+
+        Layer(uint64_t capacity, double errorRate);
+        bool Test(uint64_t hash) const;
+        void Set(uint64_t hash);
+    };
+
+    uint32_t m_expansion{DEFAULT_EXPANSION};
+    bool m_nonScaling{false};
+    std::vector<Layer> m_layers;
+
+    BloomFilter() = default;
+};
+
+#endif // BLOOMFILTER_H
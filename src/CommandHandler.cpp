@@ -1,13 +1,15 @@
 
 #include <iostream>
 #include <sys/socket.h>
-#include <sys/time.h>
+#include <chrono>
+#include <charconv>
 
 #include "CommandHandler.h"
 #include "RESPEncoder.h"
 #include "RESPDecoder.h"
 #include "Server.h"
 #include "SocketReader.h"
+#include "HyperLogLog.h"
 
 std::string CommandHandler::PING_cmdHandler(CommandArray commandArgs)
 {
@@ -36,6 +38,10 @@ std::string CommandHandler::SET_cmdHandler(CommandArray commandArgs, KeyValueSto
     {
         return kvStore.set(commandArgs->at(1), commandArgs->at(2), stoi(commandArgs->at(4)));
     }
+    else if (commandArgs->size() == 5 && toLower(commandArgs->at(3)) == "pxat")
+    {
+        return kvStore.setExpireAt(commandArgs->at(1), commandArgs->at(2), stoll(commandArgs->at(4)));
+    }
     else if (commandArgs->size() == 3)
     {
         return kvStore.set(commandArgs->at(1), commandArgs->at(2));
@@ -84,14 +90,81 @@ std::string CommandHandler::INFO_cmdHandler(CommandArray commandArgs, Server& se
         std::string role = server.getReplicationRole();
         std::string result = "role:" + role + "\n";
 
-        if (role == "master")
+        if (role == "slave")
+        {
+            std::string master = server.m_mapConfiguration["replicaof"];
+            bool linkUp = server.m_dMasterConnSocket != -1 && !server.m_replicaLoad.valid();
+            result.append("master_host:" + master.substr(0, master.find(' ')) + "\n");
+            result.append("master_port:" + master.substr(master.find(' ') + 1) + "\n");
+            result.append("master_link_status:" + std::string(linkUp ? "up" : "down") + "\n");
+            result.append("master_sync_in_progress:" + std::to_string(server.m_replicaLoad.valid()) + "\n");
+            result.append("slave_repl_offset:" + std::to_string(server.m_replBacklog.Offset()) + "\n");
+            result.append("master_lag_ms:" + std::to_string(server.replicationLagMs()) + "\n");
+            result.append("master_lag_bytes:" + std::to_string(server.replicationLagBytes()) + "\n");
+        }
+
+        // Replicas can have replicas of their own, they get the stream of their master passed on
+        result.append("connected_slaves:" + std::to_string(server.m_mapReplicaPortSocket.size()) + "\n");
+        int index = 0;
+        for (const auto &[port, fd] : server.m_mapReplicaPortSocket)
         {
-            result.append("master_replid:");
-            result.append(server.m_mapConfiguration["master_replid"]);
-            result.append("\n");
-            result.append("master_repl_offset:");
-            result.append(server.m_mapConfiguration["master_repl_offset"]);
-            result.append("\n");
+            std::string state = "online";
+            if (auto sync = server.m_replicaSyncs.find(fd); sync != server.m_replicaSyncs.end())
+                state = sync->second.state == Server::ReplicaSyncState::WAIT_BGSAVE_END || sync->second.state == Server::ReplicaSyncState::SEND_FILE ? "send_bulk"
+                      : sync->second.state == Server::ReplicaSyncState::WAIT_ACK ? "wait_ack" : "wait_bgsave";
+            // lag: seconds since its last ACK, replicas send one every second
+            int64_t offset = 0, lag = -1;
+            if (auto link = server.m_replicaLinks.find(fd); link != server.m_replicaLinks.end())
+            {
+                offset = link->second.ackOffset;
+                lag = time(nullptr) - link->second.ackTime;
+            }
+            result.append("slave" + std::to_string(index++) + ":port=" + port + ",state=" + state +
+                          ",offset=" + std::to_string(offset) + ",lag=" + std::to_string(lag) + "\n");
+        }
+
+        const ReplicationBacklog &backlog = server.m_replBacklog;
+        result.append("master_replid:" + server.m_replId + "\n");
+        result.append("master_replid2:" + server.m_replId2 + "\n");
+        result.append("master_repl_offset:" + std::to_string(backlog.Offset()) + "\n");
+        result.append("second_repl_offset:" + std::to_string(server.m_secondReplIdOffset) + "\n");
+        result.append("repl_backlog_active:" + std::to_string(backlog.Active()) + "\n");
+        result.append("repl_backlog_size:" + std::to_string(backlog.Size()) + "\n");
+        result.append("repl_backlog_first_byte_offset:" + std::to_string(backlog.FirstOffset()) + "\n");
+        result.append("repl_backlog_histlen:" + std::to_string(backlog.HistLen()) + "\n");
+
+        return RESPEncoder::encodeString(result);
+    }
+
+    if (toLower(commandArgs->at(1)) == "persistence")
+    {
+        bool bgsaveInProgress = server.m_rdbChildPid != -1;
+        std::string result = "loading:0\n";
+        result.append("async_loading:" + std::to_string(server.m_replicaLoad.valid()) + "\n");
+        result.append("rdb_changes_since_last_save:" + std::to_string(server.m_dirty) + "\n");
+        result.append("rdb_bgsave_in_progress:" + std::to_string(bgsaveInProgress) + "\n");
+        result.append("rdb_last_save_time:" + std::to_string(server.m_lastSave) + "\n");
+        result.append("rdb_last_bgsave_status:" + std::string(server.m_rdbLastBgsaveOk ? "ok" : "err") + "\n");
+        result.append("rdb_last_bgsave_time_sec:" + std::to_string(server.m_rdbLastBgsaveTime) + "\n");
+        result.append("rdb_current_bgsave_time_sec:" +
+                      std::to_string(bgsaveInProgress ? time(nullptr) - server.m_rdbSaveTimeStart : -1) + "\n");
+        result.append("rdb_last_cow_size:" + std::to_string(server.m_rdbLastCowSize) + "\n");
+        result.append("rdb_saves:" + std::to_string(server.m_rdbSaves) + "\n");
+        result.append("rdb_snapshot_segments:" + std::to_string(server.m_snapshotSegments) + "\n");
+        result.append("aof_enabled:" + std::to_string(server.m_aof.Enabled()) + "\n");
+        result.append("aof_rewrite_in_progress:" + std::to_string(server.m_aofChildPid != -1) + "\n");
+        result.append("aof_rewrite_scheduled:" + std::to_string(server.m_aofRewriteScheduled) + "\n");
+        result.append("aof_current_rewrite_time_sec:" +
+                      std::to_string(server.m_aofChildPid != -1 ? time(nullptr) - server.m_aofRewriteTimeStart : -1) + "\n");
+        result.append("aof_last_bgrewrite_status:" + std::string(server.m_aofLastRewriteOk ? "ok" : "err") + "\n");
+        result.append("aof_last_write_status:" + std::string(server.m_aof.LastWriteOk() ? "ok" : "err") + "\n");
+        result.append("aof_rewrites:" + std::to_string(server.m_aofRewrites) + "\n");
+        if (server.m_aof.Enabled())
+        {
+            result.append("aof_fsync:" + AppendOnlyFile::FsyncName(server.m_aof.Policy()) + "\n");
+            result.append("aof_current_size:" + std::to_string(server.m_aof.CurrentSize()) + "\n");
+            result.append("aof_base_size:" + std::to_string(server.m_aof.BaseSize()) + "\n");
+            result.append("aof_buffer_length:" + std::to_string(server.m_aof.BufferLength()) + "\n");
         }
 
         return RESPEncoder::encodeString(result);
@@ -100,199 +173,224 @@ std::string CommandHandler::INFO_cmdHandler(CommandArray commandArgs, Server& se
     return RESPEncoder::encodeError("Unsupported INFO section");
 }
 
+std::string CommandHandler::SAVE_cmdHandler(CommandArray commandArgs, Server &server)
+{
+    if (commandArgs->size() != 1)
+        return RESPEncoder::encodeError("wrong number of arguments for 'save' command");
+
+    if (server.m_rdbChildPid != -1)
+        return RESPEncoder::encodeError("Background save already in progress");
+
+    try
+    {
+        server.saveSnapshot();
+    }
+    catch (const std::runtime_error &e)
+    {
+        return RESPEncoder::encodeError(e.what());
+    }
+
+    server.m_dirty = 0;
+    server.m_lastSave = time(nullptr);
+    ++server.m_rdbSaves;
+    return "+OK\r\n";
+}
+
+std::string CommandHandler::BGSAVE_cmdHandler(CommandArray commandArgs, Server &server)
+{
+    if (commandArgs->size() != 1)
+        return RESPEncoder::encodeError("wrong number of arguments for 'bgsave' command");
+
+    std::string error;
+    if (!server.startBackgroundSave(error))
+        return RESPEncoder::encodeError(error);
+
+    return RESPEncoder::encodeSimpleString("Background saving started");
+}
+
+std::string CommandHandler::LASTSAVE_cmdHandler(CommandArray commandArgs, Server &server)
+{
+    if (commandArgs->size() != 1)
+        return RESPEncoder::encodeError("wrong number of arguments for 'lastsave' command");
+
+    return RESPEncoder::encodeInteger(server.m_lastSave);
+}
+
+std::string CommandHandler::BGREWRITEAOF_cmdHandler(CommandArray commandArgs, Server &server)
+{
+    if (commandArgs->size() != 1)
+        return RESPEncoder::encodeError("wrong number of arguments for 'bgrewriteaof' command");
+
+    std::string error;
+    if (!server.startAofRewrite(error))
+        return RESPEncoder::encodeError(error);
+
+    if (server.m_aofRewriteScheduled)
+        return RESPEncoder::encodeSimpleString("Background append only file rewriting scheduled");
+    return RESPEncoder::encodeSimpleString("Background append only file rewriting started");
+}
+
 std::string CommandHandler::REPLCONF_cmdHandler(CommandArray commandArgs, Server &server, const int clientFd)
 {
     if (commandArgs->size() == 3 && commandArgs->at(1) == "listening-port")
     {
         server.m_mapReplicaPortSocket[commandArgs->at(2)] = clientFd;
+        server.m_replicaSyncs[clientFd]; // gets no command stream until its full sync is done
         std::cout << "Got Replica connection [port: " << commandArgs->at(2) << "]" << std::endl;
     }
 
-    if (commandArgs->size() == 3 && toLower(commandArgs->at(1)) == "getack")
+    // "capa <capability>" pairs, unknown ones are ignored. lz4 compresses the link once PSYNC is answered
+    for (size_t index = 1; index + 1 < commandArgs->size(); index += 2)
+    {
+        if (toLower(commandArgs->at(index)) == "capa" && toLower(commandArgs->at(index + 1)) == "lz4")
+            server.m_replicaSyncs[clientFd].lz4 = true;
+    }
+
+    if (commandArgs->size() == 3 && toLower(commandArgs->at(1)) == "ack")
+    {
+        int64_t offset = -1;
+        std::from_chars(commandArgs->at(2).data(), commandArgs->at(2).data() + commandArgs->at(2).size(), offset);
+        server.replicationAck(clientFd, offset);
+        return NO_REPLY; // replicas don't expect a reply to ACKs
+    }
+
+    // The master's clock, once a second in the stream, tells how old a replica's data is
+    if (commandArgs->size() == 3 && toLower(commandArgs->at(1)) == "heartbeat" && clientFd == server.m_dMasterConnSocket)
     {
-        if (toLower(commandArgs->at(1)) == "wait")
-            return RESPEncoder::encodeArray({REPLCONF, "ACK", server.m_mapConfiguration["waitcmd_offset"]});
-        else
-            return RESPEncoder::encodeArray({REPLCONF, "ACK", server.m_mapConfiguration["master_repl_offset"]});
+        int64_t masterTimeMs = 0;
+        std::from_chars(commandArgs->at(2).data(), commandArgs->at(2).data() + commandArgs->at(2).size(), masterTimeMs);
+        server.replicationHeartbeat(masterTimeMs);
     }
 
+    if (commandArgs->size() == 3 && toLower(commandArgs->at(1)) == "getack")
+        return RESPEncoder::encodeArray({REPLCONF, "ACK", std::to_string(server.m_replBacklog.Offset())});
+
     return "+OK\r\n";
 }
 
 std::string CommandHandler::PSYNC_cmdHandler(CommandArray commandArgs, Server &server, const int clientFd)
 {
-    std::string result = "FULLRESYNC " +
-				server.m_mapConfiguration["master_replid"] + " " +
-				server.m_mapConfiguration["master_repl_offset"];
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'psync' command");
+
+    // A replica that has part of our history only gets what it missed, from the backlog
+    if (server.replicationTryPartialSync(clientFd, commandArgs->at(1), commandArgs->at(2)))
+        return NO_REPLY;
+
+    /* FULLRESYNC and a snapshot of the current dataset follow, produced by a child so the event loop keeps going */
+    server.replicationQueueFullSync(clientFd);
+    return NO_REPLY;
+}
+
+std::string CommandHandler::REPLICAOF_cmdHandler(CommandArray commandArgs, Server &server)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for '" + commandArgs->at(0) + "' command");
+
+    if (!(toLower(commandArgs->at(1)) == "no" && toLower(commandArgs->at(2)) == "one"))
+    {
+        int port = 0;
+        auto [ptr, ec] = std::from_chars(commandArgs->at(2).data(), commandArgs->at(2).data() + commandArgs->at(2).size(), port);
+        if (ec != std::errc() || ptr != commandArgs->at(2).data() + commandArgs->at(2).size() || port <= 0 || port > 65535)
+            return RESPEncoder::encodeError("Invalid master port");
+    }
 
-		result = RESPEncoder::encodeSimpleString(result);
+    server.replicationSetMaster(commandArgs->at(1), commandArgs->at(2));
+    return RESPEncoder::encodeSimpleString("OK");
+}
 
-		std::cout << "Sending response..." << std::endl;
-		send(clientFd, result.c_str(), result.length(), 0);
+// READONLY [MAXLAG milliseconds] [MAXOFFSETLAG bytes]
+// READWRITE
+std::string CommandHandler::READONLY_cmdHandler(CommandArray commandArgs, Server &server, const int clientFd)
+{
+    if (commandArgs->at(0) == READWRITE)
+    {
+        if (commandArgs->size() != 1)
+            return RESPEncoder::encodeError("wrong number of arguments for 'readwrite' command");
+        server.m_readBounds.erase(clientFd);
+        return RESPEncoder::encodeSimpleString("OK");
+    }
 
-		/* Send initial empty rdb file */
-		const std::string empty_rdb = "\x52\x45\x44\x49\x53\x30\x30\x31\x31\xfa\x09\
-\x72\x65\x64\x69\x73\x2d\x76\x65\x72\x05\x37\x2e\x32\x2e\x30\xfa\x0a\x72\x65\
-\x64\x69\x73\x2d\x62\x69\x74\x73\xc0\x40\xfa\x05\x63\x74\x69\x6d\x65\xc2\x6d\
-\x08\xbc\x65\xfa\x08\x75\x73\x65\x64\x2d\x6d\x65\x6d\xc2\xb0\xc4\x10\x00\xfa\
-\x08\x61\x6f\x66\x2d\x62\x61\x73\x65\xc0\x00\xff\xf0\x6e\x3b\xfe\xc0\xff\x5a\xa2";
+    // Reads on a master are never stale, the bounds only matter once the client talks to a replica
+    Server::ReadBounds bounds;
+    for (size_t index = 1; index < commandArgs->size(); index += 2)
+    {
+        std::string option = toLower(commandArgs->at(index));
+        int64_t *value = option == "maxlag" ? &bounds.maxLagMs : option == "maxoffsetlag" ? &bounds.maxLagBytes : nullptr;
+        if (!value || index + 1 >= commandArgs->size())
+            return RESPEncoder::encodeError("syntax error");
+
+        const std::string &arg = commandArgs->at(index + 1);
+        auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), *value);
+        if (ec != std::errc() || ptr != arg.data() + arg.size() || *value < 0)
+            return RESPEncoder::encodeError("value is not an integer or out of range");
+    }
 
-		return "$" + std::to_string(empty_rdb.length()) + "\r\n" + empty_rdb;
+    if (bounds.maxLagMs < 0 && bounds.maxLagBytes < 0)
+        server.m_readBounds.erase(clientFd);
+    else
+        server.m_readBounds[clientFd] = bounds;
+    return RESPEncoder::encodeSimpleString("OK");
 }
 
-std::string CommandHandler::WAIT_cmdHandler(CommandArray commandArgs, Server &server)
+std::string CommandHandler::WAIT_cmdHandler(CommandArray commandArgs, Server &server, const int clientFd)
 {
-    if (server.m_mapConfiguration["waitcmd_offset"] == "0")
-		{
-			std::cout << "No write commands yet" << std::endl;
-			return RESPEncoder::encodeInteger(server.m_mapReplicaPortSocket.size());
-		}
-
-		int replicaThreshold = std::stoi(commandArgs->at(1));
-		int timeThreshold = std::stoi(commandArgs->at(2));
-		int replicasMetThreshold = 0;
-
-		std::cout << "Got thresholds: " << replicaThreshold << " " << timeThreshold << std::endl;
-		// Trying FD approach
-		fd_set replSockets, readySockets;
-		FD_ZERO(&replSockets);
-
-		for (auto& replica : server.m_mapReplicaPortSocket)
-		{
-			FD_SET(replica.second, &replSockets);
-
-			std::cout << "Sending req to replica: " << replica.first << " socket: " << replica.second << std::endl;
-			// sendData(replica.second, {REPLCONF, "getack", "wait"});
-			server.sendData(replica.second, {"REPLCONF", "GETACK", "*"});
-		}
-
-		timeval timeUntil;
-		gettimeofday(&timeUntil, nullptr);
-
-		// set timeout
-		timeUntil.tv_usec += timeThreshold * 1000;
-		if (timeUntil.tv_usec > 1000000)
-		{// update seconds
-			timeUntil.tv_sec += timeUntil.tv_usec / 1000000;
-			timeUntil.tv_usec = timeUntil.tv_usec % 1000000;
-		}
-
-		while (true)
-		{
-			timeval timeout;
-			timeout.tv_usec = 0;
-			timeout.tv_sec = 0; // polling; not right need to change
-
-			readySockets = replSockets;
-
-			if (select(FD_SETSIZE, &readySockets, nullptr, nullptr, &timeout) < 0)
-			{
-				std::cout << "select() error or timed out";
-				break;
-			}
-
-			for (int currSock{0}; currSock < FD_SETSIZE; ++currSock)
-			{
-				if (FD_ISSET(currSock, &readySockets))
-				{
-					try
-					{
-						auto ackResponse{SocketReader(currSock).ReadArray()};
-						if (ackResponse.size() == 3)
-						{
-							std::cout << "[Replica: " << currSock << "] is up to date. Offset: " << std::stoi(ackResponse.back()) << std::endl;
-							++replicasMetThreshold;
-						}
-					}
-					catch(const std::exception& e)
-					{
-						FD_CLR(currSock, &replSockets);
-					}
-				}
-			}
-
-			//Check time threshold
-			timeval t;
-			gettimeofday(&t, nullptr);
-
-			if (t.tv_sec > timeUntil.tv_sec || (t.tv_sec == timeUntil.tv_sec && t.tv_usec > timeUntil.tv_usec))
-			{
-				std::cout << "Timed out!" << std::endl;
-				break;
-			}
-		}
-
-		/*
-		timeval timeUntil;
-		gettimeofday(&timeUntil, nullptr);
-
-		// set timeout
-		timeUntil.tv_usec += timeThreshold * 1000;
-		if (timeUntil.tv_usec > 1000000)
-		{// update seconds
-			timeUntil.tv_sec += timeUntil.tv_usec / 1000000;
-			timeUntil.tv_usec = timeUntil.tv_usec % 1000000;
-		}
-
-		std::cout << "Got thresholds: " << replicaThreshold << " " << timeThreshold << std::endl;
-
-		for (auto& replica : m_mapReplicaPortSocket)
-		{
-			try
-			{
-				std::cout << "Checking replica: " << replica.first << std::endl;
-				// sendData(replica.second, {REPLCONF, "getack", "wait"});
-				sendData(replica.second, {"REPLCONF", "GETACK", "*"});
-				auto ackResponse{SocketReader(replica.second).ReadArray()};
-
-				// if (ackResponse.size() == 3 && std::stoi(ackResponse.back()) == std::stoi(m_mapConfiguration["waitcmd_offset"]))
-				if (ackResponse.size() == 3)
-				{
-					std::cout << "[Replica: " << replica.first << "] is up to date. Offset: " << std::stoi(ackResponse.back()) << std::endl;
-					++replicasMetThreshold;
-
-					// if (replicasMetThreshold == replicaThreshold)
-					// {
-					// 	std::cout << "Replica threshold met -> " << replicasMetThreshold << std::endl;
-					// 	break;
-					// }
-				}
-				else
-					throw std::runtime_error("Not up to date");
-			}
-			catch (const std::exception& e)
-			{
-				std::cout << "[Replica: " << replica.first
-					<< "] did not respond or offset not up to date. Error: " << e.what() << std::endl;
-			}
-
-			// Check time threshold
-			// timeval t;
-			// gettimeofday(&t, nullptr);
-
-			// if (t.tv_sec >= timeUntil.tv_sec || t.tv_usec >= timeUntil.tv_usec)
-			// {
-			// 	std::cout << "Timed out!" << std::endl;
-			// 	break;
-			// }
-		}
-		*/
-
-		return RESPEncoder::encodeInteger(replicasMetThreshold);
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'wait' command");
+    if (server.getReplicationRole() == "slave")
+        return RESPEncoder::encodeError("WAIT cannot be used with replica instances");
+
+    int64_t replicas = 0, timeoutMs = 0;
+    for (auto [arg, value] : {std::pair{&commandArgs->at(1), &replicas}, std::pair{&commandArgs->at(2), &timeoutMs}})
+    {
+        auto [ptr, ec] = std::from_chars(arg->data(), arg->data() + arg->size(), *value);
+        if (ec != std::errc() || ptr != arg->data() + arg->size() || *value < 0)
+            return RESPEncoder::encodeError("value is not an integer or out of range");
+    }
+
+    // Everything propagated so far, the client's own writes included
+    int64_t offset = server.m_replBacklog.Offset();
+    size_t acked = server.replicasAcked(offset);
+    if (acked >= static_cast<uint64_t>(replicas))
+        return RESPEncoder::encodeInteger(acked);
+
+    // Parked until enough ACKs come in or the timeout (0 = none) expires, the event loop goes on
+    auto deadline = timeoutMs > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs)
+                                  : std::chrono::steady_clock::time_point::max();
+    server.m_waitingClients.push_back({clientFd, offset, static_cast<size_t>(replicas), deadline});
+    server.m_replGetAckPending = true;
+    return NO_REPLY;
 }
 
-std::string CommandHandler::TYPE_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore, StreamHandler& streamHandler)
+std::string CommandHandler::TYPE_cmdHandler(CommandArray commandArgs, Server& server)
 {
     if (commandArgs->size() != 2)
         return RESPEncoder::encodeError("wrong number of arguments for 'type' command");
 
-    if (kvStore.get(commandArgs->at(1)) != NULL_BULK_ENCODED)
-			return RESPEncoder::encodeSimpleString("string");
-    else
-    {
-        if (streamHandler.IsStreamPresent(commandArgs->at(1)))
-            return RESPEncoder::encodeSimpleString("stream");
-    }
+    const std::string &key = commandArgs->at(1);
+
+    if (server.m_kvStore.get(key) != NULL_BULK_ENCODED)
+        return RESPEncoder::encodeSimpleString("string");
+    else if (server.m_streamHandler.IsStreamPresent(key))
+        return RESPEncoder::encodeSimpleString("stream");
+    else if (server.m_filterHandler.IsBloomFilterPresent(key))
+        return RESPEncoder::encodeSimpleString("MBbloom--"); // same type names as the RedisBloom module
+    else if (server.m_filterHandler.IsCuckooFilterPresent(key))
+        return RESPEncoder::encodeSimpleString("MBbloomCF");
+    else if (server.m_sketchHandler.IsCountMinSketchPresent(key))
+        return RESPEncoder::encodeSimpleString("CMSk-TYPE");
+    else if (server.m_sketchHandler.IsTopKPresent(key))
+        return RESPEncoder::encodeSimpleString("TopK-TYPE");
+    else if (server.m_timeSeriesHandler.IsTimeSeriesPresent(key))
+        return RESPEncoder::encodeSimpleString("TSDB-TYPE");
+    else if (server.m_vectorHandler.IsVectorSetPresent(key))
+        return RESPEncoder::encodeSimpleString("vectorset");
+    else if (server.m_geoHandler.IsGeoSetPresent(key))
+        return RESPEncoder::encodeSimpleString("zset"); // geo keys are sorted sets in Redis
+    else if (server.m_hashHandler.IsHashPresent(key))
+        return RESPEncoder::encodeSimpleString("hash");
+    else if (server.m_jsonHandler.IsJsonPresent(key))
+        return RESPEncoder::encodeSimpleString("ReJSON-RL");
 
     return RESPEncoder::encodeSimpleString("none");
 }
@@ -362,3 +460,103 @@ std::string CommandHandler::SUBSCRIPTION_cmdHandler(CommandArray commandArgs, Se
 	return RESPEncoder::encodeError("Can't execute '" + commandArgs->at(0) + "' in subscribed mode");
 }
 
+
+std::string CommandHandler::PFADD_cmdHandler(CommandArray commandArgs, KeyValueStore &kvStore)
+{
+    if (commandArgs->size() < 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'pfadd' command");
+
+    std::string currentValue = kvStore.get(commandArgs->at(1));
+    std::string hll;
+    bool updated = false;
+
+    if (currentValue == NULL_BULK_ENCODED)
+    {
+        hll = HyperLogLog::CreateEmpty();
+        updated = true; // creating the key counts as an update
+    }
+    else
+    {
+        hll = *RESPDecoder::decodeString(currentValue);
+        if (!HyperLogLog::IsValid(hll))
+            return RESPEncoder::encodeError("Key is not a valid HyperLogLog string value");
+    }
+
+    for (auto it = commandArgs->begin() + 2; it != commandArgs->end(); ++it)
+        updated |= HyperLogLog::Add(hll, *it);
+
+    if (updated)
+        kvStore.set(commandArgs->at(1), hll);
+
+    return RESPEncoder::encodeInteger(updated ? 1 : 0);
+}
+
+std::string CommandHandler::PFCOUNT_cmdHandler(CommandArray commandArgs, KeyValueStore &kvStore)
+{
+    if (commandArgs->size() < 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'pfcount' command");
+
+    if (commandArgs->size() == 2)
+    {
+        std::string currentValue = kvStore.get(commandArgs->at(1));
+        if (currentValue == NULL_BULK_ENCODED)
+            return RESPEncoder::encodeInteger(0);
+
+        std::string hll = *RESPDecoder::decodeString(currentValue);
+        if (!HyperLogLog::IsValid(hll))
+            return RESPEncoder::encodeError("Key is not a valid HyperLogLog string value");
+
+        bool cacheUpdated = false;
+        uint64_t cardinality = HyperLogLog::Count(hll, cacheUpdated);
+        if (cacheUpdated)
+            kvStore.set(commandArgs->at(1), hll); // only the cached cardinality changed, no need to propagate
+
+        return RESPEncoder::encodeInteger(cardinality);
+    }
+
+    // Multiple keys: cardinality of the union, computed on a temporary merged set of registers
+    std::vector<uint8_t> merged(HyperLogLog::REGISTERS, 0), registers(HyperLogLog::REGISTERS);
+    for (auto it = commandArgs->begin() + 1; it != commandArgs->end(); ++it)
+    {
+        std::string currentValue = kvStore.get(*it);
+        if (currentValue == NULL_BULK_ENCODED)
+            continue;
+
+        std::string hll = *RESPDecoder::decodeString(currentValue);
+        if (!HyperLogLog::IsValid(hll))
+            return RESPEncoder::encodeError("Key is not a valid HyperLogLog string value");
+
+        HyperLogLog::UnpackRegisters(hll, registers.data());
+        HyperLogLog::MergeRegisters(merged.data(), registers.data());
+    }
+
+    return RESPEncoder::encodeInteger(HyperLogLog::CountRegisters(merged.data()));
+}
+
+std::string CommandHandler::PFMERGE_cmdHandler(CommandArray commandArgs, KeyValueStore &kvStore)
+{
+    if (commandArgs->size() < 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'pfmerge' command");
+
+    std::vector<uint8_t> merged(HyperLogLog::REGISTERS, 0), registers(HyperLogLog::REGISTERS);
+    bool allSparse = true;
+
+    // Destination key takes part in the merge too if it exists
+    for (auto it = commandArgs->begin() + 1; it != commandArgs->end(); ++it)
+    {
+        std::string currentValue = kvStore.get(*it);
+        if (currentValue == NULL_BULK_ENCODED)
+            continue;
+
+        std::string hll = *RESPDecoder::decodeString(currentValue);
+        if (!HyperLogLog::IsValid(hll))
+            return RESPEncoder::encodeError("Key is not a valid HyperLogLog string value");
+
+        allSparse &= HyperLogLog::IsSparse(hll);
+        HyperLogLog::UnpackRegisters(hll, registers.data());
+        HyperLogLog::MergeRegisters(merged.data(), registers.data());
+    }
+
+    kvStore.set(commandArgs->at(1), HyperLogLog::FromRegisters(merged.data(), allSparse));
+    return RESPEncoder::encodeSimpleString("OK");
+}
@@ -24,16 +24,24 @@ public:
     static std::string SET_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
     static std::string GET_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
     static std::string CONFIG_cmdHandler(CommandArray commandArgs, std::unordered_map<std::string, std::string>& mapConfiguration);
-    //static std::string SAVE_cmdHandler(CommandArray commandArgs);
+    static std::string SAVE_cmdHandler(CommandArray commandArgs, Server& server);
+    static std::string BGSAVE_cmdHandler(CommandArray commandArgs, Server& server);
+    static std::string LASTSAVE_cmdHandler(CommandArray commandArgs, Server& server);
+    static std::string BGREWRITEAOF_cmdHandler(CommandArray commandArgs, Server& server);
     static std::string KEYS_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
     static std::string INFO_cmdHandler(CommandArray commandArgs, Server& server);
     static std::string REPLCONF_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd);
     static std::string PSYNC_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd);
-    static std::string WAIT_cmdHandler(CommandArray commandArgs, Server& server);
-    static std::string TYPE_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore, StreamHandler& streamHandler);
+    static std::string WAIT_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd);
+    static std::string REPLICAOF_cmdHandler(CommandArray commandArgs, Server& server); // REPLICAOF, SLAVEOF
+    static std::string READONLY_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd); // READONLY, READWRITE
+    static std::string TYPE_cmdHandler(CommandArray commandArgs, Server& server);
     static std::string INCR_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
     static std::string TRANSACTION_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd); // MULTI, EXEC, DISCARD
     static std::string SUBSCRIPTION_cmdHandler(CommandArray commandArgs, Server& server, const int clientFd);
+    static std::string PFADD_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
+    static std::string PFCOUNT_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
+    static std::string PFMERGE_cmdHandler(CommandArray commandArgs, KeyValueStore& kvStore);
 };
 
 
@@ -0,0 +1,127 @@
+#include <stdexcept>
+
+#include "ConsumerGroup.h"
+#include "Utility.h"
+
+Consumer *ConsumerGroup::FindConsumer(std::string_view name)
+{
+    auto consumer = m_consumers.find(name);
+    return consumer == m_consumers.end() ? nullptr : &consumer->second;
+}
+
+std::pair<Consumer *, bool> ConsumerGroup::AddConsumer(const std::string &name, uint64_t now)
+{
+    auto [consumer, created] = m_consumers.try_emplace(name);
+    if (created)
+    {
+        consumer->second.name = name;
+        consumer->second.seenTime = now;
+    }
+    return {&consumer->second, created};
+}
+
+size_t ConsumerGroup::DeleteConsumer(std::string_view name)
+{
+    auto consumer = m_consumers.find(name);
+    if (consumer == m_consumers.end())
+        return 0;
+
+    size_t pending = consumer->second.pending.Size();
+    consumer->second.pending.ForEach([this](const StreamId &id)
+                                     { m_pending.Erase(id); });
+    m_consumers.erase(consumer);
+    return pending;
+}
+
+PendingEntry &ConsumerGroup::Deliver(const StreamId &id, Consumer &consumer, uint64_t now)
+{
+    auto [entry, inserted] = m_pending.Insert({id, &consumer, now, 1});
+    if (inserted)
+        consumer.pending.Insert(id);
+    else
+    {
+        Transfer(*entry, consumer);
+        entry->deliveryTime = now;
+        entry->deliveryCount = 1;
+    }
+    return *entry;
+}
+
+void ConsumerGroup::Transfer(PendingEntry &entry, Consumer &consumer)
+{
+    if (entry.consumer == &consumer)
+        return;
+    entry.consumer->pending.Erase(entry.id);
+    consumer.pending.Insert(entry.id);
+    entry.consumer = &consumer;
+}
+
+bool ConsumerGroup::Ack(const StreamId &id)
+{
+    PendingEntry *entry = m_pending.Find(id);
+    if (!entry)
+        return false;
+    entry->consumer->pending.Erase(id);
+    m_pending.Erase(id);
+    return true;
+}
+
+void ConsumerGroup::Serialize(std::string &blob) const
+{
+    appendBinary<uint64_t>(blob, m_lastDelivered.ms);
+    appendBinary<uint64_t>(blob, m_lastDelivered.seq);
+
+    appendBinary<uint64_t>(blob, m_consumers.size());
+    for (const auto &[name, consumer] : m_consumers)
+    {
+        appendBinaryString(blob, name);
+        appendBinary<uint64_t>(blob, consumer.seenTime);
+        appendBinary<uint64_t>(blob, consumer.activeTime);
+    }
+
+    appendBinary<uint64_t>(blob, m_pending.Size());
+    m_pending.ForEach([&blob](const PendingEntry &entry)
+                      {
+        appendBinary<uint64_t>(blob, entry.id.ms);
+        appendBinary<uint64_t>(blob, entry.id.seq);
+        appendBinaryString(blob, entry.consumer->name);
+        appendBinary<uint64_t>(blob, entry.deliveryTime);
+        appendBinary<uint64_t>(blob, entry.deliveryCount); });
+}
+
+std::unique_ptr<ConsumerGroup> ConsumerGroup::Deserialize(BinaryReader &reader)
+{
+    StreamId lastDelivered;
+    lastDelivered.ms = reader.read<uint64_t>();
+    lastDelivered.seq = reader.read<uint64_t>();
+    auto group = std::make_unique<ConsumerGroup>(lastDelivered);
+
+    // Every consumer and pending entry takes at least its fixed size fields, more than the rest of the
+    // blob can hold is corrupt
+    auto consumers = reader.read<uint64_t>();
+    if (consumers > reader.remaining() / (3 * sizeof(uint64_t)))
+        throw std::runtime_error("Corrupted consumer group");
+    for (; consumers > 0; --consumers)
+    {
+        Consumer &consumer = *group->AddConsumer(reader.readString(), 0).first;
+        consumer.seenTime = reader.read<uint64_t>();
+        consumer.activeTime = reader.read<uint64_t>();
+    }
+
+    auto pending = reader.read<uint64_t>();
+    if (pending > reader.remaining() / (5 * sizeof(uint64_t)))
+        throw std::runtime_error("Corrupted consumer group");
+    for (; pending > 0; --pending)
+    {
+        PendingEntry entry;
+        entry.id.ms = reader.read<uint64_t>();
+        entry.id.seq = reader.read<uint64_t>();
+        entry.consumer = group->AddConsumer(reader.readString(), 0).first;
+        entry.deliveryTime = reader.read<uint64_t>();
+        entry.deliveryCount = reader.read<uint64_t>();
+        group->m_pending.Insert(entry);
+        entry.consumer->pending.Insert(entry.id);
+    }
+
+    return group;
+}
@@ -0,0 +1,232 @@
+#ifndef CONSUMERGROUP_H
+#define CONSUMERGROUP_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+
+#include "Stream.h"
+#include "RadixTree.h"
+
+/*
+   Stream consumer groups
+   - A group hands every entry after its last delivered ID to one of its consumers, the entry stays
+     pending (in the group's PEL) until it is acknowledged or claimed by another consumer
+   - The PEL is kept in ID order twice: once for the group with the delivery details, and as bare IDs
+     per consumer, so a consumer's own history and XPENDING for one consumer don't scan the others
+   - Both are IdLists: sorted chunks of up to 128 values under a radix tree keyed by each chunk's
+     first ID, about 40 bytes per pending entry plus 16 in its consumer's list
+*/
+
+/* Values ordered by StreamId: StreamIds themselves, or anything with an `id` member */
+template <typename T>
+class IdList
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 128;
+
+    // Lookups hand out the values for modification like RadixTree does. Inserts and erases move the
+    // values of the chunk they touch, so pointers from before one of those are stale
+
+    size_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+
+    T *Find(const StreamId &id) const
+    {
+        Chunk *chunk = m_chunks.Floor(id.Bytes());
+        if (!chunk)
+            return nullptr;
+        auto value = position(*chunk, id);
+        return value != chunk->values.end() && idOf(*value) == id ? &*value : nullptr;
+    }
+
+    /* First value with an ID >= id */
+    T *LowerBound(const StreamId &id) const
+    {
+        if (Chunk *chunk = m_chunks.Floor(id.Bytes()))
+        {
+            auto value = position(*chunk, id);
+            if (value != chunk->values.end())
+                return &*value;
+        }
+        // Any later chunk starts past id
+        StreamId next = id;
+        if (!next.Increment())
+            return nullptr;
+        Chunk *chunk = m_chunks.LowerBound(next.Bytes());
+        return chunk ? &chunk->values.front() : nullptr;
+    }
+
+    /* First value with an ID > id */
+    T *After(const StreamId &id) const
+    {
+        StreamId next = id;
+        return next.Increment() ? LowerBound(next) : nullptr;
+    }
+
+    T *First() const
+    {
+        Chunk *chunk = m_chunks.First();
+        return chunk ? &chunk->values.front() : nullptr;
+    }
+
+    T *Last() const
+    {
+        Chunk *chunk = m_chunks.Last();
+        return chunk ? &chunk->values.back() : nullptr;
+    }
+
+    /* The value with its ID, second is false if one was there already (and left as is) */
+    std::pair<T *, bool> Insert(const T &value)
+    {
+        const StreamId &id = idOf(value);
+        Chunk *chunk = m_chunks.Floor(id.Bytes());
+        if (!chunk)
+            return {newChunk(value), true};
+
+        auto at = position(*chunk, id);
+        if (at != chunk->values.end() && idOf(*at) == id)
+            return {&*at, false};
+
+        if (chunk->values.size() >= CHUNK_SIZE)
+        {
+            // Deliveries come in ID order, past the end of a full chunk starts the next one
+            if (at == chunk->values.end())
+                return {newChunk(value), true};
+
+            // Otherwise split, the upper half moves to a chunk of its own
+            size_t offset = at - chunk->values.begin();
+            Chunk upper{idOf(chunk->values[CHUNK_SIZE / 2]), {chunk->values.begin() + CHUNK_SIZE / 2, chunk->values.end()}};
+            chunk->values.resize(CHUNK_SIZE / 2);
+            StreamId upperKey = upper.key;
+            m_chunks.Insert(upperKey.Bytes(), std::move(upper));
+            // An ID that sorts right before the upper half stays at the end of the lower one: the upper
+            // chunk is keyed by its first value, lookups of anything smaller go to the lower chunk
+            if (offset > CHUNK_SIZE / 2)
+            {
+                chunk = m_chunks.Find(upperKey.Bytes());
+                offset -= CHUNK_SIZE / 2;
+            }
+            at = chunk->values.begin() + offset;
+        }
+
+        ++m_size;
+        return {&*chunk->values.insert(at, value), true};
+    }
+
+    bool Erase(const StreamId &id)
+    {
+        Chunk *chunk = m_chunks.Floor(id.Bytes());
+        if (!chunk)
+            return false;
+        auto value = position(*chunk, id);
+        if (value == chunk->values.end() || idOf(*value) != id)
+            return false;
+
+        chunk->values.erase(value);
+        --m_size;
+        if (chunk->values.empty())
+            m_chunks.Erase(chunk->key.Bytes());
+        return true;
+    }
+
+    template <typename F>
+    void ForEach(F &&f) const
+    {
+        for (Chunk *chunk = m_chunks.First(); chunk; chunk = chunkAfter(*chunk))
+        {
+            for (const T &value : chunk->values)
+                f(value);
+        }
+    }
+
+private:
+    struct Chunk
+    {
+        StreamId key; // ID of its first value when it was made, all its values are at or past it
+        std::vector<T> values;
+    };
+
+    RadixTree<Chunk, 16> m_chunks;
+    size_t m_size{};
+
+    static const StreamId &idOf(const StreamId &id) { return id; }
+    template <typename V>
+    static const StreamId &idOf(const V &value) { return value.id; }
+
+    static typename std::vector<T>::iterator position(Chunk &chunk, const StreamId &id)
+    {
+        return std::lower_bound(chunk.values.begin(), chunk.values.end(), id,
+                                [](const T &value, const StreamId &target) { return idOf(value) < target; });
+    }
+
+    T *newChunk(const T &value)
+    {
+        m_chunks.Insert(idOf(value).Bytes(), Chunk{idOf(value), {value}});
+        ++m_size;
+        return &m_chunks.Find(idOf(value).Bytes())->values.front();
+    }
+
+    Chunk *chunkAfter(const Chunk &chunk) const
+    {
+        StreamId next = idOf(chunk.values.back());
+        return next.Increment() ? m_chunks.LowerBound(next.Bytes()) : nullptr;
+    }
+};
+
+struct Consumer;
+
+struct PendingEntry
+{
+    StreamId id;
+    Consumer *consumer{};
+    uint64_t deliveryTime{}; // unix ms of the last delivery
+    uint64_t deliveryCount{};
+};
+
+struct Consumer
+{
+    std::string name;
+    uint64_t seenTime{};   // unix ms it last read or claimed
+    uint64_t activeTime{}; // unix ms it last got entries, 0 if never
+    IdList<StreamId> pending;
+};
+
+class ConsumerGroup
+{
+public:
+    explicit ConsumerGroup(const StreamId &lastDelivered) : m_lastDelivered(lastDelivered) {}
+
+    const StreamId &LastDelivered() const { return m_lastDelivered; }
+    void SetLastDelivered(const StreamId &id) { m_lastDelivered = id; }
+
+    Consumer *FindConsumer(std::string_view name);
+    /* Creates it if missing, second is false if it existed */
+    std::pair<Consumer *, bool> AddConsumer(const std::string &name, uint64_t now);
+    /* Its pending entries are dropped with it, returns how many */
+    size_t DeleteConsumer(std::string_view name);
+
+    /* Makes id pending for consumer. An entry delivered before (the last delivered ID was set back)
+       moves to consumer and starts counting again */
+    PendingEntry &Deliver(const StreamId &id, Consumer &consumer, uint64_t now);
+    /* Hands a pending entry to consumer without counting a delivery */
+    void Transfer(PendingEntry &entry, Consumer &consumer);
+    bool Ack(const StreamId &id);
+
+    const IdList<PendingEntry> &Pending() const { return m_pending; }
+    const std::map<std::string, Consumer, std::less<>> &Consumers() const { return m_consumers; }
+
+    void Serialize(std::string &blob) const;
+    static std::unique_ptr<ConsumerGroup> Deserialize(BinaryReader &reader);
+
+private:
+    StreamId m_lastDelivered;
+    IdList<PendingEntry> m_pending;
+    std::map<std::string, Consumer, std::less<>> m_consumers; // map nodes stay put, pending entries point at them
+};
+
+#endif // CONSUMERGROUP_H
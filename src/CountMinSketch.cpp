@@ -0,0 +1,174 @@
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+#include "CountMinSketch.h"
+#include "Utility.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CMS_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct CounterRange
+    {
+        uint32_t minimum;
+        uint32_t maximum;
+    };
+
+    CounterRange counterRangeScalar(const uint32_t *counters, const uint32_t *indices, uint32_t rows)
+    {
+        CounterRange range{std::numeric_limits<uint32_t>::max(), 0};
+        for (uint32_t row = 0; row < rows; ++row)
+        {
+            range.minimum = std::min(range.minimum, counters[indices[row]]);
+            range.maximum = std::max(range.maximum, counters[indices[row]]);
+        }
+        return range;
+    }
+
+#ifdef CMS_KERNELS_X86
+
+    // Eight rows per gather. Counters are unsigned, they are compared with the sign bit flipped
+    __attribute__((target("avx2"))) CounterRange counterRangeAvx2(const uint32_t *counters, const uint32_t *indices, uint32_t rows)
+    {
+        const __m256i signBit = _mm256_set1_epi32(0x80000000);
+        __m256i minVec = _mm256_set1_epi32(0x7FFFFFFF);
+        __m256i maxVec = _mm256_set1_epi32(0x80000000);
+        uint32_t row = 0;
+        for (; row + 8 <= rows; row += 8)
+        {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + row));
+            __m256i values = _mm256_xor_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(counters), idx, 4), signBit);
+            minVec = _mm256_min_epi32(minVec, values);
+            maxVec = _mm256_max_epi32(maxVec, values);
+        }
+
+        alignas(32) uint32_t minLanes[8], maxLanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(minLanes), _mm256_xor_si256(minVec, signBit));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(maxLanes), _mm256_xor_si256(maxVec, signBit));
+        // Rows past the last multiple of 8 are read one by one
+        CounterRange range = counterRangeScalar(counters, indices + row, rows - row);
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            range.minimum = std::min(range.minimum, minLanes[lane]);
+            range.maximum = std::max(range.maximum, maxLanes[lane]);
+        }
+        return range;
+    }
+
+#endif // CMS_KERNELS_X86
+
+    using CounterRangeKernel = CounterRange (*)(const uint32_t *, const uint32_t *, uint32_t);
+
+    CounterRangeKernel activeCounterRange()
+    {
+#ifdef CMS_KERNELS_X86
+        static const CounterRangeKernel kernel = __builtin_cpu_supports("avx2") ? counterRangeAvx2 : counterRangeScalar;
+        return kernel;
+#else
+        return counterRangeScalar;
+#endif
+    }
+
+    // Sketches under 8 rows never fill a gather, the inlined scalar loop beats the indirect call
+    inline CounterRange counterRange(const uint32_t *counters, const uint32_t *indices, uint32_t rows)
+    {
+        return rows >= 8 ? activeCounterRange()(counters, indices, rows) : counterRangeScalar(counters, indices, rows);
+    }
+}
+
+CountMinSketch::CountMinSketch(uint32_t width, uint32_t depth)
+    : m_width(width), m_depth(depth)
+{
+    if (width == 0 || depth == 0 || depth > MAX_DEPTH)
+        throw std::invalid_argument("width must be positive and depth in the range [1, 64]");
+    if (static_cast<uint64_t>(width) * depth > MAX_COUNTERS)
+        throw std::invalid_argument("sketch is too big");
+
+    m_counters.resize(static_cast<size_t>(width) * depth, 0);
+}
+
+std::unique_ptr<CountMinSketch> CountMinSketch::FromErrorRate(double error, double probability)
+{
+    // Written so that NaN fails it too
+    if (!(error > 0 && error < 1 && probability > 0 && probability < 1))
+        throw std::invalid_argument("error and probability must be in the range (0, 1)");
+    if (2 / error > MAX_COUNTERS)
+        throw std::invalid_argument("sketch is too big");
+
+    // Same dimensioning as RedisBloom: over estimation by error * total with the given probability
+    auto width = static_cast<uint32_t>(std::ceil(2 / error));
+    auto depth = static_cast<uint32_t>(std::ceil(std::log10(probability) / std::log10(0.5)));
+
+    return std::make_unique<CountMinSketch>(width, std::clamp<uint32_t>(depth, 1, MAX_DEPTH));
+}
+
+void CountMinSketch::rowIndices(const std::string &item, uint32_t *indices) const
+{
+    uint64_t hash = murmurHash64A(item);
+    uint32_t h1 = static_cast<uint32_t>(hash);
+    uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+    // index = row * width + fastrange(h1 + row * h2, width), no branches or divisions so it vectorizes
+    for (uint32_t row = 0; row < m_depth; ++row)
+    {
+        uint32_t rowHash = h1 + row * h2;
+        indices[row] = row * m_width + static_cast<uint32_t>((static_cast<uint64_t>(rowHash) * m_width) >> 32);
+    }
+}
+
+uint64_t CountMinSketch::IncrBy(const std::string &item, uint32_t increment)
+{
+    uint32_t indices[MAX_DEPTH];
+    rowIndices(item, indices);
+
+    // Every counter goes up by the same amount, so the minimum does too
+    uint32_t *counters = m_counters.data();
+    CounterRange range = counterRange(counters, indices, m_depth);
+    if (range.maximum > std::numeric_limits<uint32_t>::max() - increment)
+        throw std::overflow_error("CMS: INCRBY overflow");
+
+    for (uint32_t row = 0; row < m_depth; ++row)
+        counters[indices[row]] += increment;
+
+    m_totalCount += increment;
+    return range.minimum + increment;
+}
+
+uint64_t CountMinSketch::Query(const std::string &item) const
+{
+    uint32_t indices[MAX_DEPTH];
+    rowIndices(item, indices);
+    return counterRange(m_counters.data(), indices, m_depth).minimum;
+}
+
+std::string CountMinSketch::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint32_t>(blob, m_width);
+    appendBinary<uint32_t>(blob, m_depth);
+    appendBinary<uint64_t>(blob, m_totalCount);
+    blob.append(reinterpret_cast<const char *>(m_counters.data()), m_counters.size() * sizeof(uint32_t));
+
+    return blob;
+}
+
+std::unique_ptr<CountMinSketch> CountMinSketch::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto width = reader.read<uint32_t>();
+    auto depth = reader.read<uint32_t>();
+
+    auto sketch = std::make_unique<CountMinSketch>(width, depth);
+    sketch->m_totalCount = reader.read<uint64_t>();
+
+    size_t bytes = sketch->m_counters.size() * sizeof(uint32_t);
+    std::memcpy(sketch->m_counters.data(), reader.readBytes(bytes), bytes);
+
+    return sketch;
+}
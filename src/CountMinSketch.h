@@ -0,0 +1,49 @@
+#ifndef COUNTMINSKETCH_H
+#define COUNTMINSKETCH_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/*
+   Count-Min Sketch
+   - 'depth' rows of 'width' counters, an item increments one counter per row and its estimated
+     count is the minimum of those counters (never under estimates)
+   - All row indices of an item are derived from a single 64 bit hash (h1 + row * h2) and computed
+     together in a branch free loop the compiler vectorizes
+   - The counters of all rows are read with AVX2 gathers on CPUs that have it (picked at run time),
+     for queries and for the overflow check of increments. AVX2 can't scatter, so the adds are scalar
+*/
+
+class CountMinSketch
+{
+public:
+    static constexpr uint32_t MAX_DEPTH = 64;
+    static constexpr uint64_t MAX_COUNTERS = 1ULL << 28; // 1GB, and gather indices must fit in an int32
+
+    CountMinSketch(uint32_t width, uint32_t depth);
+    static std::unique_ptr<CountMinSketch> FromErrorRate(double error, double probability);
+
+    /* Returns the estimated count after the increment. Throws on counter overflow */
+    uint64_t IncrBy(const std::string &item, uint32_t increment);
+    uint64_t Query(const std::string &item) const;
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Depth() const { return m_depth; }
+    uint64_t TotalCount() const { return m_totalCount; }
+    size_t MemoryUsage() const { return sizeof(*this) + m_counters.size() * sizeof(uint32_t); }
+
+    std::string Serialize() const;
+    static std::unique_ptr<CountMinSketch> Deserialize(const std::string &blob);
+
+private:
+    uint32_t m_width;
+    uint32_t m_depth;
+    uint64_t m_totalCount{};
+    std::vector<uint32_t> m_counters; // row major, depth * width
+
+    void rowIndices(const std::string &item, uint32_t *indices) const;
+};
+
+#endif // COUNTMINSKETCH_H
@@ -0,0 +1,226 @@
+
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+
+#include "CuckooFilter.h"
+#include "Utility.h"
+
+namespace
+{
+    inline uint8_t fingerprintOf(uint64_t hash)
+    {
+        return static_cast<uint8_t>((hash >> 32) % 255 + 1); // never 0, that marks an empty slot
+    }
+
+    inline uint64_t alternateBucket(uint64_t bucket, uint8_t fingerprint, uint64_t numBuckets)
+    {
+        return (bucket ^ (fingerprint * 0x5bd1e995ULL)) & (numBuckets - 1);
+    }
+}
+
+CuckooFilter::CuckooFilter(uint64_t capacity, uint16_t bucketSize, uint16_t maxIterations, uint16_t expansion)
+    : m_bucketSize(bucketSize), m_maxIterations(maxIterations), m_expansion(expansion)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("capacity must be positive");
+    if (bucketSize == 0 || bucketSize > 255)
+        throw std::invalid_argument("bucket size must be in the range [1, 255]");
+    if (maxIterations == 0)
+        throw std::invalid_argument("max iterations must be positive");
+    if (capacity > MAX_LAYER_BYTES || std::bit_ceil((capacity + bucketSize - 1) / bucketSize) * bucketSize > MAX_LAYER_BYTES)
+        throw std::invalid_argument("capacity too large");
+
+    m_layers.emplace_back(std::bit_ceil((capacity + bucketSize - 1) / bucketSize), bucketSize);
+}
+
+bool CuckooFilter::insertIntoBucket(Layer &layer, uint64_t bucket, uint8_t fingerprint)
+{
+    uint8_t *slots = bucketSlots(layer, bucket);
+    for (uint16_t i = 0; i < m_bucketSize; ++i)
+    {
+        if (slots[i] == 0)
+        {
+            slots[i] = fingerprint;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::insertIntoLayer(Layer &layer, uint8_t fingerprint, uint64_t hash)
+{
+    uint64_t bucket = hash & (layer.numBuckets - 1);
+    uint64_t alternate = alternateBucket(bucket, fingerprint, layer.numBuckets);
+
+    if (insertIntoBucket(layer, bucket, fingerprint) || insertIntoBucket(layer, alternate, fingerprint))
+        return true;
+
+    // Both buckets are full, kick fingerprints to their alternate buckets.
+    // Keep the path so the layer can be restored if we give up, otherwise the last victim would be lost.
+    struct Kick { uint64_t bucket; uint16_t slot; uint8_t fingerprint; };
+    std::vector<Kick> path;
+    path.reserve(m_maxIterations);
+
+    uint64_t current = (hash >> 16) & 1 ? bucket : alternate;
+    uint8_t victim = fingerprint;
+
+    for (uint16_t iteration = 0; iteration < m_maxIterations; ++iteration)
+    {
+        uint16_t slot = (hash + iteration) % m_bucketSize;
+        uint8_t *slots = bucketSlots(layer, current);
+
+        path.push_back({current, slot, slots[slot]});
+        std::swap(victim, slots[slot]);
+
+        current = alternateBucket(current, victim, layer.numBuckets);
+        if (insertIntoBucket(layer, current, victim))
+            return true;
+    }
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        bucketSlots(layer, it->bucket)[it->slot] = it->fingerprint;
+
+    return false;
+}
+
+void CuckooFilter::Add(const std::string &item)
+{
+    uint64_t hash = murmurHash64A(item);
+    uint8_t fingerprint = fingerprintOf(hash);
+
+    if (!insertIntoLayer(m_layers.back(), fingerprint, hash))
+    {
+        uint64_t numBuckets = m_layers.back().numBuckets * std::bit_ceil<uint64_t>(m_expansion);
+        if (m_expansion == 0 || m_layers.size() >= MAX_LAYERS || numBuckets * m_bucketSize > MAX_LAYER_BYTES)
+            throw std::runtime_error("Filter is full");
+
+        m_layers.emplace_back(numBuckets, m_bucketSize);
+        if (!insertIntoLayer(m_layers.back(), fingerprint, hash))
+            throw std::runtime_error("Filter is full");
+    }
+
+    ++m_numItems;
+}
+
+bool CuckooFilter::Exists(const std::string &item) const
+{
+    return Count(item) > 0;
+}
+
+uint64_t CuckooFilter::Count(const std::string &item) const
+{
+    uint64_t hash = murmurHash64A(item);
+    uint8_t fingerprint = fingerprintOf(hash);
+    uint64_t count = 0;
+
+    for (const auto &layer : m_layers)
+    {
+        uint64_t bucket = hash & (layer.numBuckets - 1);
+        uint64_t alternate = alternateBucket(bucket, fingerprint, layer.numBuckets);
+
+        const uint8_t *slots = bucketSlots(layer, bucket);
+        count += std::count(slots, slots + m_bucketSize, fingerprint);
+
+        if (alternate != bucket)
+        {
+            slots = bucketSlots(layer, alternate);
+            count += std::count(slots, slots + m_bucketSize, fingerprint);
+        }
+    }
+
+    return count;
+}
+
+bool CuckooFilter::Delete(const std::string &item)
+{
+    uint64_t hash = murmurHash64A(item);
+    uint8_t fingerprint = fingerprintOf(hash);
+
+    // Newest layers first, that's where the latest copies were added
+    for (auto it = m_layers.rbegin(); it != m_layers.rend(); ++it)
+    {
+        uint64_t bucket = hash & (it->numBuckets - 1);
+
+        for (uint64_t candidate : {bucket, alternateBucket(bucket, fingerprint, it->numBuckets)})
+        {
+            uint8_t *slots = bucketSlots(*it, candidate);
+            auto found = std::find(slots, slots + m_bucketSize, fingerprint);
+            if (found != slots + m_bucketSize)
+            {
+                *found = 0;
+                --m_numItems;
+                ++m_numDeletes;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+uint64_t CuckooFilter::NumberOfBuckets() const
+{
+    uint64_t buckets = 0;
+    for (const auto &layer : m_layers)
+        buckets += layer.numBuckets;
+    return buckets;
+}
+
+size_t CuckooFilter::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const auto &layer : m_layers)
+        bytes += sizeof(layer) + layer.slots.size();
+    return bytes;
+}
+
+std::string CuckooFilter::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint16_t>(blob, m_bucketSize);
+    appendBinary<uint16_t>(blob, m_maxIterations);
+    appendBinary<uint16_t>(blob, m_expansion);
+    appendBinary<uint64_t>(blob, m_numItems);
+    appendBinary<uint64_t>(blob, m_numDeletes);
+    appendBinary<uint64_t>(blob, m_layers.size());
+
+    for (const auto &layer : m_layers)
+    {
+        appendBinary<uint64_t>(blob, layer.numBuckets);
+        blob.append(reinterpret_cast<const char *>(layer.slots.data()), layer.slots.size());
+    }
+
+    return blob;
+}
+
+std::unique_ptr<CuckooFilter> CuckooFilter::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    std::unique_ptr<CuckooFilter> filter(new CuckooFilter());
+
+    filter->m_bucketSize = reader.read<uint16_t>();
+    filter->m_maxIterations = reader.read<uint16_t>();
+    filter->m_expansion = reader.read<uint16_t>();
+    filter->m_numItems = reader.read<uint64_t>();
+    filter->m_numDeletes = reader.read<uint64_t>();
+    auto numLayers = reader.read<uint64_t>();
+
+    // Same limits as CF.RESERVE and expansion, and a layer's slots have to be in the blob before they are allocated
+    if (filter->m_bucketSize == 0 || filter->m_bucketSize > 255 || filter->m_maxIterations == 0 ||
+        numLayers == 0 || numLayers > MAX_LAYERS || numLayers > reader.remaining() / sizeof(uint64_t))
+        throw std::runtime_error("Corrupted cuckoo filter");
+
+    for (uint64_t i = 0; i < numLayers; ++i)
+    {
+        auto numBuckets = reader.read<uint64_t>();
+        if (!std::has_single_bit(numBuckets) || numBuckets > MAX_LAYER_BYTES / filter->m_bucketSize ||
+            numBuckets * filter->m_bucketSize > reader.remaining())
+            throw std::runtime_error("Corrupted cuckoo filter layer");
+
+        Layer &layer = filter->m_layers.emplace_back(numBuckets, filter->m_bucketSize);
+        std::memcpy(layer.slots.data(), reader.readBytes(layer.slots.size()), layer.slots.size());
+    }
+
+    return filter;
+}
@@ -0,0 +1,67 @@
+#ifndef CUCKOOFILTER_H
+#define CUCKOOFILTER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/*
+   Cuckoo filter (partial key cuckoo hashing with 8 bit fingerprints)
+   - Unlike a Bloom filter items can be deleted
+   - Every item has two candidate buckets, i2 = i1 ^ hash(fingerprint), so an item can be moved
+     ("kicked") to its alternate bucket without knowing the original item
+   - When an insert fails after 'maxIterations' kicks a new, 'expansion' times bigger, filter is chained
+*/
+
+class CuckooFilter
+{
+public:
+    static constexpr uint16_t DEFAULT_BUCKET_SIZE = 2;
+    static constexpr uint16_t DEFAULT_MAX_ITERATIONS = 20;
+    static constexpr uint16_t DEFAULT_EXPANSION = 1;
+    static constexpr uint64_t DEFAULT_CAPACITY = 1024;
+    static constexpr size_t MAX_LAYERS = 32;
+    static constexpr uint64_t MAX_LAYER_BYTES = 1ULL << 30; // one byte per slot
+
+    CuckooFilter(uint64_t capacity, uint16_t bucketSize = DEFAULT_BUCKET_SIZE,
+                 uint16_t maxIterations = DEFAULT_MAX_ITERATIONS, uint16_t expansion = DEFAULT_EXPANSION);
+
+    /* Items can be added more than once (each copy needs a matching Delete). Throws when the filter can't grow anymore */
+    void Add(const std::string &item);
+    bool Exists(const std::string &item) const;
+    bool Delete(const std::string &item);
+    uint64_t Count(const std::string &item) const;
+
+    uint64_t Size() const { return m_numItems; }
+    uint64_t NumberOfBuckets() const;
+    size_t MemoryUsage() const;
+
+    std::string Serialize() const;
+    static std::unique_ptr<CuckooFilter> Deserialize(const std::string &blob);
+
+private:
+    struct Layer
+    {
+        uint64_t numBuckets{}; // power of two
+        std::vector<uint8_t> slots; // numBuckets * bucketSize fingerprints, 0 means empty
+
+        Layer(uint64_t numBuckets, uint16_t bucketSize) : numBuckets(numBuckets), slots(numBuckets * bucketSize, 0) {}
+    };
+
+    uint16_t m_bucketSize{DEFAULT_BUCKET_SIZE};
+    uint16_t m_maxIterations{DEFAULT_MAX_ITERATIONS};
+    uint16_t m_expansion{DEFAULT_EXPANSION};
+    uint64_t m_numItems{};
+    uint64_t m_numDeletes{};
+    std::vector<Layer> m_layers;
+
+    CuckooFilter() = default;
+
+    bool insertIntoLayer(Layer &layer, uint8_t fingerprint, uint64_t hash);
+    bool insertIntoBucket(Layer &layer, uint64_t bucket, uint8_t fingerprint);
+    uint8_t *bucketSlots(Layer &layer, uint64_t bucket) { return layer.slots.data() + bucket * m_bucketSize; }
+    const uint8_t *bucketSlots(const Layer &layer, uint64_t bucket) const { return layer.slots.data() + bucket * m_bucketSize; }
+};
+
+#endif // CUCKOOFILTER_H
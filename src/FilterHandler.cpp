@@ -0,0 +1,296 @@
+
+#include <iostream>
+#include <stdexcept>
+#include <new>
+
+#include "FilterHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+std::string FilterHandler::FilterCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == BF_RESERVE)
+            return bfReserveHandler(std::move(commandArgs));
+        else if (command == BF_ADD || command == BF_MADD)
+            return bfAddHandler(std::move(commandArgs));
+        else if (command == BF_EXISTS || command == BF_MEXISTS)
+            return bfExistsHandler(std::move(commandArgs));
+        else if (command == BF_CARD)
+            return bfCardHandler(std::move(commandArgs));
+        else if (command == CF_RESERVE)
+            return cfReserveHandler(std::move(commandArgs));
+        else if (command == CF_ADD || command == CF_ADDNX)
+            return cfAddHandler(std::move(commandArgs));
+        else if (command == CF_EXISTS || command == CF_MEXISTS)
+            return cfExistsHandler(std::move(commandArgs));
+        else if (command == CF_DEL)
+            return cfDelHandler(std::move(commandArgs));
+        else if (command == CF_COUNT)
+            return cfCountHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        // stoul / stod failures and bad filter parameters
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+    catch (const std::length_error &e)
+    {
+        return RESPEncoder::encodeError("filter too large");
+    }
+    catch (const std::bad_alloc &e)
+    {
+        return RESPEncoder::encodeError("not enough memory for the filter");
+    }
+
+    return RESPEncoder::encodeError("Unsupported filter command");
+}
+
+BloomFilter &FilterHandler::getOrCreateBloomFilter(const std::string &key)
+{
+    auto &filter = m_bloomFilters[key];
+    if (!filter)
+        filter = std::make_unique<BloomFilter>(BloomFilter::DEFAULT_CAPACITY, BloomFilter::DEFAULT_ERROR_RATE);
+
+    return *filter;
+}
+
+CuckooFilter &FilterHandler::getOrCreateCuckooFilter(const std::string &key)
+{
+    auto &filter = m_cuckooFilters[key];
+    if (!filter)
+        filter = std::make_unique<CuckooFilter>(CuckooFilter::DEFAULT_CAPACITY);
+
+    return *filter;
+}
+
+// BF.RESERVE key error_rate capacity [EXPANSION expansion] [NONSCALING]
+std::string FilterHandler::bfReserveHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'bf.reserve' command");
+
+    const std::string &key = (*commandArgs)[1];
+    if (IsBloomFilterPresent(key))
+        return RESPEncoder::encodeError("item exists");
+
+    double errorRate = std::stod((*commandArgs)[2]);
+    uint64_t capacity = std::stoull((*commandArgs)[3]);
+    uint32_t expansion = BloomFilter::DEFAULT_EXPANSION;
+    bool nonScaling = false;
+
+    for (size_t i = 4; i < commandArgs->size(); ++i)
+    {
+        std::string option = toLower((*commandArgs)[i]);
+        if (option == "expansion" && i + 1 < commandArgs->size())
+            expansion = std::stoul((*commandArgs)[++i]);
+        else if (option == "nonscaling")
+            nonScaling = true;
+        else
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    m_bloomFilters[key] = std::make_unique<BloomFilter>(capacity, errorRate, expansion, nonScaling);
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// BF.ADD key item | BF.MADD key item [item ...]
+std::string FilterHandler::bfAddHandler(CommandArray commandArgs)
+{
+    bool multi = (*commandArgs)[0] == BF_MADD;
+    if (commandArgs->size() < 3 || (!multi && commandArgs->size() != 3))
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    BloomFilter &filter = getOrCreateBloomFilter((*commandArgs)[1]);
+    std::vector<std::string> results;
+
+    for (auto it = commandArgs->begin() + 2; it != commandArgs->end(); ++it)
+    {
+        try
+        {
+            results.push_back(RESPEncoder::encodeInteger(filter.Add(*it) ? 1 : 0));
+        }
+        catch (const std::runtime_error &e)
+        {
+            results.push_back(RESPEncoder::encodeError(e.what()));
+        }
+    }
+
+    return multi ? RESPEncoder::encodeArray(results, true) : results.front();
+}
+
+// BF.EXISTS key item | BF.MEXISTS key item [item ...]
+std::string FilterHandler::bfExistsHandler(CommandArray commandArgs)
+{
+    bool multi = (*commandArgs)[0] == BF_MEXISTS;
+    if (commandArgs->size() < 3 || (!multi && commandArgs->size() != 3))
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    auto it = m_bloomFilters.find((*commandArgs)[1]);
+    std::vector<std::string> results;
+
+    for (auto item = commandArgs->begin() + 2; item != commandArgs->end(); ++item)
+    {
+        bool exists = it != m_bloomFilters.end() && it->second->Exists(*item);
+        results.push_back(RESPEncoder::encodeInteger(exists ? 1 : 0));
+    }
+
+    return multi ? RESPEncoder::encodeArray(results, true) : results.front();
+}
+
+std::string FilterHandler::bfCardHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'bf.card' command");
+
+    auto it = m_bloomFilters.find((*commandArgs)[1]);
+    return RESPEncoder::encodeInteger(it != m_bloomFilters.end() ? it->second->Size() : 0);
+}
+
+// CF.RESERVE key capacity [BUCKETSIZE bucketsize] [MAXITERATIONS maxiterations] [EXPANSION expansion]
+std::string FilterHandler::cfReserveHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cf.reserve' command");
+
+    const std::string &key = (*commandArgs)[1];
+    if (IsCuckooFilterPresent(key))
+        return RESPEncoder::encodeError("item exists");
+
+    uint64_t capacity = std::stoull((*commandArgs)[2]);
+    unsigned long bucketSize = CuckooFilter::DEFAULT_BUCKET_SIZE;
+    unsigned long maxIterations = CuckooFilter::DEFAULT_MAX_ITERATIONS;
+    unsigned long expansion = CuckooFilter::DEFAULT_EXPANSION;
+
+    for (size_t i = 3; i + 1 < commandArgs->size(); i += 2)
+    {
+        std::string option = toLower((*commandArgs)[i]);
+        unsigned long value = std::stoul((*commandArgs)[i + 1]);
+
+        if (option == "bucketsize")
+            bucketSize = value;
+        else if (option == "maxiterations")
+            maxIterations = value;
+        else if (option == "expansion")
+            expansion = value;
+        else
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    if (commandArgs->size() % 2 == 0 || bucketSize > UINT16_MAX || maxIterations > UINT16_MAX || expansion > UINT16_MAX)
+        return RESPEncoder::encodeError("syntax error");
+
+    m_cuckooFilters[key] = std::make_unique<CuckooFilter>(capacity, bucketSize, maxIterations, expansion);
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// CF.ADD key item | CF.ADDNX key item
+std::string FilterHandler::cfAddHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    CuckooFilter &filter = getOrCreateCuckooFilter((*commandArgs)[1]);
+    const std::string &item = (*commandArgs)[2];
+
+    if ((*commandArgs)[0] == CF_ADDNX && filter.Exists(item))
+        return RESPEncoder::encodeInteger(0);
+
+    try
+    {
+        filter.Add(item);
+    }
+    catch (const std::runtime_error &e)
+    {
+        return RESPEncoder::encodeError(e.what());
+    }
+
+    return RESPEncoder::encodeInteger(1);
+}
+
+// CF.EXISTS key item | CF.MEXISTS key item [item ...]
+std::string FilterHandler::cfExistsHandler(CommandArray commandArgs)
+{
+    bool multi = (*commandArgs)[0] == CF_MEXISTS;
+    if (commandArgs->size() < 3 || (!multi && commandArgs->size() != 3))
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    auto it = m_cuckooFilters.find((*commandArgs)[1]);
+    std::vector<std::string> results;
+
+    for (auto item = commandArgs->begin() + 2; item != commandArgs->end(); ++item)
+    {
+        bool exists = it != m_cuckooFilters.end() && it->second->Exists(*item);
+        results.push_back(RESPEncoder::encodeInteger(exists ? 1 : 0));
+    }
+
+    return multi ? RESPEncoder::encodeArray(results, true) : results.front();
+}
+
+std::string FilterHandler::cfDelHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cf.del' command");
+
+    auto it = m_cuckooFilters.find((*commandArgs)[1]);
+    if (it == m_cuckooFilters.end())
+        return RESPEncoder::encodeError("Not found");
+
+    return RESPEncoder::encodeInteger(it->second->Delete((*commandArgs)[2]) ? 1 : 0);
+}
+
+std::string FilterHandler::cfCountHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cf.count' command");
+
+    auto it = m_cuckooFilters.find((*commandArgs)[1]);
+    return RESPEncoder::encodeInteger(it != m_cuckooFilters.end() ? it->second->Count((*commandArgs)[2]) : 0);
+}
+
+void FilterHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_bloomFilters))
+    {
+        writer.WriteKey(RDB_TYPE_BLOOM, key);
+        writer.WriteString(value->Serialize());
+    }
+    for (const auto &[key, value] : segment.Of(m_cuckooFilters))
+    {
+        writer.WriteKey(RDB_TYPE_CUCKOO, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void FilterHandler::LoadRdb(RdbReader &reader, uint8_t type, const std::string &key)
+{
+    if (type == RDB_TYPE_BLOOM)
+        m_bloomFilters[key] = BloomFilter::Deserialize(reader.ReadString());
+    else
+        m_cuckooFilters[key] = CuckooFilter::Deserialize(reader.ReadString());
+}
+
+void FilterHandler::MergeFrom(FilterHandler &other)
+{
+    m_bloomFilters.merge(other.m_bloomFilters);
+    m_cuckooFilters.merge(other.m_cuckooFilters);
+}
+
+void FilterHandler::Swap(FilterHandler &other)
+{
+    m_bloomFilters.swap(other.m_bloomFilters);
+    m_cuckooFilters.swap(other.m_cuckooFilters);
+}
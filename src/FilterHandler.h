@@ -0,0 +1,51 @@
+#ifndef FILTERHANDLER_H
+#define FILTERHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "BloomFilter.h"
+#include "CuckooFilter.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class FilterHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<BloomFilter>> m_bloomFilters;
+    std::unordered_map<std::string, std::unique_ptr<CuckooFilter>> m_cuckooFilters;
+
+    std::string bfReserveHandler(CommandArray commandArgs);
+    std::string bfAddHandler(CommandArray commandArgs);
+    std::string bfExistsHandler(CommandArray commandArgs);
+    std::string bfCardHandler(CommandArray commandArgs);
+
+    std::string cfReserveHandler(CommandArray commandArgs);
+    std::string cfAddHandler(CommandArray commandArgs);
+    std::string cfExistsHandler(CommandArray commandArgs);
+    std::string cfDelHandler(CommandArray commandArgs);
+    std::string cfCountHandler(CommandArray commandArgs);
+
+    BloomFilter &getOrCreateBloomFilter(const std::string &key);
+    CuckooFilter &getOrCreateCuckooFilter(const std::string &key);
+
+public:
+    std::string FilterCommandProcessor(CommandArray commandArgs);
+
+    bool IsBloomFilterPresent(const std::string &key) const { return m_bloomFilters.contains(key); }
+    bool IsCuckooFilterPresent(const std::string &key) const { return m_cuckooFilters.contains(key); }
+
+    size_t KeyCount() const { return m_bloomFilters.size() + m_cuckooFilters.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(FilterHandler &other);
+    void Swap(FilterHandler &other);
+};
+
+#endif // FILTERHANDLER_H
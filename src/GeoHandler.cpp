@@ -0,0 +1,327 @@
+
+#include <charconv>
+#include <stdexcept>
+
+#include "GeoHandler.h"
+#include "Rdb.h"
+#include "GeoHash.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+namespace
+{
+    std::string formatDouble(double value)
+    {
+        char buffer[32];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, end);
+    }
+
+    // Distances are reported with 4 decimals like Redis
+    std::string formatDistance(double value)
+    {
+        char buffer[64];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 4);
+        return std::string(buffer, end);
+    }
+
+    std::string encodePosition(double longitude, double latitude)
+    {
+        return RESPEncoder::encodeArray({RESPEncoder::encodeString(formatDouble(longitude)), RESPEncoder::encodeString(formatDouble(latitude))}, true);
+    }
+}
+
+std::string GeoHandler::GeoCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == GEOADD)
+            return geoAddHandler(std::move(commandArgs));
+        else if (command == GEOPOS)
+            return geoPosHandler(std::move(commandArgs));
+        else if (command == GEODIST)
+            return geoDistHandler(std::move(commandArgs));
+        else if (command == GEOSEARCH)
+            return geoSearchHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+
+    return RESPEncoder::encodeError("Unsupported geo command");
+}
+
+double GeoHandler::unitToMeters(const std::string &unit)
+{
+    std::string lower = toLower(unit);
+    if (lower == "m")
+        return 1;
+    else if (lower == "km")
+        return 1000;
+    else if (lower == "ft")
+        return 0.3048;
+    else if (lower == "mi")
+        return 1609.34;
+
+    throw std::invalid_argument("unsupported unit provided. please use M, KM, FT, MI");
+}
+
+// GEOADD key [NX | XX] [CH] longitude latitude member [longitude latitude member ...]
+std::string GeoHandler::geoAddHandler(CommandArray commandArgs)
+{
+    bool nx = false, xx = false, ch = false;
+    size_t index = 2;
+    for (; index < commandArgs->size(); ++index)
+    {
+        std::string option = toLower((*commandArgs)[index]);
+        if (option == "nx")
+            nx = true;
+        else if (option == "xx")
+            xx = true;
+        else if (option == "ch")
+            ch = true;
+        else
+            break;
+    }
+
+    if (commandArgs->size() < index + 3 || (commandArgs->size() - index) % 3 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'geoadd' command");
+    if (nx && xx)
+        return RESPEncoder::encodeError("XX and NX options at the same time are not compatible");
+
+    // Validate every triple first so a bad pair doesn't leave a partial update behind
+    std::vector<std::pair<double, double>> positions;
+    for (size_t i = index; i < commandArgs->size(); i += 3)
+    {
+        double longitude = std::stod((*commandArgs)[i]);
+        double latitude = std::stod((*commandArgs)[i + 1]);
+        if (!GeoHash::IsValid(longitude, latitude))
+            return RESPEncoder::encodeError("invalid longitude,latitude pair " + (*commandArgs)[i] + "," + (*commandArgs)[i + 1]);
+        positions.emplace_back(longitude, latitude);
+    }
+
+    auto &set = m_geoSets[(*commandArgs)[1]];
+    if (!set)
+        set = std::make_unique<GeoSet>();
+
+    long long added = 0, changedCount = 0;
+    for (size_t i = index, n = 0; i < commandArgs->size(); i += 3, ++n)
+    {
+        const std::string &member = (*commandArgs)[i + 2];
+        uint64_t existing;
+        bool exists = set->GetHash(member, existing);
+        if ((nx && exists) || (xx && !exists))
+            continue;
+
+        bool changed;
+        added += set->Add(member, positions[n].first, positions[n].second, changed);
+        changedCount += changed;
+    }
+
+    if (set->Size() == 0)
+        m_geoSets.erase((*commandArgs)[1]);
+
+    return RESPEncoder::encodeInteger(ch ? changedCount : added);
+}
+
+// GEOPOS key [member ...]
+std::string GeoHandler::geoPosHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'geopos' command");
+
+    auto it = m_geoSets.find((*commandArgs)[1]);
+
+    std::vector<std::string> results;
+    for (size_t i = 2; i < commandArgs->size(); ++i)
+    {
+        double longitude, latitude;
+        if (it != m_geoSets.end() && it->second->GetPosition((*commandArgs)[i], longitude, latitude))
+            results.push_back(encodePosition(longitude, latitude));
+        else
+            results.push_back("*-1\r\n");
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// GEODIST key member1 member2 [M | KM | FT | MI]
+std::string GeoHandler::geoDistHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 4 && commandArgs->size() != 5)
+        return RESPEncoder::encodeError("wrong number of arguments for 'geodist' command");
+
+    double unit = commandArgs->size() == 5 ? unitToMeters((*commandArgs)[4]) : 1;
+
+    auto it = m_geoSets.find((*commandArgs)[1]);
+    double lon1, lat1, lon2, lat2;
+    if (it == m_geoSets.end() || !it->second->GetPosition((*commandArgs)[2], lon1, lat1) || !it->second->GetPosition((*commandArgs)[3], lon2, lat2))
+        return NULL_BULK_ENCODED;
+
+    return RESPEncoder::encodeString(formatDistance(GeoHash::Distance(lon1, lat1, lon2, lat2) / unit));
+}
+
+// GEOSEARCH key FROMMEMBER member | FROMLONLAT longitude latitude
+//           BYRADIUS radius unit | BYBOX width height unit
+//           [ASC | DESC] [COUNT count [ANY]] [WITHCOORD] [WITHDIST] [WITHHASH]
+std::string GeoHandler::geoSearchHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 6)
+        return RESPEncoder::encodeError("wrong number of arguments for 'geosearch' command");
+
+    const auto &args = *commandArgs;
+    auto it = m_geoSets.find(args[1]);
+
+    bool hasCentre = false, hasShape = false;
+    double longitude = 0, latitude = 0, unit = 1;
+    std::string fromMember;
+    GeoSet::Shape shape;
+    GeoSet::Sort sort = GeoSet::Sort::NONE;
+    size_t count = 0;
+    bool any = false, withCoord = false, withDist = false, withHash = false;
+
+    for (size_t i = 2; i < args.size(); ++i)
+    {
+        std::string option = toLower(args[i]);
+        size_t remaining = args.size() - i - 1;
+
+        if (option == "frommember" && remaining >= 1 && !hasCentre)
+        {
+            fromMember = args[++i];
+            hasCentre = true;
+        }
+        else if (option == "fromlonlat" && remaining >= 2 && !hasCentre)
+        {
+            longitude = std::stod(args[i + 1]);
+            latitude = std::stod(args[i + 2]);
+            if (!GeoHash::IsValid(longitude, latitude))
+                return RESPEncoder::encodeError("invalid longitude,latitude pair " + args[i + 1] + "," + args[i + 2]);
+            i += 2;
+            hasCentre = true;
+        }
+        else if (option == "byradius" && remaining >= 2 && !hasShape)
+        {
+            shape.radius = std::stod(args[i + 1]);
+            unit = unitToMeters(args[i + 2]);
+            if (shape.radius < 0)
+                return RESPEncoder::encodeError("radius cannot be negative");
+            shape.radius *= unit;
+            i += 2;
+            hasShape = true;
+        }
+        else if (option == "bybox" && remaining >= 3 && !hasShape)
+        {
+            shape.isBox = true;
+            shape.width = std::stod(args[i + 1]);
+            shape.height = std::stod(args[i + 2]);
+            unit = unitToMeters(args[i + 3]);
+            if (shape.width < 0 || shape.height < 0)
+                return RESPEncoder::encodeError("height or width cannot be negative");
+            shape.width *= unit;
+            shape.height *= unit;
+            i += 3;
+            hasShape = true;
+        }
+        else if (option == "asc")
+            sort = GeoSet::Sort::ASC;
+        else if (option == "desc")
+            sort = GeoSet::Sort::DESC;
+        else if (option == "count" && remaining >= 1)
+        {
+            long long value = std::stoll(args[++i]);
+            if (value <= 0)
+                return RESPEncoder::encodeError("COUNT must be > 0");
+            count = value;
+        }
+        else if (option == "any")
+            any = true;
+        else if (option == "withcoord")
+            withCoord = true;
+        else if (option == "withdist")
+            withDist = true;
+        else if (option == "withhash")
+            withHash = true;
+        else
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    if (!hasCentre)
+        return RESPEncoder::encodeError("exactly one of FROMMEMBER or FROMLONLAT can be specified for geosearch");
+    if (!hasShape)
+        return RESPEncoder::encodeError("exactly one of BYRADIUS and BYBOX can be specified for geosearch");
+    if (any && count == 0)
+        return RESPEncoder::encodeError("the ANY argument requires COUNT argument");
+
+    if (it == m_geoSets.end())
+        return RESPEncoder::encodeArray({}, true);
+
+    if (!fromMember.empty() && !it->second->GetPosition(fromMember, longitude, latitude))
+        return RESPEncoder::encodeError("could not decode requested zset member");
+
+    // COUNT without an explicit order returns the closest ones, like Redis
+    if (count > 0 && !any && sort == GeoSet::Sort::NONE)
+        sort = GeoSet::Sort::ASC;
+
+    bool plain = !withCoord && !withDist && !withHash;
+    std::vector<std::string> results;
+
+    for (const auto &match : it->second->Search(longitude, latitude, shape, sort, count, any))
+    {
+        if (plain)
+        {
+            results.push_back(RESPEncoder::encodeString(*match.member));
+            continue;
+        }
+
+        std::vector<std::string> item{RESPEncoder::encodeString(*match.member)};
+        if (withDist)
+            item.push_back(RESPEncoder::encodeString(formatDistance(match.distance / unit)));
+        if (withHash)
+            item.push_back(RESPEncoder::encodeInteger(match.hash));
+        if (withCoord)
+        {
+            double pointLon, pointLat;
+            GeoHash::Decode(match.hash, pointLon, pointLat);
+            item.push_back(encodePosition(pointLon, pointLat));
+        }
+        results.push_back(RESPEncoder::encodeArray(item, true));
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+void GeoHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_geoSets))
+    {
+        writer.WriteKey(RDB_TYPE_GEO, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void GeoHandler::LoadRdb(RdbReader &reader, uint8_t, const std::string &key)
+{
+    m_geoSets[key] = GeoSet::Deserialize(reader.ReadString());
+}
+
+void GeoHandler::MergeFrom(GeoHandler &other)
+{
+    m_geoSets.merge(other.m_geoSets);
+}
+
+void GeoHandler::Swap(GeoHandler &other)
+{
+    m_geoSets.swap(other.m_geoSets);
+}
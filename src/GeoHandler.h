@@ -0,0 +1,42 @@
+#ifndef GEOHANDLER_H
+#define GEOHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "GeoSet.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class GeoHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<GeoSet>> m_geoSets;
+
+    std::string geoAddHandler(CommandArray commandArgs);
+    std::string geoPosHandler(CommandArray commandArgs);
+    std::string geoDistHandler(CommandArray commandArgs);
+    std::string geoSearchHandler(CommandArray commandArgs);
+
+    // Meters per unit for "m", "km", "ft", "mi", throws std::invalid_argument otherwise
+    static double unitToMeters(const std::string &unit);
+
+public:
+    std::string GeoCommandProcessor(CommandArray commandArgs);
+
+    bool IsGeoSetPresent(const std::string &key) const { return m_geoSets.contains(key); }
+
+    size_t KeyCount() const { return m_geoSets.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(GeoHandler &other);
+    void Swap(GeoHandler &other);
+};
+
+#endif // GEOHANDLER_H
@@ -0,0 +1,171 @@
+
+#include <cmath>
+#include <algorithm>
+
+#include "GeoHash.h"
+
+namespace
+{
+    constexpr double DEG_TO_RAD = M_PI / 180.0;
+    constexpr double RAD_TO_DEG = 180.0 / M_PI;
+
+    // Spreads the 32 bits of x to the even bit positions of a 64 bit word
+    uint64_t spreadBits(uint32_t x)
+    {
+        uint64_t v = x;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        v = (v | (v << 2)) & 0x3333333333333333ULL;
+        v = (v | (v << 1)) & 0x5555555555555555ULL;
+        return v;
+    }
+
+    uint32_t squashBits(uint64_t v)
+    {
+        v &= 0x5555555555555555ULL;
+        v = (v | (v >> 1)) & 0x3333333333333333ULL;
+        v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+        v = (v | (v >> 4)) & 0x00FF00FF00FF00FFULL;
+        v = (v | (v >> 8)) & 0x0000FFFF0000FFFFULL;
+        v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+        return static_cast<uint32_t>(v);
+    }
+
+    uint32_t toCell(double value, double min, double max, int step)
+    {
+        double offset = (value - min) / (max - min) * static_cast<double>(1ULL << step);
+        return static_cast<uint32_t>(std::clamp(offset, 0.0, static_cast<double>((1ULL << step) - 1)));
+    }
+}
+
+bool GeoHash::IsValid(double longitude, double latitude)
+{
+    return longitude >= LON_MIN && longitude <= LON_MAX && latitude >= LAT_MIN && latitude <= LAT_MAX;
+}
+
+uint64_t GeoHash::interleave(uint32_t latBits, uint32_t lonBits)
+{
+    return spreadBits(latBits) | (spreadBits(lonBits) << 1);
+}
+
+void GeoHash::deinterleave(uint64_t hash, uint32_t &latBits, uint32_t &lonBits)
+{
+    latBits = squashBits(hash);
+    lonBits = squashBits(hash >> 1);
+}
+
+uint64_t GeoHash::Encode(double longitude, double latitude)
+{
+    return interleave(toCell(latitude, LAT_MIN, LAT_MAX, STEP_MAX), toCell(longitude, LON_MIN, LON_MAX, STEP_MAX));
+}
+
+void GeoHash::Decode(uint64_t hash, double &longitude, double &latitude)
+{
+    uint32_t latBits, lonBits;
+    deinterleave(hash, latBits, lonBits);
+
+    constexpr double cells = static_cast<double>(1ULL << STEP_MAX);
+    longitude = std::clamp(LON_MIN + (lonBits + 0.5) / cells * (LON_MAX - LON_MIN), LON_MIN, LON_MAX);
+    latitude = std::clamp(LAT_MIN + (latBits + 0.5) / cells * (LAT_MAX - LAT_MIN), LAT_MIN, LAT_MAX);
+}
+
+double GeoHash::Distance(double lon1, double lat1, double lon2, double lat2)
+{
+    double lat1r = lat1 * DEG_TO_RAD, lat2r = lat2 * DEG_TO_RAD;
+    double u = std::sin((lat2r - lat1r) / 2);
+    double v = std::sin((lon2 - lon1) * DEG_TO_RAD / 2);
+    double a = u * u + std::cos(lat1r) * std::cos(lat2r) * v * v;
+    return 2.0 * EARTH_RADIUS_M * std::asin(std::sqrt(a));
+}
+
+// Coarsest step whose cells are still about as large as the search range, so 3x3 cells cover it
+int GeoHash::estimateSteps(double rangeMeters, double latitude)
+{
+    if (rangeMeters == 0)
+        return STEP_MAX;
+
+    int step = 1;
+    while (rangeMeters < MERCATOR_MAX)
+    {
+        rangeMeters *= 2;
+        step++;
+    }
+    step -= 2;
+
+    // Cells get narrower towards the poles
+    if (latitude > 66 || latitude < -66)
+    {
+        step--;
+        if (latitude > 80 || latitude < -80)
+            step--;
+    }
+
+    return std::clamp(step, 1, STEP_MAX);
+}
+
+std::vector<GeoHash::HashRange> GeoHash::RangesForBox(double longitude, double latitude, double widthM, double heightM)
+{
+    // Bounding box in degrees, longitudes are left unwrapped (may go beyond +-180)
+    double latDelta = heightM / 2 / EARTH_RADIUS_M * RAD_TO_DEG;
+    double lonDelta = widthM / 2 / EARTH_RADIUS_M / std::cos(latitude * DEG_TO_RAD) * RAD_TO_DEG;
+    double minLat = latitude - latDelta, maxLat = latitude + latDelta;
+    double minLon = longitude - lonDelta, maxLon = longitude + lonDelta;
+
+    int step = estimateSteps(std::hypot(widthM, heightM) / 2, latitude);
+    double cellLat, cellLon;
+    int64_t centreLat, centreLon;
+
+    // Drop to a coarser step until the 3x3 cells around the centre cover the whole bounding box
+    while (true)
+    {
+        double cells = static_cast<double>(1ULL << step);
+        cellLat = (LAT_MAX - LAT_MIN) / cells;
+        cellLon = (LON_MAX - LON_MIN) / cells;
+        centreLat = toCell(latitude, LAT_MIN, LAT_MAX, step);
+        centreLon = toCell(longitude, LON_MIN, LON_MAX, step);
+
+        bool covered = LAT_MIN + (centreLat - 1) * cellLat <= minLat && LAT_MIN + (centreLat + 2) * cellLat >= maxLat &&
+                       LON_MIN + (centreLon - 1) * cellLon <= minLon && LON_MIN + (centreLon + 2) * cellLon >= maxLon;
+        if (covered || step == 1)
+            break;
+        --step;
+    }
+
+    int64_t cellsPerAxis = 1LL << step;
+    int shift = 2 * (STEP_MAX - step);
+    std::vector<HashRange> ranges;
+
+    for (int64_t dLat = -1; dLat <= 1; ++dLat)
+    {
+        int64_t cellLatIndex = centreLat + dLat;
+        if (cellLatIndex < 0 || cellLatIndex >= cellsPerAxis)
+            continue;
+        if (LAT_MIN + (cellLatIndex + 1) * cellLat < minLat || LAT_MIN + cellLatIndex * cellLat > maxLat)
+            continue; // box doesn't reach this row
+
+        for (int64_t dLon = -1; dLon <= 1; ++dLon)
+        {
+            int64_t cellLonIndex = centreLon + dLon;
+            if (LON_MIN + (cellLonIndex + 1) * cellLon < minLon || LON_MIN + cellLonIndex * cellLon > maxLon)
+                continue;
+
+            cellLonIndex = (cellLonIndex % cellsPerAxis + cellsPerAxis) % cellsPerAxis; // wrap around the antimeridian
+            uint64_t cell = interleave(cellLatIndex, cellLonIndex);
+            ranges.emplace_back(cell << shift, (cell + 1) << shift);
+        }
+    }
+
+    // Neighbouring cells are often adjacent on the curve, merging them saves index seeks
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<HashRange> merged;
+    for (const auto &range : ranges)
+    {
+        if (!merged.empty() && range.first <= merged.back().second)
+            merged.back().second = std::max(merged.back().second, range.second);
+        else
+            merged.push_back(range);
+    }
+
+    return merged;
+}
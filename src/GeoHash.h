@@ -0,0 +1,46 @@
+#ifndef GEOHASH_H
+#define GEOHASH_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+/*
+   Geohash helpers (same layout as Redis so hashes match GEOADD scores there)
+   - 26 steps per axis => 52 bit hash, latitude bits on even positions, longitude bits on odd ones
+   - Members sorted by hash are clustered by area: every cell of 'step' bits is one contiguous
+     hash range, so an area query is a handful of range scans over the ordered index
+*/
+
+class GeoHash
+{
+public:
+    static constexpr double LAT_MIN = -85.05112878;
+    static constexpr double LAT_MAX = 85.05112878;
+    static constexpr double LON_MIN = -180.0;
+    static constexpr double LON_MAX = 180.0;
+    static constexpr int STEP_MAX = 26;
+    static constexpr double EARTH_RADIUS_M = 6372797.560856;
+    static constexpr double MERCATOR_MAX = 20037726.37;
+
+    using HashRange = std::pair<uint64_t, uint64_t>; // [min, max) of 52 bit hashes
+
+    static bool IsValid(double longitude, double latitude);
+    static uint64_t Encode(double longitude, double latitude);
+
+    /* Centre of the 52 bit cell, which is what GEOPOS reports */
+    static void Decode(uint64_t hash, double &longitude, double &latitude);
+
+    /* Great circle distance in meters */
+    static double Distance(double lon1, double lat1, double lon2, double lat2);
+
+    /* Hash ranges (at most 9, merged when adjacent) covering a width x height meters box centred on the point */
+    static std::vector<HashRange> RangesForBox(double longitude, double latitude, double widthM, double heightM);
+
+private:
+    static int estimateSteps(double rangeMeters, double latitude);
+    static uint64_t interleave(uint32_t latBits, uint32_t lonBits);
+    static void deinterleave(uint64_t hash, uint32_t &latBits, uint32_t &lonBits);
+};
+
+#endif // GEOHASH_H
@@ -0,0 +1,231 @@
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "GeoSet.h"
+#include "GeoHash.h"
+#include "Utility.h"
+
+// First block whose last entry is >= entry (the last block if entry is beyond all of them)
+size_t GeoSet::blockFor(const Entry &entry) const
+{
+    auto it = std::lower_bound(m_blocks.begin(), m_blocks.end(), entry,
+                               [](const std::vector<Entry> &block, const Entry &value) { return block.back() < value; });
+    return it == m_blocks.end() ? m_blocks.size() - 1 : it - m_blocks.begin();
+}
+
+void GeoSet::indexInsert(const Entry &entry)
+{
+    if (m_blocks.empty())
+    {
+        m_blocks.emplace_back().reserve(BLOCK_SIZE);
+        m_blocks.back().push_back(entry);
+        return;
+    }
+
+    size_t index = blockFor(entry);
+    auto &block = m_blocks[index];
+    block.insert(std::upper_bound(block.begin(), block.end(), entry), entry);
+
+    if (block.size() >= BLOCK_SIZE)
+    {
+        std::vector<Entry> upperHalf;
+        upperHalf.reserve(BLOCK_SIZE);
+        upperHalf.assign(block.begin() + BLOCK_SIZE / 2, block.end());
+        block.resize(BLOCK_SIZE / 2);
+        m_blocks.insert(m_blocks.begin() + index + 1, std::move(upperHalf));
+    }
+}
+
+void GeoSet::indexErase(const Entry &entry)
+{
+    size_t index = blockFor(entry);
+    auto &block = m_blocks[index];
+
+    auto it = std::lower_bound(block.begin(), block.end(), entry);
+    if (it == block.end() || it->member != entry.member)
+        throw std::logic_error("geo index out of sync with members");
+
+    block.erase(it);
+    if (block.empty())
+        m_blocks.erase(m_blocks.begin() + index);
+}
+
+bool GeoSet::Add(const std::string &member, double longitude, double latitude, bool &changed)
+{
+    uint64_t hash = GeoHash::Encode(longitude, latitude);
+
+    auto [it, inserted] = m_members.try_emplace(member, hash);
+    if (inserted)
+    {
+        indexInsert({hash, &it->first});
+        changed = true;
+        return true;
+    }
+
+    changed = it->second != hash;
+    if (changed)
+    {
+        indexErase({it->second, &it->first});
+        it->second = hash;
+        indexInsert({hash, &it->first});
+    }
+    return false;
+}
+
+bool GeoSet::Remove(const std::string &member)
+{
+    auto it = m_members.find(member);
+    if (it == m_members.end())
+        return false;
+
+    indexErase({it->second, &it->first});
+    m_members.erase(it);
+    return true;
+}
+
+bool GeoSet::GetHash(const std::string &member, uint64_t &hash) const
+{
+    auto it = m_members.find(member);
+    if (it == m_members.end())
+        return false;
+
+    hash = it->second;
+    return true;
+}
+
+bool GeoSet::GetPosition(const std::string &member, double &longitude, double &latitude) const
+{
+    uint64_t hash;
+    if (!GetHash(member, hash))
+        return false;
+
+    GeoHash::Decode(hash, longitude, latitude);
+    return true;
+}
+
+std::vector<GeoSet::Match> GeoSet::Search(double longitude, double latitude, const Shape &shape, Sort sort, size_t count, bool any) const
+{
+    std::vector<Match> matches;
+    if (m_blocks.empty())
+        return matches;
+
+    double width = shape.isBox ? shape.width : 2 * shape.radius;
+    double height = shape.isBox ? shape.height : 2 * shape.radius;
+    bool stopEarly = any && count > 0;
+
+    for (const auto &[rangeMin, rangeMax] : GeoHash::RangesForBox(longitude, latitude, width, height))
+    {
+        // First block that can hold rangeMin, then walk entries until the range ends
+        auto blockIt = std::lower_bound(m_blocks.begin(), m_blocks.end(), rangeMin,
+                                        [](const std::vector<Entry> &block, uint64_t hash) { return block.back().hash < hash; });
+
+        for (; blockIt != m_blocks.end() && blockIt->front().hash < rangeMax; ++blockIt)
+        {
+            auto entryIt = std::lower_bound(blockIt->begin(), blockIt->end(), rangeMin,
+                                            [](const Entry &entry, uint64_t hash) { return entry.hash < hash; });
+
+            for (; entryIt != blockIt->end() && entryIt->hash < rangeMax; ++entryIt)
+            {
+                double pointLon, pointLat;
+                GeoHash::Decode(entryIt->hash, pointLon, pointLat);
+
+                double distance;
+                if (shape.isBox)
+                {
+                    // Same checks as Redis: vertical and horizontal (along the centre latitude) offsets
+                    if (GeoHash::Distance(longitude, pointLat, longitude, latitude) > shape.height / 2 ||
+                        GeoHash::Distance(pointLon, latitude, longitude, latitude) > shape.width / 2)
+                        continue;
+                    distance = GeoHash::Distance(pointLon, pointLat, longitude, latitude);
+                }
+                else
+                {
+                    distance = GeoHash::Distance(pointLon, pointLat, longitude, latitude);
+                    if (distance > shape.radius)
+                        continue;
+                }
+
+                matches.push_back({entryIt->member, distance, entryIt->hash});
+                if (stopEarly && matches.size() == count)
+                    break;
+            }
+
+            if (stopEarly && matches.size() == count)
+                break;
+        }
+
+        if (stopEarly && matches.size() == count)
+            break;
+    }
+
+    auto closer = [](const Match &a, const Match &b) { return a.distance < b.distance; };
+    auto farther = [](const Match &a, const Match &b) { return a.distance > b.distance; };
+
+    // Only the first 'count' results need to be ordered
+    size_t keep = count > 0 ? std::min(count, matches.size()) : matches.size();
+    if (sort == Sort::ASC)
+        std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), closer);
+    else if (sort == Sort::DESC)
+        std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), farther);
+
+    matches.resize(keep);
+    return matches;
+}
+
+size_t GeoSet::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this) + m_blocks.capacity() * sizeof(std::vector<Entry>);
+    for (const auto &block : m_blocks)
+        bytes += block.capacity() * sizeof(Entry);
+
+    // hash map node: next pointer + key + value + cached hash, plus one bucket pointer
+    bytes += m_members.size() * (sizeof(void *) + sizeof(std::string) + sizeof(uint64_t) + sizeof(size_t)) +
+             m_members.bucket_count() * sizeof(void *);
+    for (const auto &[member, hash] : m_members)
+    {
+        if (member.capacity() > 15)
+            bytes += member.capacity() + 1;
+    }
+
+    return bytes;
+}
+
+std::string GeoSet::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint64_t>(blob, m_members.size());
+
+    // In index order so loading can rebuild the blocks without sorting
+    for (const auto &block : m_blocks)
+    {
+        for (const auto &entry : block)
+        {
+            appendBinary<uint64_t>(blob, entry.hash);
+            appendBinaryString(blob, *entry.member);
+        }
+    }
+
+    return blob;
+}
+
+std::unique_ptr<GeoSet> GeoSet::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto set = std::make_unique<GeoSet>();
+
+    auto numMembers = reader.read<uint64_t>();
+    set->m_members.reserve(numMembers);
+
+    for (uint64_t i = 0; i < numMembers; ++i)
+    {
+        auto hash = reader.read<uint64_t>();
+        auto [it, inserted] = set->m_members.try_emplace(reader.readString(), hash);
+
+        if (set->m_blocks.empty() || set->m_blocks.back().size() >= BLOCK_SIZE / 2)
+            set->m_blocks.emplace_back().reserve(BLOCK_SIZE);
+        set->m_blocks.back().push_back({hash, &it->first});
+    }
+
+    return set;
+}
@@ -0,0 +1,83 @@
+#ifndef GEOSET_H
+#define GEOSET_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/*
+   Geo set
+   - member -> 52 bit geohash, plus an index ordered by (hash, member) so the members of a geohash
+     cell are one contiguous range
+   - The ordered index is a list of sorted blocks (at most BLOCK_SIZE entries each, split when full),
+     16 byte entries pointing at the member strings owned by the hash map. Range scans read
+     contiguous memory and inserts only shift entries inside one block
+   - Area searches scan the (at most 9) cell ranges around the centre and filter by exact distance
+*/
+
+class GeoSet
+{
+public:
+    enum class Sort
+    {
+        NONE,
+        ASC,
+        DESC
+    };
+
+    struct Shape
+    {
+        bool isBox{};
+        double radius{}; // meters, BYRADIUS
+        double width{};  // meters, BYBOX
+        double height{};
+    };
+
+    struct Match
+    {
+        const std::string *member;
+        double distance; // meters
+        uint64_t hash;
+    };
+
+    /* Returns true if the member is new. 'changed' is set if a new member was added or an existing one moved */
+    bool Add(const std::string &member, double longitude, double latitude, bool &changed);
+    bool Remove(const std::string &member);
+
+    bool GetPosition(const std::string &member, double &longitude, double &latitude) const;
+    bool GetHash(const std::string &member, uint64_t &hash) const;
+
+    /* 'count' = 0 means no limit. With 'any' the scan stops after 'count' matches instead of returning the closest ones */
+    std::vector<Match> Search(double longitude, double latitude, const Shape &shape, Sort sort, size_t count = 0, bool any = false) const;
+
+    size_t Size() const { return m_members.size(); }
+    size_t MemoryUsage() const;
+
+    std::string Serialize() const;
+    static std::unique_ptr<GeoSet> Deserialize(const std::string &blob);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 512;
+
+    struct Entry
+    {
+        uint64_t hash;
+        const std::string *member;
+
+        bool operator<(const Entry &other) const
+        {
+            return hash != other.hash ? hash < other.hash : *member < *other.member;
+        }
+    };
+
+    std::unordered_map<std::string, uint64_t> m_members; // node based, so key addresses are stable
+    std::vector<std::vector<Entry>> m_blocks;            // non empty, sorted, ordered between each other
+
+    void indexInsert(const Entry &entry);
+    void indexErase(const Entry &entry);
+    size_t blockFor(const Entry &entry) const;
+};
+
+#endif // GEOSET_H
@@ -0,0 +1,151 @@
+
+#include <stdexcept>
+
+#include "HashHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+std::string HashHandler::HashCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    if (command == HSET)
+        return hsetHandler(std::move(commandArgs));
+    else if (command == HGET)
+        return hgetHandler(std::move(commandArgs));
+    else if (command == HGETALL)
+        return hgetallHandler(std::move(commandArgs));
+    else if (command == HDEL)
+        return hdelHandler(std::move(commandArgs));
+    else if (command == HLEN)
+        return hlenHandler(std::move(commandArgs));
+
+    return RESPEncoder::encodeError("Unsupported hash command");
+}
+
+const HashHandler::Hash *HashHandler::GetHash(const std::string &key) const
+{
+    auto it = m_hashes.find(key);
+    return it == m_hashes.end() ? nullptr : &it->second;
+}
+
+// HSET key field value [field value ...]
+std::string HashHandler::hsetHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4 || commandArgs->size() % 2 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'hset' command");
+
+    Hash &hash = m_hashes[(*commandArgs)[1]];
+    long long added = 0;
+    for (size_t i = 2; i < commandArgs->size(); i += 2)
+    {
+        auto [it, inserted] = hash.insert_or_assign((*commandArgs)[i], (*commandArgs)[i + 1]);
+        added += inserted;
+    }
+
+    return RESPEncoder::encodeInteger(added);
+}
+
+// HGET key field
+std::string HashHandler::hgetHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'hget' command");
+
+    const Hash *hash = GetHash((*commandArgs)[1]);
+    if (!hash)
+        return NULL_BULK_ENCODED;
+
+    auto it = hash->find((*commandArgs)[2]);
+    return it == hash->end() ? NULL_BULK_ENCODED : RESPEncoder::encodeString(it->second);
+}
+
+// HGETALL key
+std::string HashHandler::hgetallHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'hgetall' command");
+
+    std::vector<std::string> fieldsAndValues;
+    if (const Hash *hash = GetHash((*commandArgs)[1]))
+    {
+        for (const auto &[field, value] : *hash)
+        {
+            fieldsAndValues.push_back(field);
+            fieldsAndValues.push_back(value);
+        }
+    }
+
+    return RESPEncoder::encodeArray(fieldsAndValues);
+}
+
+// HDEL key field [field ...], the key is deleted with its last field
+std::string HashHandler::hdelHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'hdel' command");
+
+    auto it = m_hashes.find((*commandArgs)[1]);
+    if (it == m_hashes.end())
+        return RESPEncoder::encodeInteger(0);
+
+    long long removed = 0;
+    for (size_t i = 2; i < commandArgs->size(); ++i)
+        removed += it->second.erase((*commandArgs)[i]);
+
+    if (it->second.empty())
+        m_hashes.erase(it);
+
+    return RESPEncoder::encodeInteger(removed);
+}
+
+// HLEN key
+std::string HashHandler::hlenHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'hlen' command");
+
+    const Hash *hash = GetHash((*commandArgs)[1]);
+    return RESPEncoder::encodeInteger(hash ? hash->size() : 0);
+}
+
+void HashHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, hash] : segment.Of(m_hashes))
+    {
+        writer.WriteKey(RDB_TYPE_HASH, key);
+        writer.WriteLength(hash.size());
+        for (const auto &[field, value] : hash)
+        {
+            writer.WriteString(field);
+            writer.WriteString(value);
+        }
+    }
+}
+
+void HashHandler::LoadRdb(RdbReader &reader, uint8_t type, const std::string &key)
+{
+    auto pairs = reader.ReadHash(type);
+
+    Hash &hash = m_hashes[key];
+    hash.clear();
+    hash.reserve(pairs.size());
+    for (auto &[field, value] : pairs)
+        hash[std::move(field)] = std::move(value);
+}
+
+void HashHandler::MergeFrom(HashHandler &other)
+{
+    m_hashes.merge(other.m_hashes);
+}
+
+void HashHandler::Swap(HashHandler &other)
+{
+    m_hashes.swap(other.m_hashes);
+}
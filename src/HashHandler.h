@@ -0,0 +1,50 @@
+#ifndef HASHHANDLER_H
+#define HASHHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+/*
+   Hash type (field -> value maps), the documents FT.* indexes are built from
+*/
+
+class HashHandler
+{
+public:
+    using Hash = std::unordered_map<std::string, std::string>;
+
+private:
+    std::unordered_map<std::string, Hash> m_hashes;
+
+    std::string hsetHandler(CommandArray commandArgs);
+    std::string hgetHandler(CommandArray commandArgs);
+    std::string hgetallHandler(CommandArray commandArgs);
+    std::string hdelHandler(CommandArray commandArgs);
+    std::string hlenHandler(CommandArray commandArgs);
+
+public:
+    std::string HashCommandProcessor(CommandArray commandArgs);
+
+    bool IsHashPresent(const std::string &key) const { return m_hashes.contains(key); }
+
+    size_t KeyCount() const { return m_hashes.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key); /* any of the hash encodings (zipmap, ziplist, listpack) */
+    void MergeFrom(HashHandler &other);
+    void Swap(HashHandler &other);
+
+    /* nullptr if the key doesn't exist */
+    const Hash *GetHash(const std::string &key) const;
+
+    const std::unordered_map<std::string, Hash> &GetAllHashes() const { return m_hashes; }
+};
+
+#endif // HASHHANDLER_H
@@ -0,0 +1,479 @@
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HLL_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#include "HyperLogLog.h"
+#include "Utility.h"
+
+/*
+   Header layout (16 bytes):
+   "HYLL" | encoding (1 byte) | unused (3 bytes) | cached cardinality (8 bytes, little endian)
+   The most significant bit of the last cardinality byte is set when the cache is invalid.
+
+   Sparse opcodes:
+   ZERO  00xxxxxx           -> 1 to 64 registers set to 0
+   XZERO 01xxxxxx yyyyyyyy  -> 1 to 16384 registers set to 0
+   VAL   1vvvvvxx           -> 1 to 4 registers set to value 1 to 32
+*/
+
+namespace
+{
+    constexpr uint64_t HASH_SEED = 0xadc83b19ULL;
+    constexpr int SPARSE_VAL_MAX_VALUE = 32;
+    constexpr int SPARSE_VAL_MAX_LEN = 4;
+    constexpr int SPARSE_ZERO_MAX_LEN = 64;
+    constexpr int SPARSE_XZERO_MAX_LEN = 16384;
+
+#ifdef HLL_KERNELS_X86
+    // Register wise max 32 at a time, for CPUs that have AVX2 (picked at run time). Returns how many were merged
+    __attribute__((target("avx2"))) long mergeRegistersAvx2(uint8_t *target, const uint8_t *source)
+    {
+        long index = 0;
+        for (; index + 32 <= HyperLogLog::REGISTERS; index += 32)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(target + index));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + index));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(target + index), _mm256_max_epu8(a, b));
+        }
+        return index;
+    }
+#endif
+
+    std::string makeHeader(HyperLogLog::Encoding encoding)
+    {
+        std::string header("HYLL", 4);
+        header.push_back(static_cast<char>(encoding));
+        header.append(11, '\0'); // 3 unused bytes + 8 bytes of cardinality (0 => valid and empty)
+        return header;
+    }
+
+    /* Walks the sparse opcodes calling fn(firstRegister, runLength, value) for each run */
+    template <typename Fn>
+    void forEachSparseRun(const std::string &hll, Fn &&fn)
+    {
+        auto p = reinterpret_cast<const uint8_t *>(hll.data()) + HyperLogLog::HEADER_SIZE;
+        auto end = reinterpret_cast<const uint8_t *>(hll.data()) + hll.size();
+        long index = 0;
+
+        while (p < end && index < HyperLogLog::REGISTERS)
+        {
+            long runLength{};
+            uint8_t value{};
+
+            if ((*p & 0xC0) == 0x00) // ZERO
+            {
+                runLength = (*p & 0x3F) + 1;
+                ++p;
+            }
+            else if ((*p & 0xC0) == 0x40) // XZERO
+            {
+                if (p + 1 >= end)
+                    break;
+                runLength = (((*p & 0x3F) << 8) | p[1]) + 1;
+                p += 2;
+            }
+            else // VAL
+            {
+                value = ((*p >> 2) & 0x1F) + 1;
+                runLength = (*p & 0x03) + 1;
+                ++p;
+            }
+
+            runLength = std::min(runLength, HyperLogLog::REGISTERS - index);
+            fn(index, runLength, value);
+            index += runLength;
+        }
+    }
+
+    /* Appends the opcodes for 'runLength' registers set to 'value' (at most 32) */
+    void appendSparseRun(std::string &sparse, uint8_t value, long runLength)
+    {
+        while (runLength > 0)
+        {
+            if (value == 0 && runLength > SPARSE_ZERO_MAX_LEN)
+            {
+                long len = std::min<long>(runLength, SPARSE_XZERO_MAX_LEN);
+                sparse.push_back(static_cast<char>(0x40 | ((len - 1) >> 8)));
+                sparse.push_back(static_cast<char>((len - 1) & 0xFF));
+                runLength -= len;
+            }
+            else if (value == 0)
+            {
+                sparse.push_back(static_cast<char>(runLength - 1));
+                runLength = 0;
+            }
+            else
+            {
+                long len = std::min<long>(runLength, SPARSE_VAL_MAX_LEN);
+                sparse.push_back(static_cast<char>(0x80 | ((value - 1) << 2) | (len - 1)));
+                runLength -= len;
+            }
+        }
+    }
+
+    double sigma(double x)
+    {
+        if (x == 1.0)
+            return INFINITY;
+
+        double zPrime;
+        double y = 1;
+        double z = x;
+        do
+        {
+            x *= x;
+            zPrime = z;
+            z += x * y;
+            y += y;
+        } while (zPrime != z);
+
+        return z;
+    }
+
+    double tau(double x)
+    {
+        if (x == 0.0 || x == 1.0)
+            return 0.0;
+
+        double zPrime;
+        double y = 1.0;
+        double z = 1 - x;
+        do
+        {
+            x = std::sqrt(x);
+            zPrime = z;
+            y *= 0.5;
+            z -= std::pow(1 - x, 2) * y;
+        } while (zPrime != z);
+
+        return z / 3;
+    }
+}
+
+std::string HyperLogLog::CreateEmpty()
+{
+    std::string hll = makeHeader(SPARSE);
+
+    // single XZERO opcode covering all registers
+    hll.push_back(static_cast<char>(0x40 | ((REGISTERS - 1) >> 8)));
+    hll.push_back(static_cast<char>((REGISTERS - 1) & 0xFF));
+
+    return hll;
+}
+
+bool HyperLogLog::IsValid(const std::string &hll)
+{
+    if (hll.size() < HEADER_SIZE || hll.compare(0, 4, "HYLL") != 0)
+        return false;
+
+    if (hll[4] == DENSE)
+        return hll.size() == DENSE_SIZE;
+
+    return hll[4] == SPARSE;
+}
+
+bool HyperLogLog::Add(std::string &hll, const std::string &element)
+{
+    long index{};
+    uint8_t count = patternLength(element, index);
+
+    return IsSparse(hll) ? addSparse(hll, index, count) : addDense(hll, index, count);
+}
+
+uint64_t HyperLogLog::Count(std::string &hll, bool &cacheUpdated)
+{
+    auto card = reinterpret_cast<uint8_t *>(hll.data()) + 8;
+    cacheUpdated = false;
+
+    if ((card[7] & 0x80) == 0)
+    {
+        uint64_t cached{};
+        for (int i = 7; i >= 0; --i)
+            cached = (cached << 8) | card[i];
+        return cached;
+    }
+
+    int histogram[64]{};
+
+    if (IsSparse(hll))
+    {
+        forEachSparseRun(hll, [&histogram](long, long runLength, uint8_t value)
+        { histogram[value] += runLength; });
+    }
+    else
+    {
+        auto regs = reinterpret_cast<const uint8_t *>(hll.data()) + HEADER_SIZE;
+        for (long index = 0; index < REGISTERS; ++index)
+            ++histogram[getDenseRegister(regs, index)];
+    }
+
+    uint64_t cardinality = estimate(histogram);
+
+    for (int i = 0; i < 8; ++i)
+        card[i] = (cardinality >> (i * 8)) & 0xFF;
+    cacheUpdated = true;
+
+    return cardinality;
+}
+
+void HyperLogLog::UnpackRegisters(const std::string &hll, uint8_t *registers)
+{
+    if (IsSparse(hll))
+    {
+        std::memset(registers, 0, REGISTERS);
+        forEachSparseRun(hll, [registers](long first, long runLength, uint8_t value)
+        {
+            if (value != 0)
+                std::memset(registers + first, value, runLength);
+        });
+        return;
+    }
+
+    // Dense: every 3 bytes hold exactly 4 registers
+    auto p = reinterpret_cast<const uint8_t *>(hll.data()) + HEADER_SIZE;
+    for (long index = 0; index < REGISTERS; index += 4, p += 3)
+    {
+        registers[index] = p[0] & REGISTER_MAX;
+        registers[index + 1] = ((p[0] >> 6) | (p[1] << 2)) & REGISTER_MAX;
+        registers[index + 2] = ((p[1] >> 4) | (p[2] << 4)) & REGISTER_MAX;
+        registers[index + 3] = p[2] >> 2;
+    }
+}
+
+void HyperLogLog::MergeRegisters(uint8_t *target, const uint8_t *source)
+{
+    long index = 0;
+
+#ifdef HLL_KERNELS_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        index = mergeRegistersAvx2(target, source);
+#endif
+#if defined(__SSE2__)
+    for (; index + 16 <= REGISTERS; index += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(target + index));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(target + index), _mm_max_epu8(a, b));
+    }
+#endif
+
+    for (; index < REGISTERS; ++index)
+        target[index] = std::max(target[index], source[index]);
+}
+
+uint64_t HyperLogLog::CountRegisters(const uint8_t *registers)
+{
+    int histogram[64]{};
+    for (long index = 0; index < REGISTERS; ++index)
+        ++histogram[registers[index]];
+
+    return estimate(histogram);
+}
+
+std::string HyperLogLog::FromRegisters(const uint8_t *registers, bool preferSparse)
+{
+    if (preferSparse && *std::max_element(registers, registers + REGISTERS) <= SPARSE_VAL_MAX_VALUE)
+    {
+        std::string sparse = encodeSparse(registers);
+        if (sparse.size() <= SPARSE_MAX_BYTES)
+        {
+            std::string hll = makeHeader(SPARSE) + sparse;
+            invalidateCache(hll);
+            return hll;
+        }
+    }
+
+    std::string hll = makeHeader(DENSE);
+    hll.resize(DENSE_SIZE, '\0');
+
+    auto p = reinterpret_cast<uint8_t *>(hll.data()) + HEADER_SIZE;
+    for (long index = 0; index < REGISTERS; index += 4, p += 3)
+    {
+        p[0] = registers[index] | (registers[index + 1] << 6);
+        p[1] = (registers[index + 1] >> 2) | (registers[index + 2] << 4);
+        p[2] = (registers[index + 2] >> 4) | (registers[index + 3] << 2);
+    }
+
+    invalidateCache(hll);
+    return hll;
+}
+
+int HyperLogLog::patternLength(const std::string &element, long &index)
+{
+    uint64_t hash = murmurHash64A(element, HASH_SEED);
+    index = hash & (REGISTERS - 1);
+
+    // Count the zeroes (+1) after the register index bits, sentinel bit guarantees termination
+    hash >>= P;
+    hash |= 1ULL << Q;
+
+    uint64_t bit = 1;
+    int count = 1;
+    while ((hash & bit) == 0)
+    {
+        ++count;
+        bit <<= 1;
+    }
+
+    return count;
+}
+
+uint8_t HyperLogLog::getDenseRegister(const uint8_t *regs, long index)
+{
+    long byte = index * REGISTER_BITS / 8;
+    int firstBit = (index * REGISTER_BITS) & 7;
+
+    if (firstBit <= 8 - REGISTER_BITS)
+        return (regs[byte] >> firstBit) & REGISTER_MAX;
+
+    return ((regs[byte] >> firstBit) | (regs[byte + 1] << (8 - firstBit))) & REGISTER_MAX;
+}
+
+void HyperLogLog::setDenseRegister(uint8_t *regs, long index, uint8_t value)
+{
+    long byte = index * REGISTER_BITS / 8;
+    int firstBit = (index * REGISTER_BITS) & 7;
+
+    regs[byte] &= ~(REGISTER_MAX << firstBit);
+    regs[byte] |= value << firstBit;
+
+    if (firstBit > 8 - REGISTER_BITS)
+    {
+        regs[byte + 1] &= ~(REGISTER_MAX >> (8 - firstBit));
+        regs[byte + 1] |= value >> (8 - firstBit);
+    }
+}
+
+bool HyperLogLog::addDense(std::string &hll, long index, uint8_t count)
+{
+    auto regs = reinterpret_cast<uint8_t *>(hll.data()) + HEADER_SIZE;
+
+    if (getDenseRegister(regs, index) >= count)
+        return false;
+
+    setDenseRegister(regs, index, count);
+    invalidateCache(hll);
+    return true;
+}
+
+bool HyperLogLog::addSparse(std::string &hll, long index, uint8_t count)
+{
+    // Find the opcode whose run covers the register, and the one before it
+    auto ops = reinterpret_cast<const uint8_t *>(hll.data());
+    size_t at = HEADER_SIZE, previous = HEADER_SIZE, opLength{};
+    long first = 0, runLength{};
+    uint8_t current{};
+    for (; at < hll.size(); previous = at, at += opLength, first += runLength)
+    {
+        opLength = (ops[at] & 0xC0) == 0x40 ? 2 : 1;
+        if (at + opLength > hll.size())
+            break;
+        current = 0;
+        if ((ops[at] & 0xC0) == 0x00) // ZERO
+            runLength = (ops[at] & 0x3F) + 1;
+        else if ((ops[at] & 0xC0) == 0x40) // XZERO
+            runLength = (((ops[at] & 0x3F) << 8) | ops[at + 1]) + 1;
+        else // VAL
+        {
+            runLength = (ops[at] & 0x03) + 1;
+            current = ((ops[at] >> 2) & 0x1F) + 1;
+        }
+        if (index < first + runLength)
+            break;
+    }
+
+    // Opcodes that don't cover every register: dense is rebuilt from what there is
+    bool covered = at < hll.size() && at + opLength <= hll.size();
+    if (covered && current >= count)
+        return false;
+
+    if (!covered || count > SPARSE_VAL_MAX_VALUE)
+    {
+        promoteToDense(hll);
+        return addDense(hll, index, count);
+    }
+
+    // Split the run around the register, the way Redis does: same value before, the new one, same value after
+    std::string split;
+    appendSparseRun(split, current, index - first);
+    appendSparseRun(split, count, 1);
+    appendSparseRun(split, current, first + runLength - index - 1);
+    hll.replace(at, opLength, split);
+
+    // A VAL next to one of the same value (the run before, or one just split off) becomes a single opcode
+    for (size_t op = previous, merged = 0; merged < 5 && op < hll.size(); ++merged)
+    {
+        auto code = static_cast<uint8_t>(hll[op]);
+        auto next = op + 1 < hll.size() ? static_cast<uint8_t>(hll[op + 1]) : 0;
+        if ((code & 0x80) && (next & 0x80) && ((code ^ next) & 0x7C) == 0 && (code & 0x03) + (next & 0x03) + 2 <= SPARSE_VAL_MAX_LEN)
+        {
+            hll[op] = static_cast<char>(code + (next & 0x03) + 1);
+            hll.erase(op + 1, 1);
+            continue;
+        }
+        op += (code & 0xC0) == 0x40 ? 2 : 1;
+    }
+
+    if (hll.size() - HEADER_SIZE > SPARSE_MAX_BYTES)
+    {
+        promoteToDense(hll);
+        return true;
+    }
+
+    invalidateCache(hll);
+    return true;
+}
+
+void HyperLogLog::promoteToDense(std::string &hll)
+{
+    uint8_t registers[REGISTERS];
+    UnpackRegisters(hll, registers);
+    hll = FromRegisters(registers, false);
+}
+
+std::string HyperLogLog::encodeSparse(const uint8_t *registers)
+{
+    std::string sparse;
+    long index = 0;
+
+    while (index < REGISTERS)
+    {
+        uint8_t value = registers[index];
+        long runLength = 1;
+        while (index + runLength < REGISTERS && registers[index + runLength] == value)
+            ++runLength;
+
+        appendSparseRun(sparse, value, runLength);
+        index += runLength;
+    }
+
+    return sparse;
+}
+
+void HyperLogLog::invalidateCache(std::string &hll)
+{
+    hll[HEADER_SIZE - 1] = static_cast<char>(static_cast<uint8_t>(hll[HEADER_SIZE - 1]) | 0x80);
+}
+
+uint64_t HyperLogLog::estimate(const int *histogram)
+{
+    // Ertl's improved raw estimator, same as used by Redis (no bias correction tables needed)
+    const double m = REGISTERS;
+
+    double z = m * tau((m - histogram[Q + 1]) / m);
+    for (int j = Q; j >= 1; --j)
+    {
+        z += histogram[j];
+        z *= 0.5;
+    }
+    z += m * sigma(histogram[0] / m);
+
+    return static_cast<uint64_t>(std::llround(0.5 / std::log(2.0) * m * m / z));
+}
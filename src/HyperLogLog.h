@@ -0,0 +1,65 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <string>
+#include <cstdint>
+
+/*
+   HyperLogLog
+   - Uses the same string layout as Redis ("HYLL" header followed by registers) so the value
+     lives in KeyValueStore as a plain string and gets saved / replicated like any other string
+   - Sparse encoding (run length opcodes) while the set is small, promoted to dense encoding
+     (16384 registers of 6 bits = 12KB) once it grows
+   - Header caches the last computed cardinality, it is invalidated whenever a register changes
+*/
+
+class HyperLogLog
+{
+public:
+    static constexpr int P = 14;                  // bits of the hash used to select a register
+    static constexpr int REGISTERS = 1 << P;      // 16384 registers
+    static constexpr int Q = 64 - P;              // bits of the hash used to count leading zeroes
+    static constexpr int REGISTER_BITS = 6;
+    static constexpr int REGISTER_MAX = (1 << REGISTER_BITS) - 1;
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr size_t DENSE_SIZE = HEADER_SIZE + (REGISTERS * REGISTER_BITS + 7) / 8;
+    static constexpr size_t SPARSE_MAX_BYTES = 3000; // promote to dense beyond this
+
+    enum Encoding : uint8_t
+    {
+        DENSE = 0,
+        SPARSE = 1
+    };
+
+    static std::string CreateEmpty();
+    static bool IsValid(const std::string &hll);
+    static bool IsSparse(const std::string &hll) { return hll[4] == SPARSE; }
+
+    /* Returns true if some register was updated (the cached cardinality is invalidated then) */
+    static bool Add(std::string &hll, const std::string &element);
+
+    /* Uses the cached cardinality if valid, otherwise computes and caches it. Sets 'cacheUpdated' if hll was modified */
+    static uint64_t Count(std::string &hll, bool &cacheUpdated);
+
+    /* Helpers for PFMERGE and multi key PFCOUNT which work on unpacked registers (one byte per register) */
+    static void UnpackRegisters(const std::string &hll, uint8_t *registers);
+    static void MergeRegisters(uint8_t *target, const uint8_t *source); // target[i] = max(target[i], source[i])
+    static uint64_t CountRegisters(const uint8_t *registers);
+    static std::string FromRegisters(const uint8_t *registers, bool preferSparse);
+
+private:
+    static int patternLength(const std::string &element, long &index);
+
+    static uint8_t getDenseRegister(const uint8_t *regs, long index);
+    static void setDenseRegister(uint8_t *regs, long index, uint8_t value);
+
+    static bool addDense(std::string &hll, long index, uint8_t count);
+    static bool addSparse(std::string &hll, long index, uint8_t count);
+    static void promoteToDense(std::string &hll);
+    static std::string encodeSparse(const uint8_t *registers);
+
+    static void invalidateCache(std::string &hll);
+    static uint64_t estimate(const int *histogram);
+};
+
+#endif // HYPERLOGLOG_H
@@ -0,0 +1,872 @@
+
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Json.h"
+#include "Utility.h"
+
+namespace
+{
+    inline bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+#if defined(__SSE2__)
+    // Bit i set for every byte of the 16 at 'p' that ends a plain string run: '"', '\\' or a control character
+    inline unsigned stringSpecialMask(const char *p)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i quote = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+        __m128i backslash = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+        __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(chunk, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+        return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, backslash), control));
+    }
+
+    // Bit i set for every byte of the 16 at 'p' that is JSON whitespace
+    inline unsigned whitespaceMask(const char *p)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+        __m128i other = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+        return _mm_movemask_epi8(_mm_or_si128(space, other));
+    }
+#else
+    // Same masks a byte at a time on targets without SSE2
+    inline unsigned stringSpecialMask(const char *p)
+    {
+        unsigned mask = 0;
+        for (int index = 0; index < 16; ++index)
+        {
+            unsigned char c = static_cast<unsigned char>(p[index]);
+            if (c == '"' || c == '\\' || c < 0x20)
+                mask |= 1u << index;
+        }
+        return mask;
+    }
+
+    inline unsigned whitespaceMask(const char *p)
+    {
+        unsigned mask = 0;
+        for (int index = 0; index < 16; ++index)
+        {
+            if (isWhitespace(p[index]))
+                mask |= 1u << index;
+        }
+        return mask;
+    }
+#endif
+
+    void appendUtf8(std::string &out, uint32_t codePoint)
+    {
+        if (codePoint < 0x80)
+            out.push_back(codePoint);
+        else if (codePoint < 0x800)
+        {
+            out.push_back(0xC0 | (codePoint >> 6));
+            out.push_back(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out.push_back(0xE0 | (codePoint >> 12));
+            out.push_back(0x80 | ((codePoint >> 6) & 0x3F));
+            out.push_back(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            out.push_back(0xF0 | (codePoint >> 18));
+            out.push_back(0x80 | ((codePoint >> 12) & 0x3F));
+            out.push_back(0x80 | ((codePoint >> 6) & 0x3F));
+            out.push_back(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    void dumpString(std::string &out, std::string_view str)
+    {
+        static const char HEX[] = "0123456789abcdef";
+
+        out.push_back('"');
+        const char *p = str.data(), *end = p + str.size();
+        while (p < end)
+        {
+            const char *run = p;
+            while (end - p >= 16)
+            {
+                unsigned mask = stringSpecialMask(p);
+                if (mask)
+                {
+                    p += __builtin_ctz(mask);
+                    break;
+                }
+                p += 16;
+            }
+            while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20)
+                ++p;
+            out.append(run, p);
+
+            if (p == end)
+                break;
+
+            char c = *p++;
+            switch (c)
+            {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            case '\b':
+                out.append("\\b");
+                break;
+            case '\f':
+                out.append("\\f");
+                break;
+            default:
+                out.append("\\u00");
+                out.push_back(HEX[(c >> 4) & 0xF]);
+                out.push_back(HEX[c & 0xF]);
+            }
+        }
+        out.push_back('"');
+    }
+}
+
+class JsonValue::Parser
+{
+public:
+    Parser(std::string_view text) : m_begin(text.data()), m_p(text.data()), m_end(text.data() + text.size()) {}
+
+    JsonValue ParseDocument()
+    {
+        skipWhitespace();
+        JsonValue value = parseValue(0);
+        skipWhitespace();
+        if (m_p != m_end)
+            fail("unexpected trailing characters");
+        return value;
+    }
+
+private:
+    const char *m_begin;
+    const char *m_p;
+    const char *m_end;
+
+    [[noreturn]] void fail(const char *what) const
+    {
+        throw std::invalid_argument(std::string("invalid JSON, ") + what + " at offset " + std::to_string(m_p - m_begin));
+    }
+
+    void skipWhitespace()
+    {
+        if (m_p == m_end || !isWhitespace(*m_p))
+            return; // the common case: tokens are separated by nothing or a single space
+
+        while (m_end - m_p >= 16)
+        {
+            unsigned mask = whitespaceMask(m_p);
+            if (mask != 0xFFFF)
+            {
+                m_p += __builtin_ctz(~mask);
+                return;
+            }
+            m_p += 16;
+        }
+        while (m_p < m_end && isWhitespace(*m_p))
+            ++m_p;
+    }
+
+    void expect(char c, const char *what)
+    {
+        if (m_p == m_end || *m_p != c)
+            fail(what);
+        ++m_p;
+    }
+
+    JsonValue parseValue(int depth)
+    {
+        if (m_p == m_end)
+            fail("unexpected end of input");
+
+        switch (*m_p)
+        {
+        case '{':
+            return parseObject(depth + 1);
+        case '[':
+            return parseArray(depth + 1);
+        case '"':
+        {
+            ++m_p;
+            JsonValue value{std::string()};
+            parseString(std::get<std::string>(value.m_value));
+            return value;
+        }
+        case 't':
+            parseLiteral("true");
+            return JsonValue(true);
+        case 'f':
+            parseLiteral("false");
+            return JsonValue(false);
+        case 'n':
+            parseLiteral("null");
+            return JsonValue();
+        default:
+            return parseNumber();
+        }
+    }
+
+    void parseLiteral(std::string_view literal)
+    {
+        if (static_cast<size_t>(m_end - m_p) < literal.size() || std::memcmp(m_p, literal.data(), literal.size()) != 0)
+            fail("unexpected token");
+        m_p += literal.size();
+    }
+
+    JsonValue parseObject(int depth)
+    {
+        if (depth > MAX_DEPTH)
+            fail("document nested too deep");
+
+        ++m_p; // '{'
+        JsonValue value;
+        Object &object = value.m_value.emplace<Object>();
+
+        skipWhitespace();
+        if (m_p < m_end && *m_p == '}')
+        {
+            ++m_p;
+            return value;
+        }
+
+        while (true)
+        {
+            skipWhitespace();
+            expect('"', "expected member name");
+            std::string key;
+            parseString(key);
+
+            skipWhitespace();
+            expect(':', "expected ':'");
+            skipWhitespace();
+            object.emplace_back(std::move(key), parseValue(depth));
+
+            skipWhitespace();
+            if (m_p < m_end && *m_p == ',')
+            {
+                ++m_p;
+                continue;
+            }
+            expect('}', "expected ',' or '}'");
+            return value;
+        }
+    }
+
+    JsonValue parseArray(int depth)
+    {
+        if (depth > MAX_DEPTH)
+            fail("document nested too deep");
+
+        ++m_p; // '['
+        JsonValue value;
+        Array &array = value.m_value.emplace<Array>();
+
+        skipWhitespace();
+        if (m_p < m_end && *m_p == ']')
+        {
+            ++m_p;
+            return value;
+        }
+
+        while (true)
+        {
+            skipWhitespace();
+            array.push_back(parseValue(depth));
+
+            skipWhitespace();
+            if (m_p < m_end && *m_p == ',')
+            {
+                ++m_p;
+                continue;
+            }
+            expect(']', "expected ',' or ']'");
+            return value;
+        }
+    }
+
+    // Called after the opening quote, consumes the closing one
+    void parseString(std::string &out)
+    {
+        while (true)
+        {
+            const char *run = m_p;
+            while (m_end - m_p >= 16)
+            {
+                unsigned mask = stringSpecialMask(m_p);
+                if (mask)
+                {
+                    m_p += __builtin_ctz(mask);
+                    break;
+                }
+                m_p += 16;
+            }
+            while (m_p < m_end && *m_p != '"' && *m_p != '\\' && static_cast<unsigned char>(*m_p) >= 0x20)
+                ++m_p;
+            out.append(run, m_p);
+
+            if (m_p == m_end)
+                fail("unterminated string");
+
+            char c = *m_p++;
+            if (c == '"')
+                return;
+            if (c != '\\')
+                fail("control character in string");
+            if (m_p == m_end)
+                fail("unterminated string");
+
+            switch (*m_p++)
+            {
+            case '"':
+                out.push_back('"');
+                break;
+            case '\\':
+                out.push_back('\\');
+                break;
+            case '/':
+                out.push_back('/');
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+            {
+                uint32_t codePoint = parseHex4();
+                if (codePoint >= 0xD800 && codePoint < 0xDC00) // high surrogate, a low one must follow
+                {
+                    if (m_end - m_p < 6 || m_p[0] != '\\' || m_p[1] != 'u')
+                        fail("invalid surrogate pair");
+                    m_p += 2;
+                    uint32_t low = parseHex4();
+                    if (low < 0xDC00 || low >= 0xE000)
+                        fail("invalid surrogate pair");
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+    }
+
+    uint32_t parseHex4()
+    {
+        if (m_end - m_p < 4)
+            fail("invalid unicode escape");
+
+        uint32_t value;
+        auto [ptr, ec] = std::from_chars(m_p, m_p + 4, value, 16);
+        if (ec != std::errc() || ptr != m_p + 4)
+            fail("invalid unicode escape");
+        m_p += 4;
+        return value;
+    }
+
+    JsonValue parseNumber()
+    {
+        const char *start = m_p;
+        auto digits = [this]()
+        {
+            const char *first = m_p;
+            while (m_p < m_end && *m_p >= '0' && *m_p <= '9')
+                ++m_p;
+            return m_p - first;
+        };
+
+        if (m_p < m_end && *m_p == '-')
+            ++m_p;
+        if (m_p < m_end && *m_p == '0')
+            ++m_p;
+        else if (digits() == 0)
+            fail("unexpected token");
+
+        bool integral = true;
+        if (m_p < m_end && *m_p == '.')
+        {
+            ++m_p;
+            integral = false;
+            if (digits() == 0)
+                fail("invalid number");
+        }
+        if (m_p < m_end && (*m_p == 'e' || *m_p == 'E'))
+        {
+            ++m_p;
+            integral = false;
+            if (m_p < m_end && (*m_p == '+' || *m_p == '-'))
+                ++m_p;
+            if (digits() == 0)
+                fail("invalid number");
+        }
+
+        if (integral)
+        {
+            int64_t value;
+            auto [ptr, ec] = std::from_chars(start, m_p, value);
+            if (ec == std::errc())
+                return JsonValue(value);
+            // too big for int64, keep it as a double
+        }
+
+        double value;
+        auto [ptr, ec] = std::from_chars(start, m_p, value);
+        if (ec != std::errc() || !std::isfinite(value))
+            fail("number out of range");
+        return JsonValue(value);
+    }
+};
+
+JsonValue JsonValue::Parse(std::string_view text)
+{
+    return Parser(text).ParseDocument();
+}
+
+const char *JsonValue::TypeName() const
+{
+    switch (GetType())
+    {
+    case Type::NUL:
+        return "null";
+    case Type::BOOLEAN:
+        return "boolean";
+    case Type::INTEGER:
+        return "integer";
+    case Type::NUMBER:
+        return "number";
+    case Type::STRING:
+        return "string";
+    case Type::ARRAY:
+        return "array";
+    case Type::OBJECT:
+        return "object";
+    }
+    return "unknown";
+}
+
+JsonValue *JsonValue::Member(std::string_view key)
+{
+    if (GetType() != Type::OBJECT)
+        return nullptr;
+
+    for (auto &[name, value] : AsObject())
+    {
+        if (name == key)
+            return &value;
+    }
+    return nullptr;
+}
+
+std::string JsonValue::Dump() const
+{
+    std::string out;
+    Dump(out);
+    return out;
+}
+
+void JsonValue::Dump(std::string &out) const
+{
+    switch (GetType())
+    {
+    case Type::NUL:
+        out.append("null");
+        break;
+    case Type::BOOLEAN:
+        out.append(std::get<bool>(m_value) ? "true" : "false");
+        break;
+    case Type::INTEGER:
+    {
+        char buffer[24];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), AsInteger());
+        out.append(buffer, end);
+        break;
+    }
+    case Type::NUMBER:
+    {
+        char buffer[32];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), std::get<double>(m_value));
+        out.append(buffer, end);
+        if (std::string_view(buffer, end).find_first_of(".e") == std::string_view::npos)
+            out.append(".0"); // stays a double when parsed back
+        break;
+    }
+    case Type::STRING:
+        dumpString(out, std::get<std::string>(m_value));
+        break;
+    case Type::ARRAY:
+    {
+        out.push_back('[');
+        bool first = true;
+        for (const auto &item : AsArray())
+        {
+            if (!first)
+                out.push_back(',');
+            first = false;
+            item.Dump(out);
+        }
+        out.push_back(']');
+        break;
+    }
+    case Type::OBJECT:
+    {
+        out.push_back('{');
+        bool first = true;
+        for (const auto &[key, value] : AsObject())
+        {
+            if (!first)
+                out.push_back(',');
+            first = false;
+            dumpString(out, key);
+            out.push_back(':');
+            value.Dump(out);
+        }
+        out.push_back('}');
+        break;
+    }
+    }
+}
+
+std::string JsonValue::Serialize() const
+{
+    std::string blob;
+    serialize(blob);
+    return blob;
+}
+
+void JsonValue::serialize(std::string &blob) const
+{
+    appendBinary<uint8_t>(blob, static_cast<uint8_t>(GetType()));
+    switch (GetType())
+    {
+    case Type::NUL:
+        break;
+    case Type::BOOLEAN:
+        appendBinary<uint8_t>(blob, std::get<bool>(m_value));
+        break;
+    case Type::INTEGER:
+        appendBinary<int64_t>(blob, AsInteger());
+        break;
+    case Type::NUMBER:
+        appendBinary<double>(blob, std::get<double>(m_value));
+        break;
+    case Type::STRING:
+        appendBinaryString(blob, std::get<std::string>(m_value));
+        break;
+    case Type::ARRAY:
+        appendBinary<uint64_t>(blob, AsArray().size());
+        for (const auto &item : AsArray())
+            item.serialize(blob);
+        break;
+    case Type::OBJECT:
+        appendBinary<uint64_t>(blob, AsObject().size());
+        for (const auto &[key, value] : AsObject())
+        {
+            appendBinaryString(blob, key);
+            value.serialize(blob);
+        }
+        break;
+    }
+}
+
+std::unique_ptr<JsonValue> JsonValue::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto value = std::make_unique<JsonValue>(deserialize(reader, 0));
+    if (!reader.atEnd())
+        throw std::runtime_error("Unexpected trailing data in serialized JSON");
+    return value;
+}
+
+JsonValue JsonValue::deserialize(BinaryReader &reader, int depth)
+{
+    if (depth > MAX_DEPTH)
+        throw std::runtime_error("Serialized JSON nested too deep");
+
+    JsonValue value;
+    switch (static_cast<Type>(reader.read<uint8_t>()))
+    {
+    case Type::NUL:
+        break;
+    case Type::BOOLEAN:
+        value.m_value = reader.read<uint8_t>() != 0;
+        break;
+    case Type::INTEGER:
+        value.m_value = reader.read<int64_t>();
+        break;
+    case Type::NUMBER:
+        value.m_value = reader.read<double>();
+        break;
+    case Type::STRING:
+        value.m_value = reader.readString();
+        break;
+    case Type::ARRAY:
+    {
+        Array &array = value.m_value.emplace<Array>();
+        for (auto count = reader.read<uint64_t>(); count > 0; --count)
+            array.push_back(deserialize(reader, depth + 1));
+        break;
+    }
+    case Type::OBJECT:
+    {
+        Object &object = value.m_value.emplace<Object>();
+        for (auto count = reader.read<uint64_t>(); count > 0; --count)
+        {
+            std::string key = reader.readString();
+            object.emplace_back(std::move(key), deserialize(reader, depth + 1));
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("Unknown JSON type in serialized data");
+    }
+    return value;
+}
+
+JsonPath::JsonPath(std::string_view path)
+{
+    size_t pos = 0;
+    std::string legacyPath;
+    if (!path.empty() && path[0] == '$')
+        pos = 1;
+    else
+    {
+        m_legacy = true;
+        if (path.empty() || path == ".")
+            return;
+        if (path[0] != '.' && path[0] != '[')
+        {
+            legacyPath = "." + std::string(path);
+            path = legacyPath;
+        }
+    }
+
+    auto isNameChar = [](char c) { return c != '.' && c != '[' && c != ']' && c != ' '; };
+
+    while (pos < path.size())
+    {
+        Segment segment; // a member unless the path says otherwise
+        if (path.substr(pos, 2) == "..")
+        {
+            segment.kind = Segment::Kind::DESCENDANT;
+            pos += 2;
+            if (pos < path.size() && path[pos] == '*')
+            {
+                segment.wildcard = true;
+                ++pos;
+            }
+            else
+            {
+                size_t end = pos;
+                while (end < path.size() && isNameChar(path[end]))
+                    ++end;
+                if (end == pos)
+                    throw std::invalid_argument("missing name after '..' in path");
+                segment.name = path.substr(pos, end - pos);
+                pos = end;
+            }
+        }
+        else if (path[pos] == '.')
+        {
+            ++pos;
+            if (pos < path.size() && path[pos] == '*')
+            {
+                segment.kind = Segment::Kind::WILDCARD;
+                ++pos;
+            }
+            else
+            {
+                size_t end = pos;
+                while (end < path.size() && isNameChar(path[end]))
+                    ++end;
+                if (end == pos)
+                    throw std::invalid_argument("missing name after '.' in path");
+                segment.name = path.substr(pos, end - pos);
+                pos = end;
+            }
+        }
+        else if (path[pos] == '[')
+        {
+            size_t close = path.find(']', pos);
+            if (close == std::string_view::npos)
+                throw std::invalid_argument("missing ']' in path");
+
+            std::string_view inner = path.substr(pos + 1, close - pos - 1);
+            while (!inner.empty() && inner.front() == ' ')
+                inner.remove_prefix(1);
+            while (!inner.empty() && inner.back() == ' ')
+                inner.remove_suffix(1);
+
+            if (inner == "*")
+                segment.kind = Segment::Kind::WILDCARD;
+            else if (inner.size() >= 2 && (inner[0] == '\'' || inner[0] == '"') && inner.back() == inner[0])
+                segment.name = inner.substr(1, inner.size() - 2);
+            else
+            {
+                segment.kind = Segment::Kind::INDEX;
+                auto [ptr, ec] = std::from_chars(inner.data(), inner.data() + inner.size(), segment.index);
+                if (inner.empty() || ec != std::errc() || ptr != inner.data() + inner.size())
+                    throw std::invalid_argument("unsupported path selector '[" + std::string(inner) + "]'");
+            }
+            pos = close + 1;
+        }
+        else
+            throw std::invalid_argument("unexpected character in path at offset " + std::to_string(pos));
+
+        m_segments.push_back(std::move(segment));
+    }
+}
+
+void JsonPath::descend(const Segment &segment, JsonValue &node, std::vector<JsonValue *> &out)
+{
+    // Matches are collected parents first, callers that restructure the tree rely on that order
+    if (node.GetType() == JsonValue::Type::OBJECT)
+    {
+        for (auto &[name, value] : node.AsObject())
+        {
+            if (segment.wildcard || name == segment.name)
+                out.push_back(&value);
+        }
+        for (auto &[name, value] : node.AsObject())
+            descend(segment, value, out);
+    }
+    else if (node.GetType() == JsonValue::Type::ARRAY)
+    {
+        for (auto &item : node.AsArray())
+        {
+            if (segment.wildcard)
+                out.push_back(&item);
+        }
+        for (auto &item : node.AsArray())
+            descend(segment, item, out);
+    }
+}
+
+void JsonPath::apply(const Segment &segment, JsonValue &node, std::vector<JsonValue *> &out)
+{
+    switch (segment.kind)
+    {
+    case Segment::Kind::MEMBER:
+        if (JsonValue *member = node.Member(segment.name))
+            out.push_back(member);
+        break;
+    case Segment::Kind::INDEX:
+        if (node.GetType() == JsonValue::Type::ARRAY)
+        {
+            auto &array = node.AsArray();
+            int64_t index = segment.index < 0 ? segment.index + static_cast<int64_t>(array.size()) : segment.index;
+            if (index >= 0 && index < static_cast<int64_t>(array.size()))
+                out.push_back(&array[index]);
+        }
+        break;
+    case Segment::Kind::WILDCARD:
+        if (node.GetType() == JsonValue::Type::ARRAY)
+        {
+            for (auto &item : node.AsArray())
+                out.push_back(&item);
+        }
+        else if (node.GetType() == JsonValue::Type::OBJECT)
+        {
+            for (auto &[name, value] : node.AsObject())
+                out.push_back(&value);
+        }
+        break;
+    case Segment::Kind::DESCENDANT:
+        descend(segment, node, out);
+        break;
+    }
+}
+
+std::vector<JsonValue *> JsonPath::Evaluate(JsonValue &root) const
+{
+    std::vector<JsonValue *> nodes{&root}, next;
+    for (const auto &segment : m_segments)
+    {
+        next.clear();
+        for (JsonValue *node : nodes)
+            apply(segment, *node, next);
+        nodes.swap(next);
+        if (nodes.empty())
+            break;
+    }
+    return nodes;
+}
+
+size_t JsonPath::Assign(JsonValue &root, const JsonValue &value) const
+{
+    if (m_segments.empty())
+    {
+        root = value;
+        return 1;
+    }
+
+    const Segment &last = m_segments.back();
+    std::vector<JsonValue *> targets;
+    if (last.kind == Segment::Kind::MEMBER)
+    {
+        // Evaluate up to the parents so a missing member can be added
+        std::vector<JsonValue *> parents{&root}, next;
+        for (size_t i = 0; i + 1 < m_segments.size() && !parents.empty(); ++i)
+        {
+            next.clear();
+            for (JsonValue *node : parents)
+                apply(m_segments[i], *node, next);
+            parents.swap(next);
+        }
+
+        // Deepest parents first: adding a member may move the ones nested below it
+        size_t assigned = 0;
+        for (auto it = parents.rbegin(); it != parents.rend(); ++it)
+        {
+            JsonValue *parent = *it;
+            if (parent->GetType() != JsonValue::Type::OBJECT)
+                continue;
+
+            if (JsonValue *member = parent->Member(last.name))
+                *member = value;
+            else
+                parent->AsObject().emplace_back(last.name, value);
+            ++assigned;
+        }
+        return assigned;
+    }
+
+    targets = Evaluate(root);
+    for (auto it = targets.rbegin(); it != targets.rend(); ++it)
+        **it = value;
+    return targets.size();
+}
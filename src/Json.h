@@ -0,0 +1,128 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <variant>
+#include <cstdint>
+
+/*
+   JSON document
+   - Parsed once into a tree of typed nodes, integers are kept exact (int64) apart from doubles.
+     Object members keep their insertion order
+   - The parser scans string bodies and whitespace 16 bytes at a time (SSE2) and only falls back
+     to the byte loop around escapes and structural characters
+   - Path reads / updates walk the tree and touch only the addressed nodes, the text form is only
+     produced for what a command returns
+   - Serialize() stores the tree in a compact binary form (type tag + payload) so loading a
+     snapshot doesn't parse text again
+*/
+
+class BinaryReader;
+
+class JsonValue
+{
+public:
+    using Array = std::vector<JsonValue>;
+    using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+    static constexpr int MAX_DEPTH = 128;
+
+    // Order matches the variant alternatives
+    enum class Type : uint8_t
+    {
+        NUL,
+        BOOLEAN,
+        INTEGER,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    JsonValue() = default;
+    explicit JsonValue(bool value) : m_value(value) {}
+    explicit JsonValue(int64_t value) : m_value(value) {}
+    explicit JsonValue(double value) : m_value(value) {}
+    explicit JsonValue(std::string value) : m_value(std::move(value)) {}
+
+    /* Throws std::invalid_argument for malformed documents */
+    static JsonValue Parse(std::string_view text);
+
+    Type GetType() const { return static_cast<Type>(m_value.index()); }
+    const char *TypeName() const;
+    bool IsNumber() const { return GetType() == Type::INTEGER || GetType() == Type::NUMBER; }
+
+    int64_t AsInteger() const { return std::get<int64_t>(m_value); }
+    double AsDouble() const { return GetType() == Type::INTEGER ? static_cast<double>(AsInteger()) : std::get<double>(m_value); }
+    Array &AsArray() { return std::get<Array>(m_value); }
+    const Array &AsArray() const { return std::get<Array>(m_value); }
+    Object &AsObject() { return std::get<Object>(m_value); }
+    const Object &AsObject() const { return std::get<Object>(m_value); }
+
+    /* nullptr if this isn't an object or has no such member */
+    JsonValue *Member(std::string_view key);
+
+    /* Compact text form */
+    std::string Dump() const;
+    void Dump(std::string &out) const;
+
+    std::string Serialize() const;
+    static std::unique_ptr<JsonValue> Deserialize(const std::string &blob);
+
+private:
+    std::variant<std::monostate, bool, int64_t, double, std::string, Array, Object> m_value;
+
+    class Parser;
+
+    void serialize(std::string &blob) const;
+    static JsonValue deserialize(BinaryReader &reader, int depth);
+};
+
+/*
+   JSONPath subset: $ root, .name / ['name'] members, [n] array elements (negative from the end),
+   [*] / .* all children, ..name recursive descent.
+   Paths without the leading '$' use the legacy syntax ("." or "a.b[0]") which addresses a single value
+*/
+
+class JsonPath
+{
+public:
+    /* Throws std::invalid_argument for malformed paths */
+    JsonPath(std::string_view path);
+
+    bool IsLegacy() const { return m_legacy; }
+    bool IsRoot() const { return m_segments.empty(); }
+
+    std::vector<JsonValue *> Evaluate(JsonValue &root) const;
+
+    /* Nodes addressed by the path, creating the last member if its parent object exists. Returns the number of nodes set */
+    size_t Assign(JsonValue &root, const JsonValue &value) const;
+
+private:
+    struct Segment
+    {
+        enum class Kind
+        {
+            MEMBER,
+            INDEX,
+            WILDCARD,
+            DESCENDANT // recursive descent to 'name' (or every node with a wildcard name)
+        };
+
+        Kind kind{Kind::MEMBER};
+        std::string name{};
+        int64_t index{};
+        bool wildcard{};
+    };
+
+    bool m_legacy{};
+    std::vector<Segment> m_segments;
+
+    static void apply(const Segment &segment, JsonValue &node, std::vector<JsonValue *> &out);
+    static void descend(const Segment &segment, JsonValue &node, std::vector<JsonValue *> &out);
+};
+
+#endif // JSON_H
@@ -0,0 +1,273 @@
+
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+
+#include "JsonHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+std::string JsonHandler::JsonCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == JSON_SET)
+            return jsonSetHandler(std::move(commandArgs));
+        else if (command == JSON_GET)
+            return jsonGetHandler(std::move(commandArgs));
+        else if (command == JSON_NUMINCRBY)
+            return jsonNumIncrByHandler(std::move(commandArgs));
+        else if (command == JSON_ARRAPPEND)
+            return jsonArrAppendHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+
+    return RESPEncoder::encodeError("Unsupported json command");
+}
+
+// JSON.SET key path value [NX | XX]
+std::string JsonHandler::jsonSetHandler(CommandArray commandArgs)
+{
+    const auto &args = *commandArgs;
+    if (args.size() != 4 && args.size() != 5)
+        return RESPEncoder::encodeError("wrong number of arguments for 'json.set' command");
+
+    bool nx = false, xx = false;
+    if (args.size() == 5)
+    {
+        std::string option = toLower(args[4]);
+        nx = option == "nx";
+        xx = option == "xx";
+        if (!nx && !xx)
+            throw std::invalid_argument("expected NX or XX");
+    }
+
+    JsonPath path(args[2]);
+    JsonValue value = JsonValue::Parse(args[3]);
+
+    auto it = m_documents.find(args[1]);
+    if (it == m_documents.end())
+    {
+        if (!path.IsRoot())
+            return RESPEncoder::encodeError("new objects must be created at the root");
+        if (xx)
+            return NULL_BULK_ENCODED;
+
+        m_documents.emplace(args[1], std::make_unique<JsonValue>(std::move(value)));
+        return RESPEncoder::encodeSimpleString("OK");
+    }
+
+    if (nx || xx)
+    {
+        bool exists = !path.Evaluate(*it->second).empty();
+        if ((nx && exists) || (xx && !exists))
+            return NULL_BULK_ENCODED;
+    }
+
+    if (path.Assign(*it->second, value) == 0)
+        return NULL_BULK_ENCODED;
+
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// JSON.GET key [path ...]
+std::string JsonHandler::jsonGetHandler(CommandArray commandArgs)
+{
+    const auto &args = *commandArgs;
+    if (args.size() < 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'json.get' command");
+
+    auto it = m_documents.find(args[1]);
+    if (it == m_documents.end())
+        return NULL_BULK_ENCODED;
+
+    // JSONPath results are an array of every match, a legacy path returns the single value it addresses
+    auto render = [&](const std::string &pathText, std::string &out) -> bool
+    {
+        JsonPath path(pathText);
+        std::vector<JsonValue *> matches = path.Evaluate(*it->second);
+        if (path.IsLegacy())
+        {
+            if (matches.empty())
+                return false;
+            matches.front()->Dump(out);
+            return true;
+        }
+
+        out.push_back('[');
+        for (size_t i = 0; i < matches.size(); ++i)
+        {
+            if (i > 0)
+                out.push_back(',');
+            matches[i]->Dump(out);
+        }
+        out.push_back(']');
+        return true;
+    };
+
+    std::string out;
+    if (args.size() <= 3)
+    {
+        const std::string &pathText = args.size() == 3 ? args[2] : ".";
+        if (!render(pathText, out))
+            return RESPEncoder::encodeError("Path '" + pathText + "' does not exist");
+        return RESPEncoder::encodeString(out);
+    }
+
+    // Several paths: an object keyed by path
+    out.push_back('{');
+    for (size_t i = 2; i < args.size(); ++i)
+    {
+        if (i > 2)
+            out.push_back(',');
+        out.append(JsonValue(args[i]).Dump());
+        out.push_back(':');
+        if (!render(args[i], out))
+            return RESPEncoder::encodeError("Path '" + args[i] + "' does not exist");
+    }
+    out.push_back('}');
+
+    return RESPEncoder::encodeString(out);
+}
+
+// JSON.NUMINCRBY key path value
+std::string JsonHandler::jsonNumIncrByHandler(CommandArray commandArgs)
+{
+    const auto &args = *commandArgs;
+    if (args.size() != 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'json.numincrby' command");
+
+    auto it = m_documents.find(args[1]);
+    if (it == m_documents.end())
+        return RESPEncoder::encodeError("could not perform this operation on a key that doesn't exist");
+
+    JsonValue increment = JsonValue::Parse(args[3]);
+    if (!increment.IsNumber())
+        throw std::invalid_argument("increment must be a number");
+
+    JsonPath path(args[2]);
+    std::vector<JsonValue *> matches = path.Evaluate(*it->second);
+    if (path.IsLegacy() && (matches.empty() || !matches.front()->IsNumber()))
+        return RESPEncoder::encodeError("wrong type of path value - expected a number");
+
+    // Integers stay integers unless the increment is a double or the sum overflows
+    std::vector<std::optional<JsonValue>> results;
+    for (const JsonValue *node : matches)
+    {
+        if (!node->IsNumber())
+        {
+            results.emplace_back();
+            continue;
+        }
+
+        int64_t sum;
+        if (node->GetType() == JsonValue::Type::INTEGER && increment.GetType() == JsonValue::Type::INTEGER
+            && !__builtin_add_overflow(node->AsInteger(), increment.AsInteger(), &sum))
+        {
+            results.emplace_back(JsonValue(sum));
+            continue;
+        }
+
+        double result = node->AsDouble() + increment.AsDouble();
+        if (!std::isfinite(result))
+            throw std::out_of_range("result is not a finite number");
+        results.emplace_back(JsonValue(result));
+    }
+
+    for (size_t i = 0; i < matches.size(); ++i)
+    {
+        if (results[i])
+            *matches[i] = *results[i];
+    }
+
+    if (path.IsLegacy())
+        return RESPEncoder::encodeString(results.front()->Dump());
+
+    std::string out{"["};
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (i > 0)
+            out.push_back(',');
+        out.append(results[i] ? results[i]->Dump() : "null");
+    }
+    out.push_back(']');
+
+    return RESPEncoder::encodeString(out);
+}
+
+// JSON.ARRAPPEND key path value [value ...]
+std::string JsonHandler::jsonArrAppendHandler(CommandArray commandArgs)
+{
+    const auto &args = *commandArgs;
+    if (args.size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'json.arrappend' command");
+
+    auto it = m_documents.find(args[1]);
+    if (it == m_documents.end())
+        return RESPEncoder::encodeError("could not perform this operation on a key that doesn't exist");
+
+    std::vector<JsonValue> values;
+    for (size_t i = 3; i < args.size(); ++i)
+        values.push_back(JsonValue::Parse(args[i]));
+
+    JsonPath path(args[2]);
+    std::vector<JsonValue *> matches = path.Evaluate(*it->second);
+    if (path.IsLegacy() && (matches.empty() || matches.front()->GetType() != JsonValue::Type::ARRAY))
+        return RESPEncoder::encodeError("wrong type of path value - expected an array");
+
+    // Deepest matches first, growing an outer array may move the ones nested in it
+    std::vector<std::string> lengths(matches.size(), NULL_BULK_ENCODED);
+    for (size_t i = matches.size(); i-- > 0;)
+    {
+        if (matches[i]->GetType() != JsonValue::Type::ARRAY)
+            continue;
+
+        auto &array = matches[i]->AsArray();
+        array.insert(array.end(), values.begin(), values.end());
+        lengths[i] = RESPEncoder::encodeInteger(array.size());
+    }
+
+    if (path.IsLegacy())
+        return lengths.front();
+
+    return RESPEncoder::encodeArray(lengths, true);
+}
+
+void JsonHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_documents))
+    {
+        writer.WriteKey(RDB_TYPE_JSON, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void JsonHandler::LoadRdb(RdbReader &reader, uint8_t, const std::string &key)
+{
+    m_documents[key] = JsonValue::Deserialize(reader.ReadString());
+}
+
+void JsonHandler::MergeFrom(JsonHandler &other)
+{
+    m_documents.merge(other.m_documents);
+}
+
+void JsonHandler::Swap(JsonHandler &other)
+{
+    m_documents.swap(other.m_documents);
+}
@@ -0,0 +1,39 @@
+#ifndef JSONHANDLER_H
+#define JSONHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "Json.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class JsonHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<JsonValue>> m_documents;
+
+    std::string jsonSetHandler(CommandArray commandArgs);
+    std::string jsonGetHandler(CommandArray commandArgs);
+    std::string jsonNumIncrByHandler(CommandArray commandArgs);
+    std::string jsonArrAppendHandler(CommandArray commandArgs);
+
+public:
+    std::string JsonCommandProcessor(CommandArray commandArgs);
+
+    bool IsJsonPresent(const std::string &key) const { return m_documents.contains(key); }
+
+    size_t KeyCount() const { return m_documents.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(JsonHandler &other);
+    void Swap(JsonHandler &other);
+};
+
+#endif // JSONHANDLER_H
@@ -10,11 +10,17 @@
 
 typedef struct timeval timeVal;
 
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
 /*
 
 	key - value store
 	- support expiration
 	- support different types
+	- keys are spread over partitions, one table each: a segmented snapshot has a segment per partition,
+	  so each segment loads on its own thread straight into the table the store then keeps
 
 */
 
@@ -25,26 +31,45 @@ class KeyValueStore
 
 public:
 
-	void initializeKeyValues(const std::string& dbpath, const std::string& dbfile);
+	KeyValueStore() : m_partitions(s_partitionCount) {}
+
+	/* For stores made from then on, set once at startup from --snapshot-segments */
+	static void SetPartitionCount(size_t count) { s_partitionCount = count; }
+	size_t PartitionCount() const { return m_partitions.size(); }
 
 	const std::string get(const std::string& key);
 	std::unique_ptr<std::vector<std::string>> getArray(const std::string& key);
 
 	const std::string set(const std::string& key, const std::string& value, int timeout = 0);
+	const std::string setExpireAt(const std::string& key, const std::string& value, int64_t expireAtMs); /* unix time in ms */
 	const std::string set(const std::string& key, const std::vector<std::string>& arrVal);
 
 	std::unique_ptr<std::vector<std::string>> getAllKeys(const std::string& regex = "");
 
-private:
+	size_t KeyCount() const;
+	size_t KeyCount(const RdbSegment &segment) const; /* keys the segment saves, the even hash split share when segments aren't partitions */
+	size_t ExpiresCount() const;
+	void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const; /* expired keys are skipped */
+	void LoadRdb(RdbReader &reader, const std::string& key, int64_t expireAtMs);
+	void Reserve(size_t keys, size_t expires); /* presize from the RDB resize-db hint before loading, spread over the partitions */
+	void ReservePartition(size_t partition, size_t keys); /* before loading the segment that holds it */
+	/* Splices the other store's entries in, no key or value is copied. Partitions this one has nothing in
+	   yet, and hasn't sized beyond the other's table, are taken over whole, table and all */
+	void MergeFrom(KeyValueStore& other);
+	void Swap(KeyValueStore& other);
 
-	std::unordered_map<std::string, std::string> m_mapKeyValues;
-	std::unordered_map<std::string, timeVal> m_mapKeyTimeouts;
+private:
 
+	struct Partition
+	{
+		std::unordered_map<std::string, std::string> keyValues;
+		std::unordered_map<std::string, timeVal> keyTimeouts;
+	};
 
-	unsigned char read(std::ifstream &rdb);
-	std::pair<std::optional<uint64_t>, std::optional<int8_t>> get_str_bytes_len(std::ifstream &rdb);
-	std::string read_byte_to_string(std::ifstream &rdb);
+	static inline size_t s_partitionCount{1};
+	std::vector<Partition> m_partitions;
 
+	Partition& partitionOf(const std::string& key);
 };
 
 
@@ -1,6 +1,7 @@
 
 #include "SupportedCommands.h"
 #include "ListHandler.h"
+#include "Rdb.h"
 #include "Utility.h"
 #include "RESPEncoder.h"
 #include <thread>
@@ -72,7 +73,7 @@ std::string ListHandler::lpushHandler(CommandArray commandArgs)
         std::lock_guard<std::mutex> lock(m_listsMutex);
         result = m_lists[listName]->AddElementsAtFront(std::move(elementsToAdd));
     }
-    setEventForBlockingLists(listName, elementsToAdd.size());
+    servePopWaiters(listName);
 
     return std::move(result);
 }
@@ -99,7 +100,7 @@ std::string ListHandler::rpushHandler(CommandArray commandArgs)
         std::lock_guard<std::mutex> lock(m_listsMutex);
         result = m_lists[listName]->AddElementsAtEnd(std::move(elementsToAdd));
     }
-    setEventForBlockingLists(listName, elementsToAdd.size());
+    servePopWaiters(listName);
 
     return std::move(result);
 }
@@ -152,7 +153,7 @@ std::string ListHandler::lrangeHandler(CommandArray commandArgs)
 
 std::string ListHandler::lpopHandler(CommandArray commandArgs)
 {
-    std::lock_guard<std::mutex> lock(m_listsMutex); // As this func is called from blocking thread too
+    std::lock_guard<std::mutex> lock(m_listsMutex); // LockLists() holds it across a fork
 
     std::string &listName = (*commandArgs)[1];
     int itemsToRemove = 1;
@@ -220,6 +221,8 @@ std::string ListHandler::blpopHandler(CommandArray commandArgs, const int client
         auto result = lpopHandler(std::make_unique<std::vector<std::string>>(tempArgs));
         if (result != NULL_BULK_ENCODED) // Found an element
         {
+            m_servedPops.push_back(std::move(tempArgs));
+
             // Format response as per BLPOP requirements
             std::vector<std::string> respArray = {RESPEncoder::encodeString(*it), result};
             return RESPEncoder::encodeArray(respArray, true);
@@ -230,42 +233,30 @@ std::string ListHandler::blpopHandler(CommandArray commandArgs, const int client
     if (blockingVal == "0")
         blockingVal = std::to_string(10 * 60); // default to 10 minutes if 0 is specified
 
-    m_blockingLists[clientFd] = {listNames, std::make_shared<EventWaiter>()};
+    auto waiter = std::make_shared<PopWaiter>();
+    waiter->listNames = std::move(listNames);
+    {
+        std::lock_guard<std::mutex> lock(m_blockingListsMutex);
+        m_popWaiters.push_back(waiter);
+    }
 
-    std::thread blockingThread([this, blockingVal, clientFd]()
+    // A push pops for it on the main thread, here the reply is only sent
+    std::thread blockingThread([this, blockingVal, clientFd, waiter]()
     {
         auto timeoutDuration = std::chrono::duration<double>(std::stod(blockingVal));
         auto timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(timeoutDuration);
 
-        bool eventOccurred = m_blockingLists[clientFd].second->waitForEvent(timeoutMs);
-        std::string response;
-
-        if (eventOccurred)
+        waiter->event.waitForEvent(timeoutMs);
         {
-            // Check each list for available elements
-            for (const auto& listName : m_blockingLists[clientFd].first)
+            std::lock_guard<std::mutex> lock(m_blockingListsMutex);
+            if (!waiter->done)
             {
-                std::vector<std::string> commandArgs = {LPOP, listName};
-                response = lpopHandler(std::make_unique<std::vector<std::string>>(commandArgs));
-                if (response != NULL_BULK_ENCODED) // Found an element
-                {
-                    // Format response as per BLPOP requirements
-                    std::vector<std::string> respArray = {RESPEncoder::encodeString(listName), response};
-                    response = RESPEncoder::encodeArray(respArray, true);
-                    break;
-                }
+                waiter->done = true;
+                std::erase(m_popWaiters, waiter);
             }
         }
-        if (response.empty())
-        {
-            response = "*-1\r\n"; // Timeout or no element found, return nil array
-        }
-
-        {
-            std::lock_guard<std::mutex> lock(m_blockingListsMutex);
-            m_blockingLists.erase(clientFd);
-        }
 
+        std::string response = waiter->reply.empty() ? "*-1\r\n" : waiter->reply; // Timeout, return nil array
         std::cout << "Sending response from blocking thread..." << response << std::endl;
         send(clientFd, response.c_str(), response.length(), 0);
     });
@@ -274,26 +265,28 @@ std::string ListHandler::blpopHandler(CommandArray commandArgs, const int client
     return NO_REPLY; // Indicate that response will be sent later
 }
 
-void ListHandler::setEventForBlockingLists(const std::string &listName, int noOfElementsAdded)
+void ListHandler::servePopWaiters(const std::string &listName)
 {
     std::lock_guard<std::mutex> lock(m_blockingListsMutex);
-    std::list<std::shared_ptr<EventWaiter>> waitersToNotify;
 
-    for (auto& [clientFd, pair] : m_blockingLists)
+    // Oldest first, one element each while the list has any. Served ones leave the queue, so this goes over a copy
+    auto waiters = m_popWaiters;
+    for (const auto &waiter : waiters)
     {
-        auto& [listNames, eventWaiter] = pair;
-        if (std::find(listNames.begin(), listNames.end(), listName) != listNames.end())
-        {
-            waitersToNotify.push_back(eventWaiter);
-        }
-    }
-
-    for (int i = 0; i < noOfElementsAdded && !waitersToNotify.empty(); ++i)
-    {
-        auto eventWaiter = waitersToNotify.front();
-        waitersToNotify.pop_front();
-
-        eventWaiter->setEvent();
+        if (waiter->done || std::find(waiter->listNames.begin(), waiter->listNames.end(), listName) == waiter->listNames.end())
+            continue;
+
+        std::vector<std::string> popArgs = {LPOP, listName};
+        auto result = lpopHandler(std::make_unique<std::vector<std::string>>(popArgs));
+        if (result == NULL_BULK_ENCODED)
+            break;
+        m_servedPops.push_back(std::move(popArgs));
+
+        std::vector<std::string> respArray = {RESPEncoder::encodeString(listName), result};
+        waiter->reply = RESPEncoder::encodeArray(respArray, true);
+        waiter->done = true;
+        std::erase(m_popWaiters, waiter);
+        waiter->event.setEvent();
     }
 }
 
@@ -313,3 +306,43 @@ std::string List::AddElementsAtFront(const std::vector<std::string> &elementsToA
 
     return RESPEncoder::encodeInteger(m_listStore.size()); // return new length of the list
 }
+
+size_t ListHandler::KeyCount() const
+{
+    std::lock_guard<std::mutex> lock(m_listsMutex);
+    return m_lists.size();
+}
+
+void ListHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    std::lock_guard<std::mutex> lock(m_listsMutex);
+    for (const auto &[key, list] : segment.Of(m_lists))
+    {
+        writer.WriteKey(RDB_TYPE_LIST, key);
+        writer.WriteLength(list->m_listStore.size());
+        for (const auto &element : list->m_listStore)
+            writer.WriteString(element);
+    }
+}
+
+void ListHandler::LoadRdb(RdbReader &reader, uint8_t type, const std::string &key)
+{
+    auto elements = reader.ReadList(type);
+
+    std::lock_guard<std::mutex> lock(m_listsMutex);
+    auto &list = m_lists[key];
+    list = std::make_unique<List>(key);
+    list->m_listStore.assign(std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+}
+
+void ListHandler::MergeFrom(ListHandler &other)
+{
+    std::scoped_lock lock(m_listsMutex, other.m_listsMutex);
+    m_lists.merge(other.m_lists);
+}
+
+void ListHandler::Swap(ListHandler &other)
+{
+    std::scoped_lock lock(m_listsMutex, other.m_listsMutex);
+    m_lists.swap(other.m_lists);
+}
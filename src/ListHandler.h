@@ -7,10 +7,15 @@
 #include <string>
 #include <list>
 #include <unordered_map>
-#include <map>
+#include <deque>
 #include <mutex>
+#include <utility>
 
-class EventWaiter;
+#include "Utility.h"
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
 
 using CommandArray = std::unique_ptr<std::vector<std::string>>;
 
@@ -36,12 +41,32 @@ class ListHandler
 public:
     std::string ListCommandProcessor(CommandArray commandArgs, const int clientFd);
 
+    size_t KeyCount() const;
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key); /* any of the list encodings, so lists from a Redis dump load too */
+    void MergeFrom(ListHandler &other);
+    void Swap(ListHandler &other);
+
+    /* Held across fork() so a snapshot child doesn't see a list half way through a BLPOP */
+    std::unique_lock<std::mutex> LockLists() const { return std::unique_lock<std::mutex>(m_listsMutex); }
+
+    /* The pops BLPOPs did since the last call, as the LPOPs that replay them. Main thread only */
+    std::vector<std::vector<std::string>> TakeServedPops() { return std::exchange(m_servedPops, {}); }
+
 private:
-    std::mutex m_listsMutex;
+    mutable std::mutex m_listsMutex;
     std::unordered_map<std::string, std::unique_ptr<List>> m_lists;
     
     std::mutex m_blockingListsMutex;
-    std::map<int, std::pair<std::vector<std::string>, std::shared_ptr<EventWaiter>>> m_blockingLists; /* listName, pair(vector<listNames>, EventWaiter) */
+    struct PopWaiter
+    {
+        std::vector<std::string> listNames;
+        bool done{}; // served or timed out, under m_blockingListsMutex
+        std::string reply;
+        EventWaiter event;
+    };
+    std::deque<std::shared_ptr<PopWaiter>> m_popWaiters; /* blocked BLPOPs oldest first */
+    std::vector<std::vector<std::string>> m_servedPops;
 
     std::string lpushHandler(CommandArray commandArgs);
     std::string rpushHandler(CommandArray commandArgs);
@@ -50,7 +75,7 @@ private:
     std::string rpopHandler(CommandArray commandArgs);
     
     std::string blpopHandler(CommandArray commandArgs, const int clientFd);
-    void setEventForBlockingLists(const std::string &listName, int noOfElementsAdded);
+    void servePopWaiters(const std::string &listName);
 };
 
 #endif // LIST_HANDLER_H
@@ -0,0 +1,263 @@
+
+#include <cstring>
+#include <vector>
+#include <bit>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Lz4.h"
+
+namespace
+{
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t LAST_LITERALS = 5; // the block always ends with this many literals
+    constexpr size_t MF_LIMIT = 12;     // no match starts this close to the end
+    constexpr uint32_t STORED = 0x80000000u;
+
+    uint32_t read32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+
+    uint64_t read64(const uint8_t *p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, 8);
+        return value;
+    }
+
+    // Bytes in common from a and b on, at most limit - b
+    size_t commonLength(const uint8_t *a, const uint8_t *b, const uint8_t *limit)
+    {
+        const uint8_t *start = b;
+        while (b + 8 <= limit)
+        {
+            uint64_t diff = read64(a) ^ read64(b);
+            if (diff != 0)
+                return b - start + std::countr_zero(diff) / 8;
+            a += 8;
+            b += 8;
+        }
+        while (b < limit && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return b - start;
+    }
+
+    void writeLength(uint8_t *&op, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *op++ = 255;
+        *op++ = static_cast<uint8_t>(length);
+    }
+
+    void putLE32(std::string &out, uint32_t value)
+    {
+        char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8), static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+        out.append(bytes, 4);
+    }
+
+    uint32_t getLE32(const char *p)
+    {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(p);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+}
+
+void Lz4::Compress(std::string_view input, std::string &out)
+{
+    const auto *src = reinterpret_cast<const uint8_t *>(input.data());
+    const size_t length = input.size();
+    const size_t start = out.size();
+    out.resize(start + MaxCompressedSize(length));
+    auto *base = reinterpret_cast<uint8_t *>(out.data() + start);
+    uint8_t *op = base;
+
+    size_t anchor = 0;
+    if (length > MF_LIMIT)
+    {
+        // Positions + 1, 0 is an empty slot. 4K entries at most, like the reference implementation, to stay in L1
+        const int hashLog = std::clamp(static_cast<int>(std::bit_width(length)), 8, 12);
+        thread_local std::vector<uint32_t> table;
+        table.assign(size_t{1} << hashLog, 0);
+        auto hash = [hashLog](uint32_t sequence) { return (sequence * 2654435761u) >> (32 - hashLog); };
+
+        const size_t matchStartLimit = length - MF_LIMIT;
+        const size_t matchEndLimit = length - LAST_LITERALS;
+        size_t pos = 0;
+        while (pos < matchStartLimit)
+        {
+            uint32_t sequence = read32(src + pos);
+            uint32_t &slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+
+            if (candidate == 0 || pos - (candidate - 1) > 65535 || read32(src + candidate - 1) != sequence)
+            {
+                // Skip faster through data that doesn't match
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            size_t ref = candidate - 1;
+            size_t matchLength = MIN_MATCH + commonLength(src + ref + MIN_MATCH, src + pos + MIN_MATCH, src + matchEndLimit);
+
+            size_t literals = pos - anchor;
+            uint8_t *token = op++;
+            *token = static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4);
+            if (literals >= 15)
+                writeLength(op, literals - 15);
+            std::memcpy(op, src + anchor, literals);
+            op += literals;
+
+            size_t offset = pos - ref;
+            *op++ = static_cast<uint8_t>(offset);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+
+            size_t extra = matchLength - MIN_MATCH;
+            *token |= static_cast<uint8_t>(std::min<size_t>(extra, 15));
+            if (extra >= 15)
+                writeLength(op, extra - 15);
+
+            pos += matchLength;
+            anchor = pos;
+        }
+    }
+
+    size_t literals = length - anchor;
+    *op++ = static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4);
+    if (literals >= 15)
+        writeLength(op, literals - 15);
+    std::memcpy(op, src + anchor, literals);
+    op += literals;
+
+    out.resize(start + (op - base));
+}
+
+bool Lz4::Decompress(std::string_view input, char *out, size_t outLength)
+{
+    const auto *ip = reinterpret_cast<const uint8_t *>(input.data());
+    const uint8_t *inEnd = ip + input.size();
+    char *op = out;
+    char *outEnd = out + outLength;
+
+    auto readLength = [&](size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (ip >= inEnd)
+                return false;
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (ip < inEnd)
+    {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > static_cast<size_t>(inEnd - ip) || literals > static_cast<size_t>(outEnd - op))
+            return false;
+        std::memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if (ip == inEnd)
+            return op == outEnd;
+
+        if (inEnd - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - out) || matchLength > static_cast<size_t>(outEnd - op))
+            return false;
+
+        // Overlapping matches repeat the bytes just written
+        const char *match = op - offset;
+        if (offset >= matchLength)
+        {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            for (size_t index = 0; index < matchLength; ++index)
+                *op++ = match[index];
+        }
+    }
+    return false;
+}
+
+void Lz4::AppendFrames(std::string_view raw, std::string &out)
+{
+    while (!raw.empty())
+    {
+        std::string_view chunk = raw.substr(0, FRAME_SIZE);
+        raw.remove_prefix(chunk.size());
+
+        size_t header = out.size();
+        out.append(FRAME_HEADER, '\0');
+        Compress(chunk, out);
+        size_t payload = out.size() - header - FRAME_HEADER;
+
+        uint32_t payloadField = static_cast<uint32_t>(payload);
+        if (payload >= chunk.size())
+        {
+            out.resize(header + FRAME_HEADER);
+            out.append(chunk);
+            payloadField = static_cast<uint32_t>(chunk.size()) | STORED;
+        }
+
+        std::string fields;
+        putLE32(fields, static_cast<uint32_t>(chunk.size()));
+        putLE32(fields, payloadField);
+        out.replace(header, FRAME_HEADER, fields);
+    }
+}
+
+void Lz4::FrameDecoder::Feed(const char *data, size_t length, std::string &out)
+{
+    m_pending.append(data, length);
+
+    size_t pos = 0;
+    while (m_pending.size() - pos >= FRAME_HEADER)
+    {
+        uint32_t rawLength = getLE32(m_pending.data() + pos);
+        uint32_t payloadField = getLE32(m_pending.data() + pos + 4);
+        size_t payload = payloadField & ~STORED;
+        if (rawLength > FRAME_SIZE || payload > MaxCompressedSize(FRAME_SIZE))
+            throw std::runtime_error("Corrupt frame on the compressed replication link");
+        if (m_pending.size() - pos - FRAME_HEADER < payload)
+            break;
+
+        std::string_view body(m_pending.data() + pos + FRAME_HEADER, payload);
+        if (payloadField & STORED)
+        {
+            if (payload != rawLength)
+                throw std::runtime_error("Corrupt frame on the compressed replication link");
+            out.append(body);
+        }
+        else
+        {
+            size_t start = out.size();
+            out.resize(start + rawLength);
+            if (!Decompress(body, out.data() + start, rawLength))
+                throw std::runtime_error("Corrupt frame on the compressed replication link");
+        }
+        pos += FRAME_HEADER + payload;
+    }
+    m_pending.erase(0, pos);
+}
@@ -0,0 +1,45 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/*
+   LZ4 block codec and the framing of a compressed replication link
+   - Blocks use the standard LZ4 block format: greedy matching over a hash table of 4 byte
+     sequences, the table is sized to the input so small blocks stay cheap
+   - A frame is "<raw length u32><payload length u32>" (little endian) and the payload, the high bit
+     of the payload length marks data that didn't compress and is stored as is. Frames are
+     independent of each other, a compressed link can start anywhere in the stream
+*/
+
+class Lz4
+{
+public:
+    static constexpr size_t FRAME_SIZE = 1 << 20; // raw bytes per frame at most
+    static constexpr size_t FRAME_HEADER = 8;
+
+    static size_t MaxCompressedSize(size_t length) { return length + length / 255 + 16; }
+
+    /* Appends the compressed block to out */
+    static void Compress(std::string_view input, std::string &out);
+    /* Decodes a block of exactly outLength bytes, false if it is corrupt */
+    static bool Decompress(std::string_view input, char *out, size_t outLength);
+
+    /* Appends the data to out as frames of at most FRAME_SIZE raw bytes */
+    static void AppendFrames(std::string_view raw, std::string &out);
+
+    /* Turns the bytes of a compressed link back into the stream, whatever the read boundaries */
+    class FrameDecoder
+    {
+    public:
+        /* Appends what the complete frames decode to out, throws std::runtime_error on a corrupt frame */
+        void Feed(const char *data, size_t length, std::string &out);
+
+    private:
+        std::string m_pending;
+    };
+};
+
+#endif // LZ4_H
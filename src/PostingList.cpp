@@ -0,0 +1,158 @@
+
+#include <algorithm>
+
+#include "PostingList.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void PostingList::Append(uint32_t docId)
+{
+    if (m_blocks.empty() || m_blocks.back().count == BLOCK_DOCS)
+    {
+        m_blocks.push_back({docId, docId, 1, {}});
+        ++m_count;
+        return;
+    }
+
+    Block &block = m_blocks.back();
+    uint32_t delta = docId - block.lastDoc;
+    while (delta >= 0x80)
+    {
+        block.bytes.push_back(static_cast<uint8_t>(delta) | 0x80);
+        delta >>= 7;
+    }
+    block.bytes.push_back(static_cast<uint8_t>(delta));
+
+    block.lastDoc = docId;
+    ++block.count;
+    ++m_count;
+}
+
+size_t PostingList::DecodeDeltas(const uint8_t *in, size_t count, uint32_t base, uint32_t *out)
+{
+    const uint8_t *start = in;
+    size_t decoded = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+#endif
+
+    while (decoded < count)
+    {
+#if defined(__SSE2__)
+        // Fast path: 16 single byte deltas (at least 16 bytes are left since every delta takes one or more)
+        while (count - decoded >= 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+            if (_mm_movemask_epi8(bytes) != 0)
+                break;
+
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            __m128i groups[4] = {_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+                                 _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)};
+
+            for (__m128i group : groups)
+            {
+                // prefix sum of the 4 lanes, then add the running id
+                group = _mm_add_epi32(group, _mm_slli_si128(group, 4));
+                group = _mm_add_epi32(group, _mm_slli_si128(group, 8));
+                group = _mm_add_epi32(group, _mm_set1_epi32(static_cast<int>(base)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + decoded), group);
+
+                base = out[decoded + 3];
+                decoded += 4;
+            }
+            in += 16;
+        }
+
+        if (decoded == count)
+            break;
+#endif
+
+        // One varint the slow way, then try the fast path again
+        uint32_t delta = 0;
+        int shift = 0;
+        uint8_t byte;
+        do
+        {
+            byte = *in++;
+            delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        base += delta;
+        out[decoded++] = base;
+    }
+
+    return in - start;
+}
+
+size_t PostingList::decodeBlock(const Block &block, uint32_t *out) const
+{
+    out[0] = block.firstDoc;
+    DecodeDeltas(block.bytes.data(), block.count - 1, block.firstDoc, out + 1);
+    return block.count;
+}
+
+std::vector<uint32_t> PostingList::Decode() const
+{
+    std::vector<uint32_t> ids(m_count);
+    size_t offset = 0;
+    for (const auto &block : m_blocks)
+        offset += decodeBlock(block, ids.data() + offset);
+    return ids;
+}
+
+std::vector<uint32_t> PostingList::Intersect(const std::vector<uint32_t> &candidates) const
+{
+    std::vector<uint32_t> result;
+    uint32_t buffer[BLOCK_DOCS];
+
+    auto candidate = candidates.begin();
+    auto block = m_blocks.begin();
+
+    while (candidate != candidates.end() && block != m_blocks.end())
+    {
+        // Skip whole blocks that end before the next candidate, then candidates before the block
+        if (block->lastDoc < *candidate)
+        {
+            block = std::partition_point(block, m_blocks.end(), [&](const Block &b) { return b.lastDoc < *candidate; });
+            continue;
+        }
+        if (*candidate < block->firstDoc)
+        {
+            candidate = std::lower_bound(candidate, candidates.end(), block->firstDoc);
+            continue;
+        }
+
+        size_t count = decodeBlock(*block, buffer);
+        const uint32_t *id = buffer, *end = buffer + count;
+        while (candidate != candidates.end() && id != end && *candidate <= block->lastDoc)
+        {
+            if (*candidate < *id)
+                ++candidate;
+            else if (*id < *candidate)
+                ++id;
+            else
+            {
+                result.push_back(*candidate);
+                ++candidate;
+                ++id;
+            }
+        }
+        ++block;
+    }
+
+    return result;
+}
+
+size_t PostingList::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this) + m_blocks.capacity() * sizeof(Block);
+    for (const auto &block : m_blocks)
+        bytes += block.bytes.capacity();
+    return bytes;
+}
@@ -0,0 +1,70 @@
+#ifndef POSTINGLIST_H
+#define POSTINGLIST_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+   Compressed posting list (sorted document ids)
+   - Blocks of up to BLOCK_DOCS ids: first id kept raw, the rest as deltas in LEB128 varints, so a
+     dense list costs ~1 byte per document
+   - Decoding takes 16 bytes at a time with SSE2: when none of them has the continuation bit set
+     they are 16 one byte deltas, widened and prefix summed in registers
+   - Blocks remember their first / last id so intersections skip blocks without decoding them
+   - Ids must be appended in increasing order (documents get a new id when they are re-indexed, ids
+     are renumbered densely when deleted ones are purged)
+*/
+
+class PostingList
+{
+public:
+    static constexpr size_t BLOCK_DOCS = 128;
+
+    void Append(uint32_t docId);
+
+    static constexpr uint32_t DROPPED = UINT32_MAX;
+
+    /* Replaces every id by renumber(id), dropping the ids it maps to DROPPED (garbage collection of
+       deleted documents). The new ids must keep the order of the old ones */
+    template <typename Mapping>
+    void Renumber(Mapping &&renumber)
+    {
+        std::vector<uint32_t> ids = Decode();
+        m_blocks.clear();
+        m_count = 0;
+        for (uint32_t id : ids)
+        {
+            if (uint32_t newId = renumber(id); newId != DROPPED)
+                Append(newId);
+        }
+    }
+
+    std::vector<uint32_t> Decode() const;
+
+    /* Sorted ids present both in 'candidates' and in this list */
+    std::vector<uint32_t> Intersect(const std::vector<uint32_t> &candidates) const;
+
+    size_t Size() const { return m_count; }
+    bool Empty() const { return m_count == 0; }
+    size_t MemoryUsage() const;
+
+    /* Decodes 'count' varint deltas from 'in' on top of 'base' into 'out', returns the bytes consumed */
+    static size_t DecodeDeltas(const uint8_t *in, size_t count, uint32_t base, uint32_t *out);
+
+private:
+    struct Block
+    {
+        uint32_t firstDoc;
+        uint32_t lastDoc;
+        uint32_t count;
+        std::vector<uint8_t> bytes; // deltas of the ids after the first one
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_count{};
+
+    size_t decodeBlock(const Block &block, uint32_t *out) const;
+};
+
+#endif // POSTINGLIST_H
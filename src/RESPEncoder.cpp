@@ -1,4 +1,6 @@
 
+#include <charconv>
+
 #include "RESPEncoder.h"
 
 const std::string RESPEncoder::encodeString(const std::string& str)
@@ -21,7 +23,7 @@ const std::string RESPEncoder::encodeSimpleString(const std::string& str)
 	return result;
 }
 
-const std::string RESPEncoder::encodeInteger(const int integer)
+const std::string RESPEncoder::encodeInteger(const long long integer)
 {
 	std::string result{":"};
 	result.append(std::to_string(integer));
@@ -51,11 +53,35 @@ const std::string RESPEncoder::encodeArray(const std::vector<std::string>& arr,
 	return result;
 }
 
-const std::string RESPEncoder::encodeError(const std::string& errMsg)
+const std::string RESPEncoder::encodeError(const std::string& errMsg, const std::string& code)
 {
-	std::string result{"-ERR "};
+	std::string result{"-" + code + " "};
 	result.append(errMsg);
 	result.append("\r\n");
 
 	return result;
 }
+
+namespace
+{
+	void appendLength(std::string& out, char type, size_t length)
+	{
+		char header[32]{type};
+		char* end = std::to_chars(header + 1, header + sizeof(header) - 2, length).ptr;
+		*end++ = '\r';
+		*end++ = '\n';
+		out.append(header, end);
+	}
+}
+
+void RESPEncoder::appendArrayHeader(std::string& out, size_t size)
+{
+	appendLength(out, '*', size);
+}
+
+void RESPEncoder::appendString(std::string& out, std::string_view str)
+{
+	appendLength(out, '$', str.size());
+	out.append(str);
+	out.append("\r\n", 2);
+}
@@ -5,6 +5,7 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 
 class RESPEncoder
 {
@@ -13,9 +14,13 @@ public:
 
 	static const std::string encodeString(const std::string& str);
 	static const std::string encodeSimpleString(const std::string& str);
-	static const std::string encodeInteger(const int integer);
+	static const std::string encodeInteger(const long long integer);
 	static const std::string encodeArray(const std::vector<std::string>& arr, bool dontEncodeItems = false);
-	static const std::string encodeError(const std::string& errMsg);
+	static const std::string encodeError(const std::string& errMsg, const std::string& code = "ERR");
+
+	// Append to a reply being built in place, for replies too big to assemble from encoded parts
+	static void appendArrayHeader(std::string& out, size_t size);
+	static void appendString(std::string& out, std::string_view str);
 };
 
 #endif
@@ -0,0 +1,247 @@
+#ifndef RADIXTREE_H
+#define RADIXTREE_H
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+
+/*
+   Ordered map over fixed length byte keys
+   - Radix tree with compressed edges: a node holds all the bytes a chain of single children would,
+     keys sharing long prefixes (big endian timestamps) stay a few levels deep however many there are
+   - Children are sorted by their edge byte, so keys come out in byte order, which is numeric order
+     for big endian integers
+   - Keys have the same length, so only the nodes at full key depth hold a value and every other
+     node below the root has at least two children
+*/
+
+template <typename Value, size_t KeyLength>
+class RadixTree
+{
+public:
+    using Key = std::array<uint8_t, KeyLength>;
+
+    RadixTree() : m_root(std::make_unique<Node>()) {}
+
+    // Lookups hand out the stored values for modification, like iterators of a const pointer would
+
+    /* Inserts or replaces */
+    void Insert(const Key &key, Value value)
+    {
+        Node *node = m_root.get();
+        size_t depth = 0;
+        while (depth < KeyLength)
+        {
+            uint8_t byte = key[depth];
+            auto edge = std::lower_bound(node->edges.begin(), node->edges.end(), byte);
+            size_t index = edge - node->edges.begin();
+            if (edge == node->edges.end() || *edge != byte)
+            {
+                auto leaf = std::make_unique<Node>();
+                leaf->prefix.assign(key.begin() + depth + 1, key.end());
+                leaf->value = std::move(value);
+                node->edges.insert(edge, byte);
+                node->children.insert(node->children.begin() + index, std::move(leaf));
+                ++m_size;
+                return;
+            }
+
+            Node *child = node->children[index].get();
+            size_t common = 0;
+            while (common < child->prefix.size() && child->prefix[common] == key[depth + 1 + common])
+                ++common;
+            if (common < child->prefix.size())
+            {
+                // Split the edge where the key leaves it, the new leaf goes under the middle node
+                auto middle = std::make_unique<Node>();
+                middle->prefix.assign(child->prefix.begin(), child->prefix.begin() + common);
+                middle->edges.push_back(child->prefix[common]);
+                auto old = std::move(node->children[index]);
+                old->prefix.erase(old->prefix.begin(), old->prefix.begin() + common + 1);
+                middle->children.push_back(std::move(old));
+                node->children[index] = std::move(middle);
+                child = node->children[index].get();
+            }
+            node = child;
+            depth += 1 + common;
+        }
+
+        if (!node->value)
+            ++m_size;
+        node->value = std::move(value);
+    }
+
+    bool Erase(const Key &key)
+    {
+        if (!erase(m_root.get(), key, 0))
+            return false;
+        --m_size;
+        return true;
+    }
+
+    Value *Find(const Key &key) const
+    {
+        Node *node = m_root.get();
+        size_t depth = 0;
+        while (depth < KeyLength)
+        {
+            auto edge = std::lower_bound(node->edges.begin(), node->edges.end(), key[depth]);
+            if (edge == node->edges.end() || *edge != key[depth])
+                return nullptr;
+            node = node->children[edge - node->edges.begin()].get();
+            if (!std::equal(node->prefix.begin(), node->prefix.end(), key.begin() + depth + 1))
+                return nullptr;
+            depth += 1 + node->prefix.size();
+        }
+        return node->value ? &*node->value : nullptr;
+    }
+
+    /* Value of the smallest key >= key */
+    Value *LowerBound(const Key &key) const { return lowerBound(m_root.get(), key, 0); }
+    /* Value of the largest key <= key */
+    Value *Floor(const Key &key) const { return floor(m_root.get(), key, 0); }
+    Value *First() const { return m_size ? minimum(m_root.get()) : nullptr; }
+    Value *Last() const { return m_size ? maximum(m_root.get()) : nullptr; }
+
+    size_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+    size_t MemoryUsage() const { return sizeof(*this) + memoryUsage(m_root.get()); } // without what the values own
+    void Clear()
+    {
+        m_root = std::make_unique<Node>();
+        m_size = 0;
+    }
+
+private:
+    struct Node
+    {
+        std::vector<uint8_t> prefix; // key bytes after the edge byte leading here
+        std::vector<uint8_t> edges;  // first byte of each child, sorted
+        std::vector<std::unique_ptr<Node>> children;
+        std::optional<Value> value;
+    };
+
+    std::unique_ptr<Node> m_root;
+    size_t m_size{};
+
+    // <0, 0, >0 as the node's prefix compares to the key bytes at the same depth
+    static int comparePrefix(const Node *node, const Key &key, size_t depth)
+    {
+        auto [nodeIt, keyIt] = std::mismatch(node->prefix.begin(), node->prefix.end(), key.begin() + depth);
+        if (nodeIt == node->prefix.end())
+            return 0;
+        return *nodeIt < *keyIt ? -1 : 1;
+    }
+
+    static size_t memoryUsage(const Node *node)
+    {
+        size_t bytes = sizeof(Node) + node->prefix.capacity() + node->edges.capacity() + node->children.capacity() * sizeof(node->children[0]);
+        for (const auto &child : node->children)
+            bytes += memoryUsage(child.get());
+        return bytes;
+    }
+
+    static Value *minimum(Node *node)
+    {
+        while (!node->value)
+            node = node->children.front().get();
+        return &*node->value;
+    }
+
+    static Value *maximum(Node *node)
+    {
+        while (!node->value)
+            node = node->children.back().get();
+        return &*node->value;
+    }
+
+    // depth counts the key bytes matched before node's edge byte
+    bool erase(Node *node, const Key &key, size_t depth)
+    {
+        if (depth == KeyLength)
+        {
+            if (!node->value)
+                return false;
+            node->value.reset();
+            return true;
+        }
+
+        auto edge = std::lower_bound(node->edges.begin(), node->edges.end(), key[depth]);
+        if (edge == node->edges.end() || *edge != key[depth])
+            return false;
+        size_t index = edge - node->edges.begin();
+        Node *child = node->children[index].get();
+        if (comparePrefix(child, key, depth + 1) != 0 || !erase(child, key, depth + 1 + child->prefix.size()))
+            return false;
+
+        if (!child->value && child->children.empty())
+        {
+            node->edges.erase(edge);
+            node->children.erase(node->children.begin() + index);
+        }
+        else if (!child->value && child->children.size() == 1)
+        {
+            // Fold the only grandchild into the child to keep the edges compressed
+            auto grandchild = std::move(child->children.front());
+            child->prefix.push_back(child->edges.front());
+            child->prefix.insert(child->prefix.end(), grandchild->prefix.begin(), grandchild->prefix.end());
+            child->edges = std::move(grandchild->edges);
+            child->children = std::move(grandchild->children);
+            child->value = std::move(grandchild->value);
+        }
+        return true;
+    }
+
+    static Value *lowerBound(Node *node, const Key &key, size_t depth)
+    {
+        if (depth == KeyLength)
+            return node->value ? &*node->value : nullptr;
+
+        auto edge = std::lower_bound(node->edges.begin(), node->edges.end(), key[depth]);
+        for (size_t index = edge - node->edges.begin(); index < node->edges.size(); ++index)
+        {
+            Node *child = node->children[index].get();
+            if (node->edges[index] != key[depth])
+                return minimum(child);
+
+            int order = comparePrefix(child, key, depth + 1);
+            if (order > 0)
+                return minimum(child);
+            if (order == 0)
+            {
+                if (Value *value = lowerBound(child, key, depth + 1 + child->prefix.size()))
+                    return value;
+            }
+        }
+        return nullptr;
+    }
+
+    static Value *floor(Node *node, const Key &key, size_t depth)
+    {
+        if (depth == KeyLength)
+            return node->value ? &*node->value : nullptr;
+
+        auto edge = std::upper_bound(node->edges.begin(), node->edges.end(), key[depth]);
+        for (size_t index = edge - node->edges.begin(); index-- > 0;)
+        {
+            Node *child = node->children[index].get();
+            if (node->edges[index] != key[depth])
+                return maximum(child);
+
+            int order = comparePrefix(child, key, depth + 1);
+            if (order < 0)
+                return maximum(child);
+            if (order == 0)
+            {
+                if (Value *value = floor(child, key, depth + 1 + child->prefix.size()))
+                    return value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif // RADIXTREE_H
@@ -0,0 +1,996 @@
+
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <charconv>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include "Rdb.h"
+
+namespace
+{
+    // Reflected form of the Jones polynomial 0xad93d23594c935a9
+    constexpr uint64_t CRC64_POLY = 0x95ac9329ac4bc9b5ULL;
+
+    struct Crc64Tables
+    {
+        uint64_t table[8][256];
+
+        Crc64Tables()
+        {
+            for (int n = 0; n < 256; ++n)
+            {
+                uint64_t crc = n;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? (crc >> 1) ^ CRC64_POLY : crc >> 1;
+                table[0][n] = crc;
+            }
+
+            for (int n = 0; n < 256; ++n)
+            {
+                for (int k = 1; k < 8; ++k)
+                    table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xFF];
+            }
+        }
+    };
+
+    const Crc64Tables &crc64Tables()
+    {
+        static const Crc64Tables tables;
+        return tables;
+    }
+
+    // Fixed width fields are little endian in the file whatever the host
+    uint64_t loadLittleEndian(const uint8_t *p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; --i)
+            value = (value << 8) | p[i];
+        return value;
+    }
+
+    void storeLittleEndian(uint8_t *out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    // Bounds checked walk over an encoded blob (ziplist, listpack, zipmap)
+    struct BlobCursor
+    {
+        const uint8_t *pos;
+        const uint8_t *end;
+        const char *what;
+
+        BlobCursor(const std::string &blob, const char *what)
+            : pos(reinterpret_cast<const uint8_t *>(blob.data())), end(pos + blob.size()), what(what) {}
+
+        const uint8_t *need(size_t len)
+        {
+            if (len > static_cast<size_t>(end - pos))
+                throw std::runtime_error(std::string("Corrupt ") + what + " in RDB file");
+            const uint8_t *ptr = pos;
+            pos += len;
+            return ptr;
+        }
+
+        uint8_t byte() { return *need(1); }
+
+        uint64_t littleEndian(int bytes)
+        {
+            return loadLittleEndian(need(bytes), bytes);
+        }
+
+        uint64_t bigEndian(int bytes)
+        {
+            const uint8_t *p = need(bytes);
+            uint64_t value = 0;
+            for (int i = 0; i < bytes; ++i)
+                value = (value << 8) | p[i];
+            return value;
+        }
+    };
+
+    std::string integerToString(int64_t value)
+    {
+        char buffer[24];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, end);
+    }
+
+    // Sign extends the low 'bits' bits of value
+    int64_t signExtend(uint64_t value, int bits)
+    {
+        uint64_t sign = uint64_t{1} << (bits - 1);
+        return static_cast<int64_t>((value ^ sign) - sign);
+    }
+
+    void lzfDecompress(const uint8_t *in, size_t inLen, char *out, size_t outLen)
+    {
+        const uint8_t *ip = in, *inEnd = in + inLen;
+        char *op = out, *outEnd = out + outLen;
+
+        while (ip < inEnd)
+        {
+            unsigned ctrl = *ip++;
+            if (ctrl < 32) // literal run of ctrl + 1 bytes
+            {
+                size_t len = ctrl + 1;
+                if (len > static_cast<size_t>(inEnd - ip) || len > static_cast<size_t>(outEnd - op))
+                    throw std::runtime_error("Corrupt LZF string in RDB file");
+                std::memcpy(op, ip, len);
+                ip += len;
+                op += len;
+                continue;
+            }
+
+            // Back reference: length in the top 3 bits (7 = extended), offset in the low 5 bits and the next byte
+            size_t len = ctrl >> 5;
+            if (len == 7)
+            {
+                if (ip == inEnd)
+                    throw std::runtime_error("Corrupt LZF string in RDB file");
+                len += *ip++;
+            }
+            if (ip == inEnd)
+                throw std::runtime_error("Corrupt LZF string in RDB file");
+            size_t offset = ((ctrl & 0x1F) << 8) + *ip++ + 1;
+            len += 2;
+
+            if (offset > static_cast<size_t>(op - out) || len > static_cast<size_t>(outEnd - op))
+                throw std::runtime_error("Corrupt LZF string in RDB file");
+
+            const char *ref = op - offset;
+            if (offset >= len)
+                std::memcpy(op, ref, len);
+            else
+                for (size_t i = 0; i < len; ++i) // overlapping copy repeats the pattern
+                    op[i] = ref[i];
+            op += len;
+        }
+
+        if (op != outEnd)
+            throw std::runtime_error("Corrupt LZF string in RDB file");
+    }
+
+    enum : uint8_t
+    {
+        RDB_ENC_INT8 = 0,
+        RDB_ENC_INT16 = 1,
+        RDB_ENC_INT32 = 2,
+        RDB_ENC_LZF = 3
+    };
+
+    enum : uint8_t
+    {
+        RDB_MODULE_OPCODE_EOF = 0,
+        RDB_MODULE_OPCODE_SINT = 1,
+        RDB_MODULE_OPCODE_UINT = 2,
+        RDB_MODULE_OPCODE_FLOAT = 3,
+        RDB_MODULE_OPCODE_DOUBLE = 4,
+        RDB_MODULE_OPCODE_STRING = 5
+    };
+
+    enum : uint64_t
+    {
+        QUICKLIST_NODE_CONTAINER_PLAIN = 1,
+        QUICKLIST_NODE_CONTAINER_PACKED = 2
+    };
+}
+
+uint64_t crc64(uint64_t crc, const void *data, size_t len)
+{
+    const auto &t = crc64Tables().table;
+    const auto *p = static_cast<const uint8_t *>(data);
+
+    // Eight bytes per step, the tables take them in little endian order
+    while (len >= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        crc ^= word;
+        crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^ t[5][(crc >> 16) & 0xFF] ^ t[4][(crc >> 24) & 0xFF]
+            ^ t[3][(crc >> 32) & 0xFF] ^ t[2][(crc >> 40) & 0xFF] ^ t[1][(crc >> 48) & 0xFF] ^ t[0][crc >> 56];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+RdbWriter::RdbWriter(int fd, size_t bufferSize) : m_fd(fd), m_buffer(bufferSize, '\0')
+{
+}
+
+void RdbWriter::append(const void *data, size_t len)
+{
+    const auto *p = static_cast<const char *>(data);
+    while (len > 0)
+    {
+        if (m_used == m_buffer.size())
+            flush();
+
+        size_t chunk = std::min(len, m_buffer.size() - m_used);
+        std::memcpy(m_buffer.data() + m_used, p, chunk);
+        m_used += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+}
+
+void RdbWriter::flush()
+{
+    m_crc = crc64(m_crc, m_buffer.data(), m_used);
+    writeAll(m_buffer.data(), m_used);
+    m_used = 0;
+}
+
+void RdbWriter::writeAll(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(m_fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Failed writing RDB: " + std::string(strerror(errno)));
+        }
+        data += n;
+        len -= n;
+        m_flushed += n;
+    }
+}
+
+void RdbWriter::WriteHeader()
+{
+    append("REDIS0011", 9);
+    WriteAux("redis-ver", "7.2.0");
+    WriteAux("redis-bits", "64");
+    WriteAux("ctime", std::to_string(time(nullptr)));
+    WriteAux("aof-base", "0");
+}
+
+void RdbWriter::WriteAux(std::string_view key, std::string_view value)
+{
+    appendByte(RDB_OPCODE_AUX);
+    WriteString(key);
+    WriteString(value);
+}
+
+void RdbWriter::WriteSelectDb(uint64_t db)
+{
+    appendByte(RDB_OPCODE_SELECTDB);
+    WriteLength(db);
+}
+
+void RdbWriter::WriteResizeDb(uint64_t keys, uint64_t expires)
+{
+    appendByte(RDB_OPCODE_RESIZEDB);
+    WriteLength(keys);
+    WriteLength(expires);
+}
+
+void RdbWriter::WriteKey(RdbType type, std::string_view key, int64_t expireAtMs)
+{
+    if (expireAtMs > 0)
+    {
+        appendByte(RDB_OPCODE_EXPIRETIME_MS);
+        uint8_t bytes[8];
+        storeLittleEndian(bytes, expireAtMs, 8);
+        append(bytes, 8);
+    }
+
+    appendByte(type);
+    WriteString(key);
+    ++m_keys;
+}
+
+void RdbWriter::WriteLength(uint64_t length)
+{
+    // 00xxxxxx | 01xxxxxx xxxxxxxx | 0x80 + 32 bit big endian | 0x81 + 64 bit big endian
+    if (length < (1 << 6))
+        appendByte(length);
+    else if (length < (1 << 14))
+    {
+        uint8_t bytes[2] = {static_cast<uint8_t>(0x40 | (length >> 8)), static_cast<uint8_t>(length)};
+        append(bytes, 2);
+    }
+    else if (length <= UINT32_MAX)
+    {
+        uint8_t bytes[5] = {0x80, static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+                            static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+        append(bytes, 5);
+    }
+    else
+    {
+        uint8_t bytes[9] = {0x81};
+        for (int i = 0; i < 8; ++i)
+            bytes[1 + i] = static_cast<uint8_t>(length >> (56 - 8 * i));
+        append(bytes, 9);
+    }
+}
+
+void RdbWriter::WriteString(std::string_view str)
+{
+    WriteLength(str.size());
+    append(str.data(), str.size());
+}
+
+void RdbWriter::Finish()
+{
+    // The checksum covers everything up to and including the EOF opcode
+    appendByte(RDB_OPCODE_EOF);
+    flush();
+
+    uint8_t checksum[8];
+    storeLittleEndian(checksum, m_crc, 8);
+    writeAll(reinterpret_cast<const char *>(checksum), sizeof(checksum));
+}
+
+RdbReader::RdbReader(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed opening " + path + ": " + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed reading " + path + ": " + strerror(errno));
+    }
+
+    m_size = st.st_size;
+    if (m_size > 0)
+    {
+        void *mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed mapping " + path + ": " + strerror(errno));
+        }
+        m_data = static_cast<const uint8_t *>(mapped);
+        madvise(mapped, m_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+    close(fd); // the mapping stays valid
+
+    if (m_size < 9 || std::memcmp(m_data, "REDIS", 5) != 0)
+    {
+        if (m_data)
+            munmap(const_cast<uint8_t *>(m_data), m_size);
+        throw std::runtime_error(path + " is not an RDB file");
+    }
+
+    const char *digits = reinterpret_cast<const char *>(m_data) + 5;
+    std::from_chars(digits, digits + 4, m_version);
+    if (m_version < 1 || m_version > MAX_VERSION)
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+        throw std::runtime_error("Can't load RDB version " + std::to_string(m_version));
+    }
+    m_pos = 9;
+
+    // Checksumming runs next to the parser, otherwise it would add a full extra pass over the file
+    if (m_version >= 5 && m_size >= 17)
+        m_checksum = std::async(std::launch::async, [data = m_data, len = m_size - 8] { return crc64(0, data, len); });
+}
+
+RdbReader::RdbReader(int socketFd, uint64_t length, std::string eofMark)
+    : m_socketFd(socketFd), m_remaining(eofMark.empty() ? length : UINT64_MAX), m_eofMark(std::move(eofMark))
+{
+    const uint8_t *header = need(9);
+    if (std::memcmp(header, "REDIS", 5) != 0)
+        throw std::runtime_error("The master did not send an RDB payload");
+
+    std::from_chars(reinterpret_cast<const char *>(header) + 5, reinterpret_cast<const char *>(header) + 9, m_version);
+    if (m_version < 1 || m_version > MAX_VERSION)
+        throw std::runtime_error("Can't load RDB version " + std::to_string(m_version));
+}
+
+RdbReader::~RdbReader()
+{
+    if (m_checksum.valid())
+        m_checksum.wait(); // still reading the mapping
+    if (m_data && m_socketFd == -1)
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+}
+
+size_t RdbReader::Size() const
+{
+    if (m_socketFd == -1)
+        return m_size;
+    return m_eofMark.empty() ? m_offset + m_size + m_remaining : SIZE_MAX;
+}
+
+void RdbReader::receive(size_t len)
+{
+    if (m_socketFd == -1)
+        throw std::runtime_error("Unexpected end of RDB file at offset " + std::to_string(m_pos));
+
+    // Checksum what was parsed, then slide the unparsed tail to the front of the window
+    m_streamCrc = crc64(m_streamCrc, m_data, m_pos);
+    size_t unparsed = m_size - m_pos;
+    if (m_window.size() < std::max<size_t>(len, 4 << 20))
+    {
+        std::string grown(std::max<size_t>(len, 4 << 20), '\0');
+        if (unparsed)
+            std::memcpy(grown.data(), m_data + m_pos, unparsed);
+        m_window.swap(grown);
+    }
+    else if (unparsed)
+    {
+        std::memmove(m_window.data(), m_data + m_pos, unparsed);
+    }
+    m_offset += m_pos;
+    m_data = reinterpret_cast<const uint8_t *>(m_window.data());
+    m_size = unparsed;
+    m_pos = 0;
+
+    while (m_size < len)
+    {
+        size_t room = std::min<uint64_t>(m_window.size() - m_size, m_remaining);
+        if (room == 0)
+            throw std::runtime_error("Unexpected end of RDB payload at offset " + std::to_string(m_offset + m_size));
+
+        ssize_t bytes = recv(m_socketFd, m_window.data() + m_size, room, 0);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            throw std::runtime_error("Connection lost while receiving the RDB payload: " + std::string(bytes < 0 ? strerror(errno) : "closed"));
+
+        m_size += bytes;
+        if (m_eofMark.empty())
+            m_remaining -= bytes;
+    }
+}
+
+uint64_t RdbReader::readLength(bool &isEncoded)
+{
+    uint8_t first = ReadByte();
+    isEncoded = false;
+
+    switch (first >> 6)
+    {
+    case 0:
+        return first & 0x3F;
+    case 1:
+        return ((first & 0x3F) << 8) | ReadByte();
+    case 3:
+        isEncoded = true;
+        return first & 0x3F;
+    }
+
+    // Both wide forms are big endian
+    const uint8_t *p;
+    int bytes;
+    if (first == 0x80)
+        bytes = 4;
+    else if (first == 0x81)
+        bytes = 8;
+    else
+        throw std::runtime_error("Unknown length encoding " + std::to_string(first) + " in RDB file");
+
+    p = need(bytes);
+    uint64_t length = 0;
+    for (int i = 0; i < bytes; ++i)
+        length = (length << 8) | p[i];
+    return length;
+}
+
+uint64_t RdbReader::ReadLength()
+{
+    bool isEncoded;
+    uint64_t length = readLength(isEncoded);
+    if (isEncoded)
+        throw std::runtime_error("Unexpected string encoding where a length was expected in RDB file");
+    return length;
+}
+
+std::string RdbReader::ReadString()
+{
+    bool isEncoded;
+    uint64_t length = readLength(isEncoded);
+
+    if (!isEncoded)
+        return std::string(reinterpret_cast<const char *>(need(length)), length);
+    return readEncodedString(length);
+}
+
+std::string_view RdbReader::ReadStringView(std::string &scratch)
+{
+    bool isEncoded;
+    uint64_t length = readLength(isEncoded);
+
+    if (!isEncoded)
+        return std::string_view(reinterpret_cast<const char *>(need(length)), length);
+
+    scratch = readEncodedString(length);
+    return scratch;
+}
+
+std::string RdbReader::readEncodedString(uint64_t encoding)
+{
+    // Integer encoded strings are little endian
+    switch (encoding)
+    {
+    case RDB_ENC_INT8:
+        return integerToString(static_cast<int8_t>(ReadByte()));
+    case RDB_ENC_INT16:
+    {
+        const uint8_t *p = need(2);
+        return integerToString(static_cast<int16_t>(p[0] | (p[1] << 8)));
+    }
+    case RDB_ENC_INT32:
+    {
+        const uint8_t *p = need(4);
+        return integerToString(static_cast<int32_t>(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24)));
+    }
+    case RDB_ENC_LZF:
+    {
+        uint64_t compressedLength = ReadLength();
+        uint64_t length = ReadLength();
+        const uint8_t *compressed = need(compressedLength);
+        if (length > compressedLength * 88) // longest back reference: 264 bytes out of 3 in
+            throw std::runtime_error("Corrupt LZF string in RDB file");
+
+        std::string str(length, '\0');
+        lzfDecompress(compressed, compressedLength, str.data(), length);
+        return str;
+    }
+    }
+
+    throw std::runtime_error("Unknown string encoding " + std::to_string(encoding) + " in RDB file");
+}
+
+void RdbReader::skipString()
+{
+    bool isEncoded;
+    uint64_t length = readLength(isEncoded);
+
+    if (!isEncoded)
+        need(length);
+    else if (length == RDB_ENC_INT8)
+        need(1);
+    else if (length == RDB_ENC_INT16)
+        need(2);
+    else if (length == RDB_ENC_INT32)
+        need(4);
+    else if (length == RDB_ENC_LZF)
+    {
+        uint64_t compressedLength = ReadLength();
+        ReadLength();
+        need(compressedLength);
+    }
+    else
+        throw std::runtime_error("Unknown string encoding " + std::to_string(length) + " in RDB file");
+}
+
+int64_t RdbReader::ReadMillisecondTime()
+{
+    return static_cast<int64_t>(loadLittleEndian(need(8), 8));
+}
+
+int64_t RdbReader::ReadSecondTime()
+{
+    return static_cast<int32_t>(loadLittleEndian(need(4), 4));
+}
+
+void RdbReader::readZiplist(const std::string &ziplist, std::vector<std::string> &entries)
+{
+    // zlbytes(4) zltail(4) zllen(2) entries... 0xFF
+    BlobCursor cursor(ziplist, "ziplist");
+    cursor.need(10);
+
+    while (true)
+    {
+        uint8_t prevlen = cursor.byte();
+        if (prevlen == 0xFF)
+            break;
+        if (prevlen == 0xFE)
+            cursor.need(4);
+
+        uint8_t encoding = cursor.byte();
+        switch (encoding >> 6)
+        {
+        case 0:
+        {
+            size_t len = encoding & 0x3F;
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+            continue;
+        }
+        case 1:
+        {
+            size_t len = ((encoding & 0x3F) << 8) | cursor.byte();
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+            continue;
+        }
+        case 2:
+        {
+            size_t len = cursor.bigEndian(4);
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+            continue;
+        }
+        }
+
+        // Integers, little endian
+        int64_t value;
+        if (encoding == 0xC0)
+            value = static_cast<int16_t>(cursor.littleEndian(2));
+        else if (encoding == 0xD0)
+            value = static_cast<int32_t>(cursor.littleEndian(4));
+        else if (encoding == 0xE0)
+            value = static_cast<int64_t>(cursor.littleEndian(8));
+        else if (encoding == 0xF0)
+            value = signExtend(cursor.littleEndian(3), 24);
+        else if (encoding == 0xFE)
+            value = static_cast<int8_t>(cursor.byte());
+        else if (encoding >= 0xF1 && encoding <= 0xFD)
+            value = (encoding & 0x0F) - 1;
+        else
+            throw std::runtime_error("Corrupt ziplist in RDB file");
+
+        entries.push_back(integerToString(value));
+    }
+}
+
+void RdbReader::readListpack(const std::string &listpack, std::vector<std::string> &entries)
+{
+    // total bytes(4) element count(2) entries... 0xFF, every entry is followed by its length (backlen)
+    BlobCursor cursor(listpack, "listpack");
+    cursor.need(6);
+
+    while (true)
+    {
+        const uint8_t *start = cursor.pos;
+        uint8_t encoding = cursor.byte();
+        if (encoding == 0xFF)
+            break;
+
+        if ((encoding & 0x80) == 0) // 7 bit unsigned
+            entries.push_back(integerToString(encoding & 0x7F));
+        else if ((encoding & 0xC0) == 0x80) // 6 bit string length
+        {
+            size_t len = encoding & 0x3F;
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+        }
+        else if ((encoding & 0xE0) == 0xC0) // 13 bit signed
+            entries.push_back(integerToString(signExtend(((encoding & 0x1F) << 8) | cursor.byte(), 13)));
+        else if ((encoding & 0xF0) == 0xE0) // 12 bit string length
+        {
+            size_t len = ((encoding & 0x0F) << 8) | cursor.byte();
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+        }
+        else if (encoding == 0xF0) // 32 bit string length
+        {
+            size_t len = cursor.littleEndian(4);
+            entries.emplace_back(reinterpret_cast<const char *>(cursor.need(len)), len);
+        }
+        else if (encoding == 0xF1)
+            entries.push_back(integerToString(static_cast<int16_t>(cursor.littleEndian(2))));
+        else if (encoding == 0xF2)
+            entries.push_back(integerToString(signExtend(cursor.littleEndian(3), 24)));
+        else if (encoding == 0xF3)
+            entries.push_back(integerToString(static_cast<int32_t>(cursor.littleEndian(4))));
+        else if (encoding == 0xF4)
+            entries.push_back(integerToString(static_cast<int64_t>(cursor.littleEndian(8))));
+        else
+            throw std::runtime_error("Corrupt listpack in RDB file");
+
+        size_t entryLength = cursor.pos - start;
+        cursor.need(entryLength < 128 ? 1 : entryLength < 16384 ? 2 : entryLength < 2097152 ? 3 : entryLength < 268435456 ? 4 : 5);
+    }
+}
+
+void RdbReader::readZipmap(const std::string &zipmap, std::vector<std::string> &entries)
+{
+    // zmlen(1) then <len>key<len><free>value<free bytes>... 0xFF, lengths of 254 and up take 4 more bytes
+    BlobCursor cursor(zipmap, "zipmap");
+    cursor.need(1);
+
+    auto readLen = [&cursor]() -> size_t
+    {
+        uint8_t len = cursor.byte();
+        return len < 254 ? len : cursor.littleEndian(4);
+    };
+
+    while (true)
+    {
+        if (cursor.pos < cursor.end && *cursor.pos == 0xFF)
+            break;
+
+        size_t keyLen = readLen();
+        entries.emplace_back(reinterpret_cast<const char *>(cursor.need(keyLen)), keyLen);
+
+        size_t valueLen = readLen();
+        uint8_t free = cursor.byte();
+        entries.emplace_back(reinterpret_cast<const char *>(cursor.need(valueLen)), valueLen);
+        cursor.need(free);
+    }
+}
+
+std::vector<std::string> RdbReader::ReadList(uint8_t type)
+{
+    std::vector<std::string> elements;
+
+    switch (type)
+    {
+    case RDB_TYPE_LIST:
+    {
+        uint64_t length = ReadLength();
+        elements.reserve(std::min<uint64_t>(length, m_size - m_pos)); // every element takes at least a byte
+        for (uint64_t i = 0; i < length; ++i)
+            elements.push_back(ReadString());
+        break;
+    }
+    case RDB_TYPE_LIST_ZIPLIST:
+        readZiplist(ReadString(), elements);
+        break;
+    case RDB_TYPE_LIST_QUICKLIST:
+    {
+        uint64_t nodes = ReadLength();
+        for (uint64_t i = 0; i < nodes; ++i)
+            readZiplist(ReadString(), elements);
+        break;
+    }
+    case RDB_TYPE_LIST_QUICKLIST_2:
+    {
+        uint64_t nodes = ReadLength();
+        for (uint64_t i = 0; i < nodes; ++i)
+        {
+            uint64_t container = ReadLength();
+            if (container == QUICKLIST_NODE_CONTAINER_PLAIN) // one big element stored as is
+                elements.push_back(ReadString());
+            else if (container == QUICKLIST_NODE_CONTAINER_PACKED)
+                readListpack(ReadString(), elements);
+            else
+                throw std::runtime_error("Unknown quicklist container " + std::to_string(container) + " in RDB file");
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("Not a list type: " + std::to_string(type));
+    }
+
+    return elements;
+}
+
+std::vector<std::pair<std::string, std::string>> RdbReader::ReadHash(uint8_t type)
+{
+    std::vector<std::string> flat;
+    std::vector<std::pair<std::string, std::string>> pairs;
+
+    switch (type)
+    {
+    case RDB_TYPE_HASH:
+    {
+        uint64_t length = ReadLength();
+        pairs.reserve(std::min<uint64_t>(length, m_size - m_pos));
+        for (uint64_t i = 0; i < length; ++i)
+        {
+            std::string field = ReadString();
+            pairs.emplace_back(std::move(field), ReadString());
+        }
+        return pairs;
+    }
+    case RDB_TYPE_HASH_ZIPMAP:
+        readZipmap(ReadString(), flat);
+        break;
+    case RDB_TYPE_HASH_ZIPLIST:
+        readZiplist(ReadString(), flat);
+        break;
+    case RDB_TYPE_HASH_LISTPACK:
+        readListpack(ReadString(), flat);
+        break;
+    default:
+        throw std::runtime_error("Not a hash type: " + std::to_string(type));
+    }
+
+    // The compact encodings store field, value, field, value, ...
+    if (flat.size() % 2 != 0)
+        throw std::runtime_error("Corrupt hash in RDB file: odd number of entries");
+
+    pairs.reserve(flat.size() / 2);
+    for (size_t i = 0; i < flat.size(); i += 2)
+        pairs.emplace_back(std::move(flat[i]), std::move(flat[i + 1]));
+    return pairs;
+}
+
+void RdbReader::skipModuleValue()
+{
+    while (true)
+    {
+        uint64_t opcode = ReadLength();
+        switch (opcode)
+        {
+        case RDB_MODULE_OPCODE_EOF:
+            return;
+        case RDB_MODULE_OPCODE_SINT:
+        case RDB_MODULE_OPCODE_UINT:
+            ReadLength();
+            break;
+        case RDB_MODULE_OPCODE_FLOAT:
+            need(4);
+            break;
+        case RDB_MODULE_OPCODE_DOUBLE:
+            need(8);
+            break;
+        case RDB_MODULE_OPCODE_STRING:
+            skipString();
+            break;
+        default:
+            throw std::runtime_error("Unknown module opcode " + std::to_string(opcode) + " in RDB file");
+        }
+    }
+}
+
+void RdbReader::SkipModuleAux()
+{
+    ReadLength(); // module id
+    ReadLength(); // 'when' opcode
+    ReadLength(); // when
+    skipModuleValue();
+}
+
+void RdbReader::SkipValue(uint8_t type)
+{
+    switch (type)
+    {
+    case RDB_TYPE_LIST:
+    case RDB_TYPE_SET:
+    case RDB_TYPE_LIST_QUICKLIST:
+    {
+        uint64_t length = ReadLength();
+        for (uint64_t i = 0; i < length; ++i)
+            skipString();
+        return;
+    }
+    case RDB_TYPE_HASH:
+    {
+        uint64_t length = ReadLength();
+        for (uint64_t i = 0; i < length * 2; ++i)
+            skipString();
+        return;
+    }
+    case RDB_TYPE_ZSET:
+    {
+        uint64_t length = ReadLength();
+        for (uint64_t i = 0; i < length; ++i)
+        {
+            skipString();
+            uint8_t scoreLength = ReadByte(); // 253-255 are nan / +inf / -inf
+            if (scoreLength < 253)
+                need(scoreLength);
+        }
+        return;
+    }
+    case RDB_TYPE_ZSET_2:
+    {
+        uint64_t length = ReadLength();
+        for (uint64_t i = 0; i < length; ++i)
+        {
+            skipString();
+            need(8); // binary double
+        }
+        return;
+    }
+    case RDB_TYPE_LIST_QUICKLIST_2:
+    {
+        uint64_t nodes = ReadLength();
+        for (uint64_t i = 0; i < nodes; ++i)
+        {
+            ReadLength();
+            skipString();
+        }
+        return;
+    }
+    case RDB_TYPE_MODULE_2:
+        ReadLength(); // module id
+        skipModuleValue();
+        return;
+    case RDB_TYPE_STREAM_LISTPACKS:
+    case RDB_TYPE_STREAM_LISTPACKS_2:
+    case RDB_TYPE_STREAM_LISTPACKS_3:
+    {
+        uint64_t listpacks = ReadLength();
+        for (uint64_t i = 0; i < listpacks; ++i)
+        {
+            skipString(); // master id
+            skipString(); // listpack
+        }
+
+        ReadLength(); // length
+        ReadLength(); // last id
+        ReadLength();
+        if (type >= RDB_TYPE_STREAM_LISTPACKS_2)
+        {
+            for (int i = 0; i < 5; ++i) // first id, max deleted id, entries added
+                ReadLength();
+        }
+
+        uint64_t groups = ReadLength();
+        for (uint64_t g = 0; g < groups; ++g)
+        {
+            skipString(); // name
+            ReadLength(); // last delivered id
+            ReadLength();
+            if (type >= RDB_TYPE_STREAM_LISTPACKS_2)
+                ReadLength(); // entries read
+
+            uint64_t pending = ReadLength();
+            for (uint64_t p = 0; p < pending; ++p)
+            {
+                need(16 + 8); // raw id, delivery time
+                ReadLength(); // delivery count
+            }
+
+            uint64_t consumers = ReadLength();
+            for (uint64_t c = 0; c < consumers; ++c)
+            {
+                skipString(); // name
+                need(type >= RDB_TYPE_STREAM_LISTPACKS_3 ? 16 : 8); // seen time (and active time)
+                uint64_t owned = ReadLength();
+                for (uint64_t p = 0; p < owned; ++p)
+                    need(16); // raw id
+            }
+        }
+        return;
+    }
+    case RDB_TYPE_MODULE_PRE_GA:
+        throw std::runtime_error("Can't skip a pre-GA module value in RDB file");
+    }
+
+    // Everything else (strings, the compact encodings and the private types) is one string
+    if (type == 8 || (type > RDB_TYPE_STREAM_LISTPACKS_3 && type < RDB_TYPE_BLOOM) || type > RDB_TYPE_STREAM)
+        throw std::runtime_error("Unknown value type " + std::to_string(type) + " in RDB file");
+    skipString();
+}
+
+void RdbReader::VerifyChecksum()
+{
+    if (m_socketFd != -1)
+    {
+        // The diskless payload is followed by its mark, a length framed one must end right here
+        uint64_t actual = crc64(m_streamCrc, m_data, m_pos);
+        uint64_t expected = 0;
+        if (m_version >= 5)
+            expected = loadLittleEndian(need(8), 8);
+        if (!m_eofMark.empty() && std::memcmp(need(m_eofMark.size()), m_eofMark.data(), m_eofMark.size()) != 0)
+            throw std::runtime_error("The RDB payload does not end with the announced EOF mark");
+        if (m_pos != m_size || (m_eofMark.empty() && m_remaining != 0))
+            throw std::runtime_error("Unexpected data after the end of the RDB payload");
+        if (expected != 0 && actual != expected)
+            throw std::runtime_error("Wrong RDB checksum, the payload is corrupt");
+        return;
+    }
+
+    if (m_version < 5)
+    {
+        if (m_pos != m_size)
+            throw std::runtime_error("Unexpected data after the end of the RDB file");
+        return;
+    }
+
+    if (m_pos + 8 != m_size)
+        throw std::runtime_error("Unexpected data after the end of the RDB file");
+
+    uint64_t expected = loadLittleEndian(m_data + m_pos, 8);
+    if (expected == 0) // saved with checksums disabled
+        return;
+
+    uint64_t actual = m_checksum.get();
+    if (actual != expected)
+        throw std::runtime_error("Wrong RDB checksum, the file is corrupt");
+}
@@ -0,0 +1,258 @@
+#ifndef RDB_H
+#define RDB_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <future>
+#include <stdexcept>
+#include <cstdint>
+
+/*
+   RDB snapshot format
+   - Strings, lists and hashes use the native Redis encodings. The types this server implements
+     itself are stored under private type codes with their Serialize() blob as the value, so
+     real Redis can't load those keys
+   - The writer streams into a large buffer and hands it to write(2) in big chunks; the CRC64
+     (Jones polynomial, same as Redis) is computed slicing-by-8 over every flushed chunk
+   - The reader maps the whole file and parses it with bounds checked pointer arithmetic, the
+     checksum is verified on another thread while the keys are being parsed. It understands every
+     encoding Redis 7 writes (ziplists, listpacks, quicklists, LZF strings, ...) so dumps made by
+     Redis load too, types this server has no equivalent for are skipped
+*/
+
+enum RdbType : uint8_t
+{
+    RDB_TYPE_STRING = 0,
+    RDB_TYPE_LIST = 1,
+    RDB_TYPE_SET = 2,
+    RDB_TYPE_ZSET = 3,
+    RDB_TYPE_HASH = 4,
+    RDB_TYPE_ZSET_2 = 5,
+    RDB_TYPE_MODULE_PRE_GA = 6,
+    RDB_TYPE_MODULE_2 = 7,
+    RDB_TYPE_HASH_ZIPMAP = 9,
+    RDB_TYPE_LIST_ZIPLIST = 10,
+    RDB_TYPE_SET_INTSET = 11,
+    RDB_TYPE_ZSET_ZIPLIST = 12,
+    RDB_TYPE_HASH_ZIPLIST = 13,
+    RDB_TYPE_LIST_QUICKLIST = 14,
+    RDB_TYPE_STREAM_LISTPACKS = 15,
+    RDB_TYPE_HASH_LISTPACK = 16,
+    RDB_TYPE_ZSET_LISTPACK = 17,
+    RDB_TYPE_LIST_QUICKLIST_2 = 18,
+    RDB_TYPE_STREAM_LISTPACKS_2 = 19,
+    RDB_TYPE_SET_LISTPACK = 20,
+    RDB_TYPE_STREAM_LISTPACKS_3 = 21,
+
+    // Private to this server
+    RDB_TYPE_BLOOM = 0x80,
+    RDB_TYPE_CUCKOO = 0x81,
+    RDB_TYPE_CMS = 0x82,
+    RDB_TYPE_TOPK = 0x83,
+    RDB_TYPE_TIMESERIES = 0x84,
+    RDB_TYPE_VECTORSET = 0x85,
+    RDB_TYPE_GEO = 0x86,
+    RDB_TYPE_JSON = 0x87,
+    RDB_TYPE_STREAM = 0x88
+};
+
+enum RdbOpcode : uint8_t
+{
+    RDB_OPCODE_SLOT_INFO = 0xF4,
+    RDB_OPCODE_FUNCTION2 = 0xF5,
+    RDB_OPCODE_FUNCTION_PRE_GA = 0xF6,
+    RDB_OPCODE_MODULE_AUX = 0xF7,
+    RDB_OPCODE_IDLE = 0xF8,
+    RDB_OPCODE_FREQ = 0xF9,
+    RDB_OPCODE_AUX = 0xFA,
+    RDB_OPCODE_RESIZEDB = 0xFB,
+    RDB_OPCODE_EXPIRETIME_MS = 0xFC,
+    RDB_OPCODE_EXPIRETIME = 0xFD,
+    RDB_OPCODE_SELECTDB = 0xFE,
+    RDB_OPCODE_EOF = 0xFF
+};
+
+uint64_t crc64(uint64_t crc, const void *data, size_t len);
+
+/*
+   One of the files of a segmented snapshot. Keys are split by the hash bucket they live in, so every
+   segment walks only its own buckets of each table: segment i of n takes buckets i, i + n, i + 2n, ...
+*/
+struct RdbSegment
+{
+    size_t index{0};
+    size_t count{1};
+
+    template <typename Map>
+    class Range
+    {
+    public:
+        class iterator
+        {
+        public:
+            iterator(const Map *map, size_t bucket, size_t step) : m_map(map), m_bucket(bucket), m_step(step)
+            {
+                if (m_bucket < m_map->bucket_count())
+                    m_it = m_map->begin(m_bucket);
+                skipEmpty();
+            }
+
+            const typename Map::value_type &operator*() const { return *m_it; }
+            iterator &operator++()
+            {
+                ++m_it;
+                skipEmpty();
+                return *this;
+            }
+            bool operator!=(const iterator &other) const { return m_bucket != other.m_bucket || (m_bucket != END && m_it != other.m_it); }
+
+        private:
+            static constexpr size_t END = SIZE_MAX;
+            const Map *m_map;
+            size_t m_bucket;
+            size_t m_step;
+            typename Map::const_local_iterator m_it{};
+
+            void skipEmpty()
+            {
+                while (m_bucket < m_map->bucket_count() && m_it == m_map->end(m_bucket))
+                {
+                    m_bucket += m_step;
+                    if (m_bucket < m_map->bucket_count())
+                        m_it = m_map->begin(m_bucket);
+                }
+                if (m_bucket >= m_map->bucket_count())
+                    m_bucket = END;
+            }
+        };
+
+        Range(const Map &map, const RdbSegment &segment) : m_map(map), m_segment(segment) {}
+        iterator begin() const { return iterator(&m_map, m_segment.index, m_segment.count); }
+        iterator end() const { return iterator(&m_map, SIZE_MAX, m_segment.count); }
+
+    private:
+        const Map &m_map;
+        const RdbSegment &m_segment;
+    };
+
+    /* The entries of an unordered map that belong to this segment */
+    template <typename Map>
+    Range<Map> Of(const Map &map) const { return Range<Map>(map, *this); }
+};
+
+class RdbWriter
+{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 8 << 20;
+
+    /* Writes to an already open file or socket, throws std::runtime_error when a write fails */
+    RdbWriter(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    /* Magic, version and the aux fields Redis writes */
+    void WriteHeader();
+    void WriteAux(std::string_view key, std::string_view value);
+    void WriteSelectDb(uint64_t db);
+    void WriteResizeDb(uint64_t keys, uint64_t expires);
+
+    /* Starts a key: optional expiry (unix time in ms, 0 = none), type and name. The value follows */
+    void WriteKey(RdbType type, std::string_view key, int64_t expireAtMs = 0);
+
+    void WriteLength(uint64_t length);
+    void WriteString(std::string_view str);
+
+    /* EOF opcode and checksum, then everything buffered is written out */
+    void Finish();
+
+    uint64_t BytesWritten() const { return m_flushed + m_used; }
+    uint64_t KeysWritten() const { return m_keys; }
+
+private:
+    int m_fd;
+    std::string m_buffer;
+    size_t m_used{};
+    uint64_t m_flushed{};
+    uint64_t m_crc{};
+    uint64_t m_keys{};
+
+    void append(const void *data, size_t len);
+    void appendByte(uint8_t byte) { append(&byte, 1); }
+    void flush();
+    void writeAll(const char *data, size_t len);
+};
+
+class RdbReader
+{
+public:
+    static constexpr int MAX_VERSION = 12;
+
+    /* Maps the file and checks the header, throws std::runtime_error if it can't be read or isn't an RDB file */
+    RdbReader(const std::string &path);
+
+    /* Parses a full sync payload as it comes off the master's socket: 'length' bytes, or when 'eofMark' is set
+       everything up to that mark (diskless transfer, the master sends nothing after it until acked) */
+    RdbReader(int socketFd, uint64_t length, std::string eofMark = {});
+    ~RdbReader();
+
+    RdbReader(const RdbReader &) = delete;
+    RdbReader &operator=(const RdbReader &) = delete;
+
+    int Version() const { return m_version; }
+    size_t Size() const; /* SIZE_MAX while a diskless transfer is still coming in */
+
+    /* All of these throw std::runtime_error when the file ends in the middle of the value */
+    uint8_t ReadByte() { return *need(1); }
+    uint64_t ReadLength();
+    std::string ReadString(); // plain, integer encoded or LZF compressed
+    std::string_view ReadStringView(std::string &scratch); // points into the file unless it had to be decoded into 'scratch'
+    int64_t ReadMillisecondTime();
+    int64_t ReadSecondTime();
+
+    /* Values of the list / hash types in any of their encodings */
+    std::vector<std::string> ReadList(uint8_t type);
+    std::vector<std::pair<std::string, std::string>> ReadHash(uint8_t type);
+
+    void SkipValue(uint8_t type);
+    void SkipModuleAux();
+
+    /* Call after the EOF opcode: throws if the file has trailing garbage or the checksum doesn't match */
+    void VerifyChecksum();
+
+private:
+    const uint8_t *m_data{};
+    size_t m_size{};
+    size_t m_pos{};
+    int m_version{};
+    std::future<uint64_t> m_checksum; // computed over the whole file but the trailer while parsing
+
+    // Socket source: m_data is a window over the stream that starts at m_offset. Bytes are checksummed
+    // as they leave the window, so views handed out are only valid until the next read
+    int m_socketFd{-1};
+    uint64_t m_remaining{}; // not received yet, length framed payloads
+    std::string m_eofMark;
+    std::string m_window;
+    uint64_t m_offset{};
+    uint64_t m_streamCrc{};
+
+    const uint8_t *need(size_t len)
+    {
+        if (len > m_size - m_pos)
+            receive(len);
+        const uint8_t *ptr = m_data + m_pos;
+        m_pos += len;
+        return ptr;
+    }
+    void receive(size_t len); /* makes len bytes available at m_pos or throws */
+
+    /* Length or, for strings, a special encoding (isEncoded set, the encoding type returned) */
+    uint64_t readLength(bool &isEncoded);
+    std::string readEncodedString(uint64_t encoding);
+    void skipString();
+    void skipModuleValue();
+
+    void readZiplist(const std::string &ziplist, std::vector<std::string> &entries);
+    void readListpack(const std::string &listpack, std::vector<std::string> &entries);
+    void readZipmap(const std::string &zipmap, std::vector<std::string> &entries);
+};
+
+#endif // RDB_H
@@ -0,0 +1,53 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include "ReplicationBacklog.h"
+
+void ReplicationBacklog::SetSize(size_t size)
+{
+    m_size = std::max<size_t>(size, 16 * 1024);
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_head = m_histLen = 0;
+}
+
+void ReplicationBacklog::Feed(std::string_view data)
+{
+    if (m_buffer.empty())
+        m_buffer.resize(m_size);
+
+    m_offset += data.size();
+    m_histLen = std::min(m_histLen + data.size(), m_size);
+
+    // Only the last m_size bytes can survive anyway
+    if (data.size() > m_size)
+        data.remove_prefix(data.size() - m_size);
+
+    size_t first = std::min(data.size(), m_size - m_head);
+    std::memcpy(m_buffer.data() + m_head, data.data(), first);
+    std::memcpy(m_buffer.data(), data.data() + first, data.size() - first);
+    m_head = (m_head + data.size()) % m_size;
+}
+
+void ReplicationBacklog::Reset(int64_t offset)
+{
+    m_offset = offset;
+    m_head = m_histLen = 0;
+}
+
+bool ReplicationBacklog::CopyFrom(int64_t offset, std::string &out) const
+{
+    if (offset < FirstOffset() || offset > m_offset + 1)
+        return false;
+
+    size_t length = m_offset + 1 - offset;
+    if (length == 0)
+        return true;
+
+    size_t start = (m_head + m_size - length) % m_size;
+    size_t first = std::min(length, m_size - start);
+    out.append(m_buffer.data() + start, first);
+    out.append(m_buffer.data(), length - first);
+    return true;
+}
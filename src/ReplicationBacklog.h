@@ -0,0 +1,45 @@
+#ifndef REPLICATIONBACKLOG_H
+#define REPLICATIONBACKLOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/*
+   Replication backlog
+   - Fixed size ring buffer holding the tail of the replication stream, the command bytes sent to
+     replicas (or received from the master on a replica)
+   - The replication offset counts every byte of that stream. A replica reconnecting with
+     PSYNC <replid> <offset> only needs the bytes from 'offset' on, if they are still in the buffer
+   - Offsets follow PSYNC: the first byte of the stream is offset 1, the backlog holds
+     [FirstOffset(), Offset()]
+*/
+
+class ReplicationBacklog
+{
+public:
+    static constexpr size_t DEFAULT_SIZE = 1 << 20; // bytes
+
+    void SetSize(size_t size); /* drops the history, only meant for startup */
+    void Feed(std::string_view data);
+    void Reset(int64_t offset); /* empty history continuing at offset, after a full sync */
+
+    /* Appends the stream from 'offset' on to out, false if that part is no longer (or not yet) available */
+    bool CopyFrom(int64_t offset, std::string &out) const;
+
+    int64_t Offset() const { return m_offset; }
+    int64_t FirstOffset() const { return m_offset - static_cast<int64_t>(m_histLen) + 1; }
+    size_t HistLen() const { return m_histLen; }
+    size_t Size() const { return m_size; }
+    bool Active() const { return !m_buffer.empty(); }
+
+private:
+    size_t m_size{DEFAULT_SIZE};
+    std::vector<char> m_buffer; // allocated with the first byte fed
+    size_t m_head{};             // where the next byte goes
+    size_t m_histLen{};
+    int64_t m_offset{};
+};
+
+#endif // REPLICATIONBACKLOG_H
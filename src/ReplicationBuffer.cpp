@@ -0,0 +1,81 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "ReplicationBuffer.h"
+
+ReplicationBuffer::Block::~Block()
+{
+    // Take over the rest of the chain block by block when nobody else holds it, no recursion
+    while (next && next.use_count() == 1)
+        next = std::move(next->next);
+}
+
+void ReplicationBuffer::Append(std::string_view data)
+{
+    if (!m_tail->data.empty() && m_tail->data.size() + data.size() > BLOCK_SIZE)
+    {
+        // The old tail is freed right away unless some cursor still needs it
+        auto block = std::make_shared<Block>();
+        block->data.reserve(std::max(BLOCK_SIZE, data.size()));
+        m_tail->next = block;
+        m_tail = std::move(block);
+    }
+    m_tail->data.append(data);
+    m_length += data.size();
+}
+
+bool ReplicationBuffer::Send(int fd, Cursor &cursor) const
+{
+    while (Pending(cursor) > 0)
+    {
+        iovec iov[64];
+        int count = 0;
+        for (Block *block = cursor.block.get(); block && count < 64; block = block->next.get())
+        {
+            size_t start = block == cursor.block.get() ? cursor.pos : 0;
+            if (start < block->data.size())
+                iov[count++] = {const_cast<char *>(block->data.data()) + start, block->data.size() - start};
+        }
+
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t bytes = sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        cursor.sent += bytes;
+        for (size_t left = bytes; left > 0 || (cursor.pos == cursor.block->data.size() && cursor.block->next);)
+        {
+            if (cursor.pos == cursor.block->data.size())
+            {
+                cursor.block = cursor.block->next;
+                cursor.pos = 0;
+                continue;
+            }
+            size_t step = std::min(left, cursor.block->data.size() - cursor.pos);
+            cursor.pos += step;
+            left -= step;
+        }
+    }
+    return true;
+}
+
+void ReplicationBuffer::Consume(Cursor &cursor, std::string &out) const
+{
+    for (; cursor.block; cursor.block = cursor.block->next, cursor.pos = 0)
+    {
+        out.append(cursor.block->data, cursor.pos);
+        if (!cursor.block->next)
+            break;
+    }
+    cursor.pos = m_tail->data.size();
+    cursor.sent = m_length;
+}
@@ -0,0 +1,53 @@
+#ifndef REPLICATIONBUFFER_H
+#define REPLICATIONBUFFER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+/*
+   Output buffer of the replication stream, shared by all replicas
+   - Propagated commands are appended once to a chain of blocks, every replica holds a cursor into
+     the chain. A block lives as long as some cursor still has to send it
+   - Sends don't block: whatever a replica has pending goes out in one writev, the rest waits for
+     its socket to become writable again
+*/
+
+class ReplicationBuffer
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Block
+    {
+        std::string data;
+        std::shared_ptr<Block> next;
+
+        ~Block(); // chains can get long, they are released iteratively
+    };
+
+    struct Cursor
+    {
+        std::shared_ptr<Block> block;
+        size_t pos{};
+        uint64_t sent{}; // stream bytes before the cursor
+    };
+
+    ReplicationBuffer() : m_tail(std::make_shared<Block>()) {}
+
+    void Append(std::string_view data);
+    Cursor Tail() const { return {m_tail, m_tail->data.size(), m_length}; } /* only gets what is appended from now on */
+    uint64_t Pending(const Cursor &cursor) const { return m_length - cursor.sent; }
+
+    /* Sends as much of what is pending as the socket takes, false if the connection failed */
+    bool Send(int fd, Cursor &cursor) const;
+    /* Moves the cursor to the tail, appending what it passes over to out */
+    void Consume(Cursor &cursor, std::string &out) const;
+
+private:
+    std::shared_ptr<Block> m_tail;
+    uint64_t m_length{}; // bytes appended so far
+};
+
+#endif // REPLICATIONBUFFER_H
@@ -0,0 +1,293 @@
+
+#include <stdexcept>
+
+#include "SearchHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+std::string SearchHandler::SearchCommandProcessor(CommandArray commandArgs, const HashHandler &hashHandler)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == FT_CREATE)
+            return ftCreateHandler(std::move(commandArgs), hashHandler);
+        else if (command == FT_SEARCH)
+            return ftSearchHandler(std::move(commandArgs), hashHandler);
+        else if (command == FT_DROPINDEX)
+            return ftDropIndexHandler(std::move(commandArgs));
+        else if (command == FT_INFO)
+            return ftInfoHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+
+    return RESPEncoder::encodeError("Unsupported search command");
+}
+
+void SearchHandler::OnHashChanged(const std::string &key, const HashHandler::Hash *hash)
+{
+    for (auto &[name, index] : m_indexes)
+    {
+        if (index->Matches(key))
+            index->IndexDocument(key, hash);
+    }
+}
+
+// FT.CREATE index [ON HASH] [PREFIX count prefix [prefix ...]] SCHEMA field TEXT | TAG [SEPARATOR sep] | NUMERIC [field ...]
+std::string SearchHandler::ftCreateHandler(CommandArray commandArgs, const HashHandler &hashHandler)
+{
+    const auto &args = *commandArgs;
+    if (args.size() < 5)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ft.create' command");
+
+    const std::string &name = args[1];
+    if (m_indexes.contains(name))
+        return RESPEncoder::encodeError("Index already exists");
+
+    std::vector<std::string> prefixes;
+    size_t i = 2;
+    for (; i < args.size(); ++i)
+    {
+        std::string option = toLower(args[i]);
+        if (option == "on" && i + 1 < args.size())
+        {
+            if (toLower(args[++i]) != "hash")
+                throw std::invalid_argument("only ON HASH is supported");
+        }
+        else if (option == "prefix" && i + 1 < args.size())
+        {
+            size_t count = std::stoul(args[++i]);
+            if (count == 0 || i + count >= args.size())
+                throw std::invalid_argument("bad PREFIX count");
+            prefixes.insert(prefixes.end(), args.begin() + i + 1, args.begin() + i + 1 + count);
+            i += count;
+        }
+        else if (option == "schema")
+        {
+            ++i;
+            break;
+        }
+        else
+            throw std::invalid_argument("unexpected option '" + args[i] + "'");
+    }
+
+    std::vector<SearchIndex::Field> schema;
+    while (i < args.size())
+    {
+        if (i + 1 >= args.size())
+            throw std::invalid_argument("missing type for field '" + args[i] + "'");
+
+        SearchIndex::Field field{args[i], SearchIndex::FieldType::TEXT};
+        std::string type = toLower(args[i + 1]);
+        i += 2;
+
+        if (type == "text")
+            field.type = SearchIndex::FieldType::TEXT;
+        else if (type == "numeric")
+            field.type = SearchIndex::FieldType::NUMERIC;
+        else if (type == "tag")
+        {
+            field.type = SearchIndex::FieldType::TAG;
+            if (i + 1 < args.size() && toLower(args[i]) == "separator")
+            {
+                if (args[i + 1].size() != 1)
+                    throw std::invalid_argument("SEPARATOR must be a single character");
+                field.separator = args[i + 1][0];
+                i += 2;
+            }
+        }
+        else
+            throw std::invalid_argument("unsupported field type '" + args[i - 1] + "'");
+
+        schema.push_back(std::move(field));
+    }
+
+    createIndex(name, std::move(prefixes), std::move(schema), hashHandler);
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+void SearchHandler::createIndex(const std::string &name, std::vector<std::string> prefixes,
+                                std::vector<SearchIndex::Field> schema, const HashHandler &hashHandler)
+{
+    auto index = std::make_unique<SearchIndex>(std::move(prefixes), std::move(schema));
+    for (const auto &[key, hash] : hashHandler.GetAllHashes())
+    {
+        if (index->Matches(key))
+            index->IndexDocument(key, &hash);
+    }
+
+    m_indexes[name] = std::move(index);
+}
+
+// FT.SEARCH index query [NOCONTENT] [LIMIT offset num]
+std::string SearchHandler::ftSearchHandler(CommandArray commandArgs, const HashHandler &hashHandler)
+{
+    const auto &args = *commandArgs;
+    if (args.size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ft.search' command");
+
+    auto it = m_indexes.find(args[1]);
+    if (it == m_indexes.end())
+        return RESPEncoder::encodeError("no such index");
+
+    bool noContent = false;
+    size_t offset = 0, limit = 10;
+    for (size_t i = 3; i < args.size(); ++i)
+    {
+        std::string option = toLower(args[i]);
+        if (option == "nocontent")
+            noContent = true;
+        else if (option == "limit" && i + 2 < args.size())
+        {
+            offset = std::stoul(args[i + 1]);
+            limit = std::stoul(args[i + 2]);
+            i += 2;
+        }
+        else
+            throw std::invalid_argument("unexpected option '" + args[i] + "'");
+    }
+
+    SearchIndex::Result result = it->second->Search(args[2], offset, limit);
+
+    std::vector<std::string> reply{RESPEncoder::encodeInteger(result.total)};
+    for (const auto &key : result.keys)
+    {
+        reply.push_back(RESPEncoder::encodeString(key));
+        if (noContent)
+            continue;
+
+        std::vector<std::string> fields;
+        if (const HashHandler::Hash *hash = hashHandler.GetHash(key))
+        {
+            for (const auto &[field, value] : *hash)
+            {
+                fields.push_back(field);
+                fields.push_back(value);
+            }
+        }
+        reply.push_back(RESPEncoder::encodeArray(fields));
+    }
+
+    return RESPEncoder::encodeArray(reply, true);
+}
+
+// FT.DROPINDEX index
+std::string SearchHandler::ftDropIndexHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ft.dropindex' command");
+
+    if (!m_indexes.erase((*commandArgs)[1]))
+        return RESPEncoder::encodeError("Unknown Index name");
+
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// FT.INFO index
+std::string SearchHandler::ftInfoHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ft.info' command");
+
+    auto it = m_indexes.find((*commandArgs)[1]);
+    if (it == m_indexes.end())
+        return RESPEncoder::encodeError("Unknown Index name");
+
+    const SearchIndex &index = *it->second;
+
+    std::vector<std::string> prefixes;
+    for (const auto &prefix : index.Prefixes())
+        prefixes.push_back(RESPEncoder::encodeString(prefix));
+
+    std::vector<std::string> attributes;
+    for (const auto &field : index.Schema())
+    {
+        std::vector<std::string> attribute{RESPEncoder::encodeString("identifier"), RESPEncoder::encodeString(field.name),
+                                           RESPEncoder::encodeString("type")};
+        switch (field.type)
+        {
+        case SearchIndex::FieldType::TEXT:
+            attribute.push_back(RESPEncoder::encodeString("TEXT"));
+            break;
+        case SearchIndex::FieldType::TAG:
+            attribute.push_back(RESPEncoder::encodeString("TAG"));
+            attribute.push_back(RESPEncoder::encodeString("SEPARATOR"));
+            attribute.push_back(RESPEncoder::encodeString(std::string(1, field.separator)));
+            break;
+        case SearchIndex::FieldType::NUMERIC:
+            attribute.push_back(RESPEncoder::encodeString("NUMERIC"));
+            break;
+        }
+        attributes.push_back(RESPEncoder::encodeArray(attribute, true));
+    }
+
+    return RESPEncoder::encodeArray({RESPEncoder::encodeString("index_name"), RESPEncoder::encodeString(it->first),
+                                     RESPEncoder::encodeString("prefixes"), RESPEncoder::encodeArray(prefixes, true),
+                                     RESPEncoder::encodeString("attributes"), RESPEncoder::encodeArray(attributes, true),
+                                     RESPEncoder::encodeString("num_docs"), RESPEncoder::encodeInteger(index.NumDocs()),
+                                     RESPEncoder::encodeString("num_terms"), RESPEncoder::encodeInteger(index.NumTerms()),
+                                     RESPEncoder::encodeString("memory_usage"), RESPEncoder::encodeInteger(index.MemoryUsage())},
+                                    true);
+}
+
+void SearchHandler::SaveRdb(RdbWriter &writer) const
+{
+    for (const auto &[name, index] : m_indexes)
+    {
+        std::string definition;
+        appendBinaryString(definition, name);
+
+        appendBinary<uint32_t>(definition, index->Prefixes().size());
+        for (const auto &prefix : index->Prefixes())
+            appendBinaryString(definition, prefix);
+
+        appendBinary<uint32_t>(definition, index->Schema().size());
+        for (const auto &field : index->Schema())
+        {
+            appendBinaryString(definition, field.name);
+            appendBinary<uint8_t>(definition, static_cast<uint8_t>(field.type));
+            appendBinary<char>(definition, field.separator);
+        }
+
+        writer.WriteAux("ft-index", definition);
+    }
+}
+
+void SearchHandler::LoadRdb(const std::string &definition, const HashHandler &hashHandler)
+{
+    BinaryReader reader(definition);
+    std::string name = reader.readString();
+
+    std::vector<std::string> prefixes(reader.read<uint32_t>());
+    for (auto &prefix : prefixes)
+        prefix = reader.readString();
+
+    std::vector<SearchIndex::Field> schema(reader.read<uint32_t>());
+    for (auto &field : schema)
+    {
+        field.name = reader.readString();
+        field.type = static_cast<SearchIndex::FieldType>(reader.read<uint8_t>());
+        field.separator = reader.read<char>();
+    }
+
+    createIndex(name, std::move(prefixes), std::move(schema), hashHandler);
+}
+
+void SearchHandler::Swap(SearchHandler &other)
+{
+    m_indexes.swap(other.m_indexes);
+}
@@ -0,0 +1,41 @@
+#ifndef SEARCHHANDLER_H
+#define SEARCHHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "SearchIndex.h"
+#include "HashHandler.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+
+class SearchHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<SearchIndex>> m_indexes;
+
+    std::string ftCreateHandler(CommandArray commandArgs, const HashHandler &hashHandler);
+    std::string ftSearchHandler(CommandArray commandArgs, const HashHandler &hashHandler);
+    std::string ftDropIndexHandler(CommandArray commandArgs);
+    std::string ftInfoHandler(CommandArray commandArgs);
+
+    void createIndex(const std::string &name, std::vector<std::string> prefixes,
+                     std::vector<SearchIndex::Field> schema, const HashHandler &hashHandler);
+
+public:
+    std::string SearchCommandProcessor(CommandArray commandArgs, const HashHandler &hashHandler);
+
+    /* Keeps the indexes in sync with the hash type, 'hash' is nullptr when the key was deleted */
+    void OnHashChanged(const std::string &key, const HashHandler::Hash *hash);
+
+    /* Index definitions are saved as aux fields, the documents are re-indexed from the hashes on load */
+    void SaveRdb(RdbWriter &writer) const;
+    void LoadRdb(const std::string &definition, const HashHandler &hashHandler); /* after the hashes are loaded */
+    void Swap(SearchHandler &other);
+};
+
+#endif // SEARCHHANDLER_H
@@ -0,0 +1,496 @@
+
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "SearchIndex.h"
+
+namespace
+{
+    const std::unordered_set<std::string> STOP_WORDS{
+        "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "if", "in", "into", "is", "it",
+        "no", "not", "of", "on", "or", "such", "that", "the", "their", "then", "there", "these",
+        "they", "this", "to", "was", "will", "with"};
+
+    std::string trim(const std::string &text)
+    {
+        size_t begin = text.find_first_not_of(" \t");
+        if (begin == std::string::npos)
+            return "";
+        size_t end = text.find_last_not_of(" \t");
+        return text.substr(begin, end - begin + 1);
+    }
+
+    std::string lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    bool parseNumber(const std::string &text, double &value)
+    {
+        std::string lowered = lower(text);
+        if (lowered == "-inf")
+            value = -INFINITY;
+        else if (lowered == "+inf" || lowered == "inf")
+            value = INFINITY;
+        else
+        {
+            char *end;
+            value = std::strtod(text.c_str(), &end);
+            return !text.empty() && *end == '\0' && !std::isnan(value);
+        }
+        return true;
+    }
+
+    // Sorted union of sorted id vectors
+    std::vector<uint32_t> mergeUnion(std::vector<std::vector<uint32_t>> parts)
+    {
+        if (parts.size() == 1)
+            return std::move(parts[0]);
+
+        std::vector<uint32_t> merged;
+        for (auto &part : parts)
+            merged.insert(merged.end(), part.begin(), part.end());
+        std::sort(merged.begin(), merged.end());
+        merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+        return merged;
+    }
+}
+
+SearchIndex::SearchIndex(std::vector<std::string> prefixes, std::vector<Field> schema)
+    : m_prefixes(std::move(prefixes)), m_schema(std::move(schema)), m_fields(m_schema.size())
+{
+    if (m_schema.empty())
+        throw std::invalid_argument("schema must have at least one field");
+
+    for (size_t i = 0; i < m_schema.size(); ++i)
+    {
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (m_schema[i].name == m_schema[j].name)
+                throw std::invalid_argument("duplicate field in schema - " + m_schema[i].name);
+        }
+    }
+
+    if (m_prefixes.empty())
+        m_prefixes.push_back(""); // every key
+}
+
+bool SearchIndex::Matches(const std::string &key) const
+{
+    return std::any_of(m_prefixes.begin(), m_prefixes.end(), [&](const std::string &prefix) { return key.starts_with(prefix); });
+}
+
+std::vector<std::string> SearchIndex::tokenize(const std::string &text)
+{
+    std::vector<std::string> tokens;
+    std::string token;
+    for (size_t i = 0; i <= text.size(); ++i)
+    {
+        unsigned char c = i < text.size() ? text[i] : ' ';
+        if (std::isalnum(c) || c >= 0x80) // keep UTF-8 sequences inside tokens
+        {
+            token.push_back(std::tolower(c));
+        }
+        else if (!token.empty())
+        {
+            if (!STOP_WORDS.contains(token))
+                tokens.push_back(std::move(token));
+            token.clear();
+        }
+    }
+
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    return tokens;
+}
+
+std::vector<std::string> SearchIndex::splitTags(const std::string &text, char separator)
+{
+    std::vector<std::string> tags;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(separator, start);
+        if (end == std::string::npos)
+            end = text.size();
+
+        std::string tag = lower(trim(text.substr(start, end - start)));
+        if (!tag.empty())
+            tags.push_back(std::move(tag));
+        start = end + 1;
+    }
+
+    std::sort(tags.begin(), tags.end());
+    tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+    return tags;
+}
+
+void SearchIndex::addNumeric(FieldIndex &index, uint32_t docId, double value)
+{
+    if (index.leaves.empty())
+        index.leaves.push_back({-INFINITY, {}});
+
+    auto leaf = std::prev(std::upper_bound(index.leaves.begin(), index.leaves.end(), value,
+                                           [](double v, const NumericLeaf &l) { return v < l.min; }));
+    leaf->entries.push_back({docId, value});
+
+    if (leaf->entries.size() <= NUMERIC_LEAF_MAX)
+        return;
+
+    // Split at the median value; a leaf holding a single repeated value can't be split
+    std::vector<double> values;
+    values.reserve(leaf->entries.size());
+    for (const auto &entry : leaf->entries)
+        values.push_back(entry.value);
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    double median = values[values.size() / 2];
+
+    if (median <= leaf->min || median == *std::min_element(values.begin(), values.end()))
+    {
+        auto larger = std::upper_bound((std::sort(values.begin(), values.end()), values.begin()), values.end(), median);
+        if (larger == values.end())
+            return;
+        median = *larger;
+    }
+
+    NumericLeaf upper{median, {}};
+    std::vector<NumericEntry> lowerEntries;
+    for (const auto &entry : leaf->entries)
+        (entry.value < median ? lowerEntries : upper.entries).push_back(entry);
+    leaf->entries = std::move(lowerEntries);
+
+    index.leaves.insert(std::next(leaf), std::move(upper));
+}
+
+std::vector<uint32_t> SearchIndex::numericRange(const FieldIndex &index, const NumericRange &range) const
+{
+    std::vector<std::vector<uint32_t>> parts;
+    if (index.leaves.empty())
+        return {};
+
+    auto leaf = std::prev(std::upper_bound(index.leaves.begin(), index.leaves.end(), range.min,
+                                           [](double v, const NumericLeaf &l) { return v < l.min; }));
+
+    for (; leaf != index.leaves.end() && leaf->min <= range.max; ++leaf)
+    {
+        auto next = std::next(leaf);
+        bool inside = range.Contains(leaf->min) && next != index.leaves.end() && next->min <= range.max;
+
+        std::vector<uint32_t> &ids = parts.emplace_back();
+        ids.reserve(leaf->entries.size());
+        for (const auto &entry : leaf->entries)
+        {
+            if (inside || range.Contains(entry.value))
+                ids.push_back(entry.docId);
+        }
+    }
+
+    return parts.empty() ? std::vector<uint32_t>{} : mergeUnion(std::move(parts));
+}
+
+size_t SearchIndex::estimateNumeric(const FieldIndex &index, const NumericRange &range) const
+{
+    size_t estimate = 0;
+    for (const auto &leaf : index.leaves)
+    {
+        if (leaf.min <= range.max)
+            estimate += leaf.entries.size();
+    }
+    return estimate;
+}
+
+void SearchIndex::IndexDocument(const std::string &key, const Document *document)
+{
+    auto existing = m_docIds.find(key);
+    if (existing != m_docIds.end())
+    {
+        m_docKeys[existing->second].clear();
+        m_docIds.erase(existing);
+        ++m_deletedDocs;
+    }
+
+    if (document)
+    {
+        uint32_t docId = m_docKeys.size();
+        m_docKeys.push_back(key);
+        m_docIds[key] = docId;
+
+        for (size_t i = 0; i < m_schema.size(); ++i)
+        {
+            auto value = document->find(m_schema[i].name);
+            if (value == document->end())
+                continue;
+
+            FieldIndex &index = m_fields[i];
+            switch (m_schema[i].type)
+            {
+            case FieldType::TEXT:
+                for (const auto &token : tokenize(value->second))
+                    index.terms[token].Append(docId);
+                break;
+            case FieldType::TAG:
+                for (const auto &tag : splitTags(value->second, m_schema[i].separator))
+                    index.terms[tag].Append(docId);
+                break;
+            case FieldType::NUMERIC:
+                double number;
+                if (parseNumber(value->second, number) && std::isfinite(number))
+                    addNumeric(index, docId, number);
+                break;
+            }
+        }
+    }
+
+    if (m_deletedDocs >= GC_MIN_DELETED && m_deletedDocs > m_docIds.size())
+        collectGarbage();
+}
+
+void SearchIndex::collectGarbage()
+{
+    // Live documents keep their relative order under their new ids, the lists stay sorted
+    std::vector<uint32_t> newIds(m_docKeys.size(), PostingList::DROPPED);
+    size_t live = 0;
+    for (size_t docId = 0; docId < m_docKeys.size(); ++docId)
+    {
+        if (m_docKeys[docId].empty())
+            continue;
+        newIds[docId] = live;
+        m_docIds[m_docKeys[docId]] = live;
+        if (live != docId)
+            m_docKeys[live] = std::move(m_docKeys[docId]);
+        ++live;
+    }
+    m_docKeys.resize(live);
+
+    auto renumber = [&newIds](uint32_t docId) { return newIds[docId]; };
+    for (auto &index : m_fields)
+    {
+        for (auto it = index.terms.begin(); it != index.terms.end();)
+        {
+            it->second.Renumber(renumber);
+            it = it->second.Empty() ? index.terms.erase(it) : std::next(it);
+        }
+
+        for (auto &leaf : index.leaves)
+        {
+            std::erase_if(leaf.entries, [&](const NumericEntry &entry) { return newIds[entry.docId] == PostingList::DROPPED; });
+            for (auto &entry : leaf.entries)
+                entry.docId = newIds[entry.docId];
+        }
+    }
+
+    m_deletedDocs = 0;
+}
+
+size_t SearchIndex::fieldPosition(const std::string &name) const
+{
+    for (size_t i = 0; i < m_schema.size(); ++i)
+    {
+        if (m_schema[i].name == name)
+            return i;
+    }
+    throw std::invalid_argument("unknown field '" + name + "'");
+}
+
+std::vector<SearchIndex::Clause> SearchIndex::parse(const std::string &query) const
+{
+    std::vector<Clause> clauses;
+    static const PostingList EMPTY_LIST;
+
+    auto addTerms = [&](Clause &clause, const FieldIndex &index, const std::string &term)
+    {
+        auto it = index.terms.find(term);
+        if (it != index.terms.end())
+        {
+            clause.lists.push_back(&it->second);
+            clause.estimate += it->second.Size();
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < query.size())
+    {
+        if (std::isspace(static_cast<unsigned char>(query[pos])))
+        {
+            ++pos;
+            continue;
+        }
+
+        Clause clause;
+        if (query[pos] == '@')
+        {
+            size_t colon = query.find(':', pos);
+            if (colon == std::string::npos)
+                throw std::invalid_argument("expected ':' after field name");
+
+            size_t field = fieldPosition(query.substr(pos + 1, colon - pos - 1));
+            const FieldIndex &index = m_fields[field];
+            pos = colon + 1;
+
+            if (pos < query.size() && query[pos] == '{')
+            {
+                if (m_schema[field].type != FieldType::TAG)
+                    throw std::invalid_argument("'" + m_schema[field].name + "' is not a TAG field");
+
+                size_t close = query.find('}', pos);
+                if (close == std::string::npos)
+                    throw std::invalid_argument("missing '}'");
+
+                for (const auto &tag : splitTags(query.substr(pos + 1, close - pos - 1), '|'))
+                    addTerms(clause, index, tag);
+                pos = close + 1;
+            }
+            else if (pos < query.size() && query[pos] == '[')
+            {
+                if (m_schema[field].type != FieldType::NUMERIC)
+                    throw std::invalid_argument("'" + m_schema[field].name + "' is not a NUMERIC field");
+
+                size_t close = query.find(']', pos);
+                if (close == std::string::npos)
+                    throw std::invalid_argument("missing ']'");
+
+                std::string bounds = query.substr(pos + 1, close - pos - 1);
+                size_t split = bounds.find_first_of(" ,", bounds.find_first_not_of(' '));
+                std::string low = trim(bounds.substr(0, split));
+                std::string high = split == std::string::npos ? "" : trim(bounds.substr(split + 1));
+
+                NumericRange &range = clause.range;
+                range.minExclusive = low.starts_with('(');
+                range.maxExclusive = high.starts_with('(');
+                if (!parseNumber(low.substr(range.minExclusive), range.min) || !parseNumber(high.substr(range.maxExclusive), range.max))
+                    throw std::invalid_argument("bad numeric range '" + bounds + "'");
+
+                clause.numeric = &index;
+                clause.estimate = estimateNumeric(index, range);
+                pos = close + 1;
+            }
+            else
+            {
+                if (m_schema[field].type != FieldType::TEXT)
+                    throw std::invalid_argument("'" + m_schema[field].name + "' is not a TEXT field");
+
+                size_t end = query.find(' ', pos);
+                for (const auto &token : tokenize(query.substr(pos, end == std::string::npos ? std::string::npos : end - pos)))
+                    addTerms(clause, index, token);
+                pos = end == std::string::npos ? query.size() : end;
+            }
+        }
+        else
+        {
+            size_t end = query.find(' ', pos);
+            std::string word = query.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            pos = end == std::string::npos ? query.size() : end;
+
+            if (word == "*")
+                continue;
+
+            auto tokens = tokenize(word);
+            if (tokens.empty())
+                continue; // stop word
+
+            // a word that tokenizes into several tokens needs all of them
+            for (size_t t = 0; t < tokens.size(); ++t)
+            {
+                Clause &tokenClause = t == 0 ? clause : clauses.emplace_back();
+                for (size_t i = 0; i < m_schema.size(); ++i)
+                {
+                    if (m_schema[i].type == FieldType::TEXT)
+                        addTerms(tokenClause, m_fields[i], tokens[t]);
+                }
+                if (tokenClause.lists.empty())
+                    tokenClause.lists.push_back(&EMPTY_LIST);
+            }
+        }
+
+        if (!clause.numeric && clause.lists.empty())
+            clause.lists.push_back(&EMPTY_LIST);
+        clauses.push_back(std::move(clause));
+    }
+
+    return clauses;
+}
+
+std::vector<uint32_t> SearchIndex::materialize(const Clause &clause) const
+{
+    if (clause.numeric)
+        return numericRange(*clause.numeric, clause.range);
+
+    std::vector<std::vector<uint32_t>> parts;
+    for (const PostingList *list : clause.lists)
+        parts.push_back(list->Decode());
+    return mergeUnion(std::move(parts));
+}
+
+std::vector<uint32_t> SearchIndex::intersect(const std::vector<uint32_t> &candidates, const Clause &clause) const
+{
+    if (clause.numeric)
+    {
+        std::vector<uint32_t> matching = numericRange(*clause.numeric, clause.range), result;
+        std::set_intersection(candidates.begin(), candidates.end(), matching.begin(), matching.end(), std::back_inserter(result));
+        return result;
+    }
+
+    // candidates AND (list1 OR list2 ...) == union of candidates AND list_i
+    std::vector<std::vector<uint32_t>> parts;
+    for (const PostingList *list : clause.lists)
+        parts.push_back(list->Intersect(candidates));
+    return mergeUnion(std::move(parts));
+}
+
+SearchIndex::Result SearchIndex::Search(const std::string &query, size_t offset, size_t limit) const
+{
+    std::vector<Clause> clauses = parse(query);
+    std::sort(clauses.begin(), clauses.end(), [](const Clause &a, const Clause &b) { return a.estimate < b.estimate; });
+
+    std::vector<uint32_t> ids;
+    if (clauses.empty())
+    {
+        for (const auto &[key, docId] : m_docIds)
+            ids.push_back(docId);
+        std::sort(ids.begin(), ids.end());
+    }
+    else
+    {
+        ids = materialize(clauses.front());
+        for (size_t i = 1; i < clauses.size() && !ids.empty(); ++i)
+            ids = intersect(ids, clauses[i]);
+    }
+
+    std::erase_if(ids, [this](uint32_t docId) { return m_docKeys[docId].empty(); });
+
+    Result result;
+    result.total = ids.size();
+    for (size_t i = offset; i < ids.size() && result.keys.size() < limit; ++i)
+        result.keys.push_back(m_docKeys[ids[i]]);
+
+    return result;
+}
+
+size_t SearchIndex::NumTerms() const
+{
+    size_t terms = 0;
+    for (const auto &index : m_fields)
+        terms += index.terms.size();
+    return terms;
+}
+
+size_t SearchIndex::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const auto &index : m_fields)
+    {
+        for (const auto &[term, list] : index.terms)
+            bytes += term.capacity() + list.MemoryUsage() + 2 * sizeof(void *);
+        for (const auto &leaf : index.leaves)
+            bytes += sizeof(NumericLeaf) + leaf.entries.capacity() * sizeof(NumericEntry);
+    }
+
+    for (const auto &key : m_docKeys)
+        bytes += sizeof(std::string) + (key.capacity() > 15 ? key.capacity() : 0);
+
+    return bytes + m_docIds.size() * (sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void *));
+}
@@ -0,0 +1,138 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "PostingList.h"
+
+/*
+   Secondary index over hash documents whose key starts with one of the index prefixes
+   - TEXT fields: lowercased alphanumeric tokens (stop words dropped) -> posting list
+   - TAG fields: separator split, trimmed, lowercased values -> posting list
+   - NUMERIC fields: range leaves ordered by value, split at the median when they grow; a query
+     takes leaves fully inside the range as they are and filters only the two boundary leaves
+   - A re-indexed document gets a new id so posting lists stay append only, old ids are
+     tombstoned and purged from the lists once they outnumber the live documents; the purge
+     renumbers the live documents densely, so ids stay below twice the live count
+   - Query clauses are AND-ed, evaluated smallest first; the candidates are intersected with the
+     compressed posting lists directly, skipping blocks that can't match
+*/
+
+class SearchIndex
+{
+public:
+    using Document = std::unordered_map<std::string, std::string>;
+
+    enum class FieldType
+    {
+        TEXT,
+        TAG,
+        NUMERIC
+    };
+
+    struct Field
+    {
+        std::string name;
+        FieldType type;
+        char separator{','}; // TAG only
+    };
+
+    struct Result
+    {
+        size_t total{};
+        std::vector<std::string> keys;
+    };
+
+    SearchIndex(std::vector<std::string> prefixes, std::vector<Field> schema);
+
+    bool Matches(const std::string &key) const;
+
+    /* (Re-)indexes the document, nullptr removes it */
+    void IndexDocument(const std::string &key, const Document *document);
+
+    /*
+       Query syntax (clauses separated by spaces are AND-ed):
+         word                  token in any TEXT field
+         @field:word           token in the given TEXT field
+         @field:{a | b}        any of the tags
+         @field:[min max]      numeric range, inclusive, '(' makes a bound exclusive, -inf / +inf allowed
+         *                     every document
+       Throws std::invalid_argument on syntax errors or unknown fields
+    */
+    Result Search(const std::string &query, size_t offset, size_t limit) const;
+
+    size_t NumDocs() const { return m_docIds.size(); }
+    size_t NumTerms() const;
+    size_t MemoryUsage() const;
+    const std::vector<std::string> &Prefixes() const { return m_prefixes; }
+    const std::vector<Field> &Schema() const { return m_schema; }
+
+private:
+    static constexpr size_t NUMERIC_LEAF_MAX = 512;
+    static constexpr size_t GC_MIN_DELETED = 1024;
+
+    struct NumericEntry
+    {
+        uint32_t docId;
+        double value;
+    };
+
+    struct NumericLeaf
+    {
+        double min; // leaf covers [min, next leaf's min)
+        std::vector<NumericEntry> entries; // docId order
+    };
+
+    struct NumericRange
+    {
+        double min, max;
+        bool minExclusive, maxExclusive;
+
+        bool Contains(double value) const
+        {
+            return (minExclusive ? value > min : value >= min) && (maxExclusive ? value < max : value <= max);
+        }
+    };
+
+    struct FieldIndex
+    {
+        std::unordered_map<std::string, PostingList> terms; // TEXT and TAG
+        std::vector<NumericLeaf> leaves;                    // NUMERIC
+    };
+
+    // One AND-ed query clause: either the union of some posting lists or a numeric range
+    struct Clause
+    {
+        std::vector<const PostingList *> lists;
+        const FieldIndex *numeric{};
+        NumericRange range{};
+        size_t estimate{};
+    };
+
+    std::vector<std::string> m_prefixes;
+    std::vector<Field> m_schema;
+    std::vector<FieldIndex> m_fields; // parallel to m_schema
+
+    std::vector<std::string> m_docKeys; // by doc id, empty once deleted
+    std::unordered_map<std::string, uint32_t> m_docIds;
+    size_t m_deletedDocs{};
+
+    static std::vector<std::string> tokenize(const std::string &text);
+    static std::vector<std::string> splitTags(const std::string &text, char separator);
+
+    void addNumeric(FieldIndex &index, uint32_t docId, double value);
+    std::vector<uint32_t> numericRange(const FieldIndex &index, const NumericRange &range) const;
+    size_t estimateNumeric(const FieldIndex &index, const NumericRange &range) const;
+
+    size_t fieldPosition(const std::string &name) const;
+    std::vector<Clause> parse(const std::string &query) const;
+    std::vector<uint32_t> materialize(const Clause &clause) const;
+    std::vector<uint32_t> intersect(const std::vector<uint32_t> &candidates, const Clause &clause) const;
+
+    void collectGarbage();
+};
+
+#endif // SEARCHINDEX_H
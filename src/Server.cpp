@@ -7,6 +7,19 @@
 #include <algorithm>
 #include <sys/time.h>
 #include <fcntl.h>		// for fcntl()
+#include <sys/wait.h>	// for waitpid()
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <future>
+#include <utility>
+#include <random>
+#include <charconv>
+#include <thread>
+#include <set>
+#include <poll.h>
+#include <sys/ioctl.h>
 
 #include "Server.h"
 #include "CommandHandler.h"
@@ -16,12 +29,33 @@
 #include "SocketReader.h"
 #include "SupportedCommands.h"
 #include "StreamHandler.h"
+#include "Lz4.h"
 #include <csignal>
 #include <cstring>
 
 
 int Server::signalPipe[2] = {-1, -1};
 
+namespace
+{
+	constexpr int64_t REPL_HEARTBEAT_PERIOD_MS = 1000;
+
+	int64_t unixTimeMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	std::string randomHexId()
+	{
+		static const char hex[] = "0123456789abcdef";
+		std::random_device random;
+		std::string id;
+		for (int index = 0; index < 40; ++index)
+			id.push_back(hex[random() % 16]);
+		return id;
+	}
+}
+
 void Server::startServer(int argc, char **argv)
 {
 	for (int index{0}; index < argc ; ++index)
@@ -38,17 +72,71 @@ void Server::startServer(int argc, char **argv)
 		}
 	}
 
-	// Initialize from rdb file if it's present
-	m_kvStore.initializeKeyValues(m_mapConfiguration["dir"], m_mapConfiguration["dbfilename"]);
+	// Snapshot location and save points default to the Redis ones, --save "" disables automatic saves
+	if (m_mapConfiguration["dir"].empty())
+		m_mapConfiguration["dir"] = ".";
+	if (m_mapConfiguration["dbfilename"].empty())
+		m_mapConfiguration["dbfilename"] = "dump.rdb";
+	if (m_mapConfiguration.find("save") == m_mapConfiguration.end())
+		m_mapConfiguration["save"] = "3600 1 300 100 60 10000";
+	if (!m_mapConfiguration["snapshot-segments"].empty())
+		m_snapshotSegments = std::clamp<size_t>(std::stoul(m_mapConfiguration["snapshot-segments"]), 1, 256);
+	// Nothing is loaded yet: the string keyspace gets a partition per segment, so is every table loaded into later
+	KeyValueStore::SetPartitionCount(m_snapshotSegments);
+	m_kvStore = KeyValueStore();
+
+	if (!m_mapConfiguration["repl-diskless-sync"].empty())
+		m_replDisklessSync = m_mapConfiguration["repl-diskless-sync"] != "no";
+	if (!m_mapConfiguration["repl-diskless-sync-delay"].empty())
+		m_replDisklessSyncDelay = std::stol(m_mapConfiguration["repl-diskless-sync-delay"]);
+	if (!m_mapConfiguration["repl-backlog-size"].empty())
+		m_replBacklog.SetSize(std::stoull(m_mapConfiguration["repl-backlog-size"]));
+	if (!m_mapConfiguration["repl-output-buffer-limit"].empty())
+		m_replOutputLimit = std::stoull(m_mapConfiguration["repl-output-buffer-limit"]);
+	if (!m_mapConfiguration["repl-compression"].empty())
+		m_replCompression = m_mapConfiguration["repl-compression"] == "lz4";
+
+	// Stream nodes older than stream-cold-after seconds move out of memory, 0 keeps them all in
+	if (!m_mapConfiguration["stream-cold-after"].empty() && std::stoull(m_mapConfiguration["stream-cold-after"]) > 0)
+	{
+		if (m_mapConfiguration["stream-tier-dir"].empty())
+			m_mapConfiguration["stream-tier-dir"] = "streamtier";
+		m_streamHandler.EnableTiering(m_mapConfiguration["dir"] + "/" + m_mapConfiguration["stream-tier-dir"], std::stoull(m_mapConfiguration["stream-cold-after"]) * 1000);
+	}
 
-	if (getReplicationRole() == "master")
+	std::istringstream saveParams(m_mapConfiguration["save"]);
+	time_t seconds;
+	uint64_t changes;
+	while (saveParams >> seconds >> changes)
+		m_saveParams.emplace_back(seconds, changes);
+
+	// With the AOF on it is the source of truth on startup, like in Redis
+	if (m_mapConfiguration["appendonly"] == "yes")
+	{
+		AppendOnlyFile::Fsync fsyncPolicy = AppendOnlyFile::Fsync::EVERYSEC;
+		if (!m_mapConfiguration["appendfsync"].empty() && !AppendOnlyFile::ParseFsync(m_mapConfiguration["appendfsync"], fsyncPolicy))
+			throw std::runtime_error("appendfsync must be always, everysec or no");
+		if (!m_mapConfiguration["auto-aof-rewrite-percentage"].empty())
+			m_aofRewritePercentage = std::stoull(m_mapConfiguration["auto-aof-rewrite-percentage"]);
+		if (!m_mapConfiguration["auto-aof-rewrite-min-size"].empty())
+			m_aofRewriteMinSize = std::stoull(m_mapConfiguration["auto-aof-rewrite-min-size"]);
+		if (m_mapConfiguration["appenddirname"].empty())
+			m_mapConfiguration["appenddirname"] = "appendonlydir";
+		if (m_mapConfiguration["appendfilename"].empty())
+			m_mapConfiguration["appendfilename"] = "appendonly.aof";
+
+		m_aof.Open(m_mapConfiguration["dir"] + "/" + m_mapConfiguration["appenddirname"], m_mapConfiguration["appendfilename"], fsyncPolicy);
+		aofOpen();
+	}
+	else
 	{
-		m_mapConfiguration["master_replid"] = "8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb";
-		m_mapConfiguration["master_repl_offset"] = "0";
+		// Initialize from rdb file if it's present
+		rdbLoadSnapshot();
 	}
+	m_lastSave = time(nullptr);
+
+	m_replId = randomHexId();
 
-	if (m_mapConfiguration["waitcmd_offset"].empty())
-			m_mapConfiguration["waitcmd_offset"] = "0";
 
 	m_dServerFd = socket(AF_INET, SOCK_STREAM, 0);
   	if (m_dServerFd < 0) {
@@ -83,7 +171,7 @@ void Server::startServer(int argc, char **argv)
 
 	if (getReplicationRole() == "slave")
 	{
-		initializeSlave();
+		replicationConnect();
 	}
 
 	std::cout << "Waiting for a client to connect...\n";
@@ -99,6 +187,7 @@ void Server::runEventLoop()
 #endif
 
 	std::cout << "Starting EventLoop..." << std::endl;
+	m_bEventLoopStarted = true;
 
 	// initialize my current set
 	FD_ZERO(&currentSockets);
@@ -107,17 +196,55 @@ void Server::runEventLoop()
     // Add signal pipe read end to the socket set
     FD_SET(signalPipe[0], &currentSockets);
 
-	if (getReplicationRole() == "slave")
-	{
-		/* Add master socket to current sockets to master can send commands */
-		FD_SET(m_dMasterConnSocket, &currentSockets);
-	}
-
 	while (true)
 	{
 		readySockets = currentSockets;
+		if (m_replSnapshotPipe != -1 && replicationSnapshotDrained())
+			FD_SET(m_replSnapshotPipe, &readySockets);
+
+		/* Master sends commands on its connection, once the full sync payload on it has been loaded */
+		if (m_dMasterConnSocket != -1 && !m_replicaLoad.valid())
+			FD_SET(m_dMasterConnSocket, &readySockets);
+
+		aofFlush();
+		replicationFlush();
+		serverCron();
+		replicationProcessWaiting();
+
+		// Replicas the stream couldn't be sent to completely wake us up once they can take more
+		fd_set writeSockets;
+		FD_ZERO(&writeSockets);
+		for (const auto& [fd, link] : m_replicaLinks)
+		{
+			bool streamPending = m_replStream.Pending(link.cursor) > 0 || link.framesSent < link.frames.size();
+			if (link.outputSent < link.output.size() || (streamPending && !m_replicaSyncs.contains(fd)))
+				FD_SET(fd, &writeSockets);
+		}
 
-		if (select(FD_SETSIZE, &readySockets, nullptr, nullptr, nullptr) < 0)
+		// Wake up regularly even when idle so save points and background saves are looked after, sooner for a WAIT timeout
+		// A client parked in WAIT stays in the read set so its disconnect is seen, its next command waits for the WAIT reply
+		auto wakeup = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+		std::vector<int> waitingGone;
+		for (const auto& waiting : m_waitingClients)
+		{
+			char next;
+			ssize_t peeked = recv(waiting.fd, &next, 1, MSG_PEEK | MSG_DONTWAIT);
+			if (peeked == 0 || (peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+				waitingGone.push_back(waiting.fd);
+			else if (peeked > 0)
+				FD_CLR(waiting.fd, &readySockets); // pipelined after the WAIT, read once it is answered
+			wakeup = std::min(wakeup, waiting.deadline);
+		}
+		for (int fd : waitingGone)
+		{
+			HandleConnection(fd); // reads the EOF, the client is dropped like any other
+			FD_CLR(fd, &currentSockets);
+			FD_CLR(fd, &readySockets);
+			close(fd);
+		}
+		auto sleepUs = std::chrono::duration_cast<std::chrono::microseconds>(wakeup - std::chrono::steady_clock::now()).count();
+		struct timeval cronInterval{0, static_cast<suseconds_t>(std::max<int64_t>(sleepUs, 0))};
+		if (select(FD_SETSIZE, &readySockets, &writeSockets, nullptr, &cronInterval) < 0)
 		{
 			if (errno == EINTR)
                 continue; // Interrupted by signal, continue
@@ -141,12 +268,20 @@ void Server::runEventLoop()
                     }
                 }
 
-				if (currSock == m_dServerFd)
+				if (currSock == m_replSnapshotPipe)
+				{
+					replicationForwardSnapshot();
+				}
+				else if (currSock == m_dServerFd)
 				{
 					// server received a connection
 					int clientSocket = acceptNewConnection();
 					FD_SET(clientSocket, &currentSockets);
 				}
+				else if (std::ranges::any_of(m_waitingClients, [currSock](const WaitingClient& waiting) { return waiting.fd == currSock; }))
+				{
+					continue; // woke up while parked in WAIT, looked at again before the next select
+				}
 				else
 				{
 					// One of the client connections has msg
@@ -181,6 +316,48 @@ int Server::acceptNewConnection()
 	return clientFd;
 }
 
+namespace
+{
+	// Command table flags, commands with none (PING, INFO, REPLCONF, ...) are served everywhere
+	enum CommandFlags : uint8_t
+	{
+		CMD_WRITE = 1 << 0,    /* changes the dataset: propagated, refused on replicas */
+		CMD_READONLY = 1 << 1, /* only reads the dataset: replicas serve it within the client's staleness bounds */
+		CMD_EFFECTS = 1 << 2   /* propagated as what it did, which its handler reports, not as sent */
+	};
+
+	uint8_t commandFlags(const std::string& userCmd)
+	{
+		static const std::unordered_map<std::string_view, uint8_t> table{
+			{SET, CMD_WRITE}, {INCR, CMD_WRITE}, {GET, CMD_READONLY}, {KEYS, CMD_READONLY}, {TYPE, CMD_READONLY},
+			{XADD, CMD_WRITE}, {XRANGE, CMD_READONLY}, {XREVRANGE, CMD_READONLY}, {XREAD, CMD_READONLY},
+			{XTRIM, CMD_WRITE}, {XDEL, CMD_WRITE}, {XLEN, CMD_READONLY},
+			{XGROUP, CMD_WRITE}, {XREADGROUP, CMD_WRITE | CMD_EFFECTS}, {XACK, CMD_WRITE}, {XCLAIM, CMD_WRITE | CMD_EFFECTS}, {XAUTOCLAIM, CMD_WRITE | CMD_EFFECTS},
+			{XPENDING, CMD_READONLY}, {XINFO, CMD_READONLY},
+			{LPUSH, CMD_WRITE}, {RPUSH, CMD_WRITE}, {LPOP, CMD_WRITE}, {RPOP, CMD_WRITE}, {BLPOP, CMD_WRITE | CMD_EFFECTS},
+			{LRANGE, CMD_READONLY}, {LLEN, CMD_READONLY},
+			{PFADD, CMD_WRITE}, {PFMERGE, CMD_WRITE}, {PFCOUNT, CMD_READONLY},
+			{BF_RESERVE, CMD_WRITE}, {BF_ADD, CMD_WRITE}, {BF_MADD, CMD_WRITE},
+			{BF_EXISTS, CMD_READONLY}, {BF_MEXISTS, CMD_READONLY}, {BF_CARD, CMD_READONLY},
+			{CF_RESERVE, CMD_WRITE}, {CF_ADD, CMD_WRITE}, {CF_ADDNX, CMD_WRITE}, {CF_DEL, CMD_WRITE},
+			{CF_EXISTS, CMD_READONLY}, {CF_MEXISTS, CMD_READONLY}, {CF_COUNT, CMD_READONLY},
+			{CMS_INITBYDIM, CMD_WRITE}, {CMS_INITBYPROB, CMD_WRITE}, {CMS_INCRBY, CMD_WRITE},
+			{CMS_QUERY, CMD_READONLY}, {CMS_INFO, CMD_READONLY},
+			{TOPK_RESERVE, CMD_WRITE}, {TOPK_ADD, CMD_WRITE}, {TOPK_INCRBY, CMD_WRITE},
+			{TOPK_QUERY, CMD_READONLY}, {TOPK_COUNT, CMD_READONLY}, {TOPK_LIST, CMD_READONLY},
+			{TS_CREATE, CMD_WRITE}, {TS_ADD, CMD_WRITE}, {TS_MADD, CMD_WRITE},
+			{TS_RANGE, CMD_READONLY}, {TS_GET, CMD_READONLY}, {TS_INFO, CMD_READONLY},
+			{VADD, CMD_WRITE}, {VREM, CMD_WRITE}, {VSIM, CMD_READONLY}, {VCARD, CMD_READONLY}, {VDIM, CMD_READONLY},
+			{GEOADD, CMD_WRITE}, {GEOPOS, CMD_READONLY}, {GEODIST, CMD_READONLY}, {GEOSEARCH, CMD_READONLY},
+			{HSET, CMD_WRITE}, {HDEL, CMD_WRITE}, {HGET, CMD_READONLY}, {HGETALL, CMD_READONLY}, {HLEN, CMD_READONLY},
+			{FT_CREATE, CMD_WRITE}, {FT_DROPINDEX, CMD_WRITE}, {FT_SEARCH, CMD_READONLY}, {FT_INFO, CMD_READONLY},
+			{JSON_SET, CMD_WRITE}, {JSON_NUMINCRBY, CMD_WRITE}, {JSON_ARRAPPEND, CMD_WRITE}, {JSON_GET, CMD_READONLY},
+		};
+		auto entry = table.find(userCmd);
+		return entry == table.end() ? 0 : entry->second;
+	}
+}
+
 int Server::HandleConnection(const int clientFd)
 {
 	// This function should not take long => cardinal rule of event loop
@@ -193,14 +370,19 @@ int Server::HandleConnection(const int clientFd)
 		if (clientFd == m_dMasterConnSocket)
 		{
 			std::cout << "Master disconnected..." << std::endl;
-			close(m_dMasterConnSocket);
-			m_dMasterConnSocket = -1;
+			m_dMasterConnSocket = -1; // reconnected from serverCron, reads are served meanwhile
 		}
 
 		/* We fall here whenever the client disconnects 
 		   So go place to handle cancelling subscriptions, blocking commands etc
 		*/
 		m_subscriptionHandler.unsubscribeClientFromAllChannels(clientFd, true); // don't respond to client
+		m_readBounds.erase(clientFd);
+		dropReplica(clientFd);
+
+		// Nothing is owed to it any more, the fd may be handed to the next client that connects
+		std::erase_if(m_waitingClients, [clientFd](const WaitingClient& waiting) { return waiting.fd == clientFd; });
+		std::erase_if(m_pendingReplies, [clientFd](const auto& pending) { return pending.first == clientFd; });
 		
 		return -1;
 	}
@@ -214,31 +396,35 @@ int Server::HandleConnection(const int clientFd)
 	auto currentCmd{toLower(commandArgs[0])};
 	bool bShouldRespondBack = shouldRespondBack(status, clientFd, commandArgs);
 
+	// A replica applies writes from its master only, and serves reads to clients while it is fresh enough for them
+	if (status == "slave" && clientFd != m_dMasterConnSocket)
+	{
+		if (std::string refusal = replicaRefuseCommand(currentCmd, clientFd); !refusal.empty())
+		{
+			send(clientFd, refusal.c_str(), refusal.length(), MSG_NOSIGNAL);
+			return 0;
+		}
+	}
+
 	/* Process the command */
 	auto result{HandleCommand(std::make_unique<std::vector<std::string>>(commandArgs), clientFd)};
 
-	if (bShouldRespondBack && result != NO_REPLY)
+	if (bShouldRespondBack && result != NO_REPLY && m_aof.Policy() == AppendOnlyFile::Fsync::ALWAYS && m_aof.HasPendingWrites())
+	{
+		m_pendingReplies.emplace_back(clientFd, std::move(result)); // acknowledged once the write is on disk
+	}
+	else if (bShouldRespondBack && result != NO_REPLY)
 	{
 		//std::cout << "Sending response...[" << result << "]\n";
 		std::cout << "Sending response..." << result << std::endl;
 		send(clientFd, result.c_str(), result.length(), 0);
 	}
 
-	if (status == "master" && shouldPropogateCommand(currentCmd))
+	// A replica passes its master's stream on to its own replicas as is, GETACKs included: the offset is what
+	// was processed of that stream, at every level of the chain
+	if (clientFd == m_dMasterConnSocket)
 		PropogateCommandToReplicas(RESPEncoder::encodeArray(commandArgs));
 
-	if (status == "slave")
-	{
-		m_mapConfiguration["master_repl_offset"] = std::to_string(std::stoi(m_mapConfiguration["master_repl_offset"])
-			+ RESPEncoder::encodeArray(commandArgs).length()); // Keep updating length of processed commands
-	}
-
-	if (shouldPropogateCommand(currentCmd)) // A write command: track offset on both master and standby
-	{
-		m_mapConfiguration["waitcmd_offset"] = std::to_string(std::stoi(m_mapConfiguration["waitcmd_offset"])
-			+ RESPEncoder::encodeArray(commandArgs).length()); // Keep updating length of write commands
-	}
-
 	return 0;
 }
 
@@ -256,6 +442,31 @@ std::string Server::HandleCommand(std::unique_ptr<std::vector<std::string>> ptrA
 		return CommandHandler::SUBSCRIPTION_cmdHandler(std::move(ptrArray), *this, clientFd);
 	}
 
+	uint8_t flags = commandFlags(ptrArray->at(0));
+	if (flags & CMD_WRITE)
+	{
+		// Propagated after it ran so IDs and timestamps the command generated are replayed as they were assigned
+		std::vector<std::string> args;
+		if (!(flags & CMD_EFFECTS))
+			args = *ptrArray;
+		auto result{executeCommand(std::move(ptrArray), clientFd)};
+		if (!(flags & CMD_EFFECTS))
+			propagateWrite(std::move(args), result);
+
+		// Then what it did to groups (its own reads and claims, or blocked XREADGROUPs an XADD served) and
+		// the pops for the BLPOPs a push served
+		for (auto& effect : m_streamHandler.TakeEffects())
+			propagateCommand(effect);
+		for (auto& pop : m_listHandler.TakeServedPops())
+			propagateCommand(pop);
+		return result;
+	}
+
+	return executeCommand(std::move(ptrArray), clientFd);
+}
+
+std::string Server::executeCommand(std::unique_ptr<std::vector<std::string>> ptrArray, const int clientFd)
+{
 	if (ptrArray->at(0) == PING)
 	{
 		return CommandHandler::PING_cmdHandler(std::move(ptrArray));
@@ -282,7 +493,19 @@ std::string Server::HandleCommand(std::unique_ptr<std::vector<std::string>> ptrA
 	}
 	else if (ptrArray->at(0) == SAVE)
 	{
-		// todo: save memory snapshot in rdb format 
+		return CommandHandler::SAVE_cmdHandler(std::move(ptrArray), *this);
+	}
+	else if (ptrArray->at(0) == BGSAVE)
+	{
+		return CommandHandler::BGSAVE_cmdHandler(std::move(ptrArray), *this);
+	}
+	else if (ptrArray->at(0) == LASTSAVE)
+	{
+		return CommandHandler::LASTSAVE_cmdHandler(std::move(ptrArray), *this);
+	}
+	else if (ptrArray->at(0) == BGREWRITEAOF)
+	{
+		return CommandHandler::BGREWRITEAOF_cmdHandler(std::move(ptrArray), *this);
 	}
 	else if (ptrArray->at(0) == KEYS)
 	{
@@ -302,13 +525,24 @@ std::string Server::HandleCommand(std::unique_ptr<std::vector<std::string>> ptrA
 	}
 	else if (ptrArray->at(0) == WAIT)
 	{
-		return CommandHandler::WAIT_cmdHandler(std::move(ptrArray), *this);
+		return CommandHandler::WAIT_cmdHandler(std::move(ptrArray), *this, clientFd);
+	}
+	else if (ptrArray->at(0) == REPLICAOF || ptrArray->at(0) == SLAVEOF)
+	{
+		return CommandHandler::REPLICAOF_cmdHandler(std::move(ptrArray), *this);
+	}
+	else if (ptrArray->at(0) == READONLY || ptrArray->at(0) == READWRITE)
+	{
+		return CommandHandler::READONLY_cmdHandler(std::move(ptrArray), *this, clientFd);
 	}
 	else if (ptrArray->at(0) == TYPE)
 	{
-		return CommandHandler::TYPE_cmdHandler(std::move(ptrArray), m_kvStore, m_streamHandler);
+		return CommandHandler::TYPE_cmdHandler(std::move(ptrArray), *this);
 	}
-	else if (ptrArray->at(0) == XADD || ptrArray->at(0) == XRANGE || ptrArray->at(0) == XREAD)
+	else if (ptrArray->at(0) == XADD || ptrArray->at(0) == XRANGE || ptrArray->at(0) == XREVRANGE || ptrArray->at(0) == XREAD
+		|| ptrArray->at(0) == XTRIM || ptrArray->at(0) == XDEL || ptrArray->at(0) == XLEN || ptrArray->at(0) == XGROUP
+		|| ptrArray->at(0) == XREADGROUP || ptrArray->at(0) == XACK || ptrArray->at(0) == XPENDING || ptrArray->at(0) == XCLAIM
+		|| ptrArray->at(0) == XAUTOCLAIM || ptrArray->at(0) == XINFO)
 	{
 		return m_streamHandler.StreamCommandProcessor(std::move(ptrArray), clientFd);
 	}
@@ -321,6 +555,62 @@ std::string Server::HandleCommand(std::unique_ptr<std::vector<std::string>> ptrA
 	{
 		return m_listHandler.ListCommandProcessor(std::move(ptrArray), clientFd);
 	}
+	else if (ptrArray->at(0) == PFADD)
+	{
+		return CommandHandler::PFADD_cmdHandler(std::move(ptrArray), m_kvStore);
+	}
+	else if (ptrArray->at(0) == PFCOUNT)
+	{
+		return CommandHandler::PFCOUNT_cmdHandler(std::move(ptrArray), m_kvStore);
+	}
+	else if (ptrArray->at(0) == PFMERGE)
+	{
+		return CommandHandler::PFMERGE_cmdHandler(std::move(ptrArray), m_kvStore);
+	}
+	else if (ptrArray->at(0) == BF_RESERVE || ptrArray->at(0) == BF_ADD || ptrArray->at(0) == BF_MADD || ptrArray->at(0) == BF_EXISTS
+		|| ptrArray->at(0) == BF_MEXISTS || ptrArray->at(0) == BF_CARD || ptrArray->at(0) == CF_RESERVE || ptrArray->at(0) == CF_ADD
+		|| ptrArray->at(0) == CF_ADDNX || ptrArray->at(0) == CF_EXISTS || ptrArray->at(0) == CF_MEXISTS || ptrArray->at(0) == CF_DEL
+		|| ptrArray->at(0) == CF_COUNT)
+	{
+		return m_filterHandler.FilterCommandProcessor(std::move(ptrArray));
+	}
+	else if (ptrArray->at(0) == CMS_INITBYDIM || ptrArray->at(0) == CMS_INITBYPROB || ptrArray->at(0) == CMS_INCRBY || ptrArray->at(0) == CMS_QUERY
+		|| ptrArray->at(0) == CMS_INFO || ptrArray->at(0) == TOPK_RESERVE || ptrArray->at(0) == TOPK_ADD || ptrArray->at(0) == TOPK_INCRBY
+		|| ptrArray->at(0) == TOPK_QUERY || ptrArray->at(0) == TOPK_COUNT || ptrArray->at(0) == TOPK_LIST)
+	{
+		return m_sketchHandler.SketchCommandProcessor(std::move(ptrArray));
+	}
+	else if (ptrArray->at(0) == TS_CREATE || ptrArray->at(0) == TS_ADD || ptrArray->at(0) == TS_MADD || ptrArray->at(0) == TS_RANGE
+		|| ptrArray->at(0) == TS_GET || ptrArray->at(0) == TS_INFO)
+	{
+		return m_timeSeriesHandler.TimeSeriesCommandProcessor(std::move(ptrArray));
+	}
+	else if (ptrArray->at(0) == VADD || ptrArray->at(0) == VSIM || ptrArray->at(0) == VREM || ptrArray->at(0) == VCARD || ptrArray->at(0) == VDIM)
+	{
+		return m_vectorHandler.VectorCommandProcessor(std::move(ptrArray));
+	}
+	else if (ptrArray->at(0) == GEOADD || ptrArray->at(0) == GEOPOS || ptrArray->at(0) == GEODIST || ptrArray->at(0) == GEOSEARCH)
+	{
+		return m_geoHandler.GeoCommandProcessor(std::move(ptrArray));
+	}
+	else if (ptrArray->at(0) == HSET || ptrArray->at(0) == HGET || ptrArray->at(0) == HGETALL || ptrArray->at(0) == HDEL || ptrArray->at(0) == HLEN)
+	{
+		bool isWrite = ptrArray->at(0) == HSET || ptrArray->at(0) == HDEL;
+		std::string key = ptrArray->size() > 1 ? ptrArray->at(1) : "";
+
+		std::string response = m_hashHandler.HashCommandProcessor(std::move(ptrArray));
+		if (isWrite && !key.empty())
+			m_searchHandler.OnHashChanged(key, m_hashHandler.GetHash(key));
+		return response;
+	}
+	else if (ptrArray->at(0) == FT_CREATE || ptrArray->at(0) == FT_SEARCH || ptrArray->at(0) == FT_DROPINDEX || ptrArray->at(0) == FT_INFO)
+	{
+		return m_searchHandler.SearchCommandProcessor(std::move(ptrArray), m_hashHandler);
+	}
+	else if (ptrArray->at(0) == JSON_SET || ptrArray->at(0) == JSON_GET || ptrArray->at(0) == JSON_NUMINCRBY || ptrArray->at(0) == JSON_ARRAPPEND)
+	{
+		return m_jsonHandler.JsonCommandProcessor(std::move(ptrArray));
+	}
 	else
 	{
 		return RESPEncoder::encodeError("Unsupported command or wrong command format");
@@ -383,49 +673,253 @@ void Server::initializeSlave()
 
 	// Step 2b:
 	std::vector<std::string> input2{"REPLCONF", "capa", "psync2"};
+	if (m_replCompression)
+		input2.insert(input2.end(), {"capa", "lz4"}); // a master that can't compress ignores it and says so in its PSYNC reply
 	sendData(m_dMasterConnSocket, input2);
 	result = SocketReader(m_dMasterConnSocket).readSimpleString();
 	if (toLower(result) != toLower("ok"))
 		throw std::runtime_error("Second step of threeway handshare failed");
 
-	// Step 3:
+	// Step 3: ask for what we miss of the history we have, if any
 	std::vector<std::string> input3{"PSYNC", "?", "-1"};
+	if (m_replCachedMaster)
+		input3 = {"PSYNC", m_replId, std::to_string(m_replBacklog.Offset() + 1)};
 	sendData(m_dMasterConnSocket, input3);
-	result = SocketReader(m_dMasterConnSocket).readSimpleString();
 
 	// Store Master Information in Configuration
 	m_mapConfiguration["masterIP"] = masterIP;
 	m_mapConfiguration["masterPort"] = port;
-	m_mapConfiguration["master_repl_offset"] = result.substr(result.find_last_of(' ') + 1, 1);
 
 	std::cout << "Threeway handshake complete" << std::endl;
 
-	if (m_mapConfiguration["master_repl_offset"] == "0")
+	// The reply comes once the master is ready to stream, with a full sync the master's dataset follows. It is
+	// parsed off the socket on another thread into tables of its own, reads keep being served from the current
+	// dataset until checkReplicaLoad swaps them in
+	m_replicaLoad = std::async(std::launch::async, replicaSync, m_dMasterConnSocket);
+}
+
+void Server::replicationConnect()
+{
+	m_replLastConnectTry = time(nullptr);
+	try
 	{
-		// Master should be sending empty rdb file now
-		result = SocketReader(m_dMasterConnSocket).readRDBFile();
-		result = result.substr(result.find('\n') + 1);
-		createFileWithData("/tmp/emptyDb.rdb", result); /* Even if data is empty we can still info like version, metadata etc */
-		try
+		initializeSlave();
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Connecting to master failed: " << e.what() << std::endl;
+		if (m_dMasterConnSocket != -1)
+		{
+			close(m_dMasterConnSocket);
+			m_dMasterConnSocket = -1;
+		}
+	}
+}
+
+std::unique_ptr<Server::ReplicaLoad> Server::replicaSync(int masterFd)
+{
+	auto load = std::make_unique<ReplicaLoad>();
+	std::string reply = SocketReader(masterFd).readSimpleString();
+	std::istringstream fields(reply);
+	std::string kind, capa;
+	fields >> kind >> load->replId;
+	if (kind == "FULLRESYNC")
+		fields >> load->offset;
+	fields >> capa;
+
+	if (kind != "CONTINUE" && (kind != "FULLRESYNC" || load->replId.empty()))
+		throw std::runtime_error("Unexpected PSYNC reply from master: " + reply);
+
+	// Compressed link: a thread decodes the master's frames into a socket pair, from here on the stream is read
+	// off the other end as if it came straight from the master, replication offsets included
+	int streamFd = masterFd;
+	if (capa == "lz4")
+	{
+		int pair[2];
+		int linkFd = dup(masterFd);
+		if (linkFd < 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+		{
+			if (linkFd >= 0)
+				close(linkFd);
+			throw std::runtime_error("Can't set up the compressed replication link");
+		}
+		std::thread(replicationDecodeLink, linkFd, pair[0]).detach();
+		load->streamFd = streamFd = pair[1];
+	}
+
+	// "CONTINUE [<replid>]": the master streams what we missed right after
+	if (kind == "CONTINUE")
+	{
+		load->partial = true;
+		return load;
+	}
+
+	try
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		uint64_t length;
+		std::string eofMark;
+		SocketReader(streamFd).readRDBHeader(length, eofMark);
+
+		RdbReader reader(streamFd, length, eofMark);
+		load->result = rdbLoadKeys(reader, load->keyspace.Refs());
+		for (const auto& definition : load->result.indexDefinitions)
+			load->searchHandler.LoadRdb(definition, load->keyspace.hashHandler);
+
+		load->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+	catch (...)
+	{
+		// Ends the decoding thread, which closes its copy of the master connection
+		if (load->streamFd != -1)
+			close(load->streamFd);
+		throw;
+	}
+	return load;
+}
+
+void Server::replicationDecodeLink(int linkFd, int streamFd)
+{
+	auto sendAll = [](int fd, const char* data, size_t length)
+	{
+		while (length > 0)
 		{
-			m_kvStore.initializeKeyValues("/tmp", "emptyDb.rdb");
-			std::cout << "Initialized from Master's rdb file" << std::endl;
+			ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent <= 0)
+				return false;
+			data += sent;
+			length -= sent;
 		}
-		catch(const std::exception& e)
+		return true;
+	};
+
+	Lz4::FrameDecoder decoder;
+	std::vector<char> buffer(1 << 16);
+	std::string decoded;
+	pollfd fds[2]{{linkFd, POLLIN, 0}, {streamFd, POLLIN, 0}};
+	try
+	{
+		for (bool open = true; open;)
 		{
-			if (std::string_view(e.what()).find("database start") != std::string::npos)
+			if (poll(fds, 2, -1) < 0)
 			{
-				// Expected no database exception bcoz we are initializing from empty rdb file
-				std::cout << "Ignore expected exception: " << "database start not found" << std::endl;
+				open = errno == EINTR;
+				continue;
+			}
+
+			// Master -> replica: frames, decoded for the event loop or the full sync loader
+			if (fds[0].revents)
+			{
+				ssize_t bytes = recv(linkFd, buffer.data(), buffer.size(), 0);
+				open = bytes > 0;
+				if (open)
+				{
+					decoded.clear();
+					decoder.Feed(buffer.data(), bytes, decoded);
+					open = sendAll(streamFd, decoded.data(), decoded.size());
+				}
+			}
+
+			// Replica -> master: ACKs, they go out as they are
+			if (open && fds[1].revents)
+			{
+				ssize_t bytes = read(streamFd, buffer.data(), buffer.size());
+				open = bytes > 0 && sendAll(linkFd, buffer.data(), bytes);
 			}
-			else
-				throw; // re-throw any other exception
 		}
 	}
-	else
+	catch (const std::exception& e)
+	{
+		std::cout << "Compressed replication link failed: " << e.what() << std::endl;
+	}
+
+	// Either side going away ends the other one too
+	shutdown(linkFd, SHUT_RDWR);
+	close(linkFd);
+	close(streamFd);
+}
+
+void Server::checkReplicaLoad()
+{
+	if (!m_replicaLoad.valid() || m_replicaLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	std::unique_ptr<ReplicaLoad> load;
+	try
+	{
+		load = m_replicaLoad.get();
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Synchronizing with master failed: " << e.what() << std::endl;
+		close(m_dMasterConnSocket);
+		m_dMasterConnSocket = -1;
+		return;
+	}
+
+	// The decoding thread holds the master connection of a compressed link, we talk to it instead
+	if (load->streamFd != -1)
+	{
+		close(m_dMasterConnSocket);
+		m_dMasterConnSocket = load->streamFd;
+		std::cout << "Replication link is LZ4 compressed" << std::endl;
+	}
+
+	if (load->partial)
 	{
-		throw std::runtime_error("Initializing from full master data state not supported yet");
+		// A promoted replica continues its former master's history under an ID of its own
+		if (!load->replId.empty() && load->replId != m_replId)
+		{
+			m_replId2 = m_replId;
+			m_secondReplIdOffset = m_replBacklog.Offset() + 1;
+			m_replId = load->replId;
+			replicationDropReplicas(); // they go on with PSYNC under the old ID and learn the new one
+		}
+		std::cout << "Partial resynchronization with master accepted, continuing at offset " << m_replBacklog.Offset() << std::endl;
+		return;
 	}
+
+	// Only the event loop touches the live tables, to clients the whole dataset changes at once
+	Keyspace& loaded = load->keyspace;
+	m_kvStore.Swap(loaded.kvStore);
+	m_listHandler.Swap(loaded.listHandler);
+	m_streamHandler.Swap(loaded.streamHandler);
+	m_filterHandler.Swap(loaded.filterHandler);
+	m_sketchHandler.Swap(loaded.sketchHandler);
+	m_timeSeriesHandler.Swap(loaded.timeSeriesHandler);
+	m_vectorHandler.Swap(loaded.vectorHandler);
+	m_geoHandler.Swap(loaded.geoHandler);
+	m_hashHandler.Swap(loaded.hashHandler);
+	m_jsonHandler.Swap(loaded.jsonHandler);
+	m_searchHandler.Swap(load->searchHandler);
+
+	std::cout << "Loaded " << load->result.loaded << " keys from master in " << load->seconds << " seconds ("
+		<< load->result.expired << " expired, " << load->result.skipped << " skipped)" << std::endl;
+
+	// Our history is the master's from now on
+	m_replId = load->replId;
+	m_replId2 = std::string(40, '0');
+	m_secondReplIdOffset = -1;
+	m_replBacklog.Reset(load->offset);
+	m_replCachedMaster = true;
+	m_replHeartbeatMs = 0; // how old the new dataset is shows with the master's next heartbeat
+
+	// Our replicas followed the history we just dropped, they need a full sync of this one
+	replicationDropReplicas();
+
+	// The previous dataset can be as large as the new one, it is freed off the event loop. Segments of its
+	// cold stream nodes are given back here, the stream tier is only changed on the event loop
+	loaded.streamHandler.ReleaseColdNodes();
+	std::thread([previous = std::move(load)] {}).detach();
+
+	// Tells a diskless master the payload was consumed, it sends the writes it buffered meanwhile
+	sendData(m_dMasterConnSocket, {"REPLCONF", "ACK", std::to_string(m_replBacklog.Offset())});
+
+	// The AOF still describes the old dataset
+	if (m_aof.Enabled())
+		m_aofRewriteScheduled = true;
 }
 
 void Server::sendData(const int fd, const std::vector<std::string>& vec)
@@ -436,7 +930,7 @@ void Server::sendData(const int fd, const std::vector<std::string>& vec)
 		throw std::runtime_error("Failed to send data to master");
 }
 
-std::string Server::recvData(const int fd)
+std::string Server::recvData(const int)
 {
 	/* replaced with socketReader() to read commands one at a time
 	std::string result;
@@ -457,124 +951,1636 @@ std::string Server::recvData(const int fd)
 	return {}; 
 }
 
-bool Server::shouldPropogateCommand(const std::string& userCmd)
+std::string Server::replicaRefuseCommand(const std::string& userCmd, const int clientFd)
+{
+	std::string master = m_mapConfiguration["replicaof"]; // "<host> <port>"
+	std::string masterAddress = master.substr(0, master.find(' ')) + ":" + master.substr(master.find(' ') + 1);
+
+	// Writes only come from the master, the error tells the client where to send them
+	uint8_t flags = commandFlags(userCmd);
+	if (flags & CMD_WRITE)
+		return RESPEncoder::encodeError("You can't write against a read only replica, master is " + masterAddress, "READONLY");
+
+	auto bounds = m_readBounds.find(clientFd);
+	if (!(flags & CMD_READONLY) || bounds == m_readBounds.end())
+		return {};
+
+	// Unknown lag (link down, no heartbeat yet) is over any bound
+	int64_t lagMs = replicationLagMs();
+	int64_t lagBytes = replicationLagBytes();
+	bool tooOld = bounds->second.maxLagMs >= 0 && (lagMs < 0 || lagMs > bounds->second.maxLagMs);
+	bool tooFarBehind = bounds->second.maxLagBytes >= 0 && (lagBytes < 0 || lagBytes > bounds->second.maxLagBytes);
+	if (tooOld || tooFarBehind)
+		return RESPEncoder::encodeError("Replica lag is " + std::to_string(lagMs) + " ms, " + std::to_string(lagBytes)
+			+ " bytes, over the READONLY bounds, master is " + masterAddress, "STALE");
+	return {};
+}
+
+namespace
 {
-	if (userCmd == SET || userCmd == XADD)
+	// Replica sockets are written without blocking, false only if the connection failed
+	bool sendOutput(const int fd, std::string& output, size_t& sent)
 	{
+		while (sent < output.size())
+		{
+			ssize_t bytes = send(fd, output.data() + sent, output.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (bytes < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			sent += bytes;
+		}
+		output.clear();
+		sent = 0;
 		return true;
 	}
-	return false;
 }
 
 void Server::PropogateCommandToReplicas(const std::string& userCmd)
 {
-	for (auto& replica : m_mapReplicaPortSocket)
-	{
-		if (write(replica.second, userCmd.c_str(), userCmd.length()) < 0)
-			throw std::runtime_error("Failed to send ping request to replica");
+	m_replBacklog.Feed(userCmd);
 
-		std::cout << "Cmd Propogated to [replica: " << replica.first << "]\n";
-	}
+	// Sent by replicationFlush at the end of the event loop iteration, with everything else propagated in it
+	if (!m_replicaLinks.empty())
+		m_replStream.Append(userCmd);
 }
 
-bool Server::shouldRespondBack(const std::string& status, const int fd, std::vector<std::string>& args)
+void Server::replicationFlush()
 {
-	if (status == "master"
-		|| (status == "slave" && fd != m_dMasterConnSocket) // should always respond to master, below checks only for reponding to master
-		|| (status == "slave" && args.size() > 1 && toLower(args[0]) == REPLCONF && toLower(args[1]) == "getack")
-		|| (status == "slave" && args.size() > 1 && toLower(args[0]) == COMMAND && toLower(args[1]) == toLower("docs"))) // sent by redis.cli after connecting
+	// WAITs parked in this iteration share one GETACK
+	if (m_replGetAckPending)
 	{
-		return true;
+		m_replGetAckPending = false;
+		PropogateCommandToReplicas(RESPEncoder::encodeArray({"REPLCONF", "GETACK", "*"}));
 	}
 
-	return false;
-}
-
+	std::vector<int> failed;
+	for (auto& [fd, link] : m_replicaLinks)
+	{
+		// What goes ahead of the stream first, then the next part of a snapshot file
+		if (!sendOutput(fd, link.output, link.outputSent) || !replicationSendSnapshotFile(fd))
+		{
+			failed.push_back(fd);
+			continue;
+		}
 
-void Server::signalHandler(int signal)
-{
-    std::cout << "\nReceived signal " << signal << ". Initiating graceful shutdown..." << std::endl;
-    sendShutdownSignal();
-}
+		uint64_t pending = m_replStream.Pending(link.cursor) + (link.frames.size() - link.framesSent);
+		if (pending > m_replOutputLimit)
+		{
+			std::cout << "Replica " << fd << " is " << pending << " bytes behind, over the output buffer limit" << std::endl;
+			failed.push_back(fd);
+			continue;
+		}
 
+		// A replica still being synced gets its part of the stream after the snapshot
+		if (pending == 0 || m_replicaSyncs.contains(fd) || link.outputSent < link.output.size())
+			continue;
+		if (!link.lz4)
+		{
+			if (!m_replStream.Send(fd, link.cursor))
+				failed.push_back(fd);
+			continue;
+		}
 
-void Server::sendShutdownSignal()
-{
-    if (signalPipe[1] != -1)
-	{
-        char shutdownMsg = 'Q'; // 'Q' for quit
-        ssize_t result = write(signalPipe[1], &shutdownMsg, 1);
-        if (result == -1)
+		// Frames are cut from what piled up while the previous ones went out, a backed up link gets larger ones
+		if (link.framesSent == link.frames.size())
 		{
-            // Don't use std::cerr in signal handler (not async-signal-safe)
-            // Just ignore the error or use write() to stderr directly
-            std::string msg = "Failed to write to signal pipe\n";
-            write(STDERR_FILENO, msg.c_str(), msg.length());
-        }
-    }
+			std::string raw;
+			m_replStream.Consume(link.cursor, raw);
+			link.frames = {};
+			link.framesSent = 0;
+			Lz4::AppendFrames(raw, link.frames);
+		}
+		ssize_t sent = send(fd, link.frames.data() + link.framesSent, link.frames.size() - link.framesSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent >= 0)
+			link.framesSent += sent;
+		else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			failed.push_back(fd);
+	}
+
+	for (int fd : failed)
+		dropReplica(fd);
 }
 
-void Server::setupSignalHandling()
+bool Server::sendToReplica(const int fd, const char* data, size_t length)
 {
-	// Create a pipe for signal communication
-	if (pipe(signalPipe) == -1)
+	auto link = m_replicaLinks.find(fd);
+	if (link == m_replicaLinks.end())
+		return false;
+
+	// Past its PSYNC reply a compressed link only carries frames
+	if (link->second.lz4)
+		Lz4::AppendFrames({data, length}, link->second.output);
+	else
+		link->second.output.append(data, length);
+
+	// As much as the socket takes now, replicationFlush sends the rest once it is writable
+	if (!sendOutput(fd, link->second.output, link->second.outputSent))
 	{
-		throw std::runtime_error("Failed to create signal pipe: " + std::string(strerror(errno)));
+		std::cout << "Failed sending to replica " << fd << ": " << strerror(errno) << std::endl;
+		return false;
 	}
+	return true;
+}
 
-	// Make the write end non-blocking
-	int flags = fcntl(signalPipe[1], F_GETFL);
-	if (flags == -1 || fcntl(signalPipe[1], F_SETFL, flags | O_NONBLOCK) == -1)
+void Server::dropReplica(const int fd)
+{
+	if (auto sync = m_replicaSyncs.find(fd); sync != m_replicaSyncs.end() && sync->second.rdbFd >= 0)
+		close(sync->second.rdbFd);
+	bool wasReplica = m_replicaSyncs.erase(fd) > 0;
+	wasReplica |= m_replicaLinks.erase(fd) > 0;
+	for (auto it = m_mapReplicaPortSocket.begin(); it != m_mapReplicaPortSocket.end(); ++it)
 	{
-		throw std::runtime_error("Failed to set pipe non-blocking: " + std::string(strerror(errno)));
+		if (it->second == fd)
+		{
+			m_mapReplicaPortSocket.erase(it);
+			wasReplica = true;
+			break;
+		}
 	}
 
-	// Set up signal handlers
-	std::signal(SIGINT, signalHandler);	 // Ctrl+C
-	std::signal(SIGTERM, signalHandler); // Termination request
+	// The event loop sees the connection end and closes it
+	if (wasReplica)
+		shutdown(fd, SHUT_RDWR);
+}
 
-	std::cout << "Signal handling setup complete.." << std::endl;
+void Server::replicationDropReplicas()
+{
+	std::set<int> replicas;
+	for (const auto& [port, fd] : m_mapReplicaPortSocket)
+		replicas.insert(fd);
+	for (const auto& [fd, sync] : m_replicaSyncs)
+		replicas.insert(fd);
+	for (const auto& [fd, link] : m_replicaLinks)
+		replicas.insert(fd);
+	for (int fd : replicas)
+		dropReplica(fd);
 }
 
-void Server::cleanup()
+void Server::replicationQueueFullSync(const int fd)
 {
-	std::cout << "Performing cleanup..." << std::endl;
+	auto& sync = m_replicaSyncs[fd];
+	sync.state = ReplicaSyncState::WAIT_BGSAVE_START;
+	sync.queuedAt = time(nullptr);
+	m_replicaLinks.erase(fd);
+
+	// Without a delay to gather more replicas the snapshot starts right away, if no other child is busy
+	if (m_replDisklessSyncDelay == 0 || !m_replDisklessSync)
+		startReplicationSync();
+}
 
-	// Close all client connections
-	for (int fd = 0; fd < FD_SETSIZE; ++fd)
+namespace
+{
+	std::string replicationTempFile(const std::string& dir, pid_t pid)
 	{
-		if (fd != m_dServerFd && fd != m_dMasterConnSocket &&
-			fd != signalPipe[0] && fd != signalPipe[1])
-		{
-			if (fd > 2)
-			{ // Don't close stdin/stdout/stderr
-				close(fd);
-			}
-		}
+		return dir + "/temp-repl-" + std::to_string(pid) + ".rdb";
 	}
+}
 
-	// Cancel all blocking operations
-	// Add these methods when you implement cancellation
-	// m_listHandler.cancelAllBlockingOperations();
-	// m_streamHandler.cancelAllBlockingOperations();
+bool Server::startReplicationSync()
+{
+	if (m_rdbChildPid != -1 || m_aofChildPid != -1 || m_replChildPid != -1)
+		return false; // serverCron tries again once the running child is done
 
-	// Close master connection if slave
-	if (m_dMasterConnSocket != -1)
+	std::vector<int> replicas;
+	for (const auto& [fd, sync] : m_replicaSyncs)
 	{
-		close(m_dMasterConnSocket);
-		m_dMasterConnSocket = -1;
+		if (sync.state == ReplicaSyncState::WAIT_BGSAVE_START)
+			replicas.push_back(fd);
+	}
+	if (replicas.empty())
+		return false;
+
+	int snapshotPipe[2]{-1, -1};
+	if (m_replDisklessSync && pipe(snapshotPipe) < 0)
+	{
+		std::cout << "Can't create the replication pipe: " << strerror(errno) << std::endl;
+		return false;
 	}
 
-	// Save state if needed
-	// try
-	// {
-	// 	// Add state saving logic here
-	// 	std::cout << "State preservation complete" << std::endl;
-	// }
-	// catch (const std::exception &e)
-	// {
-	// 	std::cout << "Warning: Failed to save state: " << e.what() << std::endl;
-	// }
+	auto listsLock = m_listHandler.LockLists();
+	pid_t pid = fork();
+	listsLock.unlock();
+
+	if (pid == 0)
+	{
+		std::signal(SIGINT, SIG_DFL);
+		std::signal(SIGTERM, SIG_DFL);
+
+		int status = 0;
+		try
+		{
+			if (m_replDisklessSync)
+			{
+				close(snapshotPipe[0]);
+				RdbWriter writer(snapshotPipe[1], 1 << 20);
+				rdbSave(writer);
+			}
+			else
+			{
+				rdbWriteFile(replicationTempFile(m_mapConfiguration["dir"], getpid()), {});
+			}
+		}
+		catch (...)
+		{
+			status = 1;
+		}
+		_exit(status);
+	}
+
+	if (pid < 0)
+	{
+		std::cout << "Can't fork for the replication snapshot: " << strerror(errno) << std::endl;
+		if (m_replDisklessSync)
+		{
+			close(snapshotPipe[0]);
+			close(snapshotPipe[1]);
+		}
+		return false;
+	}
+
+	// Writes after the fork are not in the snapshot, they follow it
+	m_replChildPid = pid;
+	for (int fd : replicas)
+	{
+		m_replicaSyncs[fd].state = ReplicaSyncState::WAIT_BGSAVE_END;
+		m_replicaLinks[fd] = {m_replStream.Tail(), m_replBacklog.Offset(), time(nullptr)};
+	}
+
+	if (m_replDisklessSync)
+	{
+		close(snapshotPipe[1]);
+		fcntl(snapshotPipe[0], F_SETFL, fcntl(snapshotPipe[0], F_GETFL) | O_NONBLOCK);
+		m_replSnapshotPipe = snapshotPipe[0];
+	}
+
+	// The snapshot holds the stream up to here, the replicas continue from this offset
+	std::string reply = "+FULLRESYNC " + m_replId + " " + std::to_string(m_replBacklog.Offset());
+	std::string preamble;
+	if (m_replDisklessSync)
+	{
+		// The payload length isn't known before the child is done: announce the mark it will end with instead
+		m_replEofMark = randomHexId();
+		preamble = "$EOF:" + m_replEofMark + "\r\n";
+	}
+	for (int fd : replicas)
+	{
+		// The reply itself goes out plain, it tells the replica whether the rest is compressed
+		bool lz4 = m_replicaSyncs[fd].lz4;
+		std::string line = reply + (lz4 ? " lz4" : "") + "\r\n";
+		bool sent = sendToReplica(fd, line.data(), line.size());
+		m_replicaLinks[fd].lz4 = lz4;
+		if (!sent || !sendToReplica(fd, preamble.data(), preamble.size()))
+			dropReplica(fd);
+	}
+
+	std::cout << "Starting " << (m_replDisklessSync ? "diskless" : "disk") << " full sync for " << replicas.size()
+		<< " replica(s), snapshot child pid " << pid << std::endl;
+	return true;
+}
+
+bool Server::replicationSnapshotDrained() const
+{
+	for (const auto& [fd, sync] : m_replicaSyncs)
+	{
+		auto link = m_replicaLinks.find(fd);
+		if (sync.state == ReplicaSyncState::WAIT_BGSAVE_END && link != m_replicaLinks.end() && link->second.outputSent < link->second.output.size())
+			return false;
+	}
+	return true;
+}
+
+void Server::replicationForwardSnapshot()
+{
+	static std::vector<char> chunk(1 << 20);
+
+	// A chunk at a time, the next once every replica of the sync sent the last one: the child can't get ahead of
+	// the slowest replica by more than that and the pipe buffer, and the event loop never waits for a replica
+	ssize_t bytes;
+	while (true)
+	{
+		if (!replicationSnapshotDrained())
+			return;
+		bytes = read(m_replSnapshotPipe, chunk.data(), chunk.size());
+		if (bytes <= 0)
+			break;
+
+		std::vector<int> failed;
+		for (auto& [fd, sync] : m_replicaSyncs)
+		{
+			if (sync.state == ReplicaSyncState::WAIT_BGSAVE_END && !sendToReplica(fd, chunk.data(), bytes))
+				failed.push_back(fd);
+		}
+		for (int fd : failed)
+			dropReplica(fd);
+	}
+	if (bytes < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+
+	// End of the payload: the child closed its end on exit
+	close(m_replSnapshotPipe);
+	m_replSnapshotPipe = -1;
+
+	int status = 0;
+	bool ok = waitpid(m_replChildPid, &status, 0) == m_replChildPid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	m_replChildPid = -1;
+
+	std::vector<int> failed;
+	for (auto& [fd, sync] : m_replicaSyncs)
+	{
+		if (sync.state != ReplicaSyncState::WAIT_BGSAVE_END)
+			continue;
+		if (ok && sendToReplica(fd, m_replEofMark.data(), m_replEofMark.size()))
+			sync.state = ReplicaSyncState::WAIT_ACK;
+		else
+			failed.push_back(fd); // a replica can't use half a snapshot, it has to start over
+	}
+	for (int fd : failed)
+		dropReplica(fd);
+
+	std::cout << "Diskless snapshot streamed " << (ok ? "successfully" : "with errors") << std::endl;
+}
+
+void Server::checkReplicationSync()
+{
+	// The diskless child is reaped once its pipe reaches EOF
+	if (m_replChildPid == -1 || m_replSnapshotPipe != -1)
+		return;
+
+	int status = 0;
+	pid_t done = waitpid(m_replChildPid, &status, WNOHANG);
+	if (done == 0)
+		return;
+
+	std::string path = replicationTempFile(m_mapConfiguration["dir"], m_replChildPid);
+	bool ok = done == m_replChildPid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	m_replChildPid = -1;
+
+	int fileFd = ok ? open(path.c_str(), O_RDONLY) : -1;
+	struct stat st{};
+	if (fileFd >= 0)
+		fstat(fileFd, &st);
+	unlink(path.c_str()); // each replica holds the file open until it was sent
+
+	// The size goes first so the command stream can follow the file right away. The file is read a part at a time
+	// as each replica takes it, in replicationFlush
+	std::string preamble = "$" + std::to_string(st.st_size) + "\r\n";
+	std::vector<int> replicas, failed;
+	for (auto& [fd, sync] : m_replicaSyncs)
+	{
+		if (sync.state != ReplicaSyncState::WAIT_BGSAVE_END)
+			continue;
+		replicas.push_back(fd);
+		sync.state = ReplicaSyncState::SEND_FILE;
+		sync.rdbFd = fileFd >= 0 ? dup(fileFd) : -1;
+		sync.rdbSize = st.st_size;
+		if (sync.rdbFd < 0 || !sendToReplica(fd, preamble.data(), preamble.size()))
+			failed.push_back(fd);
+	}
+	for (int fd : failed)
+		dropReplica(fd);
+	for (int fd : replicas)
+	{
+		if (m_replicaSyncs.contains(fd) && !replicationSendSnapshotFile(fd))
+			dropReplica(fd);
+	}
+
+	if (fileFd >= 0)
+		close(fileFd);
+	std::cout << "Disk based full sync " << (ok ? "started" : "failed") << " for " << replicas.size() << " replica(s)" << std::endl;
+}
+
+bool Server::replicationSendSnapshotFile(const int fd)
+{
+	static std::vector<char> chunk(1 << 20);
+
+	auto sync = m_replicaSyncs.find(fd);
+	auto link = m_replicaLinks.find(fd);
+	if (sync == m_replicaSyncs.end() || sync->second.state != ReplicaSyncState::SEND_FILE || link == m_replicaLinks.end())
+		return true;
+
+	// The next part once the last one went out, until the socket is full
+	while (link->second.outputSent == link->second.output.size() && sync->second.rdbOffset < sync->second.rdbSize)
+	{
+		ssize_t bytes = pread(sync->second.rdbFd, chunk.data(), chunk.size(), sync->second.rdbOffset);
+		if (bytes <= 0 || !sendToReplica(fd, chunk.data(), bytes))
+			return false;
+		sync->second.rdbOffset += bytes;
+	}
+
+	// All of it is queued, the stream goes out behind it
+	if (sync->second.rdbOffset == sync->second.rdbSize)
+	{
+		close(sync->second.rdbFd);
+		sync->second.rdbFd = -1;
+		replicationPutOnline(fd);
+	}
+	return true;
+}
+
+void Server::replicationPutOnline(const int fd)
+{
+	auto sync = m_replicaSyncs.find(fd);
+	if (sync == m_replicaSyncs.end())
+		return;
+
+	// What was written during the transfer goes out with the next flush
+	m_replicaSyncs.erase(sync);
+	std::cout << "Replica " << fd << " is online, " << m_replStream.Pending(m_replicaLinks[fd].cursor) << " bytes written during the sync follow" << std::endl;
+}
+
+void Server::replicationAck(const int fd, int64_t offset)
+{
+	auto link = m_replicaLinks.find(fd);
+	if (link != m_replicaLinks.end())
+	{
+		link->second.ackOffset = std::max(link->second.ackOffset, offset);
+		link->second.ackTime = time(nullptr);
+	}
+
+	auto sync = m_replicaSyncs.find(fd);
+	if (sync != m_replicaSyncs.end() && sync->second.state == ReplicaSyncState::WAIT_ACK)
+		replicationPutOnline(fd);
+
+	replicationProcessWaiting();
+}
+
+size_t Server::replicasAcked(int64_t offset)
+{
+	size_t acked = 0;
+	for (const auto& [fd, link] : m_replicaLinks)
+	{
+		if (link.ackOffset >= offset && !m_replicaSyncs.contains(fd))
+			++acked;
+	}
+	return acked;
+}
+
+void Server::replicationProcessWaiting()
+{
+	auto now = std::chrono::steady_clock::now();
+	std::erase_if(m_waitingClients, [&](const WaitingClient& waiting)
+	{
+		size_t acked = replicasAcked(waiting.offset);
+		if (acked < waiting.replicas && now < waiting.deadline)
+			return false;
+
+		std::string reply = RESPEncoder::encodeInteger(acked);
+		send(waiting.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+		return true;
+	});
+}
+
+void Server::replicationCron()
+{
+	// Masters stamp the stream with their clock, replicas down the chain tell how old their data is from it
+	int64_t nowMs = unixTimeMs();
+	if (!m_mapConfiguration.contains("replicaof") && !m_replicaLinks.empty() && nowMs - m_replLastHeartbeatSent >= REPL_HEARTBEAT_PERIOD_MS)
+	{
+		m_replLastHeartbeatSent = nowMs;
+		PropogateCommandToReplicas(RESPEncoder::encodeArray({REPLCONF, "HEARTBEAT", std::to_string(nowMs)}));
+	}
+
+	checkReplicaLoad();
+	time_t now = time(nullptr);
+	if (m_dMasterConnSocket == -1 && m_mapConfiguration.contains("replicaof") && now != m_replLastConnectTry)
+		replicationConnect();
+
+	// Lets the master see how far behind we are, and answers WAITs without waiting for a GETACK
+	if (m_dMasterConnSocket != -1 && !m_replicaLoad.valid() && now != m_replLastAckSent)
+	{
+		m_replLastAckSent = now;
+		std::string ack = RESPEncoder::encodeArray({"REPLCONF", "ACK", std::to_string(m_replBacklog.Offset())});
+		send(m_dMasterConnSocket, ack.data(), ack.size(), MSG_NOSIGNAL); // a broken link shows up on the read side
+	}
+}
+
+void Server::replicationHeartbeat(int64_t masterTimeMs)
+{
+	m_replHeartbeatMs = masterTimeMs;
+	m_replHeartbeatSeenMs = unixTimeMs();
+}
+
+int64_t Server::replicationLagMs()
+{
+	if (m_replHeartbeatMs == 0)
+		return -1;
+
+	// Nothing left to apply and the master heard from lately: we are as recent as the link allows. Otherwise the
+	// data is at least as recent as the last heartbeat applied
+	int64_t now = unixTimeMs();
+	if (replicationLagBytes() == 0 && now - m_replHeartbeatSeenMs <= 2 * REPL_HEARTBEAT_PERIOD_MS)
+		return 0;
+	return std::max<int64_t>(now - m_replHeartbeatMs, 0);
+}
+
+int64_t Server::replicationLagBytes()
+{
+	if (m_dMasterConnSocket == -1 || m_replicaLoad.valid())
+		return -1;
+
+	// The stream is read a command at a time, what the socket holds is all that is left to apply
+	int pending = 0;
+	if (ioctl(m_dMasterConnSocket, FIONREAD, &pending) < 0)
+		return -1;
+	return pending;
+}
+
+bool Server::replicationTryPartialSync(const int fd, const std::string& replId, const std::string& offset)
+{
+	int64_t psyncOffset = -1;
+	std::from_chars(offset.data(), offset.data() + offset.size(), psyncOffset);
+
+	// Our own history, or the one of the master we were promoted from up to where we took over
+	bool knownHistory = replId == m_replId || (replId == m_replId2 && psyncOffset <= m_secondReplIdOffset);
+	std::string missing;
+	if (!knownHistory || !m_replBacklog.CopyFrom(psyncOffset, missing))
+	{
+		std::cout << "Partial resynchronization not possible for " << replId << " at offset " << offset
+			<< " (backlog holds " << m_replBacklog.FirstOffset() << "-" << m_replBacklog.Offset() << ")" << std::endl;
+		return false;
+	}
+
+	auto sync = m_replicaSyncs.find(fd);
+	bool lz4 = sync != m_replicaSyncs.end() && sync->second.lz4;
+	std::string reply = "+CONTINUE " + m_replId + (lz4 ? " lz4" : "") + "\r\n";
+
+	// Online right away, the stream continues where the backlog ended. The reply goes out plain, the backlog in frames already
+	if (sync != m_replicaSyncs.end())
+		m_replicaSyncs.erase(sync);
+	auto& link = m_replicaLinks[fd] = {m_replStream.Tail(), psyncOffset - 1, time(nullptr)};
+	if (!sendToReplica(fd, reply.data(), reply.size()))
+	{
+		dropReplica(fd);
+		return true;
+	}
+	link.lz4 = lz4;
+	if (!sendToReplica(fd, missing.data(), missing.size()))
+	{
+		dropReplica(fd);
+		return true;
+	}
+	std::cout << "Partial resynchronization of replica " << fd << ", " << missing.size() << " bytes of backlog follow" << std::endl;
+	return true;
+}
+
+void Server::replicationShiftReplId()
+{
+	m_replId2 = m_replId;
+	m_secondReplIdOffset = m_replBacklog.Offset() + 1;
+	m_replId = randomHexId();
+}
+
+void Server::replicationDropMaster()
+{
+	if (m_dMasterConnSocket == -1)
+		return;
+
+	// A sync still reading from the connection fails once it is shut down, its result is discarded
+	shutdown(m_dMasterConnSocket, SHUT_RDWR);
+	if (m_replicaLoad.valid())
+	{
+		try
+		{
+			m_replicaLoad.get();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+	close(m_dMasterConnSocket);
+	m_dMasterConnSocket = -1;
+}
+
+void Server::replicationSetMaster(const std::string& host, const std::string& port)
+{
+	bool wasMaster = !m_mapConfiguration.contains("replicaof");
+	if (toLower(host) == "no" && toLower(port) == "one")
+	{
+		if (wasMaster)
+			return;
+
+		// Former replicas of our master can go on with PSYNC, with what we got from it under the old ID
+		m_mapConfiguration.erase("replicaof");
+		replicationDropMaster();
+		replicationShiftReplId();
+		replicationDropReplicas(); // sub-replicas of ours resync partially and learn the new ID
+		std::cout << "Promoted to master, new replication ID " << m_replId << std::endl;
+		return;
+	}
+
+	m_mapConfiguration["replicaof"] = host + " " + port;
+	replicationDropMaster();
+	if (wasMaster)
+	{
+		// The new master may well continue our own history, e.g. a replica of ours that got promoted
+		m_replCachedMaster = true;
+
+		// Our replicas follow a stream that now comes from elsewhere, they reconnect and PSYNC
+		replicationDropReplicas();
+	}
+	m_replLastConnectTry = 0; // serverCron connects right away
+}
+
+bool Server::shouldRespondBack(const std::string& status, const int fd, std::vector<std::string>& args)
+{
+	if (status == "master"
+		|| (status == "slave" && fd != m_dMasterConnSocket) // should always respond to master, below checks only for reponding to master
+		|| (status == "slave" && args.size() > 1 && toLower(args[0]) == REPLCONF && toLower(args[1]) == "getack")
+		|| (status == "slave" && args.size() > 1 && toLower(args[0]) == COMMAND && toLower(args[1]) == toLower("docs"))) // sent by redis.cli after connecting
+	{
+		return true;
+	}
+
+	return false;
+}
+
+
+std::string Server::rdbFilePath()
+{
+	return m_mapConfiguration["dir"] + "/" + m_mapConfiguration["dbfilename"];
+}
+
+std::string Server::rdbManifestPath()
+{
+	return rdbFilePath() + ".manifest";
+}
+
+Server::KeyspaceRefs Server::liveKeyspace()
+{
+	return {m_kvStore, m_listHandler, m_streamHandler, m_filterHandler, m_sketchHandler, m_timeSeriesHandler, m_vectorHandler, m_geoHandler, m_hashHandler, m_jsonHandler};
+}
+
+size_t Server::keyCount()
+{
+	return m_kvStore.KeyCount() + m_listHandler.KeyCount() + m_streamHandler.KeyCount() + m_filterHandler.KeyCount()
+		+ m_sketchHandler.KeyCount() + m_timeSeriesHandler.KeyCount() + m_vectorHandler.KeyCount() + m_geoHandler.KeyCount()
+		+ m_hashHandler.KeyCount() + m_jsonHandler.KeyCount();
+}
+
+void Server::rdbSave(RdbWriter& writer, const RdbSegment& segment)
+{
+	writer.WriteHeader();
+	if (segment.index == 0)
+		m_searchHandler.SaveRdb(writer);
+
+	// Segments only get an even share of the counts as their sizing hint
+	writer.WriteSelectDb(0);
+	writer.WriteResizeDb(keyCount() / segment.count, m_kvStore.ExpiresCount() / segment.count);
+
+	m_kvStore.SaveRdb(writer, segment);
+	m_listHandler.SaveRdb(writer, segment);
+	m_streamHandler.SaveRdb(writer, segment);
+	m_filterHandler.SaveRdb(writer, segment);
+	m_sketchHandler.SaveRdb(writer, segment);
+	m_timeSeriesHandler.SaveRdb(writer, segment);
+	m_vectorHandler.SaveRdb(writer, segment);
+	m_geoHandler.SaveRdb(writer, segment);
+	m_hashHandler.SaveRdb(writer, segment);
+	m_jsonHandler.SaveRdb(writer, segment);
+
+	writer.Finish();
+}
+
+Server::RdbLoadResult Server::rdbLoadKeys(RdbReader& reader, const KeyspaceRefs& keyspace, bool presized)
+{
+	timeVal now;
+	gettimeofday(&now, NULL);
+	int64_t nowMs = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+
+	RdbLoadResult result;
+	uint64_t db = 0;
+	int64_t expireAtMs = 0;
+
+	while (true)
+	{
+		uint8_t type = reader.ReadByte();
+		if (type == RDB_OPCODE_EOF)
+			break;
+
+		switch (type)
+		{
+		case RDB_OPCODE_EXPIRETIME_MS:
+			expireAtMs = reader.ReadMillisecondTime();
+			continue;
+		case RDB_OPCODE_EXPIRETIME:
+			expireAtMs = reader.ReadSecondTime() * 1000;
+			continue;
+		case RDB_OPCODE_AUX:
+		{
+			std::string key = reader.ReadString();
+			std::string value = reader.ReadString();
+			if (key == "ft-index")
+				result.indexDefinitions.push_back(std::move(value));
+			continue;
+		}
+		case RDB_OPCODE_SELECTDB:
+			db = reader.ReadLength();
+			continue;
+		case RDB_OPCODE_RESIZEDB:
+		{
+			// Strings are the bulk of most datasets, size their table once instead of rehashing while loading
+			uint64_t keys = reader.ReadLength();
+			uint64_t expires = reader.ReadLength();
+			if (db == 0 && !presized)
+				keyspace.kvStore.Reserve(std::min<uint64_t>(keys, reader.Size()), std::min<uint64_t>(expires, reader.Size()));
+			continue;
+		}
+		case RDB_OPCODE_SLOT_INFO:
+			reader.ReadLength(); // slot, slot size, expires slot size
+			reader.ReadLength();
+			reader.ReadLength();
+			continue;
+		case RDB_OPCODE_FUNCTION2:
+			reader.ReadString();
+			continue;
+		case RDB_OPCODE_FUNCTION_PRE_GA:
+			throw std::runtime_error("Pre-release function format in RDB file is not supported");
+		case RDB_OPCODE_MODULE_AUX:
+			reader.SkipModuleAux();
+			continue;
+		case RDB_OPCODE_IDLE:
+			reader.ReadLength();
+			continue;
+		case RDB_OPCODE_FREQ:
+			reader.ReadByte();
+			continue;
+		}
+
+		std::string key = reader.ReadString();
+		int64_t keyExpireAtMs = std::exchange(expireAtMs, 0);
+
+		// Single keyspace: other databases and already expired keys are dropped like a Redis master does
+		if (db != 0 || (keyExpireAtMs > 0 && keyExpireAtMs <= nowMs))
+		{
+			reader.SkipValue(type);
+			if (db != 0)
+				++result.skipped;
+			else
+				++result.expired;
+			continue;
+		}
+
+		switch (type)
+		{
+		case RDB_TYPE_STRING:
+			keyspace.kvStore.LoadRdb(reader, key, keyExpireAtMs);
+			break;
+		case RDB_TYPE_LIST:
+		case RDB_TYPE_LIST_ZIPLIST:
+		case RDB_TYPE_LIST_QUICKLIST:
+		case RDB_TYPE_LIST_QUICKLIST_2:
+			keyspace.listHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_HASH:
+		case RDB_TYPE_HASH_ZIPMAP:
+		case RDB_TYPE_HASH_ZIPLIST:
+		case RDB_TYPE_HASH_LISTPACK:
+			keyspace.hashHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_STREAM:
+			keyspace.streamHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_BLOOM:
+		case RDB_TYPE_CUCKOO:
+			keyspace.filterHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_CMS:
+		case RDB_TYPE_TOPK:
+			keyspace.sketchHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_TIMESERIES:
+			keyspace.timeSeriesHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_VECTORSET:
+			keyspace.vectorHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_GEO:
+			keyspace.geoHandler.LoadRdb(reader, type, key);
+			break;
+		case RDB_TYPE_JSON:
+			keyspace.jsonHandler.LoadRdb(reader, type, key);
+			break;
+		default:
+			// Sets, sorted sets, Redis streams and module values have no counterpart here
+			reader.SkipValue(type);
+			++result.skipped;
+			continue;
+		}
+		++result.loaded;
+	}
+
+	reader.VerifyChecksum();
+	return result;
+}
+
+void Server::rdbLoad(const std::string& path)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	RdbReader reader(path);
+	RdbLoadResult result = rdbLoadKeys(reader, liveKeyspace());
+
+	for (const auto& definition : result.indexDefinitions)
+		m_searchHandler.LoadRdb(definition, m_hashHandler);
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Loaded " << result.loaded << " keys from " << path << " in " << elapsed.count() << " seconds ("
+		<< result.expired << " expired, " << result.skipped << " skipped)" << std::endl;
+}
+
+namespace
+{
+	struct ManifestSegment
+	{
+		std::string file;
+		uint64_t bytes;
+		uint64_t keys;
+		uint64_t strings; /* string keys, what the loader sizes tables for */
+	};
+
+	/*
+		Segmented snapshot manifest, one line per segment file (relative to dir):
+		    segment <file> <bytes> <keys> [<strings>]
+		Replacing the manifest is what makes a new set of segments current. Manifests without the string
+		key count take all keys as strings
+	*/
+	std::vector<ManifestSegment> readManifest(const std::string& path)
+	{
+		std::ifstream manifest(path);
+		if (!manifest.is_open())
+			throw std::runtime_error("Failed opening " + path);
+
+		std::vector<ManifestSegment> segments;
+		std::string line;
+		while (std::getline(manifest, line))
+		{
+			std::istringstream fields(line);
+			std::string tag;
+			ManifestSegment segment;
+			if (line.empty() || line[0] == '#')
+				continue;
+			if (!(fields >> tag >> segment.file >> segment.bytes >> segment.keys) || tag != "segment"
+				|| segment.file.find('/') != std::string::npos)
+				throw std::runtime_error("Corrupt snapshot manifest " + path + ": '" + line + "'");
+			if (!(fields >> segment.strings))
+				segment.strings = segment.keys;
+			segments.push_back(std::move(segment));
+		}
+
+		if (segments.empty())
+			throw std::runtime_error("Snapshot manifest " + path + " lists no segments");
+		return segments;
+	}
+
+	time_t modificationTime(const std::string& path)
+	{
+		struct stat st;
+		return stat(path.c_str(), &st) == 0 ? st.st_mtime : -1;
+	}
+}
+
+void Server::rdbLoadSegments(const std::string& manifestPath)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	auto segments = readManifest(manifestPath);
+	const std::string& dir = m_mapConfiguration["dir"];
+
+	// Every segment is parsed into its own tables on its own thread. Saved with as many segments as the string keyspace
+	// has partitions, segment i holds the keys of partition i: only that table is presized, and kept as it is ...
+	bool byPartition = segments.size() == m_kvStore.PartitionCount();
+	std::vector<std::future<std::pair<std::unique_ptr<Keyspace>, RdbLoadResult>>> pending;
+	uint64_t totalStrings = 0;
+	for (size_t index = 0; index < segments.size(); ++index)
+	{
+		const auto& segment = segments[index];
+		totalStrings += segment.strings;
+		pending.push_back(std::async(std::launch::async, [path = dir + "/" + segment.file, bytes = segment.bytes, strings = segment.strings, index, byPartition]
+		{
+			RdbReader reader(path);
+			if (reader.Size() != bytes)
+				throw std::runtime_error(path + " doesn't match the snapshot manifest");
+
+			auto keyspace = std::make_unique<Keyspace>();
+			if (byPartition)
+				keyspace->kvStore.ReservePartition(index, strings);
+			RdbLoadResult result = rdbLoadKeys(reader, keyspace->Refs(), true);
+			return std::make_pair(std::move(keyspace), std::move(result));
+		}));
+	}
+
+	// ... while the other types, and strings saved with another segment count, are spliced in node by node: the live
+	// tables are sized once for every segment's strings
+	if (!byPartition)
+		m_kvStore.Reserve(totalStrings, 0);
+	RdbLoadResult total;
+	for (auto& future : pending)
+	{
+		auto [keyspace, result] = future.get();
+		m_kvStore.MergeFrom(keyspace->kvStore);
+		m_listHandler.MergeFrom(keyspace->listHandler);
+		m_streamHandler.MergeFrom(keyspace->streamHandler);
+		m_filterHandler.MergeFrom(keyspace->filterHandler);
+		m_sketchHandler.MergeFrom(keyspace->sketchHandler);
+		m_timeSeriesHandler.MergeFrom(keyspace->timeSeriesHandler);
+		m_vectorHandler.MergeFrom(keyspace->vectorHandler);
+		m_geoHandler.MergeFrom(keyspace->geoHandler);
+		m_hashHandler.MergeFrom(keyspace->hashHandler);
+		m_jsonHandler.MergeFrom(keyspace->jsonHandler);
+
+		total.loaded += result.loaded;
+		total.expired += result.expired;
+		total.skipped += result.skipped;
+		total.indexDefinitions.insert(total.indexDefinitions.end(), result.indexDefinitions.begin(), result.indexDefinitions.end());
+	}
+
+	for (const auto& definition : total.indexDefinitions)
+		m_searchHandler.LoadRdb(definition, m_hashHandler);
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Loaded " << total.loaded << " keys from " << segments.size() << " snapshot segments in " << elapsed.count()
+		<< " seconds (" << total.expired << " expired, " << total.skipped << " skipped)" << std::endl;
+}
+
+void Server::rdbLoadSnapshot()
+{
+	time_t rdbTime = modificationTime(rdbFilePath());
+	time_t manifestTime = modificationTime(rdbManifestPath());
+
+	if (manifestTime >= 0 && manifestTime >= rdbTime)
+		rdbLoadSegments(rdbManifestPath());
+	else if (rdbTime >= 0)
+		rdbLoad(rdbFilePath());
+	else
+		std::cout << "No RDB file at " << rdbFilePath() << ", starting empty" << std::endl;
+}
+
+void Server::rdbWriteFile(const std::string& path, const RdbSegment& segment)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("Failed opening " + path + " for saving: " + strerror(errno));
+
+	try
+	{
+		RdbWriter writer(fd);
+		rdbSave(writer, segment);
+
+		if (fsync(fd) < 0)
+			throw std::runtime_error("fsync failed: " + std::string(strerror(errno)));
+	}
+	catch (...)
+	{
+		close(fd);
+		unlink(path.c_str());
+		throw;
+	}
+	close(fd);
+}
+
+void Server::rdbSaveToFile(const std::string& path)
+{
+	// Readers never see a partial snapshot: write a temp file, fsync, then rename over the old one
+	std::string tempPath = m_mapConfiguration["dir"] + "/temp-" + std::to_string(getpid()) + ".rdb";
+	rdbWriteFile(tempPath, {});
+
+	if (rename(tempPath.c_str(), path.c_str()) < 0)
+	{
+		unlink(tempPath.c_str());
+		throw std::runtime_error("Failed moving the snapshot to " + path + ": " + strerror(errno));
+	}
+}
+
+void Server::rdbSaveSegments()
+{
+	const std::string& dir = m_mapConfiguration["dir"];
+	const std::string& dbfilename = m_mapConfiguration["dbfilename"];
+	const size_t count = m_snapshotSegments;
+
+	std::vector<ManifestSegment> previous;
+	if (modificationTime(rdbManifestPath()) >= 0)
+		previous = readManifest(rdbManifestPath());
+
+	// One thread per segment, each walks its own share of the hash buckets of every table
+	auto tempPath = [&dir](size_t index) { return dir + "/temp-" + std::to_string(getpid()) + "-" + std::to_string(index) + ".rdb"; };
+	std::vector<std::future<void>> writers;
+	for (size_t index = 0; index < count; ++index)
+		writers.push_back(std::async(std::launch::async, [this, index, count, path = tempPath(index)] { rdbWriteFile(path, {index, count}); }));
+
+	std::string error;
+	for (auto& writer : writers)
+	{
+		try
+		{
+			writer.get();
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+		}
+	}
+	if (!error.empty())
+	{
+		for (size_t index = 0; index < count; ++index)
+			unlink(tempPath(index).c_str());
+		throw std::runtime_error(error);
+	}
+
+	// Segments get names unique to this save, the old ones stay valid until the new manifest is in place
+	timeVal now;
+	gettimeofday(&now, NULL);
+	std::string generation = std::to_string(static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000);
+	std::vector<std::string> files;
+
+	try
+	{
+		std::string manifest = "# " + std::to_string(count) + " segment snapshot: segment <file> <bytes> <keys> <strings>\n";
+		for (size_t index = 0; index < count; ++index)
+		{
+			std::string file = dbfilename + "." + generation + "-" + std::to_string(index) + ".seg";
+			struct stat st;
+			if (stat(tempPath(index).c_str(), &st) < 0 || rename(tempPath(index).c_str(), (dir + "/" + file).c_str()) < 0)
+				throw std::runtime_error("Failed moving snapshot segment " + std::to_string(index) + " in place: " + strerror(errno));
+			files.push_back(file);
+
+			// Keys of all types per segment are estimated from the even hash split; string keys are exact when
+			// segments are the partitions, they size the tables on load
+			manifest += "segment " + file + " " + std::to_string(st.st_size) + " " + std::to_string(keyCount() / count) + " "
+				+ std::to_string(m_kvStore.KeyCount({index, count})) + "\n";
+		}
+
+		std::string manifestTemp = dir + "/temp-" + std::to_string(getpid()) + ".manifest";
+		int fd = open(manifestTemp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		bool written = fd >= 0 && write(fd, manifest.data(), manifest.size()) == static_cast<ssize_t>(manifest.size()) && fsync(fd) == 0;
+		std::string reason = strerror(errno);
+		if (fd >= 0)
+			close(fd);
+		if (!written || rename(manifestTemp.c_str(), rdbManifestPath().c_str()) < 0)
+		{
+			unlink(manifestTemp.c_str());
+			throw std::runtime_error("Failed writing the snapshot manifest: " + (written ? std::string(strerror(errno)) : reason));
+		}
+	}
+	catch (...)
+	{
+		for (size_t index = 0; index < count; ++index)
+			unlink(tempPath(index).c_str());
+		for (const auto& file : files)
+			unlink((dir + "/" + file).c_str());
+		throw;
+	}
+
+	for (const auto& segment : previous)
+	{
+		if (segment.file.find("." + generation + "-") == std::string::npos)
+			unlink((dir + "/" + segment.file).c_str());
+	}
+}
+
+void Server::rdbRemoveTempFiles(pid_t pid)
+{
+	std::string prefix = m_mapConfiguration["dir"] + "/temp-" + std::to_string(pid);
+	unlink((prefix + ".rdb").c_str());
+	unlink((prefix + ".manifest").c_str());
+	for (size_t index = 0; index < m_snapshotSegments; ++index)
+		unlink((prefix + "-" + std::to_string(index) + ".rdb").c_str());
+}
+
+void Server::saveSnapshot()
+{
+	if (m_snapshotSegments > 1)
+		rdbSaveSegments();
+	else
+		rdbSaveToFile(rdbFilePath());
+}
+
+namespace
+{
+	// Memory the snapshot child had to copy because the parent kept writing (or the child itself touched)
+	uint64_t childCopyOnWriteBytes()
+	{
+		std::ifstream smaps("/proc/self/smaps_rollup");
+		std::string line;
+		uint64_t bytes = 0;
+		while (std::getline(smaps, line))
+		{
+			if (line.starts_with("Private_Dirty:"))
+				bytes += std::stoull(line.substr(line.find_first_of("0123456789"))) * 1024;
+		}
+		return bytes;
+	}
+}
+
+bool Server::startBackgroundSave(std::string& error)
+{
+	if (m_rdbChildPid != -1)
+	{
+		error = "Background save already in progress";
+		return false;
+	}
+	if (m_aofChildPid != -1)
+	{
+		error = "Background append only file rewriting in progress";
+		return false;
+	}
+	if (m_replChildPid != -1)
+	{
+		error = "Background save already in progress";
+		return false;
+	}
+
+	int infoPipe[2];
+	if (pipe(infoPipe) < 0)
+	{
+		error = "Can't create the child info pipe: " + std::string(strerror(errno));
+		return false;
+	}
+
+	m_lastBgsaveTry = time(nullptr);
+
+	// The child gets a copy-on-write view of the dataset as it is right now. Lists are also modified by
+	// BLPOP threads, hold their lock across fork() so the child never sees one half way through a change
+	auto listsLock = m_listHandler.LockLists();
+	pid_t pid = fork();
+	listsLock.unlock();
+
+	if (pid == 0)
+	{
+		// Child: only the forking thread exists here, so no logging (stdout's lock may be held) and no signal handling
+		std::signal(SIGINT, SIG_DFL);
+		std::signal(SIGTERM, SIG_DFL);
+		close(infoPipe[0]);
+
+		uint64_t info[2]{0, 0}; /* status, copy-on-write bytes */
+		try
+		{
+			saveSnapshot();
+		}
+		catch (...)
+		{
+			info[0] = 1;
+		}
+		info[1] = childCopyOnWriteBytes();
+
+		write(infoPipe[1], info, sizeof(info));
+		_exit(info[0]);
+	}
+
+	close(infoPipe[1]);
+	if (pid < 0)
+	{
+		close(infoPipe[0]);
+		m_rdbLastBgsaveOk = false;
+		error = "Can't fork for the background save: " + std::string(strerror(errno));
+		return false;
+	}
+
+	m_rdbChildPid = pid;
+	m_rdbChildInfoPipe = infoPipe[0];
+	m_rdbSaveTimeStart = time(nullptr);
+	m_dirtyBeforeBgsave = m_dirty;
+
+	std::cout << "Background saving started by pid " << pid << std::endl;
+	return true;
+}
+
+void Server::checkBackgroundSave()
+{
+	if (m_rdbChildPid == -1)
+		return;
+
+	int status = 0;
+	pid_t done = waitpid(m_rdbChildPid, &status, WNOHANG);
+	if (done == 0)
+		return; // still saving
+
+	uint64_t info[2]{1, 0};
+	bool gotInfo = read(m_rdbChildInfoPipe, info, sizeof(info)) == sizeof(info);
+	close(m_rdbChildInfoPipe);
+
+	bool ok = done == m_rdbChildPid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && gotInfo && info[0] == 0;
+	if (ok)
+	{
+		m_dirty -= m_dirtyBeforeBgsave; // writes that came in while saving are still unsaved
+		m_lastSave = time(nullptr);
+		++m_rdbSaves;
+		std::cout << "Background saving terminated with success" << std::endl;
+	}
+	else
+	{
+		rdbRemoveTempFiles(m_rdbChildPid);
+		std::cout << "Background saving error" << std::endl;
+	}
+
+	m_rdbLastBgsaveOk = ok;
+	m_rdbLastCowSize = info[1];
+	m_rdbLastBgsaveTime = time(nullptr) - m_rdbSaveTimeStart;
+	m_rdbSaveTimeStart = -1;
+	m_rdbChildInfoPipe = -1;
+	m_rdbChildPid = -1;
+}
+
+void Server::serverCron()
+{
+	replicationCron();
+	checkBackgroundSave();
+	checkAofRewrite();
+	checkReplicationSync();
+	// Children keep their own mappings of the segments, spilling needn't wait for them
+	m_streamHandler.SpillColdNodes();
+	if (m_rdbChildPid != -1 || m_aofChildPid != -1 || m_replChildPid != -1)
+		return;
+
+	// Replicas waiting for a snapshot come first, the delay lets more of them share it
+	time_t now = time(nullptr);
+	for (const auto& [fd, sync] : m_replicaSyncs)
+	{
+		if (sync.state == ReplicaSyncState::WAIT_BGSAVE_START && now - sync.queuedAt >= m_replDisklessSyncDelay)
+		{
+			if (startReplicationSync())
+				return;
+			break;
+		}
+	}
+
+	if (m_aof.Enabled())
+	{
+		// BGREWRITEAOF that had to wait for a snapshot child, or the AOF grew enough since the last rewrite
+		uint64_t size = m_aof.CurrentSize(), lastSize = std::max<uint64_t>(m_aof.SizeAfterLastRewrite(), 1);
+		bool grown = m_aofRewritePercentage > 0 && size >= m_aofRewriteMinSize && (size - std::min(size, lastSize)) * 100 / lastSize >= m_aofRewritePercentage;
+		if (m_aofRewriteScheduled || grown)
+		{
+			if (grown && !m_aofRewriteScheduled)
+				std::cout << "Starting automatic rewriting of AOF on " << (size - std::min(size, lastSize)) * 100 / lastSize << "% growth" << std::endl;
+
+			std::string error;
+			if (!startAofRewrite(error))
+				std::cout << error << std::endl;
+			return;
+		}
+	}
+
+	for (const auto& [seconds, changes] : m_saveParams)
+	{
+		// After a failed attempt wait a bit before trying again
+		if (m_dirty >= changes && now - m_lastSave >= seconds
+			&& (m_rdbLastBgsaveOk || now - m_lastBgsaveTry >= BGSAVE_RETRY_DELAY))
+		{
+			std::cout << changes << " changes in " << seconds << " seconds. Saving..." << std::endl;
+			std::string error;
+			if (!startBackgroundSave(error))
+				std::cout << error << std::endl;
+			break;
+		}
+	}
+}
+
+void Server::aofOpen()
+{
+	if (!m_aof.Files().empty())
+	{
+		aofLoad();
+	}
+	else
+	{
+		// First start with the AOF on: whatever the snapshot holds becomes the base, written before any append
+		rdbLoadSnapshot();
+		std::string tempPath = m_aof.TempBasePath(getpid());
+		rdbWriteFile(tempPath, {});
+		m_aof.FinishRewrite(tempPath);
+		std::cout << "Created AOF base from the loaded dataset (" << keyCount() << " keys)" << std::endl;
+	}
+
+	m_aof.StartAppending();
+}
+
+void Server::aofLoad()
+{
+	auto startTime = std::chrono::steady_clock::now();
+	const auto& files = m_aof.Files();
+	uint64_t commands = 0, failed = 0;
+	std::vector<std::string> args;
+
+	for (size_t index = 0; index < files.size(); ++index)
+	{
+		std::string path = m_aof.PathOf(files[index].name);
+		if (files[index].type == 'b' && path.ends_with(".rdb"))
+		{
+			rdbLoad(path);
+			continue;
+		}
+
+		// The whole file is mapped and parsed in place, commands go straight to their handlers:
+		// no transaction or subscription state, logging, replies or propagation on this path
+		AofReader reader(path);
+		while (reader.Next(args))
+		{
+			auto result{executeCommand(std::make_unique<std::vector<std::string>>(std::move(args)), -1)};
+			m_streamHandler.TakeEffects(); // the log has them already, they are what is being replayed
+			if (result.starts_with('-'))
+				++failed;
+			++commands;
+		}
+
+		if (reader.Truncated())
+		{
+			// Only the tail can be cut short (crash during a write), drop the partial command like aof-load-truncated
+			if (index + 1 != files.size())
+				throw std::runtime_error("AOF file " + path + " is truncated, can't continue loading");
+			if (truncate(path.c_str(), reader.ValidBytes()) < 0)
+				throw std::runtime_error("Failed truncating " + path + ": " + strerror(errno));
+			std::cout << "!!! Warning: short read while loading the AOF " << path << ", dropped the partial command at offset " << reader.ValidBytes() << std::endl;
+		}
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+	std::cout << "AOF loaded: " << commands << " commands replayed from " << files.size() << " files (" << failed << " failed) in "
+		<< elapsed.count() << " seconds" << std::endl;
+}
+
+void Server::propagateWrite(std::vector<std::string> args, const std::string& result)
+{
+	if (result.starts_with('-') || result == NO_REPLY)
+		return; // rejected or blocked, nothing changed
+
+	const std::string& cmd = args[0];
+	if (cmd == SET && args.size() == 5 && toLower(args[3]) == "px")
+	{
+		// A relative expiry would restart on every replay
+		auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		args[3] = "PXAT";
+		args[4] = std::to_string(nowMs + std::stoll(args[4]));
+	}
+	else if (cmd == XADD || cmd == XTRIM)
+	{
+		m_streamHandler.RewriteForLog(args, result);
+	}
+	else if (cmd == TS_ADD && args.size() > 2 && args[2] == "*" && result.starts_with(':'))
+	{
+		args[2] = result.substr(1, result.size() - 3);
+	}
+	else if (cmd == TS_MADD)
+	{
+		// One reply line per sample, the timestamp or an error
+		std::istringstream replies(result.substr(result.find('\n') + 1));
+		std::string reply;
+		for (size_t index = 2; index < args.size() && std::getline(replies, reply); index += 3)
+		{
+			if (args[index] == "*" && reply.starts_with(':'))
+				args[index] = reply.substr(1, reply.size() - 2);
+		}
+	}
+
+	propagateCommand(args);
+}
+
+void Server::propagateCommand(const std::vector<std::string>& args)
+{
+	// Encoded once: the AOF, the backlog and the replicas all replay the same bytes
+	std::string encoded = RESPEncoder::encodeArray(args);
+	if (m_aof.Enabled())
+		m_aof.Feed(encoded);
+	// A replica's own replicas get its master's stream, passed on in HandleConnection
+	if (getReplicationRole() == "master")
+		PropogateCommandToReplicas(encoded);
+	++m_dirty;
+}
+
+void Server::aofFlush()
+{
+	if (!m_aof.Flush())
+		std::cout << "Error writing to the AOF: " << strerror(errno) << std::endl;
+
+	// appendfsync always: the fsync that just happened covers every write these replies acknowledge
+	if (!m_aof.HasPendingWrites())
+	{
+		for (const auto& [fd, reply] : m_pendingReplies)
+			send(fd, reply.c_str(), reply.length(), 0);
+		m_pendingReplies.clear();
+	}
+}
+
+bool Server::startAofRewrite(std::string& error)
+{
+	if (!m_aof.Enabled())
+	{
+		error = "AOF is turned off (appendonly yes to enable)";
+		return false;
+	}
+	if (m_aofChildPid != -1)
+	{
+		error = "Background append only file rewriting already in progress";
+		return false;
+	}
+	if (m_rdbChildPid != -1 || m_replChildPid != -1)
+	{
+		m_aofRewriteScheduled = true;
+		return true;
+	}
+
+	// Writes from here on land in a new incremental file, the child only has to cover what came before
+	try
+	{
+		m_aof.StartRewrite();
+	}
+	catch (const std::exception& e)
+	{
+		error = e.what();
+		return false;
+	}
+
+	auto listsLock = m_listHandler.LockLists();
+	pid_t pid = fork();
+	listsLock.unlock();
+
+	if (pid == 0)
+	{
+		std::signal(SIGINT, SIG_DFL);
+		std::signal(SIGTERM, SIG_DFL);
+
+		int status = 0;
+		try
+		{
+			rdbWriteFile(m_aof.TempBasePath(getpid()), {});
+		}
+		catch (...)
+		{
+			status = 1;
+		}
+		_exit(status);
+	}
+
+	if (pid < 0)
+	{
+		m_aofLastRewriteOk = false;
+		error = "Can't fork for the AOF rewrite: " + std::string(strerror(errno));
+		return false;
+	}
+
+	m_aofChildPid = pid;
+	m_aofRewriteScheduled = false;
+	m_aofRewriteTimeStart = time(nullptr);
+
+	std::cout << "Background append only file rewriting started by pid " << pid << std::endl;
+	return true;
+}
+
+void Server::checkAofRewrite()
+{
+	if (m_aofChildPid == -1)
+		return;
+
+	int status = 0;
+	pid_t done = waitpid(m_aofChildPid, &status, WNOHANG);
+	if (done == 0)
+		return;
+
+	std::string tempPath = m_aof.TempBasePath(m_aofChildPid);
+	bool ok = done == m_aofChildPid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	if (ok)
+	{
+		try
+		{
+			m_aof.FinishRewrite(tempPath);
+			++m_aofRewrites;
+			std::cout << "Background AOF rewrite finished successfully" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			ok = false;
+			std::cout << "Background AOF rewrite failed: " << e.what() << std::endl;
+		}
+	}
+	else
+	{
+		// The manifest still lists the old base and every incremental file, nothing was lost
+		unlink(tempPath.c_str());
+		std::cout << "Background AOF rewrite terminated with error" << std::endl;
+	}
+
+	m_aofLastRewriteOk = ok;
+	m_aofRewriteTimeStart = -1;
+	m_aofChildPid = -1;
+}
+
+void Server::signalHandler(int signal)
+{
+    std::cout << "\nReceived signal " << signal << ". Initiating graceful shutdown..." << std::endl;
+    sendShutdownSignal();
+}
+
+
+void Server::sendShutdownSignal()
+{
+    if (signalPipe[1] != -1)
+	{
+        char shutdownMsg = 'Q'; // 'Q' for quit
+        ssize_t result = write(signalPipe[1], &shutdownMsg, 1);
+        if (result == -1)
+		{
+            // Don't use std::cerr in signal handler (not async-signal-safe)
+            // Just ignore the error or use write() to stderr directly
+            std::string msg = "Failed to write to signal pipe\n";
+            write(STDERR_FILENO, msg.c_str(), msg.length());
+        }
+    }
+}
+
+void Server::setupSignalHandling()
+{
+	// Create a pipe for signal communication
+	if (pipe(signalPipe) == -1)
+	{
+		throw std::runtime_error("Failed to create signal pipe: " + std::string(strerror(errno)));
+	}
+
+	// Make the write end non-blocking
+	int flags = fcntl(signalPipe[1], F_GETFL);
+	if (flags == -1 || fcntl(signalPipe[1], F_SETFL, flags | O_NONBLOCK) == -1)
+	{
+		throw std::runtime_error("Failed to set pipe non-blocking: " + std::string(strerror(errno)));
+	}
+
+	// Set up signal handlers
+	std::signal(SIGINT, signalHandler);	 // Ctrl+C
+	std::signal(SIGTERM, signalHandler); // Termination request
+
+	std::cout << "Signal handling setup complete.." << std::endl;
+}
+
+void Server::cleanup()
+{
+	std::cout << "Performing cleanup..." << std::endl;
+
+	// Whatever the AOF buffer still holds reaches the disk before the connections go
+	aofFlush();
+	if (m_aofChildPid != -1)
+	{
+		kill(m_aofChildPid, SIGKILL);
+		waitpid(m_aofChildPid, nullptr, 0);
+		unlink(m_aof.TempBasePath(m_aofChildPid).c_str());
+		m_aofChildPid = -1;
+	}
+	m_aof.Close();
+
+	if (m_replChildPid != -1)
+	{
+		kill(m_replChildPid, SIGKILL);
+		waitpid(m_replChildPid, nullptr, 0);
+		unlink(replicationTempFile(m_mapConfiguration["dir"], m_replChildPid).c_str());
+		m_replChildPid = -1;
+	}
+	if (m_replSnapshotPipe != -1)
+	{
+		close(m_replSnapshotPipe);
+		m_replSnapshotPipe = -1;
+	}
+
+	// Close all client connections
+	for (int fd = 0; fd < FD_SETSIZE; ++fd)
+	{
+		if (fd != m_dServerFd && fd != m_dMasterConnSocket &&
+			fd != signalPipe[0] && fd != signalPipe[1])
+		{
+			if (fd > 2)
+			{ // Don't close stdin/stdout/stderr
+				close(fd);
+			}
+		}
+	}
+
+	// Cancel all blocking operations
+	// Add these methods when you implement cancellation
+	// m_listHandler.cancelAllBlockingOperations();
+	// m_streamHandler.cancelAllBlockingOperations();
+
+	// Close master connection if slave
+	replicationDropMaster();
+
+	// A background save still running would race with the final one
+	if (m_rdbChildPid != -1)
+	{
+		kill(m_rdbChildPid, SIGKILL);
+		waitpid(m_rdbChildPid, nullptr, 0);
+		rdbRemoveTempFiles(m_rdbChildPid);
+		close(m_rdbChildInfoPipe);
+		m_rdbChildPid = -1;
+	}
+
+	// Save state if needed (like Redis: only when save points are configured)
+	if (m_bEventLoopStarted && !m_saveParams.empty())
+	{
+		try
+		{
+			saveSnapshot();
+			std::cout << "State preservation complete" << std::endl;
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Warning: Failed to save state: " << e.what() << std::endl;
+		}
+	}
 
 	std::cout << "Cleanup complete" << std::endl;
 }
@@ -7,12 +7,27 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <ctime>
+#include <future>
+#include <sys/types.h>
 
 #include "KeyValueStore.h"
 #include "StreamHandler.h"
 #include "TransactionHandler.h"
 #include "ListHandler.h"
 #include "SubscriptionHandler.h"
+#include "FilterHandler.h"
+#include "SketchHandler.h"
+#include "TimeSeriesHandler.h"
+#include "VectorHandler.h"
+#include "GeoHandler.h"
+#include "HashHandler.h"
+#include "SearchHandler.h"
+#include "JsonHandler.h"
+#include "Rdb.h"
+#include "Aof.h"
+#include "ReplicationBacklog.h"
+#include "ReplicationBuffer.h"
 
 class Server
 {
@@ -31,10 +46,18 @@ private:
 
 	
 	std::string HandleCommand(std::unique_ptr<std::vector<std::string>> ptrArray, const int clientFd /* Replication purposes */);
+	std::string executeCommand(std::unique_ptr<std::vector<std::string>> ptrArray, const int clientFd);
 	std::string getReplicationRole();
 	void initializeSlave();
+	void replicationConnect(); /* initializeSlave, a failure is retried from serverCron */
 	void PropogateCommandToReplicas(const std::string& userCmd);
-	bool shouldPropogateCommand(const std::string& userCmd);
+	void propagateWrite(std::vector<std::string> args, const std::string& result); /* as replayable: generated IDs, timestamps and expiries made absolute */
+	void propagateCommand(const std::vector<std::string>& args); /* to the AOF, the backlog and the replicas */
+	void replicationFlush(); /* once per event loop iteration, non-blocking */
+	bool sendToReplica(const int fd, const char* data, size_t length); /* queued on its link, false if the connection failed */
+	void dropReplica(const int fd);
+	void replicationDropReplicas(); /* they reconnect and PSYNC, e.g. to pick up a new replication ID */
+	std::string replicaRefuseCommand(const std::string& userCmd, const int clientFd); /* "" if a replica serves it to this client */
 	bool shouldRespondBack(const std::string& status, const int fd, std::vector<std::string>& args);
 
 	void sendData(const int fd, const std::vector<std::string>& vec);
@@ -46,6 +69,105 @@ private:
     static void signalHandler(int signal);
     static void sendShutdownSignal();
 
+	// RDB persistence
+	struct KeyspaceRefs /* where loaded keys go: the live tables or a staging Keyspace */
+	{
+		KeyValueStore& kvStore;
+		ListHandler& listHandler;
+		StreamHandler& streamHandler;
+		FilterHandler& filterHandler;
+		SketchHandler& sketchHandler;
+		TimeSeriesHandler& timeSeriesHandler;
+		VectorHandler& vectorHandler;
+		GeoHandler& geoHandler;
+		HashHandler& hashHandler;
+		JsonHandler& jsonHandler;
+	};
+
+	struct Keyspace /* tables a snapshot segment or a full sync is loaded into on its own thread before going live */
+	{
+		KeyValueStore kvStore;
+		ListHandler listHandler;
+		StreamHandler streamHandler;
+		FilterHandler filterHandler;
+		SketchHandler sketchHandler;
+		TimeSeriesHandler timeSeriesHandler;
+		VectorHandler vectorHandler;
+		GeoHandler geoHandler;
+		HashHandler hashHandler;
+		JsonHandler jsonHandler;
+
+		KeyspaceRefs Refs() { return {kvStore, listHandler, streamHandler, filterHandler, sketchHandler, timeSeriesHandler, vectorHandler, geoHandler, hashHandler, jsonHandler}; }
+	};
+
+	struct RdbLoadResult
+	{
+		uint64_t loaded{};
+		uint64_t expired{};
+		uint64_t skipped{};
+		std::vector<std::string> indexDefinitions;
+	};
+
+	struct ReplicaLoad /* the master's answer to PSYNC: a full sync payload, loaded next to the live dataset, or +CONTINUE */
+	{
+		bool partial{false};
+		std::string replId;
+		int64_t offset{};
+		Keyspace keyspace;
+		SearchHandler searchHandler;
+		RdbLoadResult result;
+		double seconds{};
+		int streamFd{-1}; /* compressed link: the decoded stream to read instead of the master socket */
+	};
+
+	std::string rdbFilePath();
+	std::string rdbManifestPath();
+	KeyspaceRefs liveKeyspace();
+	size_t keyCount();
+	void rdbSave(RdbWriter& writer, const RdbSegment& segment = {});
+	static RdbLoadResult rdbLoadKeys(RdbReader& reader, const KeyspaceRefs& keyspace, bool presized = false); /* presized: the RESIZEDB hint is ignored */
+	void rdbLoad(const std::string& path);
+	void rdbLoadSegments(const std::string& manifestPath);
+	void rdbLoadSnapshot(); /* the newer of the RDB file and the segment manifest, if any */
+	static std::unique_ptr<ReplicaLoad> replicaSync(int masterFd);
+	static void replicationDecodeLink(int linkFd, int streamFd); /* thread: master frames -> stream, ACKs -> master */
+	void checkReplicaLoad(); /* swaps in a full sync once it finished loading */
+	void rdbSaveToFile(const std::string& path); /* writes a temp file and renames it, throws on failure */
+	void rdbSaveSegments(); /* segment files written in parallel, then the manifest is replaced */
+	void rdbWriteFile(const std::string& path, const RdbSegment& segment);
+	void rdbRemoveTempFiles(pid_t pid);
+	void saveSnapshot(); /* in the configured format */
+	bool startBackgroundSave(std::string& error);
+	void checkBackgroundSave();
+	void serverCron();
+
+	// Full resynchronization of replicas
+	void replicationQueueFullSync(const int fd); /* after FULLRESYNC, the snapshot follows once a child produces it */
+	bool startReplicationSync();
+	void replicationForwardSnapshot(); /* diskless: pipe from the child -> every replica of the sync */
+	bool replicationSnapshotDrained() const; /* diskless: every replica of the sync took the last chunk */
+	bool replicationSendSnapshotFile(const int fd); /* disk based: the next parts of the file, false if the connection failed */
+	void checkReplicationSync();
+	void replicationPutOnline(const int fd); /* sends what was buffered during the transfer */
+	void replicationAck(const int fd, int64_t offset);
+	size_t replicasAcked(int64_t offset); /* online replicas that acknowledged at least offset */
+	void replicationProcessWaiting(); /* replies to parked WAITs that are satisfied or timed out */
+	void replicationCron(); /* replica side: reconnects and periodic ACKs */
+	bool replicationTryPartialSync(const int fd, const std::string& replId, const std::string& offset);
+	void replicationShiftReplId(); /* new history from here, the old ID stays valid for PSYNC up to this point */
+	void replicationDropMaster();
+	void replicationSetMaster(const std::string& host, const std::string& port); /* "no" "one" promotes to master */
+	void replicationHeartbeat(int64_t masterTimeMs); /* replica side: a heartbeat of the master was applied */
+	int64_t replicationLagMs(); /* replica side: how much older than the master's the data may be, -1 if unknown */
+	int64_t replicationLagBytes(); /* replica side: received from the master but not applied yet, -1 if the link is down */
+
+	// AOF persistence
+	void aofOpen(); /* loads the dataset from the AOF, creating one from the snapshot if there is none yet */
+	void aofLoad();
+	void aofFlush(); /* once per event loop iteration, sends the replies that waited for it */
+	bool startAofRewrite(std::string& error);
+	void checkAofRewrite();
+
 private: /* variables */
 
 	KeyValueStore m_kvStore;
@@ -53,6 +175,14 @@ private: /* variables */
 	TransactionHandler m_transactionHandler;
 	ListHandler m_listHandler;
 	SubscriptionHandler m_subscriptionHandler;
+	FilterHandler m_filterHandler;
+	SketchHandler m_sketchHandler;
+	TimeSeriesHandler m_timeSeriesHandler;
+	VectorHandler m_vectorHandler;
+	GeoHandler m_geoHandler;
+	HashHandler m_hashHandler;
+	SearchHandler m_searchHandler;
+	JsonHandler m_jsonHandler;
 
 	std::unordered_map<std::string, std::string> m_mapConfiguration;
 	std::map<std::string, int> m_mapReplicaPortSocket;
@@ -61,6 +191,103 @@ private: /* variables */
 	int m_dMasterConnSocket{-1};
 	int m_dConnBacklog{10};
 
+	// RDB persistence state
+	static constexpr int BGSAVE_RETRY_DELAY = 5; /* seconds between automatic attempts after a failed BGSAVE */
+	std::vector<std::pair<time_t, uint64_t>> m_saveParams; /* save <seconds> <changes> */
+	uint64_t m_dirty{}; /* write commands since the last successful save */
+	uint64_t m_dirtyBeforeBgsave{};
+	time_t m_lastSave{};
+	time_t m_lastBgsaveTry{};
+	pid_t m_rdbChildPid{-1};
+	int m_rdbChildInfoPipe{-1};
+	size_t m_snapshotSegments{1}; /* --snapshot-segments: more than 1 saves a segmented snapshot */
+	time_t m_rdbSaveTimeStart{-1};
+	time_t m_rdbLastBgsaveTime{-1};
+	bool m_rdbLastBgsaveOk{true};
+	uint64_t m_rdbLastCowSize{};
+	uint64_t m_rdbSaves{};
+	// Replicas going through a full resynchronization, not sent the command stream yet
+	enum class ReplicaSyncState
+	{
+		HANDSHAKE,         /* REPLCONF seen, no PSYNC yet */
+		WAIT_BGSAVE_START, /* waits for the next snapshot child */
+		WAIT_BGSAVE_END,   /* snapshot being produced / streamed, writes are buffered from the fork on */
+		SEND_FILE,         /* disk based: the snapshot file goes out as the replica takes it */
+		WAIT_ACK           /* diskless payload sent, online once the replica ACKs it was loaded */
+	};
+
+	struct ReplicaSync
+	{
+		ReplicaSyncState state{ReplicaSyncState::HANDSHAKE};
+		time_t queuedAt{};
+		bool lz4{false}; /* announced REPLCONF capa lz4: all that follows the PSYNC reply is LZ4 framed */
+		int rdbFd{-1}; /* SEND_FILE: the snapshot file, read from rdbOffset on each time the link's output drained */
+		off_t rdbOffset{};
+		off_t rdbSize{};
+	};
+
+	std::map<int, ReplicaSync> m_replicaSyncs; /* replica fd -> sync in progress */
+	ReplicationBuffer m_replStream; /* command stream not sent yet, shared by the replicas */
+	struct ReplicaLink /* a replica getting the command stream, online or once its full sync is done */
+	{
+		ReplicationBuffer::Cursor cursor{}; /* its position in m_replStream */
+		int64_t ackOffset{}; /* replication offset it last acknowledged */
+		time_t ackTime{};
+		bool lz4{false};
+		std::string frames{}; /* compressed link: frames cut from the stream, sent from framesSent on */
+		size_t framesSent{};
+		std::string output{}; /* ahead of the stream: PSYNC reply, snapshot or backlog, sent from outputSent on */
+		size_t outputSent{};
+	};
+	std::map<int, ReplicaLink> m_replicaLinks; /* replica fd -> link */
+
+	struct WaitingClient /* WAIT parked until enough replicas acknowledged 'offset' */
+	{
+		int fd;
+		int64_t offset;
+		size_t replicas;
+		std::chrono::steady_clock::time_point deadline;
+	};
+	std::vector<WaitingClient> m_waitingClients;
+	bool m_replGetAckPending{false}; /* a WAIT was parked this iteration, replicas are asked for an ACK once */
+	time_t m_replLastAckSent{}; /* replica side: ACKs go to the master every second */
+	uint64_t m_replOutputLimit{256ull << 20}; /* --repl-output-buffer-limit: replicas further behind are dropped */
+	ReplicationBacklog m_replBacklog; /* tail of the replication stream, its offset is the replication offset */
+	std::string m_replId;
+	std::string m_replId2{std::string(40, '0')}; /* history this one continues, a former master's */
+	int64_t m_secondReplIdOffset{-1}; /* m_replId2 is valid for PSYNC up to this offset */
+	bool m_replCachedMaster{false}; /* m_replId and the offset describe a master's history: reconnects try PSYNC */
+	std::future<std::unique_ptr<ReplicaLoad>> m_replicaLoad; /* replica side: payload being loaded off the master socket */
+	time_t m_replLastConnectTry{};
+	int64_t m_replLastHeartbeatSent{}; /* master side: the stream gets a heartbeat every second */
+	int64_t m_replHeartbeatMs{}; /* replica side: master clock in the last heartbeat applied, 0 if none since the sync */
+	int64_t m_replHeartbeatSeenMs{}; /* our clock when it was applied */
+	struct ReadBounds /* set with READONLY, reads on a replica further behind are refused */
+	{
+		int64_t maxLagMs{-1};
+		int64_t maxLagBytes{-1};
+	};
+	std::unordered_map<int, ReadBounds> m_readBounds; /* client fd -> bounds */
+	bool m_replCompression{false}; /* --repl-compression lz4: replica side, asks the master for a compressed link */
+	bool m_replDisklessSync{true};  /* --repl-diskless-sync: stream the snapshot, no file on the master's disk */
+	time_t m_replDisklessSyncDelay{}; /* --repl-diskless-sync-delay: wait for more replicas to share one snapshot */
+	pid_t m_replChildPid{-1};
+	int m_replSnapshotPipe{-1};
+	std::string m_replEofMark;
+
+	// AOF persistence state
+	AppendOnlyFile m_aof;
+	pid_t m_aofChildPid{-1};
+	bool m_aofRewriteScheduled{false}; /* BGREWRITEAOF asked for while a snapshot child was running */
+	time_t m_aofRewriteTimeStart{-1};
+	bool m_aofLastRewriteOk{true};
+	uint64_t m_aofRewrites{};
+	uint64_t m_aofRewritePercentage{100}; /* automatic rewrite once the AOF grew this much since the last one */
+	uint64_t m_aofRewriteMinSize{64 * 1024 * 1024};
+	std::vector<std::pair<int, std::string>> m_pendingReplies; /* appendfsync always: held until the write is fsynced */
+
+	bool m_bEventLoopStarted{false}; /* no save on shutdown if the dataset never finished loading */
+
 	// Signal handling pipe
     static int signalPipe[2];  // Self-pipe for signal handling
 
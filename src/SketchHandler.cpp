@@ -0,0 +1,280 @@
+
+#include <iostream>
+#include <stdexcept>
+#include <new>
+
+#include "SketchHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+namespace
+{
+    // Widths and counts past 32 bits would otherwise wrap into small valid ones
+    uint32_t toUint32(const std::string &arg)
+    {
+        unsigned long value = std::stoul(arg);
+        if (value > UINT32_MAX)
+            throw std::out_of_range(arg);
+        return static_cast<uint32_t>(value);
+    }
+}
+
+std::string SketchHandler::SketchCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == CMS_INITBYDIM || command == CMS_INITBYPROB)
+            return cmsInitHandler(std::move(commandArgs));
+        else if (command == CMS_INCRBY)
+            return cmsIncrByHandler(std::move(commandArgs));
+        else if (command == CMS_QUERY)
+            return cmsQueryHandler(std::move(commandArgs));
+        else if (command == CMS_INFO)
+            return cmsInfoHandler(std::move(commandArgs));
+        else if (command == TOPK_RESERVE)
+            return topkReserveHandler(std::move(commandArgs));
+        else if (command == TOPK_ADD || command == TOPK_INCRBY)
+            return topkAddHandler(std::move(commandArgs));
+        else if (command == TOPK_QUERY || command == TOPK_COUNT)
+            return topkQueryHandler(std::move(commandArgs));
+        else if (command == TOPK_LIST)
+            return topkListHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+    catch (const std::length_error &e)
+    {
+        return RESPEncoder::encodeError("sketch too large");
+    }
+    catch (const std::bad_alloc &e)
+    {
+        return RESPEncoder::encodeError("not enough memory for the sketch");
+    }
+
+    return RESPEncoder::encodeError("Unsupported sketch command");
+}
+
+// CMS.INITBYDIM key width depth | CMS.INITBYPROB key error probability
+std::string SketchHandler::cmsInitHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 4)
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    const std::string &key = (*commandArgs)[1];
+    if (IsCountMinSketchPresent(key))
+        return RESPEncoder::encodeError("CMS: key already exists");
+
+    if ((*commandArgs)[0] == CMS_INITBYDIM)
+        m_countMinSketches[key] = std::make_unique<CountMinSketch>(toUint32((*commandArgs)[2]), toUint32((*commandArgs)[3]));
+    else
+        m_countMinSketches[key] = CountMinSketch::FromErrorRate(std::stod((*commandArgs)[2]), std::stod((*commandArgs)[3]));
+
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// CMS.INCRBY key item increment [item increment ...]
+std::string SketchHandler::cmsIncrByHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4 || commandArgs->size() % 2 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cms.incrby' command");
+
+    auto it = m_countMinSketches.find((*commandArgs)[1]);
+    if (it == m_countMinSketches.end())
+        return RESPEncoder::encodeError("CMS: key does not exist");
+
+    // Validate all increments first so a bad argument doesn't leave a partial update behind
+    std::vector<uint32_t> increments;
+    for (size_t i = 3; i < commandArgs->size(); i += 2)
+    {
+        unsigned long increment = std::stoul((*commandArgs)[i]);
+        if (increment > UINT32_MAX)
+            return RESPEncoder::encodeError("CMS: Cannot parse number");
+        increments.push_back(increment);
+    }
+
+    std::vector<std::string> results;
+    for (size_t i = 2, n = 0; i < commandArgs->size(); i += 2, ++n)
+    {
+        try
+        {
+            results.push_back(RESPEncoder::encodeInteger(it->second->IncrBy((*commandArgs)[i], increments[n])));
+        }
+        catch (const std::overflow_error &e)
+        {
+            results.push_back(RESPEncoder::encodeError(e.what()));
+        }
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// CMS.QUERY key item [item ...]
+std::string SketchHandler::cmsQueryHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cms.query' command");
+
+    auto it = m_countMinSketches.find((*commandArgs)[1]);
+    if (it == m_countMinSketches.end())
+        return RESPEncoder::encodeError("CMS: key does not exist");
+
+    std::vector<std::string> results;
+    for (auto item = commandArgs->begin() + 2; item != commandArgs->end(); ++item)
+        results.push_back(RESPEncoder::encodeInteger(it->second->Query(*item)));
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+std::string SketchHandler::cmsInfoHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'cms.info' command");
+
+    auto it = m_countMinSketches.find((*commandArgs)[1]);
+    if (it == m_countMinSketches.end())
+        return RESPEncoder::encodeError("CMS: key does not exist");
+
+    return RESPEncoder::encodeArray({RESPEncoder::encodeString("width"), RESPEncoder::encodeInteger(it->second->Width()),
+                                     RESPEncoder::encodeString("depth"), RESPEncoder::encodeInteger(it->second->Depth()),
+                                     RESPEncoder::encodeString("count"), RESPEncoder::encodeInteger(it->second->TotalCount())},
+                                    true);
+}
+
+// TOPK.RESERVE key k [width depth decay]
+std::string SketchHandler::topkReserveHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3 && commandArgs->size() != 6)
+        return RESPEncoder::encodeError("wrong number of arguments for 'topk.reserve' command");
+
+    const std::string &key = (*commandArgs)[1];
+    if (IsTopKPresent(key))
+        return RESPEncoder::encodeError("TopK: key already exists");
+
+    uint32_t k = toUint32((*commandArgs)[2]);
+    if (commandArgs->size() == 3)
+        m_topKs[key] = std::make_unique<TopK>(k);
+    else
+        m_topKs[key] = std::make_unique<TopK>(k, toUint32((*commandArgs)[3]), toUint32((*commandArgs)[4]), std::stod((*commandArgs)[5]));
+
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+// TOPK.ADD key item [item ...] | TOPK.INCRBY key item increment [item increment ...]
+std::string SketchHandler::topkAddHandler(CommandArray commandArgs)
+{
+    bool withIncrement = (*commandArgs)[0] == TOPK_INCRBY;
+    if (commandArgs->size() < 3 || (withIncrement && commandArgs->size() % 2 != 0))
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    auto it = m_topKs.find((*commandArgs)[1]);
+    if (it == m_topKs.end())
+        return RESPEncoder::encodeError("TopK: key does not exist");
+
+    std::vector<uint32_t> increments;
+    for (size_t i = 2; i < commandArgs->size(); i += withIncrement ? 2 : 1)
+    {
+        unsigned long increment = withIncrement ? std::stoul((*commandArgs)[i + 1]) : 1;
+        if (increment == 0 || increment > 100000)
+            return RESPEncoder::encodeError("TopK: increment must be an integer between 1 and 100000");
+        increments.push_back(increment);
+    }
+
+    std::vector<std::string> results;
+    for (size_t i = 2, n = 0; i < commandArgs->size(); i += withIncrement ? 2 : 1, ++n)
+    {
+        auto expelled = it->second->IncrBy((*commandArgs)[i], increments[n]);
+        results.push_back(expelled ? RESPEncoder::encodeString(*expelled) : NULL_BULK_ENCODED);
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// TOPK.QUERY key item [item ...] | TOPK.COUNT key item [item ...]
+std::string SketchHandler::topkQueryHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
+
+    auto it = m_topKs.find((*commandArgs)[1]);
+    if (it == m_topKs.end())
+        return RESPEncoder::encodeError("TopK: key does not exist");
+
+    bool count = (*commandArgs)[0] == TOPK_COUNT;
+    std::vector<std::string> results;
+
+    for (auto item = commandArgs->begin() + 2; item != commandArgs->end(); ++item)
+        results.push_back(RESPEncoder::encodeInteger(count ? it->second->Count(*item) : it->second->Query(*item)));
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// TOPK.LIST key [WITHCOUNT]
+std::string SketchHandler::topkListHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2 && commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'topk.list' command");
+
+    auto it = m_topKs.find((*commandArgs)[1]);
+    if (it == m_topKs.end())
+        return RESPEncoder::encodeError("TopK: key does not exist");
+
+    bool withCount = commandArgs->size() == 3 && toLower((*commandArgs)[2]) == "withcount";
+    std::vector<std::string> results;
+
+    for (const auto &[item, count] : it->second->List())
+    {
+        results.push_back(RESPEncoder::encodeString(item));
+        if (withCount)
+            results.push_back(RESPEncoder::encodeInteger(count));
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+void SketchHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_countMinSketches))
+    {
+        writer.WriteKey(RDB_TYPE_CMS, key);
+        writer.WriteString(value->Serialize());
+    }
+    for (const auto &[key, value] : segment.Of(m_topKs))
+    {
+        writer.WriteKey(RDB_TYPE_TOPK, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void SketchHandler::LoadRdb(RdbReader &reader, uint8_t type, const std::string &key)
+{
+    if (type == RDB_TYPE_CMS)
+        m_countMinSketches[key] = CountMinSketch::Deserialize(reader.ReadString());
+    else
+        m_topKs[key] = TopK::Deserialize(reader.ReadString());
+}
+
+void SketchHandler::MergeFrom(SketchHandler &other)
+{
+    m_countMinSketches.merge(other.m_countMinSketches);
+    m_topKs.merge(other.m_topKs);
+}
+
+void SketchHandler::Swap(SketchHandler &other)
+{
+    m_countMinSketches.swap(other.m_countMinSketches);
+    m_topKs.swap(other.m_topKs);
+}
@@ -0,0 +1,47 @@
+#ifndef SKETCHHANDLER_H
+#define SKETCHHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "CountMinSketch.h"
+#include "TopK.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class SketchHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<CountMinSketch>> m_countMinSketches;
+    std::unordered_map<std::string, std::unique_ptr<TopK>> m_topKs;
+
+    std::string cmsInitHandler(CommandArray commandArgs);
+    std::string cmsIncrByHandler(CommandArray commandArgs);
+    std::string cmsQueryHandler(CommandArray commandArgs);
+    std::string cmsInfoHandler(CommandArray commandArgs);
+
+    std::string topkReserveHandler(CommandArray commandArgs);
+    std::string topkAddHandler(CommandArray commandArgs);
+    std::string topkQueryHandler(CommandArray commandArgs);
+    std::string topkListHandler(CommandArray commandArgs);
+
+public:
+    std::string SketchCommandProcessor(CommandArray commandArgs);
+
+    bool IsCountMinSketchPresent(const std::string &key) const { return m_countMinSketches.contains(key); }
+    bool IsTopKPresent(const std::string &key) const { return m_topKs.contains(key); }
+
+    size_t KeyCount() const { return m_countMinSketches.size() + m_topKs.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(SketchHandler &other);
+    void Swap(SketchHandler &other);
+};
+
+#endif // SKETCHHANDLER_H
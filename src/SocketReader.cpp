@@ -45,29 +45,30 @@ std::string SocketReader::readSimpleString()
 
 std::string SocketReader::readBulkString()
 {
-	try
-	{
-		assert(readByte() == '$'); // for $
-		
-		std::string leng;
-		char c;
-		while ((c = (char)readByte()) != '\r')
-			leng.push_back(c);
+	// EOF part way through is left to ReadArray: the whole command is lost, not just this argument
+	assert(readByte() == '$'); // for $
+	
+	std::string leng;
+	char c;
+	while ((c = (char)readByte()) != '\r')
+		leng.push_back(c);
 
-		int length = std::stoi(leng);
-		readByte(); // for \n 
+	int length = std::stoi(leng);
+	readByte(); // for \n 
 
-		std::vector<char> buffer(length);
-		read(m_fd, buffer.data(), length);
-		readSlashRN();
-		return std::string(buffer.data(), length);
-	}
-	catch(const std::exception& e)
+	// Large values can arrive in several pieces
+	std::string buffer(length, '\0');
+	for (int received = 0; received < length;)
 	{
-		if (std::string_view(e.what()).find("EOF") == std::string_view::npos)
-			throw; // re-throw if not EOF
+		ssize_t n = read(m_fd, buffer.data() + received, length - received);
+		if (n < 0)
+			throw std::runtime_error("read() failed");
+		if (n == 0)
+			throw std::runtime_error("EOF reached");
+		received += n;
 	}
-	return {};
+	readSlashRN();
+	return buffer;
 };
 
 std::vector<std::string> SocketReader::ReadArray()
@@ -101,7 +102,7 @@ std::vector<std::string> SocketReader::ReadArray()
 	return {};
 }
 
-std::string SocketReader::readRDBFile()
+void SocketReader::readRDBHeader(uint64_t& length, std::string& eofMark)
 {
 	assert(readByte() == '$'); // for $
 	
@@ -109,12 +110,12 @@ std::string SocketReader::readRDBFile()
 	char c;
 	while ((c = readByte()) != '\r')
 		leng.push_back(c);
-
-	int length = std::stoi(leng);
 	readByte(); // for \n 
 
-	std::vector<char> buffer(length);
-	read(m_fd, buffer.data(), length);
-
-	return std::string(buffer.data(), length);	
+	length = 0;
+	eofMark.clear();
+	if (leng.starts_with("EOF:"))
+		eofMark = leng.substr(4);
+	else
+		length = std::stoull(leng);
 }
@@ -21,7 +21,8 @@ public:
 	std::string readBulkString();
 	std::vector<std::string> ReadArray();
 
-	std::string readRDBFile();
+	/* "$<length>" or, for a diskless transfer, "$EOF:<mark>" in front of a full sync payload */
+	void readRDBHeader(uint64_t& length, std::string& eofMark);
 
 };
 
@@ -1,39 +1,294 @@
 
+
+#include <chrono>
+#include <limits>
+#include <charconv>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
 
 #include "Stream.h"
+#include "ConsumerGroup.h"
 #include "RESPEncoder.h"
 #include "Utility.h"
 #include "SupportedCommands.h"
 
-std::string Stream::AddEntry(unsigned long entryFirstId, unsigned long entrySecondId, const std::map<std::string, std::string> &fieldValues)
+namespace
+{
+    void putVarint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void putString(std::string &out, std::string_view str)
+    {
+        putVarint(out, str.size());
+        out.append(str);
+    }
+}
+
+bool StreamId::Increment()
+{
+    if (seq != std::numeric_limits<uint64_t>::max())
+    {
+        ++seq;
+        return true;
+    }
+    if (ms == std::numeric_limits<uint64_t>::max())
+        return false;
+    ++ms;
+    seq = 0;
+    return true;
+}
+
+bool StreamId::Decrement()
+{
+    if (seq != 0)
+    {
+        --seq;
+        return true;
+    }
+    if (ms == 0)
+        return false;
+    --ms;
+    seq = std::numeric_limits<uint64_t>::max();
+    return true;
+}
+
+std::array<uint8_t, 16> StreamId::Bytes() const
+{
+    std::array<uint8_t, 16> bytes;
+    for (int index = 0; index < 8; ++index)
+    {
+        bytes[index] = static_cast<uint8_t>(ms >> (56 - 8 * index));
+        bytes[8 + index] = static_cast<uint8_t>(seq >> (56 - 8 * index));
+    }
+    return bytes;
+}
+
+StreamNode::StreamNode(const StreamId &id, std::span<const std::string> fieldValues)
+    : m_master(id), m_last(id)
+{
+    m_masterFields = static_cast<uint32_t>(fieldValues.size() / 2);
+    putVarint(m_data, m_masterFields);
+    for (size_t index = 0; index < fieldValues.size(); index += 2)
+        putString(m_data, fieldValues[index]);
+    m_entriesOffset = static_cast<uint32_t>(m_data.size());
+    Append(id, fieldValues);
+}
+
+bool StreamNode::sameAsMasterFields(std::span<const std::string> fieldValues) const
+{
+    if (fieldValues.size() / 2 != m_masterFields)
+        return false;
+
+    const char *names = m_data.data();
+    readVarint(names);
+    for (size_t index = 0; index < fieldValues.size(); index += 2)
+    {
+        if (readString(names) != fieldValues[index])
+            return false;
+    }
+    return true;
+}
+
+bool StreamNode::Append(const StreamId &id, std::span<const std::string> fieldValues)
+{
+    if (m_count >= MAX_ENTRIES)
+        return false;
+
+    // Layout: flags, ms delta, seq (delta when the ms is the master's), fields length, fields
+    thread_local std::string fields;
+    fields.clear();
+    bool sameFields = sameAsMasterFields(fieldValues);
+    if (!sameFields)
+        putVarint(fields, fieldValues.size() / 2);
+    for (size_t index = 0; index < fieldValues.size(); index += 2)
+    {
+        if (!sameFields)
+            putString(fields, fieldValues[index]);
+        putString(fields, fieldValues[index + 1]);
+    }
+
+    size_t start = m_data.size();
+    uint64_t msDelta = id.ms - m_master.ms;
+    m_data.push_back(static_cast<char>(sameFields ? SAME_FIELDS : 0));
+    putVarint(m_data, msDelta);
+    putVarint(m_data, msDelta == 0 ? id.seq - m_master.seq : id.seq);
+    putVarint(m_data, fields.size());
+    m_data.append(fields);
+
+    // A node always takes its first entry, however big
+    if (m_count > 0 && m_data.size() > MAX_BYTES)
+    {
+        m_data.resize(start);
+        return false;
+    }
+
+    m_last = id;
+    ++m_count;
+    return true;
+}
+
+bool StreamNode::Cursor::Next()
+{
+    const char *data = m_node.m_data.data();
+    while (m_pos < m_node.m_data.size())
+    {
+        m_entry = m_pos;
+        const char *p = data + m_pos;
+        m_flags = static_cast<uint8_t>(*p++);
+        uint64_t msDelta = readVarint(p);
+        uint64_t seq = readVarint(p);
+        size_t length = readVarint(p);
+        m_fields = p - data;
+        m_pos = m_fields + length;
+
+        if (!(m_flags & DELETED))
+        {
+            m_id = {m_node.m_master.ms + msDelta, msDelta == 0 ? m_node.m_master.seq + seq : seq};
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamNode::Delete(const Cursor &cursor)
+{
+    m_data[cursor.EntryPosition()] |= DELETED;
+    ++m_deleted;
+}
+
+void StreamNode::MakeCold(const StreamTier::Location &location)
+{
+    std::string().swap(m_data);
+    m_location = location;
+    m_cold = true;
+}
+
+void StreamNode::MakeHot(std::string data)
+{
+    m_data = std::move(data);
+    m_cold = false;
+}
+
+std::unique_ptr<StreamNode> StreamNode::WithData(std::string data) const
+{
+    auto node = std::make_unique<StreamNode>(*this);
+    node->MakeHot(std::move(data));
+    return node;
+}
+
+size_t StreamNode::Cursor::FieldCount() const
+{
+    if (m_flags & SAME_FIELDS)
+        return m_node.m_masterFields;
+    const char *p = m_node.m_data.data() + m_fields;
+    return readVarint(p);
+}
+
+Stream::NodeIndex::Key Stream::indexKey(const StreamId &id)
+{
+    return id.Bytes();
+}
+
+const StreamNode *Stream::nodeAfter(const StreamNode &node) const
+{
+    StreamId next = node.LastId();
+    if (!next.Increment())
+        return nullptr;
+    auto *found = m_nodes.LowerBound(indexKey(next));
+    return found ? found->get() : nullptr;
+}
+
+const StreamNode *Stream::nodeBefore(const StreamNode &node) const
+{
+    StreamId previous = node.MasterId();
+    if (!previous.Decrement())
+        return nullptr;
+    auto *found = m_nodes.Floor(indexKey(previous));
+    return found ? found->get() : nullptr;
+}
+
+const StreamNode *Stream::readable(const StreamNode &node, std::unique_ptr<StreamNode> &scratch, bool locked) const
+{
+    if (!node.Cold())
+        return &node;
+
+    std::string data;
+    if (locked ? !m_tier->Read(node.ColdLocation(), data) : !m_tier->ReadUnlocked(node.ColdLocation(), data))
+    {
+        std::cout << "Stream " << m_streamName << ": node " << node.MasterId().ToString() << " failed its checksum, skipping its entries" << std::endl;
+        return nullptr;
+    }
+    scratch = node.WithData(std::move(data));
+    return scratch.get();
+}
+
+bool Stream::warm(StreamNode &node)
+{
+    std::string data;
+    if (!m_tier->Read(node.ColdLocation(), data))
+        return false;
+    m_tier->Release(node.ColdLocation());
+    node.MakeHot(std::move(data));
+    // Goes cold again with the next spill
+    m_firstHot = std::min(m_firstHot, node.MasterId());
+    return true;
+}
+
+void Stream::appendEntry(const StreamId &id, std::span<const std::string> fieldValues)
+{
+    auto *tail = m_nodes.Last();
+    if (!tail || !(*tail)->Append(id, fieldValues))
+    {
+        // The old tail is full for good, give back what its buffer over-allocated
+        if (tail)
+            (*tail)->ShrinkToFit();
+        m_nodes.Insert(indexKey(id), std::make_unique<StreamNode>(id, fieldValues));
+    }
+    ++m_length;
+}
+
+void Stream::eraseNode(const StreamNode &node)
+{
+    if (node.Cold())
+        m_tier->Release(node.ColdLocation());
+    m_length -= node.Count();
+    m_nodes.Erase(indexKey(node.MasterId()));
+}
+
+std::string Stream::AddEntry(unsigned long entryFirstId, unsigned long entrySecondId, std::span<const std::string> fieldValues)
 {
-    std::cout << "Adding entry with Id: " << entryFirstId << "-" << entrySecondId << std::endl;
     std::lock_guard<std::mutex> lock(m_streamStoreMutex);
 
     // Handle default cases
     if (m_firstIdDefault)
     {
-        // Auto-generate timestamp
+        // Auto-generate timestamp, a clock going backwards keeps counting from the last ID
         auto now = std::chrono::system_clock::now();
         entryFirstId = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
         entrySecondId = 0;
+        if (entryFirstId <= m_latestFirstId)
+        {
+            entryFirstId = m_latestFirstId;
+            entrySecondId = m_latestSecondId + 1;
+        }
     }
     else if (m_secondIdDefault)
     {
-        if (m_streamStore.find(entryFirstId) != m_streamStore.end())
-        {
-            // Find the highest sequence number for the given millisecond part
-            auto &secondIdMap = m_streamStore[entryFirstId];
-            entrySecondId = secondIdMap.rbegin()->first + 1; // Increment the highest sequence number
-        }
-        else
-        {
-            entrySecondId = entryFirstId == 0 ? 1 : 0; // First entry for this millisecond part
-        }
+        // Next sequence number of the millisecond part, 0-0 is not a valid Id
+        entrySecondId = entryFirstId == m_latestFirstId ? m_latestSecondId + 1 : 0;
     }
 
-    // std::cout << "latest Ids:" << m_latestFirstId << "-" << m_latestSecondId << std::endl;
+    // Reset default flags
+    m_firstIdDefault = false;
+    m_secondIdDefault = false;
 
     if (entryFirstId == 0 && entrySecondId == 0)
     {
@@ -50,12 +305,7 @@ std::string Stream::AddEntry(unsigned long entryFirstId, unsigned long entrySeco
     m_latestFirstId = entryFirstId;
     m_latestSecondId = entrySecondId;
 
-    // Add the entry to the stream store
-    m_streamStore[entryFirstId][entrySecondId] = std::move(fieldValues);
-
-    // Reset default flags
-    m_firstIdDefault = false;
-    m_secondIdDefault = false;
+    appendEntry({entryFirstId, entrySecondId}, fieldValues);
 
     return RESPEncoder::encodeString(std::to_string(entryFirstId) + "-" + std::to_string(entrySecondId));
 }
@@ -75,101 +325,352 @@ std::string Stream::getLatestEntryId() const
     return std::move(std::to_string(m_latestFirstId) + "-" + std::to_string(m_latestSecondId));
 }
 
-std::tuple<unsigned long, unsigned long, unsigned long, unsigned long> Stream::processRange(const std::string &startId, const std::string &endId)
+bool Stream::ParseId(std::string_view text, uint64_t defaultSequence, StreamId &id)
 {
-    unsigned long startMilliSecondId{}, startsequenceId{};
-    unsigned long endMilliSecondId{}, endsequenceId{};
-
-    if (startId == "-")
+    auto parsePart = [](std::string_view part, uint64_t &value)
     {
-        startMilliSecondId = 0;
-        startsequenceId = 0;
-    }
-    else
+        auto [end, error] = std::from_chars(part.data(), part.data() + part.size(), value);
+        return !part.empty() && error == std::errc() && end == part.data() + part.size();
+    };
+
+    auto separator = text.find('-');
+    if (!parsePart(text.substr(0, separator), id.ms))
+        return false;
+    id.seq = defaultSequence;
+    return separator == std::string_view::npos || parsePart(text.substr(separator + 1), id.seq);
+}
+
+Stream::Iterator::Iterator(const Stream &stream, const StreamId &start, const StreamId &end, bool reverse)
+    : m_lock(stream.m_streamStoreMutex), m_stream(stream), m_start(start), m_end(end), m_reverse(reverse)
+{
+    if (start > end)
+        return;
+
+    // Going forwards the node holding start is the last one whose master ID is not after it
+    std::unique_ptr<StreamNode> *found = stream.m_nodes.Floor(indexKey(reverse ? end : start));
+    if (!found && !reverse)
+        found = stream.m_nodes.LowerBound(indexKey(start));
+    openNode(found ? found->get() : nullptr);
+}
+
+void Stream::Iterator::openNode(const StreamNode *node)
+{
+    m_node = node;
+    m_cursor.reset();
+    m_pending = 0;
+    if (!node)
+        return;
+
+    // Without a cursor the node is passed over like one without entries
+    const StreamNode *data = m_stream.readable(*node, m_loaded);
+    if (!data)
+        return;
+    m_cursor.emplace(*data);
+    if (!m_reverse)
+        return;
+
+    // Entries only decode forwards, note where each one starts to walk them back
+    while (m_cursor->Next())
+        m_positions[m_pending++] = static_cast<uint32_t>(m_cursor->EntryPosition());
+}
+
+bool Stream::Iterator::Next()
+{
+    while (m_node)
     {
-        auto startSep = startId.find("-");
-        startMilliSecondId = std::stoul(startId.substr(0, startSep));
-        if (startSep != std::string::npos)
-            startsequenceId = std::stoul(startId.substr(startSep + 1));
+        if (!m_reverse)
+        {
+            while (m_cursor && m_cursor->Next())
+            {
+                if (m_cursor->Id() > m_end)
+                {
+                    m_node = nullptr;
+                    return false;
+                }
+                if (m_cursor->Id() >= m_start)
+                    return true;
+            }
+            const StreamNode *next = m_stream.nodeAfter(*m_node);
+            openNode(next && next->MasterId() <= m_end ? next : nullptr);
+        }
+        else
+        {
+            while (m_pending > 0)
+            {
+                m_cursor->Seek(m_positions[--m_pending]);
+                m_cursor->Next();
+                if (m_cursor->Id() < m_start)
+                {
+                    m_node = nullptr;
+                    return false;
+                }
+                if (m_cursor->Id() <= m_end)
+                    return true;
+            }
+            openNode(m_node->MasterId() > m_start ? m_stream.nodeBefore(*m_node) : nullptr);
+        }
     }
+    return false;
+}
+
+std::optional<StreamId> Stream::FirstEntryId() const
+{
+    // Nodes without entries left are dropped, the first node's first entry is the stream's
+    auto *first = m_nodes.First();
+    if (!first)
+        return std::nullopt;
+    std::unique_ptr<StreamNode> scratch;
+    const StreamNode *node = readable(**first, scratch, false);
+    if (!node)
+        return (*first)->MasterId();
+    StreamNode::Cursor cursor(*node);
+    cursor.Next();
+    return cursor.Id();
+}
+
+bool Stream::Delete(const StreamId &id)
+{
+    std::lock_guard<std::mutex> lock(m_streamStoreMutex);
 
-    if (endId == "+")
+    auto *found = m_nodes.Floor(indexKey(id));
+    if (!found || (*found)->LastId() < id)
+        return false;
+
+    // A cold node is only brought back once the entry is known to be there
+    StreamNode &node = **found;
+    std::unique_ptr<StreamNode> scratch;
+    const StreamNode *data = readable(node, scratch);
+    if (!data)
+        return false;
+    StreamNode::Cursor cursor(*data);
+    while (cursor.Next())
     {
-        endMilliSecondId = 0;
-        endsequenceId = 0;
+        if (cursor.Id() < id)
+            continue;
+        if (cursor.Id() > id || (node.Cold() && !warm(node)))
+            return false;
+
+        StreamNode::Cursor at(node);
+        at.Seek(cursor.EntryPosition());
+        at.Next();
+        node.Delete(at);
+        --m_length;
+        if (node.Count() == 0)
+            eraseNode(node);
+        return true;
     }
-    else
+    return false;
+}
+
+template <typename Predicate>
+uint64_t Stream::trimWhile(Predicate &&expendable, bool approximate)
+{
+    std::lock_guard<std::mutex> lock(m_streamStoreMutex);
+
+    uint64_t lengthBefore = m_length;
+    while (auto *first = m_nodes.First())
     {
-        auto endSep = endId.find("-");
-        endMilliSecondId = std::stoul(endId.substr(0, endSep));
-        if (endSep != std::string::npos)
-            endsequenceId = std::stoul(endId.substr(endSep + 1));
+        // Whole nodes first, expendable(node) says whether all of its entries can go
+        StreamNode &node = **first;
+        if (expendable(node.Count(), node.LastId()))
+        {
+            eraseNode(node);
+            continue;
+        }
+        if (approximate || (node.Cold() && !warm(node)))
+            break;
+
+        // Then entry by entry in what is now the first node
+        StreamNode::Cursor cursor(node);
+        while (cursor.Next() && expendable(1, cursor.Id()))
+        {
+            node.Delete(cursor);
+            --m_length;
+        }
+        if (node.Count() == 0)
+            eraseNode(node);
+        break;
     }
+    return lengthBefore - m_length;
+}
 
-    return std::make_tuple(startMilliSecondId, startsequenceId, endMilliSecondId, endsequenceId);
+uint64_t Stream::TrimToLength(uint64_t maxLength, bool approximate)
+{
+    return trimWhile([this, maxLength](uint64_t entries, const StreamId &)
+                     { return m_length >= maxLength + entries; },
+                     approximate);
 }
 
-std::map<std::string, std::map<std::string, std::string>> Stream::GetEntriesInRange(const std::string &startId, const std::string &endId, bool exclusiveStart)
+uint64_t Stream::TrimBefore(const StreamId &minId, bool approximate)
 {
-    auto [startMilliSecondId, startsequenceId, endMilliSecondId, endsequenceId] = processRange(startId, endId);
+    return trimWhile([&minId](uint64_t, const StreamId &lastId)
+                     { return lastId < minId; },
+                     approximate);
+}
+
+size_t Stream::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this) + m_nodes.MemoryUsage();
+    auto *first = m_nodes.First();
+    for (const StreamNode *node = first ? first->get() : nullptr; node; node = nodeAfter(*node))
+        bytes += node->MemoryUsage();
+    return bytes;
+}
 
-    // To store result entries
-    std::map<std::string, std::map<std::string, std::string>> resultEntries;
+Stream::Stream(const std::string &streamName)
+    : m_streamName(streamName) {}
+
+Stream::~Stream()
+{
+    ReleaseColdNodes();
+}
+
+void Stream::ReleaseColdNodes()
+{
     std::lock_guard<std::mutex> lock(m_streamStoreMutex);
+    if (!m_tier)
+        return;
+    auto *first = m_nodes.First();
+    for (const StreamNode *node = first ? first->get() : nullptr; node; node = nodeAfter(*node))
+    {
+        if (node->Cold())
+            m_tier->Release(node->ColdLocation());
+    }
+    m_tier = nullptr;
+}
 
-    auto firstEntry = startMilliSecondId == 0 ? m_streamStore.begin() : m_streamStore.lower_bound(startMilliSecondId);
-    if (firstEntry != m_streamStore.end())
+uint64_t Stream::SpillOlderThan(uint64_t cutoffMs, StreamTier &tier)
+{
+    std::lock_guard<std::mutex> lock(m_streamStoreMutex);
+    m_tier = &tier;
+
+    // Nodes go cold in ID order, so the scan starts about where the last one stopped
+    uint64_t spilled = 0;
+    auto *tail = m_nodes.Last();
+    auto *found = m_nodes.LowerBound(indexKey(m_firstHot));
+    while (found && found != tail && (*found)->LastId().ms < cutoffMs)
     {
-        auto lastEntry = endMilliSecondId == 0 ? m_streamStore.end() : m_streamStore.upper_bound(endMilliSecondId);
-        // End is inclusive
-        // Iterate through the entries until we reach the end of the range
-        for (auto it = firstEntry; it != lastEntry; ++it)
+        StreamNode &node = **found;
+        StreamTier::Location location;
+        if (!node.Cold())
         {
-            if (it->first == startMilliSecondId && startsequenceId != 0)
-            {
-                auto startSeqEntry = it->second.lower_bound(startsequenceId);
-                if (exclusiveStart && startSeqEntry != it->second.end() && startSeqEntry->first == startsequenceId)
-                    ++startSeqEntry; // Move to next entry if exclusive
+            if (!tier.Append(node.Data(), location))
+                break;
+            node.MakeCold(location);
+            ++spilled;
+        }
+        StreamId next = node.LastId();
+        found = next.Increment() ? m_nodes.LowerBound(indexKey(next)) : nullptr;
+    }
+    if (found)
+        m_firstHot = (*found)->MasterId();
+    return spilled;
+}
 
-                for (auto seqIt = startSeqEntry; seqIt != it->second.end(); ++seqIt)
-                {
-                    std::string entryId = std::to_string(it->first) + "-" + std::to_string(seqIt->first);
+ConsumerGroup *Stream::FindGroup(std::string_view name) const
+{
+    auto group = m_groups.find(name);
+    return group == m_groups.end() ? nullptr : group->second.get();
+}
 
-                    for (auto &kvPair : seqIt->second)
-                        resultEntries[entryId][kvPair.first] = kvPair.second;
-                }
-                continue;
-            }
+ConsumerGroup *Stream::CreateGroup(const std::string &name, const StreamId &lastDelivered)
+{
+    auto [group, created] = m_groups.try_emplace(name);
+    if (!created)
+        return nullptr;
+    group->second = std::make_unique<ConsumerGroup>(lastDelivered);
+    return group->second.get();
+}
 
-            if (it->first == endMilliSecondId && endsequenceId != 0)
-            {
-                auto endSeqEntry = it->second.upper_bound(endsequenceId);
-                // End is inclusive
+bool Stream::DestroyGroup(std::string_view name)
+{
+    auto group = m_groups.find(name);
+    if (group == m_groups.end())
+        return false;
+    m_groups.erase(group);
+    return true;
+}
 
-                for (auto seqIt = it->second.begin(); seqIt != endSeqEntry; ++seqIt)
-                {
-                    std::string entryId = std::to_string(it->first) + "-" + std::to_string(seqIt->first);
+// Streams are only modified on the main thread, so reading without the store lock is safe here
+// (and required in a snapshot child, the lock may have been held by a thread that doesn't exist there)
+std::string Stream::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint64_t>(blob, m_latestFirstId);
+    appendBinary<uint64_t>(blob, m_latestSecondId);
+    size_t lengthAt = blob.size();
+    appendBinary<uint64_t>(blob, m_length);
+
+    // Entries of cold nodes that fail their checksum are left out, the length says what was written
+    uint64_t written = 0;
+    auto *first = m_nodes.First();
+    std::unique_ptr<StreamNode> scratch;
+    for (const StreamNode *node = first ? first->get() : nullptr; node; node = nodeAfter(*node))
+    {
+        const StreamNode *data = readable(*node, scratch, false);
+        if (!data)
+            continue;
+        StreamNode::Cursor cursor(*data);
+        for (; cursor.Next(); ++written)
+        {
+            appendBinary<uint64_t>(blob, cursor.Id().ms);
+            appendBinary<uint64_t>(blob, cursor.Id().seq);
+            appendBinary<uint32_t>(blob, cursor.FieldCount());
+            cursor.ForEachField([&](std::string_view field, std::string_view value)
+                                {
+                appendBinaryString(blob, field);
+                appendBinaryString(blob, value); });
+        }
+    }
+    memcpy(blob.data() + lengthAt, &written, sizeof(written));
 
-                    for (auto &kvPair : seqIt->second)
-                        resultEntries[entryId][kvPair.first] = kvPair.second;
-                }
-                continue;
-            }
+    appendBinary<uint64_t>(blob, m_groups.size());
+    for (const auto &[name, group] : m_groups)
+    {
+        appendBinaryString(blob, name);
+        group->Serialize(blob);
+    }
 
-            for (auto seqIt = it->second.begin(); seqIt != it->second.end(); ++seqIt)
-            {
-                if (exclusiveStart && it->first == startMilliSecondId && seqIt->first == startsequenceId)
-                    continue;
+    return blob;
+}
 
-                std::string entryId = std::to_string(it->first) + "-" + std::to_string(seqIt->first);
+std::unique_ptr<Stream> Stream::Deserialize(const std::string &streamName, const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto stream = std::make_unique<Stream>(streamName);
+    stream->m_latestFirstId = reader.read<uint64_t>();
+    stream->m_latestSecondId = reader.read<uint64_t>();
+
+    // Counts are checked against the bytes left before anything is sized by them: an entry takes at least
+    // its ID and field count, a field or value at least its length
+    constexpr size_t MIN_ENTRY_BYTES = 2 * sizeof(uint64_t) + sizeof(uint32_t);
+    std::vector<std::string> fieldValues;
+    auto entries = reader.read<uint64_t>();
+    if (entries > reader.remaining() / MIN_ENTRY_BYTES)
+        throw std::runtime_error("Corrupted stream");
+    for (; entries > 0; --entries)
+    {
+        StreamId id;
+        id.ms = reader.read<uint64_t>();
+        id.seq = reader.read<uint64_t>();
+        uint64_t fields = reader.read<uint32_t>();
+        if (2 * fields > reader.remaining() / sizeof(uint64_t))
+            throw std::runtime_error("Corrupted stream entry");
+        fieldValues.resize(2 * fields);
+        for (auto &str : fieldValues)
+            str = reader.readString();
+        stream->appendEntry(id, fieldValues);
+    }
 
-                for (auto &kvPair : seqIt->second)
-                    resultEntries[entryId][kvPair.first] = kvPair.second;
-            }
+    // Blobs saved before consumer groups end here
+    if (!reader.atEnd())
+    {
+        for (auto groups = reader.read<uint64_t>(); groups > 0; --groups)
+        {
+            std::string name = reader.readString();
+            stream->m_groups[name] = ConsumerGroup::Deserialize(reader);
         }
     }
 
-    return std::move(resultEntries);
+    return stream;
 }
-
-
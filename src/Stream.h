@@ -2,12 +2,169 @@
 #define STREAM_H
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 #include <map>
-#include <unordered_map>
+#include <array>
+#include <span>
+#include <optional>
+#include <compare>
+#include <cstdint>
 
 #include "Utility.h"
+#include "RadixTree.h"
+#include "StreamTier.h"
+
+/*
+   Stream
+   - Entries are packed in nodes of up to 100 entries / 4KB, indexed by a radix tree keyed by the
+     big endian ID of each node's first entry (its master ID)
+   - A node stores its first entry's field names once (the master fields). Entries with the same
+     fields only store their values, and entry IDs are stored as varint deltas from the master ID,
+     so a typical entry costs a few bytes over its values
+   - Range scans seek the node holding the start ID and decode entries sequentially from there,
+     Stream::Iterator hands out views into the nodes so replies are encoded without copies
+   - Deleted entries are flagged in place and skipped, their bytes go when their whole node does.
+     Approximate trimming only drops whole nodes from the front, exact trimming flags the rest
+   - Consumer groups (ConsumerGroup.h) belong to the stream and are saved with it
+   - With tiering on, old nodes go cold: their bytes move to a StreamTier and are read back (and
+     checked) whenever a scan reaches them. Deleting from a cold node brings it back into memory
+*/
+
+struct StreamId
+{
+    uint64_t ms{};
+    uint64_t seq{};
+
+    auto operator<=>(const StreamId &) const = default;
+    std::string ToString() const { return std::to_string(ms) + "-" + std::to_string(seq); }
+    /* Steps to the next / previous possible ID, false (and left as is) at either end of the ID space */
+    bool Increment();
+    bool Decrement();
+    /* Big endian ms then seq, byte order is ID order */
+    std::array<uint8_t, 16> Bytes() const;
+};
+
+class ConsumerGroup;
+
+class StreamNode
+{
+public:
+    static constexpr size_t MAX_ENTRIES = 100;
+    static constexpr size_t MAX_BYTES = 4096;
+
+    /* fieldValues alternate field, value. The first entry's fields become the master fields */
+    StreamNode(const StreamId &id, std::span<const std::string> fieldValues);
+
+    /* Sequential decoder over the entries of a node */
+    class Cursor
+    {
+    public:
+        Cursor(const StreamNode &node) : m_node(node), m_pos(node.m_entriesOffset) {}
+
+        /* Moves to the first / next entry that isn't deleted, false past the last one */
+        bool Next();
+        /* Where the current entry starts, Seek there later to have Next decode it again */
+        size_t EntryPosition() const { return m_entry; }
+        void Seek(size_t position) { m_pos = position; }
+        const StreamId &Id() const { return m_id; }
+        size_t FieldCount() const;
+        /* Calls f(field, value) for every field of the entry, views into the node */
+        template <typename F>
+        void ForEachField(F &&f) const;
+
+    private:
+        const StreamNode &m_node;
+        size_t m_pos;         // start of the next entry
+        size_t m_entry{};     // start of the current entry
+        size_t m_fields{};    // start of the current entry's fields
+        uint8_t m_flags{};
+        StreamId m_id;
+    };
+
+    /* IDs must increase, false (and the node left as is) when the entry doesn't fit */
+    bool Append(const StreamId &id, std::span<const std::string> fieldValues);
+    /* Flags the entry the cursor is on as deleted */
+    void Delete(const Cursor &cursor);
+
+    const StreamId &MasterId() const { return m_master; }
+    const StreamId &LastId() const { return m_last; } // last appended, deleted or not
+    uint32_t Count() const { return m_count - m_deleted; }
+    size_t MemoryUsage() const { return sizeof(*this) + m_data.capacity(); }
+    void ShrinkToFit() { m_data.shrink_to_fit(); }
+
+    /* A cold node has no bytes in memory, only where they are in the tier */
+    bool Cold() const { return m_cold; }
+    const StreamTier::Location &ColdLocation() const { return m_location; }
+    const std::string &Data() const { return m_data; }
+    void MakeCold(const StreamTier::Location &location);
+    void MakeHot(std::string data);
+    /* A hot copy of a cold node, for reading it */
+    std::unique_ptr<StreamNode> WithData(std::string data) const;
+
+private:
+    // Entry flags
+    static constexpr uint8_t SAME_FIELDS = 1; // fields are the master fields, only values stored
+    static constexpr uint8_t DELETED = 2;
+
+    StreamId m_master;
+    StreamId m_last;
+    uint32_t m_count{};   // appended, deleted ones included
+    uint32_t m_deleted{};
+    uint32_t m_masterFields{};
+    uint32_t m_entriesOffset{};
+    std::string m_data; // master field count and names, then the entries
+    bool m_cold{};
+    StreamTier::Location m_location;
+
+    bool sameAsMasterFields(std::span<const std::string> fieldValues) const;
+
+    static uint64_t readVarint(const char *&p)
+    {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+
+    static std::string_view readString(const char *&p)
+    {
+        size_t length = readVarint(p);
+        std::string_view str(p, length);
+        p += length;
+        return str;
+    }
+};
+
+template <typename F>
+void StreamNode::Cursor::ForEachField(F &&f) const
+{
+    const char *p = m_node.m_data.data() + m_fields;
+    if (m_flags & SAME_FIELDS)
+    {
+        const char *names = m_node.m_data.data();
+        readVarint(names);
+        for (uint32_t index = 0; index < m_node.m_masterFields; ++index)
+        {
+            std::string_view field = readString(names);
+            f(field, readString(p));
+        }
+        return;
+    }
+
+    for (uint64_t fields = readVarint(p); fields > 0; --fields)
+    {
+        std::string_view field = readString(p);
+        f(field, readString(p));
+    }
+}
 
 class Stream
 {
@@ -18,29 +175,93 @@ private:
     bool m_firstIdDefault{false};
     bool m_secondIdDefault{false};
 
-    /* Stream Store
-       Storing this way to allow for efficient retrieval of stream data by Ids and using binary search
-       To extract entries: First we do binary search on millisecondId, then keep including all entries until
-       last millisecondId is hit then do binary search on sequenceId and include relevant entries
-    */
-    std::mutex m_streamStoreMutex;
-    std::map<unsigned long,
-             std::map<unsigned long,
-                      std::map<std::string, std::string>>>
-        m_streamStore;
-
-        std::tuple<unsigned long, unsigned long, unsigned long, unsigned long> processRange(const std::string& startId, const std::string& endId);
+    using NodeIndex = RadixTree<std::unique_ptr<StreamNode>, 16>;
+
+    mutable std::mutex m_streamStoreMutex;
+    NodeIndex m_nodes;
+    uint64_t m_length{};
+    std::map<std::string, std::unique_ptr<ConsumerGroup>, std::less<>> m_groups;
+    StreamTier *m_tier{}; // set once a node went cold
+    StreamId m_firstHot;  // nodes before it are cold, ones after may be too if they were spilled since
+
+    static NodeIndex::Key indexKey(const StreamId &id);
+    const StreamNode *nodeAfter(const StreamNode &node) const;
+    const StreamNode *nodeBefore(const StreamNode &node) const;
+    void appendEntry(const StreamId &id, std::span<const std::string> fieldValues);
+    void eraseNode(const StreamNode &node);
+    template <typename Predicate>
+    uint64_t trimWhile(Predicate &&expendable, bool approximate);
+    /* node itself, or its bytes read back into scratch if it is cold. nullptr if they are lost, the node then reads as empty */
+    const StreamNode *readable(const StreamNode &node, std::unique_ptr<StreamNode> &scratch, bool locked = true) const;
+    /* Brings a cold node back into memory before it is modified, false if its bytes are lost */
+    bool warm(StreamNode &node);
+
 public:
-    Stream(const std::string &streamName)
-        : m_streamName(streamName) {}
+    /* Entries with IDs in [start, end] in ID order, or from end down to start. Holds the stream lock while alive */
+    class Iterator
+    {
+    public:
+        Iterator(const Stream &stream, const StreamId &start, const StreamId &end, bool reverse = false);
+
+        bool Next();
+        const StreamId &Id() const { return m_cursor->Id(); }
+        size_t FieldCount() const { return m_cursor->FieldCount(); }
+        template <typename F>
+        void ForEachField(F &&f) const { m_cursor->ForEachField(std::forward<F>(f)); }
 
-    std::string AddEntry(unsigned long entryFirstId, unsigned long entrySecondId, const std::map<std::string, std::string> &fieldValues);
+    private:
+        std::unique_lock<std::mutex> m_lock;
+        const Stream &m_stream;
+        StreamId m_start;
+        StreamId m_end;
+        bool m_reverse;
+        const StreamNode *m_node{};
+        std::optional<StreamNode::Cursor> m_cursor;
+        std::unique_ptr<StreamNode> m_loaded; // the current node read back, if it is cold
+        std::array<uint32_t, StreamNode::MAX_ENTRIES> m_positions; // reverse: where the node's entries start
+        size_t m_pending{};                                         // reverse: entries of the node left to visit
+
+        void openNode(const StreamNode *node);
+    };
+
+    /* "ms" or "ms-seq", a missing sequence number becomes defaultSequence */
+    static bool ParseId(std::string_view text, uint64_t defaultSequence, StreamId &id);
+
+    // Out of line, where ConsumerGroup is complete
+    Stream(const std::string &streamName);
+    ~Stream();
+
+    /* fieldValues alternate field, value */
+    std::string AddEntry(unsigned long entryFirstId, unsigned long entrySecondId, std::span<const std::string> fieldValues);
     void setFirstIdDefault();
     void setSecondIdDefault();
     std::string getLatestEntryId() const;
-    std::map<std::string, std::map<std::string, std::string>> GetEntriesInRange(const std::string& startId, const std::string& endId, bool exclusiveStart = false);
-};
+    StreamId LastId() const { return {m_latestFirstId, m_latestSecondId}; }
+    std::optional<StreamId> FirstEntryId() const;
 
-#endif // STREAM_H
+    bool Delete(const StreamId &id);
+    /* Both return how many entries went. Approximate trims only drop whole nodes, so can leave some more */
+    uint64_t TrimToLength(uint64_t maxLength, bool approximate);
+    uint64_t TrimBefore(const StreamId &minId, bool approximate);
+
+    uint64_t Length() const { return m_length; }
+    size_t NodeCount() const { return m_nodes.Size(); }
+    size_t MemoryUsage() const;
+    /* Moves the bytes of nodes whose entries are all older than cutoffMs to the tier, never the last
+       node, which is still appended to. Returns how many nodes went cold */
+    uint64_t SpillOlderThan(uint64_t cutoffMs, StreamTier &tier);
+    /* Gives the tier back the records of the cold nodes, which can't be read afterwards. For a
+       stream that is about to be freed off the main thread */
+    void ReleaseColdNodes();
 
+    ConsumerGroup *FindGroup(std::string_view name) const;
+    /* nullptr if the name is taken */
+    ConsumerGroup *CreateGroup(const std::string &name, const StreamId &lastDelivered);
+    bool DestroyGroup(std::string_view name);
+    const std::map<std::string, std::unique_ptr<ConsumerGroup>, std::less<>> &Groups() const { return m_groups; }
 
+    std::string Serialize() const;
+    static std::unique_ptr<Stream> Deserialize(const std::string &streamName, const std::string &blob);
+};
+
+#endif // STREAM_H
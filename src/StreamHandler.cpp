@@ -1,11 +1,14 @@
 #include <stdexcept>
 #include <chrono>
 #include <iostream>
-#include <ranges>
 #include <future>
+#include <limits>
+#include <charconv>
+#include <algorithm>
 #include <sys/socket.h>
 
 #include "StreamHandler.h"
+#include "Rdb.h"
 #include "RESPEncoder.h"
 #include "Utility.h"
 #include "SupportedCommands.h"
@@ -62,15 +65,56 @@ std::string StreamHandler::StreamCommandProcessor(CommandArray commandArgs, cons
     {
         return xaddHandler(std::move(commandArgs));
     }
-    else if (command == XRANGE)
+    else if (command == XRANGE || command == XREVRANGE)
     {
         // Handle Querying a stream using xrange
-        return xrangeHandler(std::move(commandArgs));
+        bool reverse = command == XREVRANGE;
+        return xrangeHandler(std::move(commandArgs), reverse);
     }
     else if (command == XREAD)
     {
         return xreadHandler(std::move(commandArgs), clientFd);
     }
+    else if (command == XTRIM)
+    {
+        return xtrimHandler(std::move(commandArgs));
+    }
+    else if (command == XDEL)
+    {
+        return xdelHandler(std::move(commandArgs));
+    }
+    else if (command == XLEN)
+    {
+        return xlenHandler(std::move(commandArgs));
+    }
+    else if (command == XGROUP)
+    {
+        return xgroupHandler(std::move(commandArgs));
+    }
+    else if (command == XREADGROUP)
+    {
+        return xreadgroupHandler(std::move(commandArgs), clientFd);
+    }
+    else if (command == XACK)
+    {
+        return xackHandler(std::move(commandArgs));
+    }
+    else if (command == XPENDING)
+    {
+        return xpendingHandler(std::move(commandArgs));
+    }
+    else if (command == XCLAIM)
+    {
+        return xclaimHandler(std::move(commandArgs));
+    }
+    else if (command == XAUTOCLAIM)
+    {
+        return xautoclaimHandler(std::move(commandArgs));
+    }
+    else if (command == XINFO)
+    {
+        return xinfoHandler(std::move(commandArgs));
+    }
 
     throw std::runtime_error("Invalid Command!");
 }
@@ -78,8 +122,16 @@ std::string StreamHandler::StreamCommandProcessor(CommandArray commandArgs, cons
 std::string StreamHandler::xaddHandler(CommandArray commandArgs)
 {
     std::cout << "Processing xadd.." << std::endl;
+
+    // XADD key [MAXLEN|MINID [=|~] threshold] id field value [field value ...]
+    TrimArgs trim;
+    size_t index = 2;
+    bool trimming = isTrimStrategy(*commandArgs, index);
+    if (trimming && !parseTrimArgs(*commandArgs, index, trim))
+        return RESPEncoder::encodeError("syntax error");
+
     // validate commandArray for xadd
-    if (commandArgs->size() < 4 || (commandArgs->size() - 3) % 2 != 0)
+    if (commandArgs->size() < index + 3 || (commandArgs->size() - index - 1) % 2 != 0)
     {
         return RESPEncoder::encodeError("wrong number of arguments for 'xadd' command");
     }
@@ -92,313 +144,1117 @@ std::string StreamHandler::xaddHandler(CommandArray commandArgs)
         m_streams[streamName] = std::make_unique<Stream>(streamName);
     }
 
-    std::string &entryId = (*commandArgs)[2];
+    std::string &entryId = (*commandArgs)[index];
     auto [firstId, secondId] = parseEntryId(streamName, entryId);
 
-    std::map<std::string, std::string> fieldValues;
-    for (auto it = commandArgs->begin() + 3; it != commandArgs->end(); ++it)
-    {
-        std::string &field = *it;
-        std::string &value = *(++it);
-        fieldValues[field] = value;
-    }
-
-    // Add entry to the stream
+    // Add entry to the stream, fields in the order given
+    std::span<const std::string> fieldValues(commandArgs->begin() + index + 1, commandArgs->end());
     auto result = m_streams[streamName]->AddEntry(firstId, secondId, fieldValues);
+    if (trimming && result.front() != '-')
+        applyTrim(*m_streams[streamName], trim);
 
     {
+        // Wake a blocked XREAD once the stream got past the last entry it has seen
         std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
-        if (m_blockingStreams.find(streamName) != m_blockingStreams.end())
+        auto waiting = m_blockingStreams.find(streamName);
+        if (waiting != m_blockingStreams.end() && result.front() != '-' && m_streams[streamName]->LastId() > waiting->second.first)
         {
-            auto &[waitId, eventWaiter] = m_blockingStreams[streamName];
-            auto [waitFirstId, waitSecondId] = parseEntryId(streamName, waitId);
-
-            std::cout << firstId << "-" << secondId << " vs WaitId: " << waitFirstId << "-" << waitSecondId << std::endl;
-            // If the added entry is greater than the wait Id, signal the waiter
-            if (firstId > waitFirstId || (firstId == waitFirstId && secondId > waitSecondId))
-            {
-                std::cout << "Signaling waiter for stream: " << streamName << std::endl;
-                eventWaiter->setEvent();
-            }
+            std::cout << "Signaling waiter for stream: " << streamName << std::endl;
+            waiting->second.second->setEvent();
         }
+
+        if (result.front() != '-')
+            serveGroupWaiters(streamName);
     }
 
     return result;
 }
 
-std::string StreamHandler::xrangeHandler(CommandArray commandArgs)
+std::string StreamHandler::xrangeHandler(CommandArray commandArgs, bool reverse)
 {
-    if (commandArgs->size() < 4)
+    if (commandArgs->size() != 4 && commandArgs->size() != 6)
     {
-        return RESPEncoder::encodeError("wrong number of arguments for 'xrange' command");
+        return RESPEncoder::encodeError("wrong number of arguments for '" + (*commandArgs)[0] + "' command");
     }
 
-    std::string &streamName = (*commandArgs)[1];
-    if (m_streams.find(streamName) == m_streams.end())
+    // XREVRANGE takes the range end first
+    StreamId start, end;
+    const std::string &startId = (*commandArgs)[reverse ? 3 : 2];
+    const std::string &endId = (*commandArgs)[reverse ? 2 : 3];
+    if (!parseRangeId(startId, false, start) || !parseRangeId(endId, true, end))
+        return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+
+    size_t count = SIZE_MAX;
+    if (commandArgs->size() == 6)
+    {
+        if (toLower((*commandArgs)[4]) != "count")
+            return RESPEncoder::encodeError("syntax error");
+        if (!parseCount((*commandArgs)[5], count))
+            return RESPEncoder::encodeError("value is not an integer or out of range");
+    }
+
+    auto stream = m_streams.find((*commandArgs)[1]);
+    if (stream == m_streams.end())
     {
         // return empty array
         return RESPEncoder::encodeArray({});
     }
-    else
+
+    std::string reply;
+    Stream::Iterator iterator(*stream->second, start, end, reverse);
+    appendEntries(reply, iterator, count);
+    return reply;
+}
+
+bool StreamHandler::isTrimStrategy(const std::vector<std::string> &args, size_t index)
+{
+    if (index >= args.size())
+        return false;
+    std::string strategy = toLower(args[index]);
+    return strategy == "maxlen" || strategy == "minid";
+}
+
+bool StreamHandler::parseTrimArgs(const std::vector<std::string> &args, size_t &index, TrimArgs &trim)
+{
+    trim.strategyIndex = index;
+    trim.byLength = toLower(args[index++]) == "maxlen";
+    if (index < args.size() && (args[index] == "~" || args[index] == "="))
+        trim.approximate = args[index++] == "~";
+    if (index >= args.size())
+        return false;
+
+    trim.thresholdIndex = index;
+    const std::string &threshold = args[index++];
+    return trim.byLength ? parseCount(threshold, trim.maxLength) : Stream::ParseId(threshold, 0, trim.minId);
+}
+
+uint64_t StreamHandler::applyTrim(Stream &stream, const TrimArgs &trim)
+{
+    return trim.byLength ? stream.TrimToLength(trim.maxLength, trim.approximate) : stream.TrimBefore(trim.minId, trim.approximate);
+}
+
+std::string StreamHandler::xtrimHandler(CommandArray commandArgs)
+{
+    // XTRIM key MAXLEN|MINID [=|~] threshold
+    if (commandArgs->size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xtrim' command");
+
+    TrimArgs trim;
+    size_t index = 2;
+    if (!isTrimStrategy(*commandArgs, index) || !parseTrimArgs(*commandArgs, index, trim) || index != commandArgs->size())
+        return RESPEncoder::encodeError("syntax error");
+
+    auto stream = m_streams.find((*commandArgs)[1]);
+    if (stream == m_streams.end())
+        return RESPEncoder::encodeInteger(0);
+    return RESPEncoder::encodeInteger(applyTrim(*stream->second, trim));
+}
+
+std::string StreamHandler::xdelHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xdel' command");
+
+    // All IDs are checked before anything is deleted
+    std::vector<StreamId> ids(commandArgs->size() - 2);
+    for (size_t i = 0; i < ids.size(); ++i)
     {
-        // Handle querying the stream for entries in the given range
-        std::string &startId = (*commandArgs)[2];
-        std::string &endId = (*commandArgs)[3];
+        if (!Stream::ParseId((*commandArgs)[i + 2], 0, ids[i]))
+            return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+    }
 
-        auto entries = m_streams[streamName]->GetEntriesInRange(startId, endId);
-        std::vector<std::string> mainReturnArray;
+    auto stream = m_streams.find((*commandArgs)[1]);
+    if (stream == m_streams.end())
+        return RESPEncoder::encodeInteger(0);
 
-        // Form result and format into RESP
-        for (const auto &entry : entries)
-        {
-            // Format each entry into RESP
-            std::vector<std::string> entryArray, keyvalueArray;
-            entryArray.push_back(RESPEncoder::encodeString(entry.first)); // Entry ID
+    long long deleted = 0;
+    for (const auto &id : ids)
+        deleted += stream->second->Delete(id);
+    return RESPEncoder::encodeInteger(deleted);
+}
 
-            for (const auto &kv : entry.second)
-            {
-                keyvalueArray.push_back(RESPEncoder::encodeString(kv.first));
-                keyvalueArray.push_back(RESPEncoder::encodeString(kv.second));
-            }
-            entryArray.push_back(RESPEncoder::encodeArray(keyvalueArray, true /* dontEncodeItems */));
-            mainReturnArray.push_back(RESPEncoder::encodeArray(entryArray, true));
-        }
+std::string StreamHandler::xlenHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xlen' command");
+
+    auto stream = m_streams.find((*commandArgs)[1]);
+    return RESPEncoder::encodeInteger(stream == m_streams.end() ? 0 : stream->second->Length());
+}
 
-        return RESPEncoder::encodeArray(mainReturnArray, true);
+void StreamHandler::RewriteForLog(std::vector<std::string> &args, const std::string &result) const
+{
+    TrimArgs trim;
+    size_t index = 2;
+    bool trimming = isTrimStrategy(args, index);
+    if (trimming && !parseTrimArgs(args, index, trim))
+        return;
+
+    if (args[0] == XADD && index < args.size() && args[index].find('*') != std::string::npos && result.starts_with('$'))
+    {
+        size_t start = result.find("\r\n") + 2;
+        args[index] = result.substr(start, result.size() - start - 2);
     }
+
+    if (trimming && trim.approximate)
+    {
+        auto stream = m_streams.find(args[1]);
+        auto firstId = stream == m_streams.end() ? std::nullopt : stream->second->FirstEntryId();
+        args[trim.strategyIndex] = firstId ? "MINID" : "MAXLEN";
+        args[trim.strategyIndex + 1] = "=";
+        args[trim.thresholdIndex] = firstId ? firstId->ToString() : "0";
+    }
+}
+
+bool StreamHandler::parseRangeId(const std::string &arg, bool isEnd, StreamId &id)
+{
+    constexpr uint64_t MAX = std::numeric_limits<uint64_t>::max();
+    if (arg == "-" || arg == "+")
+    {
+        id = arg == "-" ? StreamId{0, 0} : StreamId{MAX, MAX};
+        return true;
+    }
+
+    // "(" excludes the ID itself, a bare millisecond part covers all of its sequence numbers
+    bool exclusive = arg.starts_with('(');
+    if (!Stream::ParseId(std::string_view(arg).substr(exclusive), isEnd ? MAX : 0, id))
+        return false;
+    if (!exclusive)
+        return true;
+    return isEnd ? id.Decrement() : id.Increment();
+}
+
+bool StreamHandler::parseCount(const std::string &arg, size_t &count)
+{
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), count);
+    return error == std::errc() && end == arg.data() + arg.size();
+}
+
+void StreamHandler::appendId(std::string &reply, const StreamId &id)
+{
+    char text[41]; // two 20 digit numbers and the dash
+    char *end = std::to_chars(text, text + 20, id.ms).ptr;
+    *end++ = '-';
+    end = std::to_chars(end, text + sizeof(text), id.seq).ptr;
+    RESPEncoder::appendString(reply, std::string_view(text, end - text));
 }
 
-std::tuple<std::vector<std::string>, std::vector<std::string>, std::string> StreamHandler::parseXreadOptions(CommandArray &commandArgs)
+void StreamHandler::appendEntry(std::string &reply, const Stream::Iterator &iterator)
 {
-    std::vector<std::string> streamNames;
-    std::vector<std::string> streamStartIds;
+    RESPEncoder::appendArrayHeader(reply, 2);
+    appendId(reply, iterator.Id());
+    RESPEncoder::appendArrayHeader(reply, 2 * iterator.FieldCount());
+    iterator.ForEachField([&reply](std::string_view field, std::string_view value)
+                          {
+        RESPEncoder::appendString(reply, field);
+        RESPEncoder::appendString(reply, value); });
+}
+
+void StreamHandler::insertArrayHeader(std::string &reply, size_t position, size_t size)
+{
+    std::string header;
+    RESPEncoder::appendArrayHeader(header, size);
+    reply.insert(position, header);
+}
 
-    int count = 1;
-    bool readBlocking = false;
-    std::string blockingVal;
+size_t StreamHandler::appendEntries(std::string &reply, Stream::Iterator &iterator, size_t count)
+{
+    size_t header = reply.size();
+    size_t entries = 0;
+    for (; entries < count && iterator.Next(); ++entries)
+        appendEntry(reply, iterator);
 
-    for (const auto &arg : *commandArgs)
+    insertArrayHeader(reply, header, entries);
+    return entries;
+}
+
+std::string StreamHandler::readStreams(const std::vector<std::string> &streamNames, const std::vector<StreamId> &lastSeenIds, size_t count)
+{
+    constexpr uint64_t MAX = std::numeric_limits<uint64_t>::max();
+
+    std::string reply;
+    size_t streamsWithEntries = 0;
+    for (size_t i = 0; i < streamNames.size(); ++i)
     {
-        if (toLower(arg) == XREAD || toLower(arg) == STREAMS)
+        auto stream = m_streams.find(streamNames[i]);
+        StreamId start = lastSeenIds[i];
+        if (stream == m_streams.end() || !start.Increment())
+            continue;
+
+        // Streams without new entries are left out of the reply
+        size_t mark = reply.size();
+        RESPEncoder::appendArrayHeader(reply, 2);
+        RESPEncoder::appendString(reply, streamNames[i]);
+        Stream::Iterator iterator(*stream->second, start, {MAX, MAX});
+        if (appendEntries(reply, iterator, count) == 0)
         {
-            ++count;
+            reply.resize(mark);
             continue;
         }
+        ++streamsWithEntries;
+    }
+
+    if (streamsWithEntries == 0)
+        return {};
+
+    insertArrayHeader(reply, 0, streamsWithEntries);
+    return reply;
+}
 
-        if (toLower(arg) == "block")
+std::string StreamHandler::xreadHandler(CommandArray commandArgs, const int clientFd)
+{
+    auto &args = *commandArgs;
+
+    // XREAD [COUNT count] [BLOCK milliseconds] STREAMS key [key ...] id [id ...]
+    size_t count = SIZE_MAX, blockMs = 0;
+    bool blocking = false;
+    size_t index = 1;
+    for (; index < args.size(); ++index)
+    {
+        std::string option = toLower(args[index]);
+        if (option == STREAMS)
         {
-            ++count;
-            readBlocking = true;
-            continue;
+            ++index;
+            break;
         }
 
-        if (readBlocking && blockingVal.empty())
+        bool valid = false;
+        if (option == "count" && index + 1 < args.size())
+            valid = parseCount(args[++index], count);
+        else if (option == "block" && index + 1 < args.size())
+            valid = blocking = parseCount(args[++index], blockMs);
+        if (!valid)
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    size_t keys = (args.size() - index) / 2;
+    if (keys == 0 || (args.size() - index) % 2 != 0)
+        return RESPEncoder::encodeError("Unbalanced 'xread' list of streams: for each stream key an ID or '$' must be specified.");
+
+    std::vector<std::string> streamNames(args.begin() + index, args.begin() + index + keys);
+    std::vector<StreamId> lastSeenIds(keys);
+    for (size_t i = 0; i < keys; ++i)
+    {
+        const std::string &id = args[index + keys + i];
+        if (id == "$")
         {
-            blockingVal = arg;
-            ++count;
-            continue;
+            auto stream = m_streams.find(streamNames[i]);
+            if (stream != m_streams.end())
+                lastSeenIds[i] = stream->second->LastId();
         }
+        else if (!Stream::ParseId(id, 0, lastSeenIds[i]))
+        {
+            return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+        }
+    }
 
-        if (count > (commandArgs->size() / 2 + (readBlocking ? 2 : 1))) // Ex: XREAD block 1000 streams stream_key other_stream_key 0-0 0-1
-            streamStartIds.push_back(arg);
-        else
-            streamNames.push_back(arg);
+    std::string reply = readStreams(streamNames, lastSeenIds, count);
+    if (!reply.empty())
+        return reply;
+
+    if (blocking)
+    {
+        processBlockingRead(blockMs, clientFd, std::move(streamNames), std::move(lastSeenIds), count);
+        return NO_REPLY;
+    }
+
+    return "*-1\r\n"; // return nil array if no entries found
+}
+
+void StreamHandler::processBlockingRead(size_t blockMs, const int clientFd, std::vector<std::string> streamNames, std::vector<StreamId> lastSeenIds, size_t count)
+{
+    std::cout << "Going to start Blocking Read..." << std::endl;
+
+    auto sharedEvent = std::make_shared<EventWaiter>();
+    {
+        std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
+        for (size_t i = 0; i < streamNames.size(); ++i)
+            m_blockingStreams[streamNames[i]] = {lastSeenIds[i], sharedEvent};
+    }
+
+    // Default to 10 minutes for BLOCK 0, max wait time supported
+    auto timeout = std::chrono::milliseconds(blockMs == 0 ? 10 * 60 * 1000 : blockMs);
+
+    std::thread blockingThread([this, timeout, clientFd, sharedEvent, streamNames, lastSeenIds, count]()
+    {
+        std::string response;
+        if (sharedEvent->waitForEvent(timeout))
+            response = readStreams(streamNames, lastSeenIds, count);
+
+        if (response.empty())
+            response = "*-1\r\n"; // Timeout, return nil array
+
+        {
+            std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
+            m_blockingStreams.clear();
+        }
+
+        send(clientFd, response.c_str(), response.length(), 0);
+    });
+
+    blockingThread.detach();
+}
+
+
+namespace
+{
+    std::string noGroupError(const std::string &streamName, const std::string &groupName, const std::string &context = "")
+    {
+        return RESPEncoder::encodeError("No such key '" + streamName + "' or consumer group '" + groupName + "'" + context, "NOGROUP");
+    }
 
-        ++count;
+    // Clocks may step back, that's no time passed
+    uint64_t elapsed(uint64_t now, uint64_t since)
+    {
+        return now > since ? now - since : 0;
     }
+}
 
-    std::cout << "Streams to read: " << streamNames.size() << ", Start Ids: " << streamStartIds.size() << std::endl;
+uint64_t StreamHandler::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-    return {std::move(streamNames), std::move(streamStartIds), std::move(blockingVal)};
+ConsumerGroup *StreamHandler::findGroup(const std::string &streamName, const std::string &groupName) const
+{
+    auto stream = m_streams.find(streamName);
+    return stream == m_streams.end() ? nullptr : stream->second->FindGroup(groupName);
 }
 
-std::string StreamHandler::xreadHandler(CommandArray commandArgs, const int clientFd)
+Consumer &StreamHandler::addConsumer(const std::string &streamName, const std::string &groupName, ConsumerGroup &group, const std::string &name, uint64_t now)
 {
-    // validate command
-    if (commandArgs->size() < 4 || commandArgs->size() % 2 != 0)
-        return RESPEncoder::encodeError("wrong number of arguments for 'xread' command");
+    auto [consumer, created] = group.AddConsumer(name, now);
+    if (created)
+        m_effects.push_back({XGROUP, "CREATECONSUMER", streamName, groupName, name});
+    return *consumer;
+}
 
-    auto [streamNames, streamStartIds, blockingVal] = parseXreadOptions(commandArgs);
-    std::vector<std::string> mainReturnArray;
+void StreamHandler::propagateClaim(const std::string &streamName, const std::string &groupName, const ConsumerGroup &group, const PendingEntry &entry)
+{
+    m_effects.push_back({XCLAIM, streamName, groupName, entry.consumer->name, "0", entry.id.ToString(),
+                         "TIME", std::to_string(entry.deliveryTime), "RETRYCOUNT", std::to_string(entry.deliveryCount),
+                         "FORCE", "JUSTID", "LASTID", group.LastDelivered().ToString()});
+}
 
-    // Process the streams
-    for (size_t i = 0; i < streamNames.size(); ++i)
+size_t StreamHandler::appendNewEntries(std::string &reply, const std::string &streamName, const std::string &groupName, Stream &stream, ConsumerGroup &group,
+                                       Consumer &consumer, size_t count, bool noAck, uint64_t now)
+{
+    constexpr uint64_t MAX = std::numeric_limits<uint64_t>::max();
+
+    size_t header = reply.size();
+    size_t entries = 0;
+    StreamId start = group.LastDelivered();
+    if (start.Increment())
     {
-        const auto &streamName = streamNames[i];
-        auto &streamStartId = streamStartIds[i];
+        Stream::Iterator iterator(stream, start, {MAX, MAX});
+        for (; entries < count && iterator.Next(); ++entries)
+        {
+            appendEntry(reply, iterator);
+            group.SetLastDelivered(iterator.Id());
+            if (!noAck)
+                propagateClaim(streamName, groupName, group, group.Deliver(iterator.Id(), consumer, now));
+        }
+    }
 
-        std::cout << "Processing stream: " << streamName << " from Id: " << streamStartId << std::endl;
+    // Nothing went pending, only the cursor moved
+    if (entries > 0 && noAck)
+        m_effects.push_back({XGROUP, "SETID", streamName, groupName, group.LastDelivered().ToString()});
+    if (entries > 0)
+        consumer.activeTime = now;
+    insertArrayHeader(reply, header, entries);
+    return entries;
+}
 
-        if (streamStartId == "$")
-            streamStartId = m_streams[streamName]->getLatestEntryId();
+size_t StreamHandler::appendPendingEntries(std::string &reply, const std::string &streamName, const std::string &groupName, Stream &stream, ConsumerGroup &group,
+                                           Consumer &consumer, const StreamId &after, size_t count, uint64_t now)
+{
+    size_t header = reply.size();
+    size_t entries = 0;
+    for (StreamId *pending = consumer.pending.After(after); pending && entries < count; ++entries)
+    {
+        StreamId id = *pending;
+        PendingEntry *entry = group.Pending().Find(id);
+        entry->deliveryTime = now;
+        ++entry->deliveryCount;
 
-        // Get the entries for the stream
-        auto entries = m_streams[streamName]->GetEntriesInRange(streamStartId, "+", true /* exclusiveStart */);
-        if (entries.empty())
+        Stream::Iterator iterator(stream, id, id);
+        if (iterator.Next())
+        {
+            appendEntry(reply, iterator);
+            propagateClaim(streamName, groupName, group, *entry);
+        }
+        else
+        {
+            // Deleted since it was delivered. Left to the next claim, which acknowledges it everywhere
+            RESPEncoder::appendArrayHeader(reply, 2);
+            appendId(reply, id);
+            reply.append("*-1\r\n");
+        }
+        pending = consumer.pending.After(id);
+    }
+
+    insertArrayHeader(reply, header, entries);
+    return entries;
+}
+
+std::string StreamHandler::readGroups(const GroupRead &read)
+{
+    uint64_t now = nowMs();
+    std::string reply;
+    size_t streamsWithEntries = 0;
+    for (size_t i = 0; i < read.streamNames.size(); ++i)
+    {
+        const std::string &streamName = read.streamNames[i];
+        ConsumerGroup *group = findGroup(streamName, read.group);
+        if (!group)
+            return noGroupError(streamName, read.group, " in XREADGROUP with GROUP option");
+
+        Consumer &consumer = addConsumer(streamName, read.group, *group, read.consumer, now);
+        consumer.seenTime = now;
+
+        // Streams without new entries are left out of the reply, the consumer's history is always in it
+        size_t mark = reply.size();
+        RESPEncoder::appendArrayHeader(reply, 2);
+        RESPEncoder::appendString(reply, streamName);
+        Stream &stream = *m_streams.at(streamName);
+        if (read.after[i])
+            appendPendingEntries(reply, streamName, read.group, stream, *group, consumer, *read.after[i], read.count, now);
+        else if (appendNewEntries(reply, streamName, read.group, stream, *group, consumer, read.count, read.noAck, now) == 0)
+        {
+            reply.resize(mark);
             continue;
+        }
+        ++streamsWithEntries;
+    }
+
+    if (streamsWithEntries == 0)
+        return {};
+
+    insertArrayHeader(reply, 0, streamsWithEntries);
+    return reply;
+}
 
-        std::vector<std::string> streamArray;
-        std::vector<std::string> entriesArray;
+std::string StreamHandler::xreadgroupHandler(CommandArray commandArgs, const int clientFd)
+{
+    auto &args = *commandArgs;
 
-        streamArray.push_back(RESPEncoder::encodeString(streamName));
+    // XREADGROUP GROUP group consumer [COUNT count] [BLOCK milliseconds] [NOACK] STREAMS key [key ...] id [id ...]
+    if (args.size() < 4 || toLower(args[1]) != "group")
+        return RESPEncoder::encodeError("syntax error");
 
-        for (const auto &entry : entries)
+    GroupRead read{args[2], args[3]};
+    size_t blockMs = 0;
+    bool blocking = false;
+    size_t index = 4;
+    for (; index < args.size(); ++index)
+    {
+        std::string option = toLower(args[index]);
+        if (option == STREAMS)
         {
-            // Format each entry into RESP
-            std::vector<std::string> entryArray, keyvalueArray;
-            entryArray.push_back(RESPEncoder::encodeString(entry.first)); // Entry ID
+            ++index;
+            break;
+        }
+
+        bool valid = false;
+        if (option == "count" && index + 1 < args.size())
+            valid = parseCount(args[++index], read.count);
+        else if (option == "block" && index + 1 < args.size())
+            valid = blocking = parseCount(args[++index], blockMs);
+        else if (option == "noack")
+            valid = read.noAck = true;
+        if (!valid)
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    size_t keys = (args.size() - index) / 2;
+    if (keys == 0 || (args.size() - index) % 2 != 0)
+        return RESPEncoder::encodeError("Unbalanced 'xreadgroup' list of streams: for each stream key an ID or '>' must be specified.");
+
+    read.streamNames.assign(args.begin() + index, args.begin() + index + keys);
+    read.after.resize(keys);
+    for (size_t i = 0; i < keys; ++i)
+    {
+        const std::string &id = args[index + keys + i];
+        StreamId after;
+        if (id != ">" && !Stream::ParseId(id, 0, after))
+            return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+        if (id != ">")
+            read.after[i] = after;
+
+        if (!findGroup(read.streamNames[i], read.group))
+            return noGroupError(read.streamNames[i], read.group, " in XREADGROUP with GROUP option");
+    }
+
+    // Only reads of new entries come back empty, history replies always have the stream in them
+    std::string reply = readGroups(read);
+    if (!reply.empty())
+        return reply;
 
-            for (const auto &kv : entry.second)
+    if (blocking)
+    {
+        processBlockingGroupRead(blockMs, clientFd, std::move(read));
+        return NO_REPLY;
+    }
+
+    return "*-1\r\n";
+}
+
+void StreamHandler::processBlockingGroupRead(size_t blockMs, const int clientFd, GroupRead read)
+{
+    auto waiter = std::make_shared<GroupWaiter>();
+    waiter->read = std::move(read);
+    {
+        std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
+        for (const auto &streamName : waiter->read.streamNames)
+            m_groupWaiters[streamName].push_back(waiter);
+    }
+
+    // Default to 10 minutes for BLOCK 0, as XREAD does
+    auto timeout = std::chrono::milliseconds(blockMs == 0 ? 10 * 60 * 1000 : blockMs);
+
+    // XADD delivers the entries on the main thread, here the reply is only sent
+    std::thread blockingThread([this, timeout, clientFd, waiter]()
+    {
+        waiter->event.waitForEvent(timeout);
+        {
+            std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
+            if (!waiter->done)
             {
-                keyvalueArray.push_back(RESPEncoder::encodeString(kv.first));
-                keyvalueArray.push_back(RESPEncoder::encodeString(kv.second));
+                waiter->done = true;
+                dropGroupWaiter(*waiter);
             }
-            entryArray.push_back(RESPEncoder::encodeArray(keyvalueArray, true /* dontEncodeItems */));
-            entriesArray.push_back(RESPEncoder::encodeArray(entryArray, true));
         }
 
-        streamArray.push_back(RESPEncoder::encodeArray(entriesArray, true));
-        mainReturnArray.push_back(RESPEncoder::encodeArray(streamArray, true));
-    }
+        std::string response = waiter->reply.empty() ? "*-1\r\n" : waiter->reply; // Timeout, return nil array
+        send(clientFd, response.c_str(), response.length(), 0);
+    });
+
+    blockingThread.detach();
+}
 
-    if (mainReturnArray.empty() && !blockingVal.empty())
+void StreamHandler::serveGroupWaiters(const std::string &streamName)
+{
+    auto waiting = m_groupWaiters.find(streamName);
+    if (waiting == m_groupWaiters.end())
+        return;
+
+    // Each one takes what is new for its group before the next one looks. Served ones leave the queues,
+    // so this goes over a copy
+    auto waiters = waiting->second;
+    for (const auto &waiter : waiters)
     {
-        processBlockingRead(blockingVal, clientFd, std::move(streamNames), std::move(streamStartIds));
-        return NO_REPLY;
+        std::string reply = readGroups(waiter->read);
+        if (reply.empty())
+            continue;
+
+        waiter->reply = std::move(reply);
+        waiter->done = true;
+        dropGroupWaiter(*waiter);
+        waiter->event.setEvent();
     }
+}
 
-    if (mainReturnArray.empty())
-        return "*-1\r\n"; // return nil array if no entries found
+void StreamHandler::dropGroupWaiter(const GroupWaiter &waiter)
+{
+    for (const auto &streamName : waiter.read.streamNames)
+    {
+        auto waiting = m_groupWaiters.find(streamName);
+        if (waiting == m_groupWaiters.end())
+            continue;
 
-    return RESPEncoder::encodeArray(mainReturnArray, true);
+        std::erase_if(waiting->second, [&waiter](const auto &queued)
+                      { return queued.get() == &waiter; });
+        if (waiting->second.empty())
+            m_groupWaiters.erase(waiting);
+    }
 }
 
-void StreamHandler::processBlockingRead(const std::string &blockingVal, const int clientFd, std::vector<std::string> streamNames, std::vector<std::string> streamStartIds)
+std::string StreamHandler::xgroupHandler(CommandArray commandArgs)
 {
-    std::cout << "Going to start Blocking Read..." << std::endl;
+    auto &args = *commandArgs;
+
+    // XGROUP CREATE key group id|$ [MKSTREAM], SETID key group id|$, DESTROY key group,
+    //        CREATECONSUMER key group consumer, DELCONSUMER key group consumer
+    std::string subcommand = args.size() > 1 ? toLower(args[1]) : "";
+    if (subcommand != "create" && subcommand != "setid" && subcommand != "destroy" && subcommand != "createconsumer" && subcommand != "delconsumer")
+        return RESPEncoder::encodeError("unknown subcommand '" + (args.size() > 1 ? args[1] : "") + "'. Try XGROUP HELP.");
+
+    bool mkStream = subcommand == "create" && args.size() == 6 && toLower(args[5]) == "mkstream";
+    if (args.size() != (subcommand == "destroy" ? 4 : 5) && !mkStream)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xgroup|" + subcommand + "' command");
+
+    const std::string &streamName = args[2];
+    const std::string &groupName = args[3];
+    auto stream = m_streams.find(streamName);
+    if (stream == m_streams.end())
+    {
+        if (!mkStream)
+            return RESPEncoder::encodeError("The XGROUP subcommand requires the key to exist. Note that for CREATE you may want to use the MKSTREAM option to create an empty stream automatically.");
+        stream = m_streams.emplace(streamName, std::make_unique<Stream>(streamName)).first;
+    }
 
-    std::atomic<bool> shouldStop = false;
-    std::vector<std::thread> threads;
+    if (subcommand == "destroy")
+        return RESPEncoder::encodeInteger(stream->second->DestroyGroup(groupName));
 
-    auto sharedEvent = std::make_shared<EventWaiter>();
+    // "$" is the stream's last ID
+    StreamId lastDelivered = stream->second->LastId();
+    bool takesId = subcommand == "create" || subcommand == "setid";
+    if (takesId && args[4] != "$" && !Stream::ParseId(args[4], 0, lastDelivered))
+        return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
 
-    for (const auto &[index, streamName] : streamNames | std::views::enumerate)
+    if (subcommand == "create")
     {
-        const auto &streamStartId = streamStartIds[index];
-        std::string waitEntryId = streamStartId;
+        if (!stream->second->CreateGroup(groupName, lastDelivered))
+            return RESPEncoder::encodeError("Consumer Group name already exists", "BUSYGROUP");
+        return RESPEncoder::encodeSimpleString("OK");
+    }
 
-        if (streamStartId == "$")
-            waitEntryId = m_streams[streamName]->getLatestEntryId();
+    ConsumerGroup *group = stream->second->FindGroup(groupName);
+    if (!group)
+        return RESPEncoder::encodeError("No such consumer group '" + groupName + "' for key name '" + streamName + "'", "NOGROUP");
 
-        {
-            std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
+    if (subcommand == "setid")
+    {
+        group->SetLastDelivered(lastDelivered);
+        return RESPEncoder::encodeSimpleString("OK");
+    }
+    if (subcommand == "createconsumer")
+        return RESPEncoder::encodeInteger(group->AddConsumer(args[4], nowMs()).second);
+    return RESPEncoder::encodeInteger(group->DeleteConsumer(args[4]));
+}
+
+std::string StreamHandler::xackHandler(CommandArray commandArgs)
+{
+    auto &args = *commandArgs;
+
+    // XACK key group id [id ...]
+    if (args.size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xack' command");
+
+    std::vector<StreamId> ids(args.size() - 3);
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (!Stream::ParseId(args[i + 3], 0, ids[i]))
+            return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+    }
+
+    ConsumerGroup *group = findGroup(args[1], args[2]);
+    if (!group)
+        return RESPEncoder::encodeInteger(0);
 
-            m_blockingStreams[streamName].first = waitEntryId;
-            m_blockingStreams[streamName].second = sharedEvent;
+    long long acked = 0;
+    for (const auto &id : ids)
+        acked += group->Ack(id);
+    return RESPEncoder::encodeInteger(acked);
+}
+
+std::string StreamHandler::xpendingHandler(CommandArray commandArgs)
+{
+    auto &args = *commandArgs;
+
+    // XPENDING key group [[IDLE min-idle-time] start end count [consumer]]
+    if (args.size() < 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xpending' command");
+
+    ConsumerGroup *group = findGroup(args[1], args[2]);
+    if (!group)
+        return noGroupError(args[1], args[2]);
+
+    const auto &pending = group->Pending();
+    std::string reply;
+    if (args.size() == 3)
+    {
+        // Summary: how many, the smallest and the largest ID, and how many each consumer has
+        RESPEncoder::appendArrayHeader(reply, 4);
+        reply.append(RESPEncoder::encodeInteger(pending.Size()));
+        if (pending.Empty())
+            return reply.append("$-1\r\n$-1\r\n*-1\r\n");
+
+        appendId(reply, pending.First()->id);
+        appendId(reply, pending.Last()->id);
+        size_t header = reply.size();
+        size_t consumers = 0;
+        for (const auto &[name, consumer] : group->Consumers())
+        {
+            if (consumer.pending.Empty())
+                continue;
+            RESPEncoder::appendArrayHeader(reply, 2);
+            RESPEncoder::appendString(reply, name);
+            RESPEncoder::appendString(reply, std::to_string(consumer.pending.Size()));
+            ++consumers;
         }
+        insertArrayHeader(reply, header, consumers);
+        return reply;
+    }
 
+    size_t index = 3;
+    size_t minIdle = 0;
+    if (toLower(args[index]) == "idle")
+    {
+        if (args.size() < 5 || !parseCount(args[4], minIdle))
+            return RESPEncoder::encodeError("syntax error");
+        index = 5;
     }
 
-    std::string blockingValLocal = blockingVal; 
-    if (blockingVal == "0")
-        blockingValLocal = std::to_string(10 * 60 * 1000); // Default to 10 minutes, max wait time supported
+    StreamId start, end;
+    size_t count = 0;
+    if ((args.size() != index + 3 && args.size() != index + 4) || !parseRangeId(args[index], false, start) ||
+        !parseRangeId(args[index + 1], true, end) || !parseCount(args[index + 2], count))
+        return RESPEncoder::encodeError("syntax error");
 
-    std::thread blockingThread([this, blockingValLocal, clientFd, sharedEvent, streamNames, streamStartIds]()
+    Consumer *only = nullptr;
+    if (args.size() == index + 4 && !(only = group->FindConsumer(args[index + 3])))
+        return "*0\r\n";
+
+    uint64_t now = nowMs();
+    size_t entries = 0;
+    auto appendPending = [&](const PendingEntry &entry)
     {
-        bool eventOccurred = sharedEvent->waitForEvent(std::chrono::milliseconds(std::stoul(blockingValLocal)));
-        std::string response;
+        uint64_t idle = elapsed(now, entry.deliveryTime);
+        if (idle < minIdle)
+            return;
+        RESPEncoder::appendArrayHeader(reply, 4);
+        appendId(reply, entry.id);
+        RESPEncoder::appendString(reply, entry.consumer->name);
+        reply.append(RESPEncoder::encodeInteger(idle));
+        reply.append(RESPEncoder::encodeInteger(entry.deliveryCount));
+        ++entries;
+    };
+
+    // One consumer's entries come from its own list, the group's has everyone else's in between
+    if (only)
+    {
+        for (StreamId *id = only->pending.LowerBound(start); id && *id <= end && entries < count; id = only->pending.After(*id))
+            appendPending(*pending.Find(*id));
+    }
+    else
+    {
+        for (PendingEntry *entry = pending.LowerBound(start); entry && entry->id <= end && entries < count; entry = pending.After(entry->id))
+            appendPending(*entry);
+    }
+
+    insertArrayHeader(reply, 0, entries);
+    return reply;
+}
 
-        if (eventOccurred)
+std::string StreamHandler::xclaimHandler(CommandArray commandArgs)
+{
+    auto &args = *commandArgs;
+
+    // XCLAIM key group consumer min-idle-time id [id ...] [IDLE ms] [TIME unix-time-milliseconds]
+    //        [RETRYCOUNT count] [FORCE] [JUSTID] [LASTID lastid]
+    if (args.size() < 6)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xclaim' command");
+
+    size_t minIdle = 0;
+    if (!parseCount(args[4], minIdle))
+        return RESPEncoder::encodeError("Invalid min-idle-time argument for XCLAIM");
+
+    // IDs up to the first option
+    std::vector<StreamId> ids;
+    size_t index = 5;
+    for (StreamId id; index < args.size() && Stream::ParseId(args[index], 0, id); ++index)
+        ids.push_back(id);
+    if (ids.empty())
+        return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+
+    uint64_t now = nowMs();
+    uint64_t deliveryTime = now;
+    std::optional<size_t> retryCount;
+    std::optional<StreamId> lastId;
+    bool force = false, justId = false;
+    for (; index < args.size(); ++index)
+    {
+        std::string option = toLower(args[index]);
+        size_t value = 0;
+        StreamId id;
+        bool valid = false;
+        if (option == "force")
+            valid = force = true;
+        else if (option == "justid")
+            valid = justId = true;
+        else if (index + 1 >= args.size())
+            valid = false;
+        else if (option == "idle" && (valid = parseCount(args[++index], value)))
+            deliveryTime = now - std::min<uint64_t>(value, now);
+        else if (option == "time" && (valid = parseCount(args[++index], value)))
+            deliveryTime = value;
+        else if (option == "retrycount" && (valid = parseCount(args[++index], value)))
+            retryCount = value;
+        else if (option == "lastid" && (valid = Stream::ParseId(args[++index], 0, id)))
+            lastId = id;
+        if (!valid)
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    ConsumerGroup *group = findGroup(args[1], args[2]);
+    if (!group)
+        return noGroupError(args[1], args[2]);
+    bool movedCursor = lastId && *lastId > group->LastDelivered();
+    if (movedCursor)
+        group->SetLastDelivered(*lastId);
+
+    Stream &stream = *m_streams.at(args[1]);
+    Consumer &consumer = addConsumer(args[1], args[2], *group, args[3], now);
+    consumer.seenTime = now;
+
+    std::string reply;
+    size_t claimed = 0;
+    for (const auto &id : ids)
+    {
+        Stream::Iterator iterator(stream, id, id);
+        bool exists = iterator.Next();
+        PendingEntry *entry = group->Pending().Find(id);
+
+        // FORCE makes entries that exist pending even if they weren't, idle or not
+        bool forced = !entry && force && exists;
+        if (forced)
         {
-            // Form new xread command to fetch new entries
-            std::vector<std::string> commandArgs = {XREAD, STREAMS};
-            for (const auto& streamName : streamNames)
-            {
-                commandArgs.push_back(streamName);
-            }
-            for (const auto& streamId : streamStartIds)
-            {
-                commandArgs.push_back(streamId);
-            }
+            entry = &group->Deliver(id, consumer, now);
+            entry->deliveryCount = 0;
+        }
+        if (!entry)
+            continue;
 
-            response = xreadHandler(std::make_unique<std::vector<std::string>>(commandArgs), clientFd);
+        if (!exists)
+        {
+            // Deleted since it was delivered, no consumer can process it any more
+            group->Ack(id);
+            m_effects.push_back({XACK, args[1], args[2], id.ToString()});
+            continue;
         }
+        if (!forced && elapsed(now, entry->deliveryTime) < minIdle)
+            continue;
+
+        group->Transfer(*entry, consumer);
+        entry->deliveryTime = deliveryTime;
+        if (retryCount)
+            entry->deliveryCount = *retryCount;
+        else if (!justId)
+            ++entry->deliveryCount;
+        consumer.activeTime = now;
+        propagateClaim(args[1], args[2], *group, *entry);
+
+        if (justId)
+            appendId(reply, id);
         else
+            appendEntry(reply, iterator);
+        ++claimed;
+    }
+
+    // The claims carry LASTID, without any the cursor moves on its own
+    if (movedCursor && claimed == 0)
+        m_effects.push_back({XGROUP, "SETID", args[1], args[2], group->LastDelivered().ToString()});
+    insertArrayHeader(reply, 0, claimed);
+    return reply;
+}
+
+std::string StreamHandler::xautoclaimHandler(CommandArray commandArgs)
+{
+    auto &args = *commandArgs;
+
+    // XAUTOCLAIM key group consumer min-idle-time start [COUNT count] [JUSTID]
+    if (args.size() < 6)
+        return RESPEncoder::encodeError("wrong number of arguments for 'xautoclaim' command");
+
+    size_t minIdle = 0, count = 100;
+    StreamId start;
+    bool justId = false;
+    if (!parseCount(args[4], minIdle))
+        return RESPEncoder::encodeError("Invalid min-idle-time argument for XAUTOCLAIM");
+    if (!parseRangeId(args[5], false, start))
+        return RESPEncoder::encodeError("Invalid stream ID specified as stream command argument");
+    for (size_t index = 6; index < args.size(); ++index)
+    {
+        std::string option = toLower(args[index]);
+        bool valid = false;
+        if (option == "justid")
+            valid = justId = true;
+        else if (option == "count" && index + 1 < args.size())
+            valid = parseCount(args[++index], count) && count > 0;
+        if (!valid)
+            return RESPEncoder::encodeError("syntax error");
+    }
+
+    ConsumerGroup *group = findGroup(args[1], args[2]);
+    if (!group)
+        return noGroupError(args[1], args[2]);
+
+    Stream &stream = *m_streams.at(args[1]);
+    uint64_t now = nowMs();
+    Consumer &consumer = addConsumer(args[1], args[2], *group, args[3], now);
+    consumer.seenTime = now;
+
+    // Looks at no more than 10 pending entries per one it may claim, a long run of fresh ones doesn't stall the server
+    size_t attempts = count < SIZE_MAX / 10 ? count * 10 : SIZE_MAX;
+    std::string claimed, deleted;
+    size_t claimedCount = 0, deletedCount = 0;
+    PendingEntry *entry = group->Pending().LowerBound(start);
+    for (; entry && attempts > 0 && claimedCount < count; --attempts)
+    {
+        StreamId id = entry->id;
+        Stream::Iterator iterator(stream, id, id);
+        if (!iterator.Next())
         {
-            response = "*-1\r\n"; // Timeout, return nil array
+            // Deleted since it was delivered, dropped from the PEL and reported
+            group->Ack(id);
+            m_effects.push_back({XACK, args[1], args[2], id.ToString()});
+            appendId(deleted, id);
+            ++deletedCount;
         }
+        else if (elapsed(now, entry->deliveryTime) >= minIdle)
+        {
+            group->Transfer(*entry, consumer);
+            entry->deliveryTime = now;
+            if (!justId)
+                ++entry->deliveryCount;
+            consumer.activeTime = now;
+            propagateClaim(args[1], args[2], *group, *entry);
+
+            if (justId)
+                appendId(claimed, id);
+            else
+                appendEntry(claimed, iterator);
+            ++claimedCount;
+        }
+        entry = group->Pending().After(id);
+    }
+
+    // Where the next call should start, 0-0 once the whole PEL was looked at
+    std::string reply;
+    RESPEncoder::appendArrayHeader(reply, 3);
+    appendId(reply, entry ? entry->id : StreamId{});
+    RESPEncoder::appendArrayHeader(reply, claimedCount);
+    reply.append(claimed);
+    RESPEncoder::appendArrayHeader(reply, deletedCount);
+    reply.append(deleted);
+    return reply;
+}
 
+std::string StreamHandler::xinfoHandler(CommandArray commandArgs)
+{
+    auto &args = *commandArgs;
+
+    // XINFO STREAM key, GROUPS key, CONSUMERS key group
+    std::string subcommand = args.size() > 1 ? toLower(args[1]) : "";
+    if (subcommand != "stream" && subcommand != "groups" && subcommand != "consumers")
+        return RESPEncoder::encodeError("unknown subcommand '" + (args.size() > 1 ? args[1] : "") + "'. Try XINFO HELP.");
+    if (args.size() != (subcommand == "consumers" ? 4 : 3))
+        return RESPEncoder::encodeError("wrong number of arguments for 'xinfo|" + subcommand + "' command");
+
+    auto stream = m_streams.find(args[2]);
+    if (stream == m_streams.end())
+        return RESPEncoder::encodeError("no such key");
+
+    std::string reply;
+    if (subcommand == "stream")
+    {
+        constexpr uint64_t MAX = std::numeric_limits<uint64_t>::max();
+
+        RESPEncoder::appendArrayHeader(reply, 12);
+        RESPEncoder::appendString(reply, "length");
+        reply.append(RESPEncoder::encodeInteger(stream->second->Length()));
+        RESPEncoder::appendString(reply, "radix-tree-keys");
+        reply.append(RESPEncoder::encodeInteger(stream->second->NodeCount()));
+        RESPEncoder::appendString(reply, "last-generated-id");
+        appendId(reply, stream->second->LastId());
+        RESPEncoder::appendString(reply, "groups");
+        reply.append(RESPEncoder::encodeInteger(stream->second->Groups().size()));
+        for (bool last : {false, true})
         {
-            std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
-            m_blockingStreams.clear();
+            RESPEncoder::appendString(reply, last ? "last-entry" : "first-entry");
+            Stream::Iterator iterator(*stream->second, {}, {MAX, MAX}, last);
+            if (iterator.Next())
+                appendEntry(reply, iterator);
+            else
+                reply.append("$-1\r\n");
         }
+        return reply;
+    }
 
-        std::cout << "Sending response from blocking thread..." << response << std::endl;
-        send(clientFd, response.c_str(), response.length(), 0);
-    });
+    if (subcommand == "groups")
+    {
+        RESPEncoder::appendArrayHeader(reply, stream->second->Groups().size());
+        for (const auto &[name, group] : stream->second->Groups())
+        {
+            RESPEncoder::appendArrayHeader(reply, 8);
+            RESPEncoder::appendString(reply, "name");
+            RESPEncoder::appendString(reply, name);
+            RESPEncoder::appendString(reply, "consumers");
+            reply.append(RESPEncoder::encodeInteger(group->Consumers().size()));
+            RESPEncoder::appendString(reply, "pending");
+            reply.append(RESPEncoder::encodeInteger(group->Pending().Size()));
+            RESPEncoder::appendString(reply, "last-delivered-id");
+            appendId(reply, group->LastDelivered());
+        }
+        return reply;
+    }
 
-    blockingThread.detach();
+    ConsumerGroup *group = stream->second->FindGroup(args[3]);
+    if (!group)
+        return noGroupError(args[2], args[3]);
 
-    //     threads.emplace_back([this, streamName, blockingVal, clientFd, &shouldStop]()
-    //     {
-    //         bool eventOccurred = false;
-
-    //         if (blockingVal == "0")
-    //         {
-    //             // Wait indefinitely but check for stop signal
-    //             while (!shouldStop.load() && !eventOccurred)
-    //             {
-    //                 std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
-
-    //                 eventOccurred = m_blockingStreams[streamName].second->waitForEvent(
-    //                     std::chrono::milliseconds(100)); // Short timeout to check stop flag
-    //             }
-
-    //         }
-    //         else
-    //         {
-    //             auto timeout = std::chrono::milliseconds(std::stoul(blockingVal));
-    //             auto deadline = std::chrono::steady_clock::now() + timeout;
-                
-    //             while (!shouldStop.load() && std::chrono::steady_clock::now() < deadline && !eventOccurred)
-    //             {
-    //                 std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
-
-    //                 auto remaining = deadline - std::chrono::steady_clock::now();
-    //                 auto waitTime = std::min(std::chrono::duration_cast<std::chrono::milliseconds>(remaining), std::chrono::milliseconds(100));
-                    
-    //                 eventOccurred = m_blockingStreams[streamName].second->waitForEvent(waitTime);
-    //             }
-    //         }
-
-    //         if (!shouldStop.load())
-    //         {
-    //             // Use compare_and_swap to ensure only one thread responds
-    //             bool expected = false;
-    //             if (shouldStop.compare_exchange_strong(expected, true))
-    //             {
-    //                 std::string response = xreadHandler(std::make_unique<std::vector<std::string>>(
-    //                     std::vector<std::string>{XREAD, STREAMS, streamName, m_blockingStreams[streamName].first}),
-    //                     clientFd);
-
-    //                 std::cout << "Sending response from blocking thread..." << response << std::endl;
-    //                 send(clientFd, response.c_str(), response.length(), 0);
-    //             }
-
-    //         }
-
-    //         // Clean up
-    //         {
-    //             std::lock_guard<std::mutex> lock(m_blockingStreamsMutex);
-    //             m_blockingStreams.erase(streamName);
-    //         }
-    //     });
-
-    // }
-
-    // for (auto &t : threads)
-    // {
-    //     t.detach();
-    // }
+    // idle: since it last read or claimed, inactive: since it last got entries (-1 if never)
+    uint64_t now = nowMs();
+    RESPEncoder::appendArrayHeader(reply, group->Consumers().size());
+    for (const auto &[name, consumer] : group->Consumers())
+    {
+        RESPEncoder::appendArrayHeader(reply, 8);
+        RESPEncoder::appendString(reply, "name");
+        RESPEncoder::appendString(reply, name);
+        RESPEncoder::appendString(reply, "pending");
+        reply.append(RESPEncoder::encodeInteger(consumer.pending.Size()));
+        RESPEncoder::appendString(reply, "idle");
+        reply.append(RESPEncoder::encodeInteger(elapsed(now, consumer.seenTime)));
+        RESPEncoder::appendString(reply, "inactive");
+        reply.append(RESPEncoder::encodeInteger(consumer.activeTime ? static_cast<long long>(elapsed(now, consumer.activeTime)) : -1));
+    }
+    return reply;
 }
 
+
+void StreamHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_streams))
+    {
+        writer.WriteKey(RDB_TYPE_STREAM, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void StreamHandler::LoadRdb(RdbReader &reader, uint8_t, const std::string &key)
+{
+    m_streams[key] = Stream::Deserialize(key, reader.ReadString());
+}
+
+void StreamHandler::MergeFrom(StreamHandler &other)
+{
+    m_streams.merge(other.m_streams);
+}
+
+void StreamHandler::Swap(StreamHandler &other)
+{
+    m_streams.swap(other.m_streams);
+}
+
+void StreamHandler::EnableTiering(const std::string &dir, uint64_t coldAfterMs)
+{
+    m_tier = std::make_unique<StreamTier>(dir, coldAfterMs);
+}
+
+void StreamHandler::SpillColdNodes()
+{
+    uint64_t now = nowMs();
+    if (!m_tier || now < m_lastSpill + 1000 || now < m_tier->ColdAfterMs())
+        return;
+    m_lastSpill = now;
+
+    for (auto &[name, stream] : m_streams)
+        stream->SpillOlderThan(now - m_tier->ColdAfterMs(), *m_tier);
+}
+
+void StreamHandler::ReleaseColdNodes()
+{
+    for (auto &[name, stream] : m_streams)
+        stream->ReleaseColdNodes();
+}
@@ -6,30 +6,132 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <deque>
+#include <optional>
 
 #include "Utility.h"
 #include "Stream.h"
+#include "ConsumerGroup.h"
 
 using CommandArray = std::unique_ptr<std::vector<std::string>>;
 
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
 class StreamHandler
 {
 private:
+    std::unique_ptr<StreamTier> m_tier; // before the streams, their cold nodes are released into it
+    uint64_t m_lastSpill{};
     std::unordered_map<std::string, std::unique_ptr<Stream>> m_streams;
     std::mutex m_blockingStreamsMutex;
-    std::unordered_map<std::string, std::pair<std::string, std::shared_ptr<EventWaiter>>> m_blockingStreams; /* streamName, pair(streamId, EventWaiter) */
+    std::unordered_map<std::string, std::pair<StreamId, std::shared_ptr<EventWaiter>>> m_blockingStreams; /* streamName, pair(last seen Id, EventWaiter) */
+
+    /* XREADGROUP arguments, also what a blocked one needs to be served later */
+    struct GroupRead
+    {
+        std::string group{};
+        std::string consumer{};
+        std::vector<std::string> streamNames{};
+        std::vector<std::optional<StreamId>> after{}; // the consumer's pending entries after the ID, or nullopt for new entries (">")
+        size_t count{SIZE_MAX};
+        bool noAck{};
+    };
+
+    struct GroupWaiter
+    {
+        GroupRead read;
+        bool done{}; // served or timed out, under m_blockingStreamsMutex
+        std::string reply;
+        EventWaiter event;
+    };
+    std::unordered_map<std::string, std::deque<std::shared_ptr<GroupWaiter>>> m_groupWaiters; /* streamName, blocked XREADGROUPs oldest first */
+    std::vector<std::vector<std::string>> m_effects; /* what group reads and claims did, see TakeEffects */
+
+    /* MAXLEN|MINID [=|~] threshold */
+    struct TrimArgs
+    {
+        bool byLength{};
+        bool approximate{};
+        size_t maxLength{};
+        StreamId minId;
+        size_t strategyIndex{}; // where the arguments are in the command
+        size_t thresholdIndex{};
+    };
 
     std::tuple<unsigned long, unsigned long> parseEntryId(const std::string& streamName, const std::string &entryId);
+    static bool isTrimStrategy(const std::vector<std::string> &args, size_t index);
+    static bool parseTrimArgs(const std::vector<std::string> &args, size_t &index, TrimArgs &trim);
+    static uint64_t applyTrim(Stream &stream, const TrimArgs &trim);
+    static bool parseRangeId(const std::string &arg, bool isEnd, StreamId &id);
+    static bool parseCount(const std::string &arg, size_t &count);
     std::string xaddHandler(CommandArray commandArgs);
-    std::string xrangeHandler(CommandArray commandArgs);
-    
-    std::tuple<std::vector<std::string>, std::vector<std::string>, std::string> parseXreadOptions(CommandArray& commandArgs);
+    std::string xrangeHandler(CommandArray commandArgs, bool reverse);
+    std::string xtrimHandler(CommandArray commandArgs);
+    std::string xdelHandler(CommandArray commandArgs);
+    std::string xlenHandler(CommandArray commandArgs);
+
+    static void appendId(std::string &reply, const StreamId &id);
+    /* [id, [field, value, ...]] of the entry the iterator is on */
+    static void appendEntry(std::string &reply, const Stream::Iterator &iterator);
+    /* For arrays whose length is only known once the items are in: puts the header in front of them */
+    static void insertArrayHeader(std::string &reply, size_t position, size_t size);
+    /* Encodes up to count entries as a RESP array straight out of the stream nodes, returns how many */
+    static size_t appendEntries(std::string &reply, Stream::Iterator &iterator, size_t count);
+    /* XREAD reply for the entries after the given IDs, empty if there are none */
+    std::string readStreams(const std::vector<std::string> &streamNames, const std::vector<StreamId> &lastSeenIds, size_t count);
     std::string xreadHandler(CommandArray commandArgs, const int clientFd);
-    void processBlockingRead(const std::string& blockingVal, const int clientFd, std::vector<std::string> streamNames, std::vector<std::string> streamStartIds);
+    void processBlockingRead(size_t blockMs, const int clientFd, std::vector<std::string> streamNames, std::vector<StreamId> lastSeenIds, size_t count);
+
+    static uint64_t nowMs();
+    ConsumerGroup *findGroup(const std::string &streamName, const std::string &groupName) const;
+    /* The consumer, created (and that propagated) if it is new */
+    Consumer &addConsumer(const std::string &streamName, const std::string &groupName, ConsumerGroup &group, const std::string &name, uint64_t now);
+    /* The pending entry as it is now, with the group's last delivered ID: an XCLAIM that recreates both */
+    void propagateClaim(const std::string &streamName, const std::string &groupName, const ConsumerGroup &group, const PendingEntry &entry);
+    /* Delivers entries past the group's last delivered ID to the consumer, returns how many */
+    size_t appendNewEntries(std::string &reply, const std::string &streamName, const std::string &groupName, Stream &stream, ConsumerGroup &group,
+                            Consumer &consumer, size_t count, bool noAck, uint64_t now);
+    /* Delivers the consumer's pending entries after the ID again, deleted ones as [id, nil] */
+    size_t appendPendingEntries(std::string &reply, const std::string &streamName, const std::string &groupName, Stream &stream, ConsumerGroup &group,
+                                Consumer &consumer, const StreamId &after, size_t count, uint64_t now);
+    /* XREADGROUP reply, empty if there is nothing new */
+    std::string readGroups(const GroupRead &read);
+    void processBlockingGroupRead(size_t blockMs, const int clientFd, GroupRead read);
+    /* Serves the XREADGROUPs blocked on the stream in the order they came, under m_blockingStreamsMutex */
+    void serveGroupWaiters(const std::string &streamName);
+    void dropGroupWaiter(const GroupWaiter &waiter);
+    std::string xgroupHandler(CommandArray commandArgs);
+    std::string xreadgroupHandler(CommandArray commandArgs, const int clientFd);
+    std::string xackHandler(CommandArray commandArgs);
+    std::string xpendingHandler(CommandArray commandArgs);
+    std::string xclaimHandler(CommandArray commandArgs);
+    std::string xautoclaimHandler(CommandArray commandArgs);
+    std::string xinfoHandler(CommandArray commandArgs);
 
 public:
     bool IsStreamPresent(const std::string& name);
+
+    size_t KeyCount() const { return m_streams.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(StreamHandler &other);
+    void Swap(StreamHandler &other);
+    /* Nodes older than coldAfterMs go to segment files in dir from then on */
+    void EnableTiering(const std::string &dir, uint64_t coldAfterMs);
+    /* Run from the server cron, does the work at most once a second */
+    void SpillColdNodes();
+    /* Before the streams are freed on another thread, the tier is only changed on the main one */
+    void ReleaseColdNodes();
     std::string StreamCommandProcessor(CommandArray commandArgs, const int clientFd);
+    /* XADD / XTRIM as they took effect, for the AOF and replicas: generated IDs as assigned and approximate
+       trims as the exact trim they came to, node boundaries needn't be the same where they are replayed */
+    void RewriteForLog(std::vector<std::string> &args, const std::string &result) const;
+    /* XREADGROUP, XCLAIM and XAUTOCLAIM aren't replayed as sent, the outcome depends on idle times and on
+       when a blocked read was served. They leave what they did to the group here instead: an XCLAIM per
+       entry delivered or claimed, XGROUP SETID / CREATECONSUMER and XACK for the rest. Main thread only */
+    std::vector<std::vector<std::string>> TakeEffects() { return std::exchange(m_effects, {}); }
 };
 
 #endif // STREAMHANDLER_H
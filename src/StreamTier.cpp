@@ -0,0 +1,163 @@
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "StreamTier.h"
+#include "Rdb.h"
+#include "Utility.h"
+
+namespace
+{
+    constexpr size_t RECORD_HEADER = sizeof(uint32_t) + sizeof(uint64_t);
+    constexpr std::string_view SEGMENT_PREFIX = "segment-";
+}
+
+StreamTier::StreamTier(const std::string &dir, uint64_t coldAfterMs)
+    : m_dir(dir), m_coldAfterMs(coldAfterMs)
+{
+    if (mkdir(m_dir.c_str(), 0755) < 0 && errno != EEXIST)
+        throw std::runtime_error("Failed creating the stream tier directory " + m_dir + ": " + strerror(errno));
+
+    // Segments of an earlier run belong to nodes that were loaded back from RDB / AOF as a whole
+    if (DIR *entries = opendir(m_dir.c_str()))
+    {
+        while (dirent *entry = readdir(entries))
+        {
+            if (std::string_view(entry->d_name).starts_with(SEGMENT_PREFIX))
+                unlink((m_dir + "/" + entry->d_name).c_str());
+        }
+        closedir(entries);
+    }
+}
+
+StreamTier::~StreamTier()
+{
+    while (!m_segments.empty())
+        closeSegment(m_segments.begin());
+}
+
+std::string StreamTier::pathOf(uint32_t segment) const
+{
+    return m_dir + "/" + std::string(SEGMENT_PREFIX) + std::to_string(segment);
+}
+
+bool StreamTier::openSegment(size_t capacity)
+{
+    uint32_t id = m_nextSegment;
+    int fd = open(pathOf(id).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0)
+        return false;
+
+    // Mapped past the end of the file, appends fill it in
+    void *mapped = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        close(fd);
+        unlink(pathOf(id).c_str());
+        return false;
+    }
+
+    ++m_nextSegment;
+    m_segments[id] = {fd, static_cast<const char *>(mapped), capacity, 0, 0};
+    m_active = id;
+    return true;
+}
+
+void StreamTier::closeSegment(std::map<uint32_t, Segment>::iterator segment)
+{
+    // Snapshot children that still have it mapped keep the file alive
+    munmap(const_cast<char *>(segment->second.data), segment->second.capacity);
+    close(segment->second.fd);
+    unlink(pathOf(segment->first).c_str());
+    if (m_active == segment->first)
+        m_active = 0;
+    m_segments.erase(segment);
+}
+
+bool StreamTier::Append(std::string_view data, Location &location)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t recordBytes = RECORD_HEADER + data.size();
+    auto active = m_segments.find(m_active);
+    if (active == m_segments.end() || active->second.size + recordBytes > active->second.capacity)
+    {
+        // A full segment stays until the last of its records is released
+        if (active != m_segments.end() && active->second.records == 0)
+            closeSegment(active);
+        if (!openSegment(std::max(SEGMENT_BYTES, recordBytes)))
+            return false;
+        active = m_segments.find(m_active);
+    }
+    Segment &segment = active->second;
+
+    std::string record;
+    record.reserve(recordBytes);
+    appendBinary<uint32_t>(record, static_cast<uint32_t>(data.size()));
+    appendBinary<uint64_t>(record, crc64(0, data.data(), data.size()));
+    record.append(data);
+
+    size_t written = 0;
+    while (written < record.size())
+    {
+        ssize_t bytes = write(segment.fd, record.data() + written, record.size() - written);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+        {
+            // Leave no partial record behind, the next append goes where this one would have
+            if (ftruncate(segment.fd, segment.size) < 0)
+                m_active = 0;
+            return false;
+        }
+        written += bytes;
+    }
+
+    location = {active->first, static_cast<uint32_t>(data.size()), segment.size};
+    segment.size += recordBytes;
+    ++segment.records;
+    return true;
+}
+
+void StreamTier::Release(const Location &location)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto segment = m_segments.find(location.segment);
+    if (segment == m_segments.end())
+        return;
+    // The one being appended to is kept for the next record
+    if (--segment->second.records == 0 && segment->first != m_active)
+        closeSegment(segment);
+}
+
+bool StreamTier::Read(const Location &location, std::string &data) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return ReadUnlocked(location, data);
+}
+
+bool StreamTier::ReadUnlocked(const Location &location, std::string &data) const
+{
+    auto segment = m_segments.find(location.segment);
+    if (segment == m_segments.end() || location.offset + RECORD_HEADER + location.length > segment->second.size)
+        return false;
+
+    const char *record = segment->second.data + location.offset;
+    uint32_t length;
+    uint64_t crc;
+    memcpy(&length, record, sizeof(length));
+    memcpy(&crc, record + sizeof(length), sizeof(crc));
+    if (length != location.length || crc64(0, record + RECORD_HEADER, length) != crc)
+        return false;
+
+    data.assign(record + RECORD_HEADER, length);
+    return true;
+}
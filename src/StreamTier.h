@@ -0,0 +1,73 @@
+#ifndef STREAMTIER_H
+#define STREAMTIER_H
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+/*
+   Cold storage for stream nodes (--stream-cold-after)
+   - Nodes whose entries are all older than the threshold have their packed bytes written to segment
+     files under <dir>/<stream-tier-dir> and dropped from memory. The stream keeps the node itself:
+     its IDs, counts and where its bytes went, so lookups still go through the radix tree
+   - Segments are append only. A record is [u32 length][u64 crc64][node bytes], checked on every read
+   - Each segment is mapped once, as large as it may grow; records are added with write(2) and show up
+     in the shared mapping, so readers never see it move. A segment goes when its last record is released
+   - The files are a cache, RDB and AOF hold whole streams, so the directory is emptied on start
+*/
+
+class StreamTier
+{
+public:
+    static constexpr size_t SEGMENT_BYTES = 64 << 20;
+
+    struct Location
+    {
+        uint32_t segment{};
+        uint32_t length{}; // of the node bytes
+        uint64_t offset{}; // of the record
+    };
+
+    /* Throws if the directory can't be created */
+    StreamTier(const std::string &dir, uint64_t coldAfterMs);
+    ~StreamTier();
+    StreamTier(const StreamTier &) = delete;
+    StreamTier &operator=(const StreamTier &) = delete;
+
+    uint64_t ColdAfterMs() const { return m_coldAfterMs; }
+
+    // Appends and releases happen on the main thread, reads also come from blocked XREADs
+
+    /* false if the record couldn't be written, the data then stays where it is */
+    bool Append(std::string_view data, Location &location);
+    void Release(const Location &location);
+    /* false if the record is missing or fails its checksum */
+    bool Read(const Location &location, std::string &data) const;
+    /* For the main thread and snapshot children, where another thread may have held the lock at fork */
+    bool ReadUnlocked(const Location &location, std::string &data) const;
+
+private:
+    struct Segment
+    {
+        int fd{-1};
+        const char *data{};
+        size_t capacity{};
+        size_t size{};
+        uint64_t records{}; // not released yet
+    };
+
+    std::string m_dir;
+    uint64_t m_coldAfterMs;
+    mutable std::mutex m_mutex;
+    std::map<uint32_t, Segment> m_segments;
+    uint32_t m_active{};      // the one appended to, 0 if none
+    uint32_t m_nextSegment{1};
+
+    std::string pathOf(uint32_t segment) const;
+    bool openSegment(size_t capacity);
+    void closeSegment(std::map<uint32_t, Segment>::iterator segment);
+};
+
+#endif // STREAMTIER_H
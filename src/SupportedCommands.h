@@ -10,15 +10,33 @@
 #define GET "get"
 #define CONFIG "config"
 #define SAVE "save"
+#define BGSAVE "bgsave"
+#define LASTSAVE "lastsave"
+#define BGREWRITEAOF "bgrewriteaof"
 #define KEYS "keys"
 #define INFO "info"
 #define REPLCONF "replconf"
 #define PSYNC "psync"
 #define WAIT "wait"
+#define REPLICAOF "replicaof"
+#define SLAVEOF "slaveof"
+#define READONLY "readonly"
+#define READWRITE "readwrite"
 #define TYPE "type"
 #define XADD "xadd"
 #define XRANGE "xrange"
+#define XREVRANGE "xrevrange"
 #define XREAD "xread"
+#define XTRIM "xtrim"
+#define XDEL "xdel"
+#define XLEN "xlen"
+#define XGROUP "xgroup"
+#define XREADGROUP "xreadgroup"
+#define XACK "xack"
+#define XPENDING "xpending"
+#define XCLAIM "xclaim"
+#define XAUTOCLAIM "xautoclaim"
+#define XINFO "xinfo"
 #define INCR "incr"
 #define MULTI "multi"
 #define EXEC "exec"
@@ -33,6 +51,61 @@
 #define SUBSCRIBE "subscribe"
 #define UNSUBSCRIBE "unsubscribe"
 #define PUBLISH "publish"
+#define PFADD "pfadd"
+#define PFCOUNT "pfcount"
+#define PFMERGE "pfmerge"
+#define BF_RESERVE "bf.reserve"
+#define BF_ADD "bf.add"
+#define BF_MADD "bf.madd"
+#define BF_EXISTS "bf.exists"
+#define BF_MEXISTS "bf.mexists"
+#define BF_CARD "bf.card"
+#define CF_RESERVE "cf.reserve"
+#define CF_ADD "cf.add"
+#define CF_ADDNX "cf.addnx"
+#define CF_EXISTS "cf.exists"
+#define CF_MEXISTS "cf.mexists"
+#define CF_DEL "cf.del"
+#define CF_COUNT "cf.count"
+#define CMS_INITBYDIM "cms.initbydim"
+#define CMS_INITBYPROB "cms.initbyprob"
+#define CMS_INCRBY "cms.incrby"
+#define CMS_QUERY "cms.query"
+#define CMS_INFO "cms.info"
+#define TOPK_RESERVE "topk.reserve"
+#define TOPK_ADD "topk.add"
+#define TOPK_INCRBY "topk.incrby"
+#define TOPK_QUERY "topk.query"
+#define TOPK_COUNT "topk.count"
+#define TOPK_LIST "topk.list"
+#define TS_CREATE "ts.create"
+#define TS_ADD "ts.add"
+#define TS_MADD "ts.madd"
+#define TS_RANGE "ts.range"
+#define TS_GET "ts.get"
+#define TS_INFO "ts.info"
+#define VADD "vadd"
+#define VSIM "vsim"
+#define VREM "vrem"
+#define VCARD "vcard"
+#define VDIM "vdim"
+#define GEOADD "geoadd"
+#define GEOPOS "geopos"
+#define GEODIST "geodist"
+#define GEOSEARCH "geosearch"
+#define HSET "hset"
+#define HGET "hget"
+#define HGETALL "hgetall"
+#define HDEL "hdel"
+#define HLEN "hlen"
+#define FT_CREATE "ft.create"
+#define FT_SEARCH "ft.search"
+#define FT_DROPINDEX "ft.dropindex"
+#define FT_INFO "ft.info"
+#define JSON_SET "json.set"
+#define JSON_GET "json.get"
+#define JSON_NUMINCRBY "json.numincrby"
+#define JSON_ARRAPPEND "json.arrappend"
 
 // Some other utility defines
 #define NULL_BULK_ENCODED "$-1\r\n"
@@ -0,0 +1,515 @@
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "TimeSeries.h"
+#include "Utility.h"
+
+/*
+   Chunk bit stream (most significant bit first):
+
+   First sample: 64 bit timestamp, 64 bit value
+
+   Timestamps, delta of delta (dod) against the previous delta:
+     '0'                   dod == 0
+     '10'   + 7 bits       dod in [-63, 64]
+     '110'  + 9 bits       dod in [-255, 256]
+     '1110' + 12 bits      dod in [-2047, 2048]
+     '1111' + 64 bits      anything else
+
+   Values, XOR against the previous value:
+     '0'                   same value
+     '10' + meaningful bits                          XOR fits in the previous leading / trailing zero window
+     '11' + 6 bits leading + 6 bits (length - 1) + meaningful bits
+*/
+
+namespace
+{
+    constexpr int MAX_SAMPLE_BITS = 4 + 64 + 2 + 6 + 6 + 64; // worst case for one sample
+    constexpr uint8_t NO_WINDOW = 0xFF;
+
+    inline uint64_t lowBits(int bits)
+    {
+        return bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    }
+}
+
+TimeSeriesChunk::TimeSeriesChunk(size_t capacityBytes)
+    : m_capacityBits(std::max<size_t>(capacityBytes, 64) * 8)
+{
+    m_words.reserve((m_capacityBits + 63) / 64);
+}
+
+void TimeSeriesChunk::writeBits(uint64_t value, int bits)
+{
+    if (bits == 0)
+        return;
+
+    size_t wordIndex = m_bitCount / 64;
+    int freeBits = 64 - static_cast<int>(m_bitCount % 64);
+    if (wordIndex >= m_words.size())
+        m_words.push_back(0);
+
+    value &= lowBits(bits);
+    if (bits <= freeBits)
+    {
+        m_words[wordIndex] |= value << (freeBits - bits);
+    }
+    else
+    {
+        int remaining = bits - freeBits;
+        m_words[wordIndex] |= value >> remaining;
+        m_words.push_back(value << (64 - remaining));
+    }
+
+    m_bitCount += bits;
+}
+
+bool TimeSeriesChunk::Append(int64_t timestamp, double value)
+{
+    uint64_t valueBits = std::bit_cast<uint64_t>(value);
+
+    if (m_count == 0)
+    {
+        writeBits(timestamp, 64);
+        writeBits(valueBits, 64);
+
+        m_firstTimestamp = m_lastTimestamp = timestamp;
+        m_lastValueBits = valueBits;
+        m_min = m_max = m_sum = value;
+        m_count = 1;
+        return true;
+    }
+
+    if (m_bitCount + MAX_SAMPLE_BITS > m_capacityBits)
+        return false;
+
+    int64_t delta = timestamp - m_lastTimestamp;
+    int64_t dod = delta - m_lastDelta;
+
+    if (dod == 0)
+        writeBits(0b0, 1);
+    else if (dod >= -63 && dod <= 64)
+    {
+        writeBits(0b10, 2);
+        writeBits(dod + 63, 7);
+    }
+    else if (dod >= -255 && dod <= 256)
+    {
+        writeBits(0b110, 3);
+        writeBits(dod + 255, 9);
+    }
+    else if (dod >= -2047 && dod <= 2048)
+    {
+        writeBits(0b1110, 4);
+        writeBits(dod + 2047, 12);
+    }
+    else
+    {
+        writeBits(0b1111, 4);
+        writeBits(static_cast<uint64_t>(dod), 64);
+    }
+
+    uint64_t xorValue = valueBits ^ m_lastValueBits;
+    if (xorValue == 0)
+    {
+        writeBits(0b0, 1);
+    }
+    else
+    {
+        uint8_t leading = std::min(std::countl_zero(xorValue), 63);
+        uint8_t trailing = std::countr_zero(xorValue);
+
+        if (m_lastLeading != NO_WINDOW && leading >= m_lastLeading && trailing >= m_lastTrailing)
+        {
+            writeBits(0b10, 2);
+            writeBits(xorValue >> m_lastTrailing, 64 - m_lastLeading - m_lastTrailing);
+        }
+        else
+        {
+            int meaningful = 64 - leading - trailing;
+            writeBits(0b11, 2);
+            writeBits(leading, 6);
+            writeBits(meaningful - 1, 6);
+            writeBits(xorValue >> trailing, meaningful);
+
+            m_lastLeading = leading;
+            m_lastTrailing = trailing;
+        }
+    }
+
+    m_lastDelta = delta;
+    m_lastTimestamp = timestamp;
+    m_lastValueBits = valueBits;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+    m_sum += value;
+    ++m_count;
+
+    return true;
+}
+
+double TimeSeriesChunk::LastValue() const
+{
+    return std::bit_cast<double>(m_lastValueBits);
+}
+
+uint64_t TimeSeriesChunk::Iterator::readBits(int bits)
+{
+    size_t wordIndex = m_bitPos / 64;
+    int freeBits = 64 - static_cast<int>(m_bitPos % 64);
+    uint64_t result;
+
+    if (bits <= freeBits)
+    {
+        result = (m_chunk.m_words[wordIndex] >> (freeBits - bits)) & lowBits(bits);
+    }
+    else
+    {
+        int remaining = bits - freeBits;
+        result = ((m_chunk.m_words[wordIndex] & lowBits(freeBits)) << remaining) | (m_chunk.m_words[wordIndex + 1] >> (64 - remaining));
+    }
+
+    m_bitPos += bits;
+    return result;
+}
+
+bool TimeSeriesChunk::Iterator::Next(Sample &sample)
+{
+    if (m_index >= m_chunk.m_count)
+        return false;
+
+    if (m_index++ == 0)
+    {
+        m_timestamp = static_cast<int64_t>(readBits(64));
+        m_valueBits = readBits(64);
+        sample = {m_timestamp, std::bit_cast<double>(m_valueBits)};
+        return true;
+    }
+
+    int64_t dod;
+    if (readBits(1) == 0)
+        dod = 0;
+    else if (readBits(1) == 0)
+        dod = static_cast<int64_t>(readBits(7)) - 63;
+    else if (readBits(1) == 0)
+        dod = static_cast<int64_t>(readBits(9)) - 255;
+    else if (readBits(1) == 0)
+        dod = static_cast<int64_t>(readBits(12)) - 2047;
+    else
+        dod = static_cast<int64_t>(readBits(64));
+
+    m_delta += dod;
+    m_timestamp += m_delta;
+
+    if (readBits(1) == 1)
+    {
+        if (readBits(1) == 1)
+        {
+            m_leading = readBits(6);
+            int meaningful = readBits(6) + 1;
+            m_trailing = 64 - m_leading - meaningful;
+        }
+        m_valueBits ^= readBits(64 - m_leading - m_trailing) << m_trailing;
+    }
+
+    sample = {m_timestamp, std::bit_cast<double>(m_valueBits)};
+    return true;
+}
+
+std::vector<Sample> TimeSeriesChunk::Decode() const
+{
+    std::vector<Sample> samples;
+    samples.reserve(m_count);
+
+    Iterator it(*this);
+    Sample sample;
+    while (it.Next(sample))
+        samples.push_back(sample);
+
+    return samples;
+}
+
+void TimeSeriesChunk::Serialize(std::string &blob) const
+{
+    appendBinary<uint64_t>(blob, m_count);
+    appendBinary<int64_t>(blob, m_firstTimestamp);
+    appendBinary<int64_t>(blob, m_lastTimestamp);
+    appendBinary<int64_t>(blob, m_lastDelta);
+    appendBinary<uint64_t>(blob, m_lastValueBits);
+    appendBinary<uint8_t>(blob, m_lastLeading);
+    appendBinary<uint8_t>(blob, m_lastTrailing);
+    appendBinary<double>(blob, m_min);
+    appendBinary<double>(blob, m_max);
+    appendBinary<double>(blob, m_sum);
+    appendBinary<uint64_t>(blob, m_bitCount);
+    blob.append(reinterpret_cast<const char *>(m_words.data()), m_words.size() * sizeof(uint64_t));
+}
+
+TimeSeriesChunk TimeSeriesChunk::Deserialize(BinaryReader &reader, size_t capacityBytes)
+{
+    TimeSeriesChunk chunk(capacityBytes);
+    chunk.m_count = reader.read<uint64_t>();
+    chunk.m_firstTimestamp = reader.read<int64_t>();
+    chunk.m_lastTimestamp = reader.read<int64_t>();
+    chunk.m_lastDelta = reader.read<int64_t>();
+    chunk.m_lastValueBits = reader.read<uint64_t>();
+    chunk.m_lastLeading = reader.read<uint8_t>();
+    chunk.m_lastTrailing = reader.read<uint8_t>();
+    chunk.m_min = reader.read<double>();
+    chunk.m_max = reader.read<double>();
+    chunk.m_sum = reader.read<double>();
+    chunk.m_bitCount = reader.read<uint64_t>();
+
+    chunk.m_words.resize((chunk.m_bitCount + 63) / 64);
+    size_t bytes = chunk.m_words.size() * sizeof(uint64_t);
+    std::memcpy(chunk.m_words.data(), reader.readBytes(bytes), bytes);
+
+    return chunk;
+}
+
+TimeSeries::TimeSeries(int64_t retentionMs, size_t chunkSizeBytes)
+    : m_retentionMs(retentionMs), m_chunkSizeBytes(chunkSizeBytes)
+{
+    if (retentionMs < 0)
+        throw std::invalid_argument("retention must be non negative");
+    if (chunkSizeBytes < 48 || chunkSizeBytes > 1048576)
+        throw std::invalid_argument("chunk size must be in the range [48, 1048576]");
+}
+
+void TimeSeries::Add(int64_t timestamp, double value)
+{
+    if (timestamp < 0)
+        throw std::runtime_error("TSDB: invalid timestamp, must be a nonnegative integer");
+
+    if (!m_chunks.empty() && m_retentionMs > 0 && timestamp < LastTimestamp() - m_retentionMs)
+        throw std::runtime_error("TSDB: Timestamp is older than retention");
+
+    if (!m_chunks.empty() && timestamp <= LastTimestamp())
+    {
+        insertOutOfOrder(timestamp, value);
+        return;
+    }
+
+    if (m_chunks.empty() || !m_chunks.back().Append(timestamp, value))
+    {
+        if (!m_chunks.empty())
+            m_chunks.back().ShrinkToFit();
+
+        m_chunks.emplace_back(m_chunkSizeBytes);
+        m_chunks.back().Append(timestamp, value);
+    }
+
+    trimToRetention();
+}
+
+void TimeSeries::insertOutOfOrder(int64_t timestamp, double value)
+{
+    // Chunk whose range should hold the sample: last chunk starting at or before it
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), timestamp,
+                               [](int64_t ts, const TimeSeriesChunk &chunk) { return ts < chunk.FirstTimestamp(); });
+    if (it != m_chunks.begin())
+        --it;
+
+    std::vector<Sample> samples = it->Decode();
+    auto position = std::lower_bound(samples.begin(), samples.end(), timestamp,
+                                     [](const Sample &sample, int64_t ts) { return sample.timestamp < ts; });
+
+    if (position != samples.end() && position->timestamp == timestamp)
+        throw std::runtime_error("TSDB: Error at upsert, update is not supported when DUPLICATE_POLICY is set to BLOCK mode");
+
+    samples.insert(position, {timestamp, value});
+
+    // Re-encode, the extra sample may not fit anymore so this can produce two chunks
+    std::vector<TimeSeriesChunk> rebuilt;
+    rebuilt.emplace_back(m_chunkSizeBytes);
+    for (const auto &sample : samples)
+    {
+        if (!rebuilt.back().Append(sample.timestamp, sample.value))
+        {
+            rebuilt.emplace_back(m_chunkSizeBytes);
+            rebuilt.back().Append(sample.timestamp, sample.value);
+        }
+    }
+
+    bool isLast = (it + 1 == m_chunks.end());
+    for (auto &chunk : rebuilt)
+    {
+        if (!isLast || &chunk != &rebuilt.back())
+            chunk.ShrinkToFit();
+    }
+
+    it = m_chunks.erase(it);
+    m_chunks.insert(it, std::make_move_iterator(rebuilt.begin()), std::make_move_iterator(rebuilt.end()));
+}
+
+void TimeSeries::trimToRetention()
+{
+    if (m_retentionMs == 0 || m_chunks.empty())
+        return;
+
+    int64_t oldestAllowed = LastTimestamp() - m_retentionMs;
+    auto firstKept = std::find_if(m_chunks.begin(), m_chunks.end() - 1,
+                                  [oldestAllowed](const TimeSeriesChunk &chunk) { return chunk.LastTimestamp() >= oldestAllowed; });
+    m_chunks.erase(m_chunks.begin(), firstKept);
+}
+
+std::vector<Sample> TimeSeries::Range(int64_t from, int64_t to, Aggregation aggregation, int64_t bucketDuration, size_t count) const
+{
+    std::vector<Sample> result;
+    if (m_chunks.empty() || count == 0)
+        return result;
+
+    if (m_retentionMs > 0)
+        from = std::max(from, LastTimestamp() - m_retentionMs);
+
+    auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), from,
+                               [](const TimeSeriesChunk &chunk, int64_t ts) { return chunk.LastTimestamp() < ts; });
+
+    if (aggregation == Aggregation::NONE)
+    {
+        for (; it != m_chunks.end() && it->FirstTimestamp() <= to; ++it)
+        {
+            TimeSeriesChunk::Iterator samples(*it);
+            Sample sample;
+            while (samples.Next(sample) && sample.timestamp <= to)
+            {
+                if (sample.timestamp < from)
+                    continue;
+
+                result.push_back(sample);
+                if (result.size() == count)
+                    return result;
+            }
+        }
+        return result;
+    }
+
+    struct Bucket
+    {
+        int64_t start{-1};
+        uint64_t count{};
+        double sum{};
+        double min{std::numeric_limits<double>::infinity()};
+        double max{-std::numeric_limits<double>::infinity()};
+    } bucket;
+
+    auto bucketStart = [bucketDuration](int64_t ts) { return ts - (ts % bucketDuration); };
+
+    // Returns false once 'count' buckets were produced
+    auto flush = [&]() -> bool
+    {
+        if (bucket.count == 0)
+            return true;
+
+        double value{};
+        switch (aggregation)
+        {
+        case Aggregation::AVG: value = bucket.sum / bucket.count; break;
+        case Aggregation::MIN: value = bucket.min; break;
+        case Aggregation::MAX: value = bucket.max; break;
+        case Aggregation::SUM: value = bucket.sum; break;
+        case Aggregation::COUNT: value = static_cast<double>(bucket.count); break;
+        case Aggregation::NONE: break;
+        }
+
+        result.push_back({bucket.start, value});
+        bucket = Bucket{};
+        return result.size() < count;
+    };
+
+    auto accumulate = [&](int64_t start, uint64_t samples, double sum, double min, double max) -> bool
+    {
+        if (start != bucket.start && !flush())
+            return false;
+
+        bucket.start = start;
+        bucket.count += samples;
+        bucket.sum += sum;
+        bucket.min = std::min(bucket.min, min);
+        bucket.max = std::max(bucket.max, max);
+        return true;
+    };
+
+    for (; it != m_chunks.end() && it->FirstTimestamp() <= to; ++it)
+    {
+        // Whole chunk inside the range and inside a single bucket: use its summary, no decompression
+        if (it->FirstTimestamp() >= from && it->LastTimestamp() <= to &&
+            bucketStart(it->FirstTimestamp()) == bucketStart(it->LastTimestamp()))
+        {
+            if (!accumulate(bucketStart(it->FirstTimestamp()), it->Count(), it->Sum(), it->Min(), it->Max()))
+                return result;
+            continue;
+        }
+
+        TimeSeriesChunk::Iterator samples(*it);
+        Sample sample;
+        while (samples.Next(sample) && sample.timestamp <= to)
+        {
+            if (sample.timestamp < from)
+                continue;
+
+            if (!accumulate(bucketStart(sample.timestamp), 1, sample.value, sample.value, sample.value))
+                return result;
+        }
+    }
+
+    flush();
+    return result;
+}
+
+std::optional<Sample> TimeSeries::Latest() const
+{
+    if (m_chunks.empty())
+        return std::nullopt;
+
+    return Sample{m_chunks.back().LastTimestamp(), m_chunks.back().LastValue()};
+}
+
+uint64_t TimeSeries::TotalSamples() const
+{
+    uint64_t samples = 0;
+    for (const auto &chunk : m_chunks)
+        samples += chunk.Count();
+    return samples;
+}
+
+size_t TimeSeries::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const auto &chunk : m_chunks)
+        bytes += chunk.MemoryUsage();
+    return bytes;
+}
+
+std::string TimeSeries::Serialize() const
+{
+    std::string blob;
+    appendBinary<int64_t>(blob, m_retentionMs);
+    appendBinary<uint64_t>(blob, m_chunkSizeBytes);
+    appendBinary<uint64_t>(blob, m_chunks.size());
+
+    for (const auto &chunk : m_chunks)
+        chunk.Serialize(blob);
+
+    return blob;
+}
+
+std::unique_ptr<TimeSeries> TimeSeries::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto retention = reader.read<int64_t>();
+    auto chunkSize = reader.read<uint64_t>();
+
+    auto series = std::make_unique<TimeSeries>(retention, chunkSize);
+    auto numChunks = reader.read<uint64_t>();
+
+    for (uint64_t i = 0; i < numChunks; ++i)
+        series->m_chunks.push_back(TimeSeriesChunk::Deserialize(reader, chunkSize));
+
+    return series;
+}
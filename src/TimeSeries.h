@@ -0,0 +1,135 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+/*
+   Time series
+   - Samples are kept in chunks compressed the Gorilla way: delta-of-delta encoded timestamps and
+     XOR encoded float values, regular metrics need ~1-2 bytes per sample
+   - Every chunk also keeps count / min / max / sum of its samples, range aggregations take those
+     directly for chunks that fall completely inside one time bucket and only decode the rest
+   - Chunks older than the retention window (relative to the newest sample) are dropped whole
+*/
+
+class BinaryReader;
+
+struct Sample
+{
+    int64_t timestamp;
+    double value;
+};
+
+class TimeSeriesChunk
+{
+public:
+    TimeSeriesChunk(size_t capacityBytes);
+
+    /* Sequential decoder over the compressed samples of a chunk */
+    class Iterator
+    {
+    public:
+        Iterator(const TimeSeriesChunk &chunk) : m_chunk(chunk) {}
+        bool Next(Sample &sample);
+
+    private:
+        const TimeSeriesChunk &m_chunk;
+        uint64_t m_bitPos{};
+        uint64_t m_index{};
+        int64_t m_timestamp{};
+        int64_t m_delta{};
+        uint64_t m_valueBits{};
+        uint8_t m_leading{};
+        uint8_t m_trailing{};
+
+        uint64_t readBits(int bits);
+    };
+
+    /* Samples must come in increasing timestamp order, returns false when the chunk is full */
+    bool Append(int64_t timestamp, double value);
+    std::vector<Sample> Decode() const;
+
+    uint64_t Count() const { return m_count; }
+    int64_t FirstTimestamp() const { return m_firstTimestamp; }
+    int64_t LastTimestamp() const { return m_lastTimestamp; }
+    double Min() const { return m_min; }
+    double Max() const { return m_max; }
+    double Sum() const { return m_sum; }
+    double LastValue() const;
+    size_t SizeInBytes() const { return (m_bitCount + 7) / 8; }
+    size_t MemoryUsage() const { return sizeof(*this) + m_words.capacity() * sizeof(uint64_t); }
+    void ShrinkToFit() { m_words.shrink_to_fit(); }
+
+    void Serialize(std::string &blob) const;
+    static TimeSeriesChunk Deserialize(BinaryReader &reader, size_t capacityBytes);
+
+private:
+    size_t m_capacityBits;
+    std::vector<uint64_t> m_words;
+    uint64_t m_bitCount{};
+
+    uint64_t m_count{};
+    int64_t m_firstTimestamp{};
+    int64_t m_lastTimestamp{};
+    int64_t m_lastDelta{};
+    uint64_t m_lastValueBits{};
+    uint8_t m_lastLeading{0xFF}; // 0xFF => no previous XOR window
+    uint8_t m_lastTrailing{};
+    double m_min{};
+    double m_max{};
+    double m_sum{};
+
+    void writeBits(uint64_t value, int bits);
+};
+
+class TimeSeries
+{
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 4096; // bytes
+
+    enum class Aggregation
+    {
+        NONE,
+        AVG,
+        MIN,
+        MAX,
+        SUM,
+        COUNT
+    };
+
+    TimeSeries(int64_t retentionMs = 0, size_t chunkSizeBytes = DEFAULT_CHUNK_SIZE);
+
+    /* Throws std::runtime_error for duplicate timestamps or samples older than the retention window */
+    void Add(int64_t timestamp, double value);
+
+    /* from / to are inclusive. For aggregations every returned sample is a bucket (start timestamp, aggregated value) */
+    std::vector<Sample> Range(int64_t from, int64_t to, Aggregation aggregation = Aggregation::NONE,
+                              int64_t bucketDuration = 0, size_t count = SIZE_MAX) const;
+    std::optional<Sample> Latest() const;
+
+    uint64_t TotalSamples() const;
+    size_t NumberOfChunks() const { return m_chunks.size(); }
+    size_t MemoryUsage() const;
+    int64_t Retention() const { return m_retentionMs; }
+    void SetRetention(int64_t retentionMs) { m_retentionMs = retentionMs; trimToRetention(); }
+    size_t ChunkSize() const { return m_chunkSizeBytes; }
+    int64_t FirstTimestamp() const { return m_chunks.empty() ? 0 : m_chunks.front().FirstTimestamp(); }
+    int64_t LastTimestamp() const { return m_chunks.empty() ? 0 : m_chunks.back().LastTimestamp(); }
+
+    std::string Serialize() const;
+    static std::unique_ptr<TimeSeries> Deserialize(const std::string &blob);
+
+private:
+    int64_t m_retentionMs;
+    size_t m_chunkSizeBytes;
+    std::vector<TimeSeriesChunk> m_chunks; // ordered, non overlapping
+
+    void insertOutOfOrder(int64_t timestamp, double value);
+    void trimToRetention();
+};
+
+#endif // TIMESERIES_H
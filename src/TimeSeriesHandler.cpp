@@ -0,0 +1,299 @@
+
+#include <chrono>
+#include <charconv>
+#include <stdexcept>
+
+#include "TimeSeriesHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+namespace
+{
+    int64_t currentTimeMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Shortest representation that parses back to the same double
+    std::string formatValue(double value)
+    {
+        char buffer[32];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, end);
+    }
+
+    std::string encodeSample(const Sample &sample)
+    {
+        return RESPEncoder::encodeArray({RESPEncoder::encodeInteger(sample.timestamp), RESPEncoder::encodeString(formatValue(sample.value))}, true);
+    }
+
+    TimeSeries::Aggregation parseAggregation(const std::string &name)
+    {
+        std::string type = toLower(name);
+        if (type == "avg")
+            return TimeSeries::Aggregation::AVG;
+        else if (type == "min")
+            return TimeSeries::Aggregation::MIN;
+        else if (type == "max")
+            return TimeSeries::Aggregation::MAX;
+        else if (type == "sum")
+            return TimeSeries::Aggregation::SUM;
+        else if (type == "count")
+            return TimeSeries::Aggregation::COUNT;
+
+        throw std::invalid_argument("unknown aggregation type '" + name + "'");
+    }
+}
+
+std::string TimeSeriesHandler::TimeSeriesCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == TS_CREATE)
+            return tsCreateHandler(std::move(commandArgs));
+        else if (command == TS_ADD)
+            return tsAddHandler(std::move(commandArgs));
+        else if (command == TS_MADD)
+            return tsMAddHandler(std::move(commandArgs));
+        else if (command == TS_RANGE)
+            return tsRangeHandler(std::move(commandArgs));
+        else if (command == TS_GET)
+            return tsGetHandler(std::move(commandArgs));
+        else if (command == TS_INFO)
+            return tsInfoHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("TSDB: bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("TSDB: value out of range");
+    }
+
+    return RESPEncoder::encodeError("Unsupported time series command");
+}
+
+// TS.CREATE key [RETENTION ms] [CHUNK_SIZE bytes]
+std::string TimeSeriesHandler::tsCreateHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 2 || commandArgs->size() % 2 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.create' command");
+
+    const std::string &key = (*commandArgs)[1];
+    if (IsTimeSeriesPresent(key))
+        return RESPEncoder::encodeError("TSDB: key already exists");
+
+    int64_t retention = 0;
+    size_t chunkSize = TimeSeries::DEFAULT_CHUNK_SIZE;
+    for (size_t i = 2; i < commandArgs->size(); i += 2)
+    {
+        std::string option = toLower((*commandArgs)[i]);
+        if (option == "retention")
+            retention = std::stoll((*commandArgs)[i + 1]);
+        else if (option == "chunk_size")
+            chunkSize = std::stoul((*commandArgs)[i + 1]);
+        else
+            return RESPEncoder::encodeError("TSDB: unknown option '" + (*commandArgs)[i] + "'");
+    }
+
+    m_series[key] = std::make_unique<TimeSeries>(retention, chunkSize);
+    return RESPEncoder::encodeSimpleString("OK");
+}
+
+std::string TimeSeriesHandler::addSample(TimeSeries &series, const std::string &timestamp, const std::string &value)
+{
+    int64_t ts = timestamp == "*" ? currentTimeMs() : std::stoll(timestamp);
+    double sampleValue = std::stod(value);
+
+    try
+    {
+        series.Add(ts, sampleValue);
+    }
+    catch (const std::runtime_error &e)
+    {
+        return RESPEncoder::encodeError(e.what());
+    }
+
+    return RESPEncoder::encodeInteger(ts);
+}
+
+// TS.ADD key timestamp|* value [RETENTION ms] [CHUNK_SIZE bytes], creates the key if needed
+std::string TimeSeriesHandler::tsAddHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4 || commandArgs->size() % 2 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.add' command");
+
+    const std::string &key = (*commandArgs)[1];
+    auto it = m_series.find(key);
+    if (it == m_series.end())
+    {
+        int64_t retention = 0;
+        size_t chunkSize = TimeSeries::DEFAULT_CHUNK_SIZE;
+        for (size_t i = 4; i < commandArgs->size(); i += 2)
+        {
+            std::string option = toLower((*commandArgs)[i]);
+            if (option == "retention")
+                retention = std::stoll((*commandArgs)[i + 1]);
+            else if (option == "chunk_size")
+                chunkSize = std::stoul((*commandArgs)[i + 1]);
+            else
+                return RESPEncoder::encodeError("TSDB: unknown option '" + (*commandArgs)[i] + "'");
+        }
+
+        // Validate the sample before creating the key so a bad TS.ADD doesn't leave an empty series behind
+        if ((*commandArgs)[2] != "*")
+            std::stoll((*commandArgs)[2]);
+        std::stod((*commandArgs)[3]);
+
+        it = m_series.emplace(key, std::make_unique<TimeSeries>(retention, chunkSize)).first;
+    }
+
+    return addSample(*it->second, (*commandArgs)[2], (*commandArgs)[3]);
+}
+
+// TS.MADD key timestamp value [key timestamp value ...], keys must already exist
+std::string TimeSeriesHandler::tsMAddHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4 || (commandArgs->size() - 1) % 3 != 0)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.madd' command");
+
+    std::vector<std::string> results;
+    for (size_t i = 1; i < commandArgs->size(); i += 3)
+    {
+        auto it = m_series.find((*commandArgs)[i]);
+        if (it == m_series.end())
+        {
+            results.push_back(RESPEncoder::encodeError("TSDB: the key does not exist"));
+            continue;
+        }
+
+        try
+        {
+            results.push_back(addSample(*it->second, (*commandArgs)[i + 1], (*commandArgs)[i + 2]));
+        }
+        catch (const std::logic_error &e)
+        {
+            results.push_back(RESPEncoder::encodeError("TSDB: invalid sample"));
+        }
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// TS.RANGE key from|- to|+ [COUNT n] [AGGREGATION avg|min|max|sum|count bucketDuration]
+std::string TimeSeriesHandler::tsRangeHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.range' command");
+
+    auto it = m_series.find((*commandArgs)[1]);
+    if (it == m_series.end())
+        return RESPEncoder::encodeError("TSDB: the key does not exist");
+
+    int64_t from = (*commandArgs)[2] == "-" ? 0 : std::stoll((*commandArgs)[2]);
+    int64_t to = (*commandArgs)[3] == "+" ? INT64_MAX : std::stoll((*commandArgs)[3]);
+
+    size_t count = SIZE_MAX;
+    auto aggregation = TimeSeries::Aggregation::NONE;
+    int64_t bucketDuration = 0;
+
+    for (size_t i = 4; i < commandArgs->size();)
+    {
+        std::string option = toLower((*commandArgs)[i]);
+        if (option == "count" && i + 1 < commandArgs->size())
+        {
+            count = std::stoul((*commandArgs)[i + 1]);
+            i += 2;
+        }
+        else if (option == "aggregation" && i + 2 < commandArgs->size())
+        {
+            aggregation = parseAggregation((*commandArgs)[i + 1]);
+            bucketDuration = std::stoll((*commandArgs)[i + 2]);
+            if (bucketDuration <= 0)
+                return RESPEncoder::encodeError("TSDB: bucketDuration must be greater than zero");
+            i += 3;
+        }
+        else
+        {
+            return RESPEncoder::encodeError("TSDB: wrong arguments for 'ts.range' command");
+        }
+    }
+
+    std::vector<std::string> results;
+    for (const auto &sample : it->second->Range(from, to, aggregation, bucketDuration, count))
+        results.push_back(encodeSample(sample));
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// TS.GET key
+std::string TimeSeriesHandler::tsGetHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.get' command");
+
+    auto it = m_series.find((*commandArgs)[1]);
+    if (it == m_series.end())
+        return RESPEncoder::encodeError("TSDB: the key does not exist");
+
+    auto latest = it->second->Latest();
+    return latest ? encodeSample(*latest) : RESPEncoder::encodeArray({}, true);
+}
+
+// TS.INFO key
+std::string TimeSeriesHandler::tsInfoHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'ts.info' command");
+
+    auto it = m_series.find((*commandArgs)[1]);
+    if (it == m_series.end())
+        return RESPEncoder::encodeError("TSDB: the key does not exist");
+
+    const TimeSeries &series = *it->second;
+    uint64_t samples = series.TotalSamples();
+    double bytesPerSample = samples ? static_cast<double>(series.MemoryUsage()) / samples : 0;
+
+    return RESPEncoder::encodeArray({RESPEncoder::encodeString("totalSamples"), RESPEncoder::encodeInteger(samples),
+                                     RESPEncoder::encodeString("memoryUsage"), RESPEncoder::encodeInteger(series.MemoryUsage()),
+                                     RESPEncoder::encodeString("bytesPerSample"), RESPEncoder::encodeString(formatValue(bytesPerSample)),
+                                     RESPEncoder::encodeString("firstTimestamp"), RESPEncoder::encodeInteger(series.FirstTimestamp()),
+                                     RESPEncoder::encodeString("lastTimestamp"), RESPEncoder::encodeInteger(series.LastTimestamp()),
+                                     RESPEncoder::encodeString("retentionTime"), RESPEncoder::encodeInteger(series.Retention()),
+                                     RESPEncoder::encodeString("chunkCount"), RESPEncoder::encodeInteger(series.NumberOfChunks()),
+                                     RESPEncoder::encodeString("chunkSize"), RESPEncoder::encodeInteger(series.ChunkSize())},
+                                    true);
+}
+
+void TimeSeriesHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_series))
+    {
+        writer.WriteKey(RDB_TYPE_TIMESERIES, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void TimeSeriesHandler::LoadRdb(RdbReader &reader, uint8_t, const std::string &key)
+{
+    m_series[key] = TimeSeries::Deserialize(reader.ReadString());
+}
+
+void TimeSeriesHandler::MergeFrom(TimeSeriesHandler &other)
+{
+    m_series.merge(other.m_series);
+}
+
+void TimeSeriesHandler::Swap(TimeSeriesHandler &other)
+{
+    m_series.swap(other.m_series);
+}
@@ -0,0 +1,43 @@
+#ifndef TIMESERIESHANDLER_H
+#define TIMESERIESHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "TimeSeries.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class TimeSeriesHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<TimeSeries>> m_series;
+
+    std::string tsCreateHandler(CommandArray commandArgs);
+    std::string tsAddHandler(CommandArray commandArgs);
+    std::string tsMAddHandler(CommandArray commandArgs);
+    std::string tsRangeHandler(CommandArray commandArgs);
+    std::string tsGetHandler(CommandArray commandArgs);
+    std::string tsInfoHandler(CommandArray commandArgs);
+
+    std::string addSample(TimeSeries &series, const std::string &timestamp, const std::string &value);
+
+public:
+    std::string TimeSeriesCommandProcessor(CommandArray commandArgs);
+
+    bool IsTimeSeriesPresent(const std::string &key) const { return m_series.contains(key); }
+
+    size_t KeyCount() const { return m_series.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(TimeSeriesHandler &other);
+    void Swap(TimeSeriesHandler &other);
+};
+
+#endif // TIMESERIESHANDLER_H
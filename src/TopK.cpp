@@ -0,0 +1,239 @@
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "TopK.h"
+#include "Utility.h"
+
+TopK::TopK(uint32_t k, uint32_t width, uint32_t depth, double decay)
+    : m_k(k), m_width(width), m_depth(depth), m_decay(decay)
+{
+    if (k == 0 || width == 0 || depth == 0 || depth > MAX_DEPTH)
+        throw std::invalid_argument("k and width must be positive and depth in the range [1, 64]");
+    if (!(decay > 0 && decay <= 1))
+        throw std::invalid_argument("decay must be in the range (0, 1]");
+    if (k > MAX_K || static_cast<uint64_t>(width) * depth > MAX_BUCKETS)
+        throw std::invalid_argument("k or width * depth too large");
+
+    m_buckets.resize(static_cast<size_t>(width) * depth, Bucket{0, 0});
+    m_heap.reserve(k);
+
+    for (int count = 0; count < DECAY_LOOKUP_SIZE; ++count)
+        m_decayLookup[count] = std::pow(decay, count);
+}
+
+void TopK::rowIndices(uint64_t hash, uint32_t *indices) const
+{
+    uint32_t h1 = static_cast<uint32_t>(hash);
+    uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+    for (uint32_t row = 0; row < m_depth; ++row)
+    {
+        uint32_t rowHash = h1 + row * h2;
+        indices[row] = row * m_width + static_cast<uint32_t>((static_cast<uint64_t>(rowHash) * m_width) >> 32);
+    }
+}
+
+double TopK::decayProbability(uint32_t count) const
+{
+    if (count < DECAY_LOOKUP_SIZE)
+        return m_decayLookup[count];
+
+    return m_decayLookup[DECAY_LOOKUP_SIZE - 1] * std::pow(m_decay, count - (DECAY_LOOKUP_SIZE - 1));
+}
+
+double TopK::nextRandom()
+{
+    // xorshift64*
+    m_randomState ^= m_randomState >> 12;
+    m_randomState ^= m_randomState << 25;
+    m_randomState ^= m_randomState >> 27;
+    return ((m_randomState * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+long TopK::findInHeap(uint32_t fingerprint, const std::string &item) const
+{
+    for (size_t i = 0; i < m_heap.size(); ++i)
+    {
+        if (m_heap[i].fingerprint == fingerprint && m_heap[i].item == item)
+            return i;
+    }
+    return -1;
+}
+
+void TopK::siftDown(size_t index)
+{
+    while (true)
+    {
+        size_t smallest = index;
+        size_t left = 2 * index + 1, right = 2 * index + 2;
+
+        if (left < m_heap.size() && m_heap[left].count < m_heap[smallest].count)
+            smallest = left;
+        if (right < m_heap.size() && m_heap[right].count < m_heap[smallest].count)
+            smallest = right;
+        if (smallest == index)
+            return;
+
+        std::swap(m_heap[index], m_heap[smallest]);
+        index = smallest;
+    }
+}
+
+std::optional<std::string> TopK::IncrBy(const std::string &item, uint32_t increment)
+{
+    uint64_t hash = murmurHash64A(item);
+    uint32_t fingerprint = static_cast<uint32_t>(hash >> 32) ^ static_cast<uint32_t>(hash);
+
+    uint32_t indices[MAX_DEPTH];
+    rowIndices(hash, indices);
+
+    uint32_t maxCount = 0;
+    for (uint32_t row = 0; row < m_depth; ++row)
+    {
+        Bucket &bucket = m_buckets[indices[row]];
+
+        if (bucket.count == 0 || bucket.fingerprint == fingerprint)
+        {
+            bucket.fingerprint = fingerprint;
+            bucket.count += increment;
+            maxCount = std::max(maxCount, bucket.count);
+            continue;
+        }
+
+        // Collision: decay the owner, take over the bucket if its count reaches 0
+        for (uint32_t remaining = increment; remaining > 0; --remaining)
+        {
+            if (nextRandom() < decayProbability(bucket.count) && --bucket.count == 0)
+            {
+                bucket.fingerprint = fingerprint;
+                bucket.count = remaining;
+                maxCount = std::max(maxCount, bucket.count);
+                break;
+            }
+        }
+    }
+
+    long position = findInHeap(fingerprint, item);
+    if (position >= 0)
+    {
+        m_heap[position].count = std::max<uint64_t>(m_heap[position].count, maxCount);
+        siftDown(position);
+        return std::nullopt;
+    }
+
+    if (m_heap.size() < m_k)
+    {
+        m_heap.push_back({maxCount, fingerprint, item});
+        std::push_heap(m_heap.begin(), m_heap.end(), [](const HeapEntry &a, const HeapEntry &b) { return a.count > b.count; });
+        return std::nullopt;
+    }
+
+    if (maxCount <= m_heap.front().count)
+        return std::nullopt;
+
+    std::string expelled = std::move(m_heap.front().item);
+    m_heap.front() = {maxCount, fingerprint, item};
+    siftDown(0);
+
+    return expelled;
+}
+
+bool TopK::Query(const std::string &item) const
+{
+    uint64_t hash = murmurHash64A(item);
+    uint32_t fingerprint = static_cast<uint32_t>(hash >> 32) ^ static_cast<uint32_t>(hash);
+
+    return findInHeap(fingerprint, item) >= 0;
+}
+
+uint64_t TopK::Count(const std::string &item) const
+{
+    uint64_t hash = murmurHash64A(item);
+    uint32_t fingerprint = static_cast<uint32_t>(hash >> 32) ^ static_cast<uint32_t>(hash);
+
+    uint32_t indices[MAX_DEPTH];
+    rowIndices(hash, indices);
+
+    uint32_t maxCount = 0;
+    for (uint32_t row = 0; row < m_depth; ++row)
+    {
+        const Bucket &bucket = m_buckets[indices[row]];
+        if (bucket.fingerprint == fingerprint)
+            maxCount = std::max(maxCount, bucket.count);
+    }
+
+    return maxCount;
+}
+
+std::vector<std::pair<std::string, uint64_t>> TopK::List() const
+{
+    std::vector<std::pair<std::string, uint64_t>> list;
+    list.reserve(m_heap.size());
+
+    for (const auto &entry : m_heap)
+        list.emplace_back(entry.item, entry.count);
+
+    std::sort(list.begin(), list.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    return list;
+}
+
+size_t TopK::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this) + m_buckets.size() * sizeof(Bucket);
+    for (const auto &entry : m_heap)
+        bytes += sizeof(entry) + entry.item.capacity();
+    return bytes;
+}
+
+std::string TopK::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint32_t>(blob, m_k);
+    appendBinary<uint32_t>(blob, m_width);
+    appendBinary<uint32_t>(blob, m_depth);
+    appendBinary<double>(blob, m_decay);
+    appendBinary<uint64_t>(blob, m_randomState);
+    blob.append(reinterpret_cast<const char *>(m_buckets.data()), m_buckets.size() * sizeof(Bucket));
+
+    appendBinary<uint64_t>(blob, m_heap.size());
+    for (const auto &entry : m_heap)
+    {
+        appendBinary<uint64_t>(blob, entry.count);
+        appendBinary<uint32_t>(blob, entry.fingerprint);
+        appendBinaryString(blob, entry.item);
+    }
+
+    return blob;
+}
+
+std::unique_ptr<TopK> TopK::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto k = reader.read<uint32_t>();
+    auto width = reader.read<uint32_t>();
+    auto depth = reader.read<uint32_t>();
+    auto decay = reader.read<double>();
+
+    auto topk = std::make_unique<TopK>(k, width, depth, decay);
+    topk->m_randomState = reader.read<uint64_t>();
+
+    size_t bytes = topk->m_buckets.size() * sizeof(Bucket);
+    std::memcpy(topk->m_buckets.data(), reader.readBytes(bytes), bytes);
+
+    auto heapSize = reader.read<uint64_t>();
+    if (heapSize > k)
+        throw std::runtime_error("Corrupted top-k heap");
+
+    for (uint64_t i = 0; i < heapSize; ++i)
+    {
+        HeapEntry entry;
+        entry.count = reader.read<uint64_t>();
+        entry.fingerprint = reader.read<uint32_t>();
+        entry.item = reader.readString();
+        topk->m_heap.push_back(std::move(entry)); // stored in heap order already
+    }
+
+    return topk;
+}
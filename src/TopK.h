@@ -0,0 +1,76 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+/*
+   Top-K heavy hitters (HeavyKeeper)
+   - 'depth' rows of 'width' buckets holding (fingerprint, count). A colliding item decays the
+     count of the bucket owner with probability decay^count, so small flows can't keep a bucket
+   - A min heap of the k biggest estimated counts gives the list, memory is fixed whatever the
+     number of distinct items
+   - The decay coin flips use a seeded PRNG stored with the sketch, so replicas replaying the same
+     commands end up with the same state
+*/
+
+class TopK
+{
+public:
+    static constexpr uint32_t DEFAULT_WIDTH = 8;
+    static constexpr uint32_t DEFAULT_DEPTH = 7;
+    static constexpr double DEFAULT_DECAY = 0.9;
+    static constexpr uint32_t MAX_DEPTH = 64;
+    static constexpr uint32_t MAX_K = 100000;
+    static constexpr uint64_t MAX_BUCKETS = 1ULL << 27; // 1GB
+
+    TopK(uint32_t k, uint32_t width = DEFAULT_WIDTH, uint32_t depth = DEFAULT_DEPTH, double decay = DEFAULT_DECAY);
+
+    /* Returns the item expelled from the top-k list, if any */
+    std::optional<std::string> IncrBy(const std::string &item, uint32_t increment);
+    bool Query(const std::string &item) const;
+    uint64_t Count(const std::string &item) const;
+    std::vector<std::pair<std::string, uint64_t>> List() const; // biggest first
+
+    uint32_t K() const { return m_k; }
+    size_t MemoryUsage() const;
+
+    std::string Serialize() const;
+    static std::unique_ptr<TopK> Deserialize(const std::string &blob);
+
+private:
+    static constexpr int DECAY_LOOKUP_SIZE = 256;
+
+    struct Bucket
+    {
+        uint32_t fingerprint;
+        uint32_t count;
+    };
+
+    struct HeapEntry
+    {
+        uint64_t count;
+        uint32_t fingerprint;
+        std::string item;
+    };
+
+    uint32_t m_k;
+    uint32_t m_width;
+    uint32_t m_depth;
+    double m_decay;
+    uint64_t m_randomState{0x9E3779B97F4A7C15ULL};
+    std::vector<Bucket> m_buckets; // row major, depth * width
+    std::vector<HeapEntry> m_heap; // min heap on count, at most k entries
+    double m_decayLookup[DECAY_LOOKUP_SIZE];
+
+    void rowIndices(uint64_t hash, uint32_t *indices) const;
+    double decayProbability(uint32_t count) const;
+    double nextRandom();
+    long findInHeap(uint32_t fingerprint, const std::string &item) const;
+    void siftDown(size_t index);
+};
+
+#endif // TOPK_H
@@ -7,6 +7,9 @@
 #include <exception>
 #include <fstream>
 #include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 
 inline const std::string toLower(const std::string &str)
 {
@@ -23,6 +26,104 @@ inline const void createFileWithData(const std::string &file, const std::string
 	outfile.close();
 }
 
+// MurmurHash64A, same hash (and seed handling) Redis uses for HyperLogLog. Assumes little endian host.
+inline uint64_t murmurHash64A(const void *key, size_t len, uint64_t seed)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = seed ^ (len * m);
+
+	auto data = static_cast<const uint8_t *>(key);
+	auto end = data + (len - (len & 7));
+
+	while (data != end)
+	{
+		uint64_t k;
+		std::memcpy(&k, data, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+		data += 8;
+	}
+
+	switch (len & 7)
+	{
+	case 7: h ^= static_cast<uint64_t>(data[6]) << 48; [[fallthrough]];
+	case 6: h ^= static_cast<uint64_t>(data[5]) << 40; [[fallthrough]];
+	case 5: h ^= static_cast<uint64_t>(data[4]) << 32; [[fallthrough]];
+	case 4: h ^= static_cast<uint64_t>(data[3]) << 24; [[fallthrough]];
+	case 3: h ^= static_cast<uint64_t>(data[2]) << 16; [[fallthrough]];
+	case 2: h ^= static_cast<uint64_t>(data[1]) << 8; [[fallthrough]];
+	case 1: h ^= static_cast<uint64_t>(data[0]);
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+inline uint64_t murmurHash64A(const std::string &str, uint64_t seed = 0)
+{
+	return murmurHash64A(str.data(), str.size(), seed);
+}
+
+/* Binary (little endian) serialization helpers used by the data types to dump / restore themselves */
+template <typename T>
+inline void appendBinary(std::string &out, const T &value)
+{
+	out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+inline void appendBinaryString(std::string &out, std::string_view str)
+{
+	appendBinary<uint64_t>(out, str.size());
+	out.append(str);
+}
+
+class BinaryReader
+{
+private:
+	const std::string &m_data;
+	size_t m_pos{};
+
+public:
+	BinaryReader(const std::string &data) : m_data(data) {}
+
+	template <typename T>
+	T read()
+	{
+		T value;
+		std::memcpy(&value, readBytes(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	const char *readBytes(size_t len)
+	{
+		if (len > m_data.size() - m_pos)
+			throw std::runtime_error("Unexpected end of serialized data");
+
+		const char *ptr = m_data.data() + m_pos;
+		m_pos += len;
+		return ptr;
+	}
+
+	std::string readString()
+	{
+		auto len = read<uint64_t>();
+		return std::string(readBytes(len), len);
+	}
+
+	bool atEnd() const { return m_pos == m_data.size(); }
+	size_t remaining() const { return m_data.size() - m_pos; } /* bounds counts read from the data before they are allocated for */
+};
+
 class EventWaiter
 {
 private:
@@ -0,0 +1,212 @@
+
+#include "VectorDistance.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    float dotF32Scalar(const float *a, const float *b, size_t n)
+    {
+        float sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    float l2SquaredF32Scalar(const float *a, const float *b, size_t n)
+    {
+        float sum = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    int32_t dotI8Scalar(const int8_t *a, const int8_t *b, size_t n)
+    {
+        int32_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += static_cast<int32_t>(a[i]) * b[i];
+        return sum;
+    }
+
+    const DistanceKernels SCALAR_KERNELS{"scalar", dotF32Scalar, l2SquaredF32Scalar, dotI8Scalar};
+
+#ifdef VECTOR_KERNELS_X86
+
+    // AVX2: two independent accumulators to hide the FMA latency
+
+    __attribute__((target("avx2,fma"))) inline float horizontalSum(__m256 v)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        return _mm_cvtss_f32(sum);
+    }
+
+    __attribute__((target("avx2,fma"))) inline int32_t horizontalSum(__m256i v)
+    {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    __attribute__((target("avx2,fma"))) float dotF32Avx2(const float *a, const float *b, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        if (i + 8 <= n)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            i += 8;
+        }
+
+        float sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma"))) float l2SquaredF32Avx2(const float *a, const float *b, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        }
+        if (i + 8 <= n)
+        {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc0 = _mm256_fmadd_ps(d, d, acc0);
+            i += 8;
+        }
+
+        float sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+        for (; i < n; ++i)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    // int8 values are widened to int16, madd_epi16 multiplies and adds adjacent pairs into int32 lanes
+    __attribute__((target("avx2,fma"))) int32_t dotI8Avx2(const int8_t *a, const int8_t *b, size_t n)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+            __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+        }
+
+        int32_t sum = horizontalSum(acc);
+        for (; i < n; ++i)
+            sum += static_cast<int32_t>(a[i]) * b[i];
+        return sum;
+    }
+
+    const DistanceKernels AVX2_KERNELS{"avx2", dotF32Avx2, l2SquaredF32Avx2, dotI8Avx2};
+
+    // AVX-512: 16 floats / 32 int8 per iteration, float tails use masked loads
+
+    __attribute__((target("avx512f,avx512bw"))) float dotF32Avx512(const float *a, const float *b, size_t n)
+    {
+        __m512 acc = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+
+        if (i < n)
+        {
+            __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc);
+        }
+        return _mm512_reduce_add_ps(acc);
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) float l2SquaredF32Avx512(const float *a, const float *b, size_t n)
+    {
+        __m512 acc = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+            acc = _mm512_fmadd_ps(d, d, acc);
+        }
+
+        if (i < n)
+        {
+            __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+            acc = _mm512_fmadd_ps(d, d, acc);
+        }
+        return _mm512_reduce_add_ps(acc);
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) int32_t dotI8Avx512(const int8_t *a, const int8_t *b, size_t n)
+    {
+        __m512i acc = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m512i va = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)));
+            __m512i vb = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+            acc = _mm512_add_epi32(acc, _mm512_madd_epi16(va, vb));
+        }
+
+        int32_t sum = _mm512_reduce_add_epi32(acc);
+        for (; i < n; ++i)
+            sum += static_cast<int32_t>(a[i]) * b[i];
+        return sum;
+    }
+
+    const DistanceKernels AVX512_KERNELS{"avx512", dotF32Avx512, l2SquaredF32Avx512, dotI8Avx512};
+
+    bool cpuHasAvx2()
+    {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+
+    bool cpuHasAvx512()
+    {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+
+#endif // VECTOR_KERNELS_X86
+}
+
+std::vector<const DistanceKernels *> SupportedDistanceKernels()
+{
+    std::vector<const DistanceKernels *> kernels{&SCALAR_KERNELS};
+#ifdef VECTOR_KERNELS_X86
+    if (cpuHasAvx2())
+        kernels.push_back(&AVX2_KERNELS);
+    if (cpuHasAvx512())
+        kernels.push_back(&AVX512_KERNELS);
+#endif
+    return kernels;
+}
+
+const DistanceKernels &ActiveDistanceKernels()
+{
+    static const DistanceKernels &active = *SupportedDistanceKernels().back();
+    return active;
+}
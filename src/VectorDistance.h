@@ -0,0 +1,31 @@
+#ifndef VECTORDISTANCE_H
+#define VECTORDISTANCE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*
+   Distance kernels for vector sets
+   - Scalar, AVX2 (+FMA) and AVX-512 (F + BW) versions of the same primitives, the best set the
+     CPU supports is picked once at runtime so one binary runs everywhere
+   - Cosine and inner product are built on the dot product (cosine vectors are normalized on insert),
+     L2 has its own float kernel. int8 vectors only need the dot product: L2 is derived from the
+     precomputed norms as |a|^2 + |b|^2 - 2 a.b
+*/
+
+struct DistanceKernels
+{
+    const char *name;
+    float (*dotF32)(const float *a, const float *b, size_t n);
+    float (*l2SquaredF32)(const float *a, const float *b, size_t n);
+    int32_t (*dotI8)(const int8_t *a, const int8_t *b, size_t n);
+};
+
+/* Fastest kernels supported by the running CPU, selected on first use */
+const DistanceKernels &ActiveDistanceKernels();
+
+/* Every kernel set the running CPU can execute, scalar first (used by the benchmarks) */
+std::vector<const DistanceKernels *> SupportedDistanceKernels();
+
+#endif // VECTORDISTANCE_H
@@ -0,0 +1,259 @@
+
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+
+#include "VectorHandler.h"
+#include "Rdb.h"
+#include "RESPEncoder.h"
+#include "Utility.h"
+#include "SupportedCommands.h"
+
+std::string VectorHandler::VectorCommandProcessor(CommandArray commandArgs)
+{
+    if (!commandArgs || commandArgs->empty())
+        throw std::runtime_error("Invalid command Array");
+
+    commandArgs->at(0).assign(toLower(commandArgs->at(0)));
+
+    std::string_view command = (*commandArgs)[0];
+    try
+    {
+        if (command == VADD)
+            return vaddHandler(std::move(commandArgs));
+        else if (command == VSIM)
+            return vsimHandler(std::move(commandArgs));
+        else if (command == VREM)
+            return vremHandler(std::move(commandArgs));
+        else if (command == VCARD)
+            return vcardHandler(std::move(commandArgs));
+        else if (command == VDIM)
+            return vdimHandler(std::move(commandArgs));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return RESPEncoder::encodeError(std::string("bad arguments: ") + e.what());
+    }
+    catch (const std::out_of_range &e)
+    {
+        return RESPEncoder::encodeError("value out of range");
+    }
+
+    return RESPEncoder::encodeError("Unsupported vector set command");
+}
+
+std::vector<float> VectorHandler::parseVector(const std::vector<std::string> &args, size_t &index)
+{
+    if (index >= args.size())
+        throw std::invalid_argument("missing vector");
+
+    std::string format = toLower(args[index]);
+    std::vector<float> vector;
+
+    if (format == "fp32" && index + 1 < args.size())
+    {
+        const std::string &blob = args[index + 1];
+        if (blob.empty() || blob.size() % sizeof(float) != 0)
+            throw std::invalid_argument("FP32 blob size must be a multiple of 4");
+
+        vector.resize(blob.size() / sizeof(float));
+        std::memcpy(vector.data(), blob.data(), blob.size()); // little endian, same as Redis
+        index += 2;
+    }
+    else if (format == "values" && index + 1 < args.size())
+    {
+        size_t count = std::stoul(args[index + 1]);
+        if (count == 0 || index + 2 + count > args.size())
+            throw std::invalid_argument("VALUES count doesn't match the number of values");
+
+        vector.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            vector.push_back(std::stof(args[index + 2 + i]));
+        index += 2 + count;
+    }
+    else
+    {
+        throw std::invalid_argument("expected FP32 or VALUES");
+    }
+
+    return vector;
+}
+
+// VADD key (FP32 blob | VALUES n v1 .. vn) element [NOQUANT | Q8] [M m] [EF ef] [METRIC COSINE|L2|IP] [FLAT]
+// Index options only apply when the first element creates the set
+std::string VectorHandler::vaddHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 5)
+        return RESPEncoder::encodeError("wrong number of arguments for 'vadd' command");
+
+    const std::string &key = (*commandArgs)[1];
+    size_t index = 2;
+    std::vector<float> vector = parseVector(*commandArgs, index);
+
+    if (index >= commandArgs->size())
+        return RESPEncoder::encodeError("wrong number of arguments for 'vadd' command");
+    const std::string &element = (*commandArgs)[index++];
+
+    VectorSet::Options options;
+    while (index < commandArgs->size())
+    {
+        std::string option = toLower((*commandArgs)[index++]);
+        if (option == "noquant")
+            options.quantization = VectorSet::Quantization::FP32;
+        else if (option == "q8")
+            options.quantization = VectorSet::Quantization::INT8;
+        else if (option == "flat")
+            options.index = VectorSet::IndexType::FLAT;
+        else if (option == "m" && index < commandArgs->size())
+            options.M = std::stoul((*commandArgs)[index++]);
+        else if (option == "ef" && index < commandArgs->size())
+            options.efConstruction = std::stoul((*commandArgs)[index++]);
+        else if (option == "metric" && index < commandArgs->size())
+        {
+            std::string metric = toLower((*commandArgs)[index++]);
+            if (metric == "cosine")
+                options.metric = VectorSet::Metric::COSINE;
+            else if (metric == "l2")
+                options.metric = VectorSet::Metric::L2;
+            else if (metric == "ip")
+                options.metric = VectorSet::Metric::IP;
+            else
+                return RESPEncoder::encodeError("unknown metric '" + metric + "'");
+        }
+        else
+            return RESPEncoder::encodeError("syntax error near '" + (*commandArgs)[index - 1] + "'");
+    }
+
+    auto it = m_vectorSets.find(key);
+    if (it == m_vectorSets.end())
+        it = m_vectorSets.emplace(key, std::make_unique<VectorSet>(vector.size(), options)).first;
+    else if (it->second->Dimension() != vector.size())
+        return RESPEncoder::encodeError("Vector dimension mismatch - got " + std::to_string(vector.size()) +
+                                        " but set has " + std::to_string(it->second->Dimension()));
+
+    return RESPEncoder::encodeInteger(it->second->Add(element, vector.data()) ? 1 : 0);
+}
+
+// VSIM key (ELE element | FP32 blob | VALUES n v1 .. vn) [WITHSCORES] [COUNT n] [EF ef]
+// Scores are distances (lower is closer): 1 - cosine similarity, euclidean distance or -dot product
+std::string VectorHandler::vsimHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() < 4)
+        return RESPEncoder::encodeError("wrong number of arguments for 'vsim' command");
+
+    auto it = m_vectorSets.find((*commandArgs)[1]);
+    if (it == m_vectorSets.end())
+        return RESPEncoder::encodeArray({}, true);
+
+    size_t index = 2;
+    std::vector<float> query;
+    if (toLower((*commandArgs)[index]) == "ele")
+    {
+        auto stored = it->second->GetVector((*commandArgs)[index + 1]);
+        if (!stored)
+            return RESPEncoder::encodeError("element not found in the set");
+        query = std::move(*stored);
+        index += 2;
+    }
+    else
+    {
+        query = parseVector(*commandArgs, index);
+    }
+
+    if (query.size() != it->second->Dimension())
+        return RESPEncoder::encodeError("Vector dimension mismatch - got " + std::to_string(query.size()) +
+                                        " but set has " + std::to_string(it->second->Dimension()));
+
+    bool withScores = false;
+    size_t count = 10;
+    uint32_t ef = 0;
+    while (index < commandArgs->size())
+    {
+        std::string option = toLower((*commandArgs)[index++]);
+        if (option == "withscores")
+            withScores = true;
+        else if (option == "count" && index < commandArgs->size())
+            count = std::stoul((*commandArgs)[index++]);
+        else if (option == "ef" && index < commandArgs->size())
+            ef = std::stoul((*commandArgs)[index++]);
+        else
+            return RESPEncoder::encodeError("syntax error near '" + (*commandArgs)[index - 1] + "'");
+    }
+
+    std::vector<std::string> results;
+    for (const auto &[element, distance] : it->second->Search(query.data(), count, ef))
+    {
+        results.push_back(RESPEncoder::encodeString(element));
+        if (withScores)
+        {
+            char buffer[32];
+            auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), distance);
+            results.push_back(RESPEncoder::encodeString(std::string(buffer, end)));
+        }
+    }
+
+    return RESPEncoder::encodeArray(results, true);
+}
+
+// VREM key element, the key is deleted with its last element
+std::string VectorHandler::vremHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 3)
+        return RESPEncoder::encodeError("wrong number of arguments for 'vrem' command");
+
+    auto it = m_vectorSets.find((*commandArgs)[1]);
+    if (it == m_vectorSets.end() || !it->second->Remove((*commandArgs)[2]))
+        return RESPEncoder::encodeInteger(0);
+
+    if (it->second->Size() == 0)
+        m_vectorSets.erase(it);
+
+    return RESPEncoder::encodeInteger(1);
+}
+
+// VCARD key
+std::string VectorHandler::vcardHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'vcard' command");
+
+    auto it = m_vectorSets.find((*commandArgs)[1]);
+    return RESPEncoder::encodeInteger(it == m_vectorSets.end() ? 0 : it->second->Size());
+}
+
+// VDIM key
+std::string VectorHandler::vdimHandler(CommandArray commandArgs)
+{
+    if (commandArgs->size() != 2)
+        return RESPEncoder::encodeError("wrong number of arguments for 'vdim' command");
+
+    auto it = m_vectorSets.find((*commandArgs)[1]);
+    if (it == m_vectorSets.end())
+        return RESPEncoder::encodeError("key does not exist");
+
+    return RESPEncoder::encodeInteger(it->second->Dimension());
+}
+
+void VectorHandler::SaveRdb(RdbWriter &writer, const RdbSegment &segment) const
+{
+    for (const auto &[key, value] : segment.Of(m_vectorSets))
+    {
+        writer.WriteKey(RDB_TYPE_VECTORSET, key);
+        writer.WriteString(value->Serialize());
+    }
+}
+
+void VectorHandler::LoadRdb(RdbReader &reader, uint8_t, const std::string &key)
+{
+    m_vectorSets[key] = VectorSet::Deserialize(reader.ReadString());
+}
+
+void VectorHandler::MergeFrom(VectorHandler &other)
+{
+    m_vectorSets.merge(other.m_vectorSets);
+}
+
+void VectorHandler::Swap(VectorHandler &other)
+{
+    m_vectorSets.swap(other.m_vectorSets);
+}
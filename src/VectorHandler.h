@@ -0,0 +1,43 @@
+#ifndef VECTORHANDLER_H
+#define VECTORHANDLER_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "VectorSet.h"
+
+using CommandArray = std::unique_ptr<std::vector<std::string>>;
+
+class RdbWriter;
+class RdbReader;
+struct RdbSegment;
+
+class VectorHandler
+{
+private:
+    std::unordered_map<std::string, std::unique_ptr<VectorSet>> m_vectorSets;
+
+    std::string vaddHandler(CommandArray commandArgs);
+    std::string vsimHandler(CommandArray commandArgs);
+    std::string vremHandler(CommandArray commandArgs);
+    std::string vcardHandler(CommandArray commandArgs);
+    std::string vdimHandler(CommandArray commandArgs);
+
+    // Parses "FP32 <blob>" or "VALUES <n> <v1> ... <vn>" starting at 'index', moves 'index' past it
+    static std::vector<float> parseVector(const std::vector<std::string> &args, size_t &index);
+
+public:
+    std::string VectorCommandProcessor(CommandArray commandArgs);
+
+    bool IsVectorSetPresent(const std::string &key) const { return m_vectorSets.contains(key); }
+
+    size_t KeyCount() const { return m_vectorSets.size(); }
+    void SaveRdb(RdbWriter &writer, const RdbSegment &segment) const;
+    void LoadRdb(RdbReader &reader, uint8_t type, const std::string &key);
+    void MergeFrom(VectorHandler &other);
+    void Swap(VectorHandler &other);
+};
+
+#endif // VECTORHANDLER_H
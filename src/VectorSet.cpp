@@ -0,0 +1,584 @@
+
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <algorithm>
+#include <stdexcept>
+
+#include "VectorSet.h"
+#include "Utility.h"
+
+VectorSet::VectorSet(uint32_t dimension, const Options &options)
+    : m_dimension(dimension), m_options(options), m_kernels(ActiveDistanceKernels())
+{
+    if (dimension == 0 || dimension > MAX_DIMENSION)
+        throw std::invalid_argument("vector dimension must be in the range [1, 32768]");
+    if (options.M < 2 || options.M > 512)
+        throw std::invalid_argument("M must be in the range [2, 512]");
+    if (options.efConstruction == 0)
+        throw std::invalid_argument("EF must be positive");
+}
+
+VectorSet::PreparedVector VectorSet::prepare(const float *vector) const
+{
+    PreparedVector prepared;
+    prepared.f32.assign(vector, vector + m_dimension);
+
+    if (m_options.metric == Metric::COSINE)
+    {
+        float norm = std::sqrt(m_kernels.dotF32(prepared.f32.data(), prepared.f32.data(), m_dimension));
+        if (norm > 0)
+        {
+            for (auto &value : prepared.f32)
+                value /= norm;
+        }
+    }
+
+    if (m_options.quantization == Quantization::INT8)
+    {
+        float maxAbs = 0;
+        for (float value : prepared.f32)
+            maxAbs = std::max(maxAbs, std::fabs(value));
+
+        prepared.scale = maxAbs / 127.0f;
+        prepared.i8.resize(m_dimension);
+        for (uint32_t i = 0; i < m_dimension; ++i)
+            prepared.i8[i] = prepared.scale > 0 ? static_cast<int8_t>(std::lround(prepared.f32[i] / prepared.scale)) : 0;
+
+        prepared.squaredNorm = prepared.scale * prepared.scale * m_kernels.dotI8(prepared.i8.data(), prepared.i8.data(), m_dimension);
+    }
+    else
+    {
+        prepared.squaredNorm = m_kernels.dotF32(prepared.f32.data(), prepared.f32.data(), m_dimension);
+    }
+
+    return prepared;
+}
+
+VectorSet::VectorView VectorSet::view(uint32_t id) const
+{
+    if (m_options.quantization == Quantization::INT8)
+        return {nullptr, m_i8.data() + static_cast<size_t>(id) * m_dimension, m_scales[id], m_squaredNorms[id]};
+
+    return {m_f32.data() + static_cast<size_t>(id) * m_dimension, nullptr, 0, m_squaredNorms[id]};
+}
+
+// Lower is closer for every metric: cosine => 1 - cos, L2 => squared euclidean, IP => -dot
+float VectorSet::distance(const VectorView &a, const VectorView &b) const
+{
+    float dot;
+    if (m_options.quantization == Quantization::INT8)
+    {
+        dot = a.scale * b.scale * m_kernels.dotI8(a.i8, b.i8, m_dimension);
+        if (m_options.metric == Metric::L2)
+            return std::max(0.0f, a.squaredNorm + b.squaredNorm - 2 * dot);
+    }
+    else
+    {
+        if (m_options.metric == Metric::L2)
+            return m_kernels.l2SquaredF32(a.f32, b.f32, m_dimension);
+        dot = m_kernels.dotF32(a.f32, b.f32, m_dimension);
+    }
+
+    return m_options.metric == Metric::COSINE ? 1.0f - dot : -dot;
+}
+
+uint32_t VectorSet::allocateNode(const std::string &element, const PreparedVector &vector)
+{
+    uint32_t id;
+    if (!m_freeIds.empty())
+    {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else
+    {
+        id = m_nodes.size();
+        m_nodes.emplace_back();
+        m_scales.push_back(0);
+        m_squaredNorms.push_back(0);
+        if (m_options.quantization == Quantization::INT8)
+            m_i8.resize(m_i8.size() + m_dimension);
+        else
+            m_f32.resize(m_f32.size() + m_dimension);
+    }
+
+    size_t offset = static_cast<size_t>(id) * m_dimension;
+    if (m_options.quantization == Quantization::INT8)
+        std::copy(vector.i8.begin(), vector.i8.end(), m_i8.begin() + offset);
+    else
+        std::copy(vector.f32.begin(), vector.f32.end(), m_f32.begin() + offset);
+
+    m_scales[id] = vector.scale;
+    m_squaredNorms[id] = vector.squaredNorm;
+
+    Node &node = m_nodes[id];
+    node.element = element;
+    node.alive = true;
+    node.links.clear();
+
+    m_ids[element] = id;
+    return id;
+}
+
+// Exponentially decaying level distribution, mL = 1 / ln(M). The uniform draw comes from a hash of the
+// element, so a replica or a reload builds the same graph from the same adds
+int VectorSet::levelOf(const std::string &element) const
+{
+    double uniform = static_cast<double>((murmurHash64A(element) >> 11) + 1) * 0x1p-53; // (0, 1]
+    int level = static_cast<int>(-std::log(uniform) / std::log(static_cast<double>(m_options.M)));
+    return std::min(level, MAX_LEVEL);
+}
+
+uint32_t VectorSet::newVisitEpoch() const
+{
+    if (m_visited.size() < m_nodes.size())
+        m_visited.resize(m_nodes.size(), 0);
+
+    if (++m_visitEpoch == 0)
+    {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_visitEpoch = 1;
+    }
+    return m_visitEpoch;
+}
+
+bool VectorSet::Add(const std::string &element, const float *vector)
+{
+    bool isNew = true;
+    if (m_ids.contains(element))
+    {
+        Remove(element);
+        isNew = false;
+    }
+
+    uint32_t id = allocateNode(element, prepare(vector));
+    if (m_options.index == IndexType::HNSW)
+        insertIntoGraph(id);
+
+    return isNew;
+}
+
+bool VectorSet::Remove(const std::string &element)
+{
+    auto it = m_ids.find(element);
+    if (it == m_ids.end())
+        return false;
+
+    uint32_t id = it->second;
+    m_ids.erase(it);
+
+    if (m_options.index == IndexType::HNSW)
+        removeFromGraph(id);
+
+    Node &node = m_nodes[id];
+    node.alive = false;
+    node.links.clear();
+    node.links.shrink_to_fit();
+    std::string().swap(node.element);
+    m_freeIds.push_back(id);
+
+    return true;
+}
+
+uint32_t VectorSet::greedyDescend(const VectorView &query, int toLevel) const
+{
+    uint32_t current = m_entryPoint;
+    float currentDistance = distance(query, view(current));
+
+    for (int level = m_maxLevel; level > toLevel; --level)
+    {
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (uint32_t neighbour : m_nodes[current].links[level])
+            {
+                float d = distance(query, view(neighbour));
+                if (d < currentDistance)
+                {
+                    current = neighbour;
+                    currentDistance = d;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return current;
+}
+
+// Best-first search of one layer, returns up to ef candidates sorted closest first
+std::vector<VectorSet::Candidate> VectorSet::searchLayer(const VectorView &query, uint32_t entry, size_t ef, int level) const
+{
+    uint32_t epoch = newVisitEpoch();
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> candidates; // closest on top
+    std::priority_queue<Candidate> results;                                           // farthest on top
+
+    float entryDistance = distance(query, view(entry));
+    candidates.emplace(entryDistance, entry);
+    results.emplace(entryDistance, entry);
+    m_visited[entry] = epoch;
+
+    while (!candidates.empty())
+    {
+        auto [currentDistance, current] = candidates.top();
+        if (currentDistance > results.top().first && results.size() >= ef)
+            break;
+        candidates.pop();
+
+        for (uint32_t neighbour : m_nodes[current].links[level])
+        {
+            if (m_visited[neighbour] == epoch)
+                continue;
+            m_visited[neighbour] = epoch;
+
+            float d = distance(query, view(neighbour));
+            if (results.size() < ef || d < results.top().first)
+            {
+                candidates.emplace(d, neighbour);
+                results.emplace(d, neighbour);
+                if (results.size() > ef)
+                    results.pop();
+            }
+        }
+    }
+
+    std::vector<Candidate> sorted(results.size());
+    for (size_t i = sorted.size(); i-- > 0; results.pop())
+        sorted[i] = results.top();
+
+    return sorted;
+}
+
+// HNSW heuristic: skip a candidate that is closer to an already selected neighbour than to the base,
+// keeps links spread in different directions. Pruned candidates fill any remaining slots.
+std::vector<uint32_t> VectorSet::selectNeighbours(const std::vector<Candidate> &candidates, size_t count) const
+{
+    std::vector<uint32_t> selected;
+    std::vector<uint32_t> pruned;
+
+    for (const auto &[candidateDistance, candidate] : candidates)
+    {
+        if (selected.size() == count)
+            break;
+
+        bool diverse = std::none_of(selected.begin(), selected.end(),
+                                    [&](uint32_t chosen) { return distance(candidate, chosen) < candidateDistance; });
+        if (diverse)
+            selected.push_back(candidate);
+        else
+            pruned.push_back(candidate);
+    }
+
+    for (size_t i = 0; i < pruned.size() && selected.size() < count; ++i)
+        selected.push_back(pruned[i]);
+
+    return selected;
+}
+
+// Adds 'to' to the links of 'from', evicting the farthest link of a full list (and its back link).
+// Returns false when 'to' is farther than every existing link of a full list.
+bool VectorSet::linkTo(uint32_t from, uint32_t to, int level)
+{
+    auto &links = m_nodes[from].links[level];
+    if (links.size() < maxLinks(level))
+    {
+        links.push_back(to);
+        return true;
+    }
+
+    size_t farthest = 0;
+    float farthestDistance = -INFINITY;
+    for (size_t i = 0; i < links.size(); ++i)
+    {
+        float d = distance(from, links[i]);
+        if (d > farthestDistance)
+        {
+            farthestDistance = d;
+            farthest = i;
+        }
+    }
+
+    if (distance(from, to) >= farthestDistance)
+        return false;
+
+    uint32_t evicted = links[farthest];
+    links[farthest] = to;
+    unlink(evicted, from, level);
+    return true;
+}
+
+void VectorSet::unlink(uint32_t from, uint32_t to, int level)
+{
+    auto &links = m_nodes[from].links[level];
+    auto it = std::find(links.begin(), links.end(), to);
+    if (it != links.end())
+    {
+        *it = links.back();
+        links.pop_back();
+    }
+}
+
+void VectorSet::insertIntoGraph(uint32_t id)
+{
+    int level = levelOf(m_nodes[id].element);
+    m_nodes[id].links.assign(level + 1, {});
+
+    if (m_entryPoint == NO_NODE)
+    {
+        m_entryPoint = id;
+        m_maxLevel = level;
+        return;
+    }
+
+    VectorView query = view(id);
+    uint32_t entry = greedyDescend(query, level);
+
+    for (int l = std::min(level, m_maxLevel); l >= 0; --l)
+    {
+        auto candidates = searchLayer(query, entry, m_options.efConstruction, l);
+        for (uint32_t neighbour : selectNeighbours(candidates, m_options.M))
+        {
+            if (linkTo(neighbour, id, l))
+                m_nodes[id].links[l].push_back(neighbour);
+        }
+        entry = candidates.front().second;
+    }
+
+    if (level > m_maxLevel)
+    {
+        m_entryPoint = id;
+        m_maxLevel = level;
+    }
+}
+
+void VectorSet::removeFromGraph(uint32_t id)
+{
+    Node &node = m_nodes[id];
+
+    for (int level = 0; level < static_cast<int>(node.links.size()); ++level)
+    {
+        const auto orphans = node.links[level];
+        for (uint32_t neighbour : orphans)
+            unlink(neighbour, id, level);
+
+        // Every former neighbour tries to link to the closest of the other former neighbours
+        for (uint32_t neighbour : orphans)
+        {
+            std::vector<Candidate> candidates;
+            const auto &links = m_nodes[neighbour].links[level];
+            for (uint32_t other : orphans)
+            {
+                if (other != neighbour && std::find(links.begin(), links.end(), other) == links.end())
+                    candidates.emplace_back(distance(neighbour, other), other);
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            for (const auto &[d, other] : candidates)
+            {
+                if (m_nodes[neighbour].links[level].size() >= maxLinks(level))
+                    break;
+                if (linkTo(other, neighbour, level))
+                    m_nodes[neighbour].links[level].push_back(other);
+            }
+        }
+    }
+
+    if (m_entryPoint != id)
+        return;
+
+    // New entry point: any node on the highest remaining level
+    m_entryPoint = NO_NODE;
+    m_maxLevel = -1;
+    for (uint32_t other = 0; other < m_nodes.size(); ++other)
+    {
+        int level = static_cast<int>(m_nodes[other].links.size()) - 1;
+        if (other != id && m_nodes[other].alive && level > m_maxLevel)
+        {
+            m_entryPoint = other;
+            m_maxLevel = level;
+        }
+    }
+}
+
+std::vector<std::pair<std::string, float>> VectorSet::Search(const float *query, size_t k, uint32_t ef) const
+{
+    std::vector<std::pair<std::string, float>> result;
+    if (m_ids.empty() || k == 0)
+        return result;
+
+    PreparedVector prepared = prepare(query);
+    VectorView queryView = prepared.View();
+    std::vector<Candidate> nearest;
+
+    if (m_options.index == IndexType::FLAT)
+    {
+        std::priority_queue<Candidate> best; // farthest on top
+        for (uint32_t id = 0; id < m_nodes.size(); ++id)
+        {
+            if (!m_nodes[id].alive)
+                continue;
+
+            float d = distance(queryView, view(id));
+            if (best.size() < k)
+                best.emplace(d, id);
+            else if (d < best.top().first)
+            {
+                best.pop();
+                best.emplace(d, id);
+            }
+        }
+
+        nearest.resize(best.size());
+        for (size_t i = nearest.size(); i-- > 0; best.pop())
+            nearest[i] = best.top();
+    }
+    else
+    {
+        uint32_t entry = greedyDescend(queryView, 0);
+        nearest = searchLayer(queryView, entry, std::max<size_t>(k, ef ? ef : DEFAULT_EF_SEARCH), 0);
+        if (nearest.size() > k)
+            nearest.resize(k);
+    }
+
+    result.reserve(nearest.size());
+    for (const auto &[d, id] : nearest)
+    {
+        // int8 rounding can push a self match slightly below zero
+        if (m_options.metric == Metric::L2)
+            result.emplace_back(m_nodes[id].element, std::sqrt(d));
+        else if (m_options.metric == Metric::COSINE)
+            result.emplace_back(m_nodes[id].element, std::max(0.0f, d));
+        else
+            result.emplace_back(m_nodes[id].element, d);
+    }
+
+    return result;
+}
+
+std::optional<std::vector<float>> VectorSet::GetVector(const std::string &element) const
+{
+    auto it = m_ids.find(element);
+    if (it == m_ids.end())
+        return std::nullopt;
+
+    size_t offset = static_cast<size_t>(it->second) * m_dimension;
+    if (m_options.quantization == Quantization::FP32)
+        return std::vector<float>(m_f32.begin() + offset, m_f32.begin() + offset + m_dimension);
+
+    std::vector<float> vector(m_dimension);
+    for (uint32_t i = 0; i < m_dimension; ++i)
+        vector[i] = m_i8[offset + i] * m_scales[it->second];
+    return vector;
+}
+
+size_t VectorSet::MemoryUsage() const
+{
+    size_t bytes = sizeof(*this) + m_f32.capacity() * sizeof(float) + m_i8.capacity() +
+                   (m_scales.capacity() + m_squaredNorms.capacity()) * sizeof(float) + m_nodes.capacity() * sizeof(Node);
+
+    for (const auto &node : m_nodes)
+    {
+        bytes += node.element.capacity() + node.links.capacity() * sizeof(std::vector<uint32_t>);
+        for (const auto &links : node.links)
+            bytes += links.capacity() * sizeof(uint32_t);
+    }
+
+    return bytes + m_ids.size() * (sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void *));
+}
+
+std::string VectorSet::Serialize() const
+{
+    std::string blob;
+    appendBinary<uint32_t>(blob, m_dimension);
+    appendBinary<uint8_t>(blob, static_cast<uint8_t>(m_options.metric));
+    appendBinary<uint8_t>(blob, static_cast<uint8_t>(m_options.quantization));
+    appendBinary<uint8_t>(blob, static_cast<uint8_t>(m_options.index));
+    appendBinary<uint32_t>(blob, m_options.M);
+    appendBinary<uint32_t>(blob, m_options.efConstruction);
+    appendBinary<uint32_t>(blob, m_entryPoint);
+    appendBinary<int32_t>(blob, m_maxLevel);
+
+    appendBinary<uint64_t>(blob, m_nodes.size());
+    for (const auto &node : m_nodes)
+    {
+        appendBinary<uint8_t>(blob, node.alive);
+        if (!node.alive)
+            continue;
+
+        appendBinaryString(blob, node.element);
+        appendBinary<uint8_t>(blob, node.links.size());
+        for (const auto &links : node.links)
+        {
+            appendBinary<uint32_t>(blob, links.size());
+            blob.append(reinterpret_cast<const char *>(links.data()), links.size() * sizeof(uint32_t));
+        }
+    }
+
+    blob.append(reinterpret_cast<const char *>(m_f32.data()), m_f32.size() * sizeof(float));
+    blob.append(reinterpret_cast<const char *>(m_i8.data()), m_i8.size());
+    blob.append(reinterpret_cast<const char *>(m_scales.data()), m_scales.size() * sizeof(float));
+    blob.append(reinterpret_cast<const char *>(m_squaredNorms.data()), m_squaredNorms.size() * sizeof(float));
+
+    return blob;
+}
+
+std::unique_ptr<VectorSet> VectorSet::Deserialize(const std::string &blob)
+{
+    BinaryReader reader(blob);
+    auto dimension = reader.read<uint32_t>();
+
+    Options options;
+    options.metric = static_cast<Metric>(reader.read<uint8_t>());
+    options.quantization = static_cast<Quantization>(reader.read<uint8_t>());
+    options.index = static_cast<IndexType>(reader.read<uint8_t>());
+    options.M = reader.read<uint32_t>();
+    options.efConstruction = reader.read<uint32_t>();
+
+    auto set = std::make_unique<VectorSet>(dimension, options);
+    set->m_entryPoint = reader.read<uint32_t>();
+    set->m_maxLevel = reader.read<int32_t>();
+
+    auto numNodes = reader.read<uint64_t>();
+    set->m_nodes.resize(numNodes);
+    for (uint32_t id = 0; id < numNodes; ++id)
+    {
+        Node &node = set->m_nodes[id];
+        node.alive = reader.read<uint8_t>();
+        if (!node.alive)
+        {
+            set->m_freeIds.push_back(id);
+            continue;
+        }
+
+        node.element = reader.readString();
+        node.links.resize(reader.read<uint8_t>());
+        for (auto &links : node.links)
+        {
+            links.resize(reader.read<uint32_t>());
+            std::memcpy(links.data(), reader.readBytes(links.size() * sizeof(uint32_t)), links.size() * sizeof(uint32_t));
+        }
+        set->m_ids[node.element] = id;
+    }
+
+    size_t values = numNodes * dimension;
+    if (options.quantization == Quantization::INT8)
+    {
+        set->m_i8.resize(values);
+        std::memcpy(set->m_i8.data(), reader.readBytes(values), values);
+    }
+    else
+    {
+        set->m_f32.resize(values);
+        std::memcpy(set->m_f32.data(), reader.readBytes(values * sizeof(float)), values * sizeof(float));
+    }
+
+    set->m_scales.resize(numNodes);
+    std::memcpy(set->m_scales.data(), reader.readBytes(numNodes * sizeof(float)), numNodes * sizeof(float));
+    set->m_squaredNorms.resize(numNodes);
+    std::memcpy(set->m_squaredNorms.data(), reader.readBytes(numNodes * sizeof(float)), numNodes * sizeof(float));
+
+    return set;
+}
@@ -0,0 +1,151 @@
+#ifndef VECTORSET_H
+#define VECTORSET_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <cstdint>
+
+#include "VectorDistance.h"
+
+/*
+   Vector set
+   - Named elements with a fixed dimension vector each, k nearest neighbour search
+   - Index is either FLAT (exact, every vector is compared) or an HNSW graph (approximate, ~log N)
+   - Vectors are kept as float32 or int8 (per vector scale = max |x| / 127, 4x less memory and
+     faster distance kernels for a small loss of recall)
+   - HNSW links are always kept bidirectional so deleting an element only touches its own
+     neighbours, which are then reconnected among themselves
+*/
+
+class VectorSet
+{
+public:
+    enum class Metric : uint8_t
+    {
+        COSINE,
+        L2,
+        IP
+    };
+
+    enum class Quantization : uint8_t
+    {
+        FP32,
+        INT8
+    };
+
+    enum class IndexType : uint8_t
+    {
+        HNSW,
+        FLAT
+    };
+
+    static constexpr uint32_t DEFAULT_M = 16;
+    static constexpr uint32_t DEFAULT_EF_CONSTRUCTION = 200;
+    static constexpr uint32_t DEFAULT_EF_SEARCH = 100;
+    static constexpr uint32_t MAX_DIMENSION = 32768;
+
+    struct Options
+    {
+        Metric metric{Metric::COSINE};
+        Quantization quantization{Quantization::INT8};
+        IndexType index{IndexType::HNSW};
+        uint32_t M{DEFAULT_M};                            // links per node and layer (2 * M on layer 0)
+        uint32_t efConstruction{DEFAULT_EF_CONSTRUCTION}; // candidate list size while inserting
+    };
+
+    VectorSet(uint32_t dimension, const Options &options);
+
+    /* Returns true for a new element, false when the vector of an existing element was replaced */
+    bool Add(const std::string &element, const float *vector);
+    bool Remove(const std::string &element);
+    bool Contains(const std::string &element) const { return m_ids.contains(element); }
+
+    /* Up to k (element, distance) pairs, closest first. 'ef' is the HNSW search width (0 = default) */
+    std::vector<std::pair<std::string, float>> Search(const float *query, size_t k, uint32_t ef = 0) const;
+
+    /* Vector as stored: normalized for cosine, dequantized for int8 */
+    std::optional<std::vector<float>> GetVector(const std::string &element) const;
+
+    size_t Size() const { return m_ids.size(); }
+    uint32_t Dimension() const { return m_dimension; }
+    const Options &GetOptions() const { return m_options; }
+    size_t MemoryUsage() const;
+
+    std::string Serialize() const;
+    static std::unique_ptr<VectorSet> Deserialize(const std::string &blob);
+
+private:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+    static constexpr int MAX_LEVEL = 16;
+
+    struct Node
+    {
+        std::string element;
+        bool alive{};
+        std::vector<std::vector<uint32_t>> links; // links[level]
+    };
+
+    // Query or stored vector in the form the distance function needs
+    struct VectorView
+    {
+        const float *f32{};
+        const int8_t *i8{};
+        float scale{};
+        float squaredNorm{};
+    };
+
+    struct PreparedVector
+    {
+        std::vector<float> f32;
+        std::vector<int8_t> i8;
+        float scale{};
+        float squaredNorm{};
+
+        VectorView View() const { return {f32.data(), i8.data(), scale, squaredNorm}; }
+    };
+
+    using Candidate = std::pair<float, uint32_t>; // (distance, node id)
+
+    uint32_t m_dimension;
+    Options m_options;
+    const DistanceKernels &m_kernels;
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_freeIds;
+    std::unordered_map<std::string, uint32_t> m_ids;
+
+    std::vector<float> m_f32;    // m_dimension floats per node (FP32)
+    std::vector<int8_t> m_i8;    // m_dimension values per node (INT8)
+    std::vector<float> m_scales; // per node, INT8 only
+    std::vector<float> m_squaredNorms;
+
+    uint32_t m_entryPoint{NO_NODE};
+    int m_maxLevel{-1};
+
+    mutable std::vector<uint32_t> m_visited; // epoch per node, avoids clearing a visited set on every search
+    mutable uint32_t m_visitEpoch{};
+
+    PreparedVector prepare(const float *vector) const;
+    VectorView view(uint32_t id) const;
+    float distance(const VectorView &a, const VectorView &b) const;
+    float distance(uint32_t a, uint32_t b) const { return distance(view(a), view(b)); }
+
+    uint32_t allocateNode(const std::string &element, const PreparedVector &vector);
+    int levelOf(const std::string &element) const;
+    size_t maxLinks(int level) const { return level == 0 ? 2 * m_options.M : m_options.M; }
+    uint32_t newVisitEpoch() const;
+
+    uint32_t greedyDescend(const VectorView &query, int toLevel) const;
+    std::vector<Candidate> searchLayer(const VectorView &query, uint32_t entry, size_t ef, int level) const;
+    std::vector<uint32_t> selectNeighbours(const std::vector<Candidate> &candidates, size_t count) const;
+    bool linkTo(uint32_t from, uint32_t to, int level);
+    void unlink(uint32_t from, uint32_t to, int level);
+
+    void insertIntoGraph(uint32_t id);
+    void removeFromGraph(uint32_t id);
+};
+
+#endif // VECTORSET_H